@@ -193,6 +193,11 @@ GLXContext glXCreateContextAttribsARB (Display *dpy, GLXFBConfig config, GLXCont
 #define GLX_NO_RESET_NOTIFICATION_ARB     0x8261
 #endif /* GLX_ARB_create_context_robustness */
 
+#ifndef GLX_ARB_create_context_no_error
+#define GLX_ARB_create_context_no_error 1
+#define GLX_CONTEXT_OPENGL_NO_ERROR_ARB   0x31B3
+#endif /* GLX_ARB_create_context_no_error */
+
 #ifndef GLX_ARB_fbconfig_float
 #define GLX_ARB_fbconfig_float 1
 #define GLX_RGBA_FLOAT_TYPE_ARB           0x20B9
@@ -918,6 +918,14 @@ struct __DRIdri2LoaderExtensionRec {
  */
 #define __DRI_CTX_FLAG_ROBUST_BUFFER_ACCESS	0x00000004
 
+/**
+ * The application promises not to generate GL errors
+ * (GL_KHR_no_error); error checking may be skipped.
+ *
+ * \requires __DRI2_NO_ERROR.
+ */
+#define __DRI_CTX_FLAG_NO_ERROR			0x00000008
+
 /**
  * \name Context reset strategies.
  */
@@ -1333,6 +1341,21 @@ struct __DRIrobustnessExtensionRec {
    __DRIextension base;
 };
 
+/**
+ * No-error context driver extension.
+ *
+ * Existence of this extension means the driver can accept the
+ * \c __DRI_CTX_FLAG_NO_ERROR flag in
+ * \c __DRIdri2ExtensionRec::createContextAttribs.
+ */
+#define __DRI2_NO_ERROR "DRI_NoError"
+#define __DRI2_NO_ERROR_VERSION 1
+
+typedef struct __DRInoErrorExtensionRec __DRInoErrorExtension;
+struct __DRInoErrorExtensionRec {
+   __DRIextension base;
+};
+
 /**
  * DRI config options extension.
  *
@@ -516,6 +516,9 @@ dri2_setup_screen(_EGLDisplay *disp)
 
       if (dri2_dpy->robustness)
          disp->Extensions.EXT_create_context_robustness = EGL_TRUE;
+
+      if (dri2_dpy->no_error)
+         disp->Extensions.KHR_create_context_no_error = EGL_TRUE;
    }
 
    if (dri2_dpy->image) {
@@ -608,6 +611,9 @@ dri2_create_screen(_EGLDisplay *disp)
 	 if (strcmp(extensions[i]->name, __DRI2_ROBUSTNESS) == 0) {
             dri2_dpy->robustness = (__DRIrobustnessExtension *) extensions[i];
 	 }
+	 if (strcmp(extensions[i]->name, __DRI2_NO_ERROR) == 0) {
+            dri2_dpy->no_error = (__DRInoErrorExtension *) extensions[i];
+	 }
 	 if (strcmp(extensions[i]->name, __DRI2_CONFIG_QUERY) == 0) {
 	    dri2_dpy->config = (__DRI2configQueryExtension *) extensions[i];
 	 }
@@ -885,13 +891,17 @@ dri2_create_context(_EGLDriver *drv, _EGLDisplay *disp, _EGLConfig *conf,
          unsigned error;
          unsigned num_attribs = 0;
          uint32_t ctx_attribs[8];
+         uint32_t flags = dri2_ctx->base.Flags;
+
+         if (dri2_ctx->base.NoError)
+            flags |= __DRI_CTX_FLAG_NO_ERROR;
 
          ctx_attribs[num_attribs++] = __DRI_CTX_ATTRIB_MAJOR_VERSION;
          ctx_attribs[num_attribs++] = dri2_ctx->base.ClientMajorVersion;
          ctx_attribs[num_attribs++] = __DRI_CTX_ATTRIB_MINOR_VERSION;
          ctx_attribs[num_attribs++] = dri2_ctx->base.ClientMinorVersion;
 
-         if (dri2_ctx->base.Flags != 0) {
+         if (flags != 0) {
             /* If the implementation doesn't support the __DRI2_ROBUSTNESS
              * extension, don't even try to send it the robust-access flag.
              * It may explode.  Instead, generate the required EGL error here.
@@ -903,7 +913,7 @@ dri2_create_context(_EGLDriver *drv, _EGLDisplay *disp, _EGLConfig *conf,
             }
 
             ctx_attribs[num_attribs++] = __DRI_CTX_ATTRIB_FLAGS;
-            ctx_attribs[num_attribs++] = dri2_ctx->base.Flags;
+            ctx_attribs[num_attribs++] = flags;
          }
 
          if (dri2_ctx->base.ResetNotificationStrategy != EGL_NO_RESET_NOTIFICATION_KHR) {
@@ -197,6 +197,15 @@ _eglParseContextAttribList(_EGLContext *ctx, _EGLDisplay *dpy,
          ctx->Flags = EGL_CONTEXT_OPENGL_ROBUST_ACCESS_BIT_KHR;
          break;
 
+      case EGL_CONTEXT_OPENGL_NO_ERROR_KHR:
+         if (!dpy->Extensions.KHR_create_context_no_error) {
+            err = EGL_BAD_ATTRIBUTE;
+            break;
+         }
+
+         ctx->NoError = !!val;
+         break;
+
       default:
          err = EGL_BAD_ATTRIBUTE;
          break;
@@ -349,6 +358,18 @@ _eglParseContextAttribList(_EGLContext *ctx, _EGLDisplay *dpy,
       err = EGL_BAD_ATTRIBUTE;
    }
 
+   /* The EGL_KHR_create_context_no_error spec says:
+    *
+    *     "BAD_MATCH is generated if the EGL_CONTEXT_OPENGL_NO_ERROR_KHR is
+    *     TRUE at the same time as a debug or robustness context is
+    *     specified."
+    */
+   if (ctx->NoError &&
+       (ctx->Flags & (EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR
+                      | EGL_CONTEXT_OPENGL_ROBUST_ACCESS_BIT_KHR)) != 0) {
+      err = EGL_BAD_MATCH;
+   }
+
    return err;
 }
 
@@ -52,10 +52,13 @@ static unsigned hash_key(const void *key, unsigned key_size)
 
    assert(key_size % 4 == 0);
 
-   /* I'm sure this can be improved on:
+   /* Plain xor makes states which only differ by swapped or repeated
+    * words collide, so rotate and multiply after each word.
     */
-   for (i = 0; i < key_size/4; i++)
+   for (i = 0; i < key_size/4; i++) {
       hash ^= ikey[i];
+      hash = ((hash << 5) | (hash >> 27)) * 0x9e3779b1;
+   }
 
    return hash;
 }
@@ -216,7 +219,7 @@ void *cso_hash_find_data_from_template( struct cso_hash *hash,
 	  */
          return iter_data;
       }
-      iter = cso_hash_iter_next(iter);
+      iter = cso_hash_find_next(iter);
    }
    return NULL;
 }
@@ -231,7 +234,7 @@ struct cso_hash_iter cso_find_state_template(struct cso_cache *sc,
       void *iter_data = cso_hash_iter_data(iter);
       if (!memcmp(iter_data, templ, size))
          return iter;
-      iter = cso_hash_iter_next(iter);
+      iter = cso_hash_find_next(iter);
    }
    return iter;
 }
@@ -31,411 +31,344 @@
   */
 
 #include "util/u_debug.h"
+#include "util/u_math.h"
 #include "util/u_memory.h"
 
 #include "cso_hash.h"
 
-#ifndef MAX
-#define MAX(a, b) ((a > b) ? (a) : (b))
-#endif
-
-static const int MinNumBits = 4;
-
-static const unsigned char prime_deltas[] = {
-   0,  0,  1,  3,  1,  5,  3,  3,  1,  9,  7,  5,  3,  9, 25,  3,
-   1, 21,  3, 21,  7, 15,  9,  5,  3, 29, 15,  0,  0,  0,  0,  0
-};
-
-static int primeForNumBits(int numBits)
-{
-   return (1 << numBits) + prime_deltas[numBits];
-}
-
 /*
-    Returns the smallest integer n such that
-    primeForNumBits(n) >= hint.
-*/
-static int countBits(int hint)
-{
-   int numBits = 0;
-   int bits = hint;
+ * Open addressing with linear probing.
+ *
+ * The nodes live in a single array of 2^numBits home buckets followed by
+ * an overflow area.  Probe sequences never wrap around: a sequence that
+ * runs past the home buckets continues into the overflow area, and the
+ * overflow area is enlarged when a sequence would run off its end.  All
+ * the nodes with a given key are therefore stored after the home bucket
+ * of the key, in array order, so iterating forward from the result of
+ * cso_hash_find() visits every one of them, like the chained table this
+ * replaces did.
+ *
+ * Removed nodes are left as tombstones so that erasing while iterating
+ * is safe; they are dropped whenever the table is rebuilt.
+ */
 
-   while (bits > 1) {
-      bits >>= 1;
-      numBits++;
-   }
+static const int MinNumBits = 3;
+static const int MinOverflow = 8;
 
-   if (numBits >= (int)sizeof(prime_deltas)) {
-      numBits = sizeof(prime_deltas) - 1;
-   } else if (primeForNumBits(numBits) < hint) {
-      ++numBits;
-   }
-   return numBits;
-}
+enum cso_node_state {
+   CSO_NODE_EMPTY = 0,
+   CSO_NODE_USED,
+   CSO_NODE_DELETED
+};
 
 struct cso_node {
-   struct cso_node *next;
    unsigned key;
+   unsigned state;
    void *value;
 };
 
-struct cso_hash_data {
-   struct cso_node *fakeNext;
-   struct cso_node **buckets;
+struct cso_hash {
+   struct cso_node *nodes;
+   int numBits;
+   int numNodes;       /**< home buckets + overflow area */
+   int overflow;
    int size;
-   int nodeSize;
-   short userNumBits;
-   short numBits;
-   int numBuckets;
+   int deleted;
 };
 
-struct cso_hash {
-   union {
-      struct cso_hash_data *d;
-      struct cso_node      *e;
-   } data;
-};
 
-static void *cso_data_allocate_node(struct cso_hash_data *hash)
+/**
+ * Home bucket of a key.  The keys are often poorly distributed (sums or
+ * xors of state words), so they are scrambled with a multiplicative hash
+ * before taking the top bits.
+ */
+static INLINE int
+cso_hash_home(const struct cso_hash *hash, unsigned key)
 {
-   return MALLOC(hash->nodeSize);
+   return (int)((key * 0x9e3779b1u) >> (32 - hash->numBits));
 }
 
-static void cso_free_node(struct cso_node *node)
-{
-   FREE(node);
-}
 
-static struct cso_node *
-cso_hash_create_node(struct cso_hash *hash,
-                      unsigned akey, void *avalue,
-                      struct cso_node **anextNode)
+/**
+ * Number of bits for a table holding size nodes, at most a third full.
+ */
+static int
+cso_hash_bits_for_size(int size)
 {
-   struct cso_node *node = cso_data_allocate_node(hash->data.d);
-
-   if (!node)
-      return NULL;
-
-   node->key = akey;
-   node->value = avalue;
-
-   node->next = (struct cso_node*)(*anextNode);
-   *anextNode = node;
-   ++hash->data.d->size;
-   return node;
+   int numBits = MinNumBits;
+   while ((size + 1) * 3 > (1 << numBits) && numBits < 30)
+      ++numBits;
+   return numBits;
 }
 
-static void cso_data_rehash(struct cso_hash_data *hash, int hint)
-{
-   if (hint < 0) {
-      hint = countBits(-hint);
-      if (hint < MinNumBits)
-         hint = MinNumBits;
-      hash->userNumBits = (short)hint;
-      while (primeForNumBits(hint) < (hash->size >> 1))
-         ++hint;
-   } else if (hint < MinNumBits) {
-      hint = MinNumBits;
-   }
 
-   if (hash->numBits != hint) {
-      struct cso_node *e = (struct cso_node *)(hash);
-      struct cso_node **oldBuckets = hash->buckets;
-      int oldNumBuckets = hash->numBuckets;
-      int  i = 0;
-
-      hash->numBits = (short)hint;
-      hash->numBuckets = primeForNumBits(hint);
-      hash->buckets = MALLOC(sizeof(struct cso_node*) * hash->numBuckets);
-      for (i = 0; i < hash->numBuckets; ++i)
-         hash->buckets[i] = e;
-
-      for (i = 0; i < oldNumBuckets; ++i) {
-         struct cso_node *firstNode = oldBuckets[i];
-         while (firstNode != e) {
-            unsigned h = firstNode->key;
-            struct cso_node *lastNode = firstNode;
-            struct cso_node *afterLastNode;
-            struct cso_node **beforeFirstNode;
-            
-            while (lastNode->next != e && lastNode->next->key == h)
-               lastNode = lastNode->next;
-
-            afterLastNode = lastNode->next;
-            beforeFirstNode = &hash->buckets[h % hash->numBuckets];
-            while (*beforeFirstNode != e)
-               beforeFirstNode = &(*beforeFirstNode)->next;
-            lastNode->next = *beforeFirstNode;
-            *beforeFirstNode = firstNode;
-            firstNode = afterLastNode;
-         }
+/**
+ * Rebuild the node array with the given number of home bucket bits,
+ * dropping the tombstones.
+ */
+static boolean
+cso_hash_rehash(struct cso_hash *hash, int numBits)
+{
+   struct cso_node *nodes;
+   int overflow = MAX2(hash->overflow, MinOverflow);
+   int numNodes, i;
+
+retry:
+   numNodes = (1 << numBits) + overflow;
+   nodes = CALLOC(numNodes, sizeof(struct cso_node));
+   if (!nodes)
+      return FALSE;
+
+   for (i = 0; i < hash->numNodes; ++i) {
+      const struct cso_node *old = &hash->nodes[i];
+      int j;
+
+      if (old->state != CSO_NODE_USED)
+         continue;
+
+      j = (int)((old->key * 0x9e3779b1u) >> (32 - numBits));
+      while (j < numNodes && nodes[j].state != CSO_NODE_EMPTY)
+         ++j;
+      if (j == numNodes) {
+         /* a long run of colliding keys, make room for it */
+         FREE(nodes);
+         overflow *= 2;
+         goto retry;
       }
-      FREE(oldBuckets);
+      nodes[j] = *old;
    }
-}
 
-static void cso_data_might_grow(struct cso_hash_data *hash)
-{
-   if (hash->size >= hash->numBuckets)
-      cso_data_rehash(hash, hash->numBits + 1);
+   FREE(hash->nodes);
+   hash->nodes = nodes;
+   hash->numBits = numBits;
+   hash->numNodes = numNodes;
+   hash->overflow = overflow;
+   hash->deleted = 0;
+   return TRUE;
 }
 
-static void cso_data_has_shrunk(struct cso_hash_data *hash)
-{
-   if (hash->size <= (hash->numBuckets >> 3) &&
-       hash->numBits > hash->userNumBits) {
-      int max = MAX(hash->numBits-2, hash->userNumBits);
-      cso_data_rehash(hash,  max);
-   }
-}
 
-static struct cso_node *cso_data_first_node(struct cso_hash_data *hash)
+static void
+cso_hash_remove_node(struct cso_hash *hash, struct cso_node *node)
 {
-   struct cso_node *e = (struct cso_node *)(hash);
-   struct cso_node **bucket = hash->buckets;
-   int n = hash->numBuckets;
-   while (n--) {
-      if (*bucket != e)
-         return *bucket;
-      ++bucket;
+   node->state = CSO_NODE_DELETED;
+   node->value = NULL;
+   --hash->size;
+   ++hash->deleted;
+
+   if (hash->size == 0) {
+      /* nothing left to iterate over, start afresh */
+      memset(hash->nodes, 0, hash->numNodes * sizeof(struct cso_node));
+      hash->deleted = 0;
    }
-   return e;
 }
 
-static struct cso_node **cso_hash_find_node(struct cso_hash *hash, unsigned akey)
+
+static struct cso_node *
+cso_hash_find_node(struct cso_hash *hash, unsigned akey)
 {
-   struct cso_node **node;
-
-   if (hash->data.d->numBuckets) {
-      node = (struct cso_node **)(&hash->data.d->buckets[akey % hash->data.d->numBuckets]);
-      assert(*node == hash->data.e || (*node)->next);
-      while (*node != hash->data.e && (*node)->key != akey)
-         node = &(*node)->next;
-   } else {
-      node = (struct cso_node **)((const struct cso_node * const *)(&hash->data.e));
+   struct cso_node *node, *end;
+
+   if (!hash->nodes)
+      return NULL;
+
+   end = hash->nodes + hash->numNodes;
+   for (node = hash->nodes + cso_hash_home(hash, akey);
+        node != end && node->state != CSO_NODE_EMPTY; ++node) {
+      if (node->state == CSO_NODE_USED && node->key == akey)
+         return node;
    }
-   return node;
+   return NULL;
 }
 
+
 struct cso_hash_iter cso_hash_insert(struct cso_hash *hash,
                                        unsigned key, void *data)
 {
-   cso_data_might_grow(hash->data.d);
-
-   {
-      struct cso_node **nextNode = cso_hash_find_node(hash, key);
-      struct cso_node *node = cso_hash_create_node(hash, key, data, nextNode);
-      if (!node) {
-         struct cso_hash_iter null_iter = {hash, 0};
-         return null_iter;
-      }
+   struct cso_hash_iter iter = {hash, NULL};
+   struct cso_node *node, *end;
 
-      {
-         struct cso_hash_iter iter = {hash, node};
+   if (!hash->nodes ||
+       (hash->size + hash->deleted + 1) * 2 > (1 << hash->numBits)) {
+      if (!cso_hash_rehash(hash, cso_hash_bits_for_size(hash->size + 1)))
          return iter;
-      }
    }
-}
-
-struct cso_hash * cso_hash_create(void)
-{
-   struct cso_hash *hash = MALLOC_STRUCT(cso_hash);
-   if (!hash)
-      return NULL;
 
-   hash->data.d = MALLOC_STRUCT(cso_hash_data);
-   if (!hash->data.d) {
-      FREE(hash);
-      return NULL;
+   for (;;) {
+      end = hash->nodes + hash->numNodes;
+      node = hash->nodes + cso_hash_home(hash, key);
+      while (node != end && node->state == CSO_NODE_USED)
+         ++node;
+      if (node != end)
+         break;
+
+      /* ran off the end of the overflow area */
+      hash->overflow *= 2;
+      if (!cso_hash_rehash(hash, hash->numBits))
+         return iter;
    }
 
-   hash->data.d->fakeNext = 0;
-   hash->data.d->buckets = 0;
-   hash->data.d->size = 0;
-   hash->data.d->nodeSize = sizeof(struct cso_node);
-   hash->data.d->userNumBits = (short)MinNumBits;
-   hash->data.d->numBits = 0;
-   hash->data.d->numBuckets = 0;
+   if (node->state == CSO_NODE_DELETED)
+      --hash->deleted;
+   node->key = key;
+   node->state = CSO_NODE_USED;
+   node->value = data;
+   ++hash->size;
+
+   iter.node = node;
+   return iter;
+}
 
-   return hash;
+struct cso_hash * cso_hash_create(void)
+{
+   return CALLOC_STRUCT(cso_hash);
 }
 
 void cso_hash_delete(struct cso_hash *hash)
 {
-   struct cso_node *e_for_x = (struct cso_node *)(hash->data.d);
-   struct cso_node **bucket = (struct cso_node **)(hash->data.d->buckets);
-   int n = hash->data.d->numBuckets;
-   while (n--) {
-      struct cso_node *cur = *bucket++;
-      while (cur != e_for_x) {
-         struct cso_node *next = cur->next;
-         cso_free_node(cur);
-         cur = next;
-      }
-   }
-   FREE(hash->data.d->buckets);
-   FREE(hash->data.d);
+   FREE(hash->nodes);
    FREE(hash);
 }
 
 struct cso_hash_iter cso_hash_find(struct cso_hash *hash,
                                      unsigned key)
 {
-   struct cso_node **nextNode = cso_hash_find_node(hash, key);
-   struct cso_hash_iter iter = {hash, *nextNode};
+   struct cso_hash_iter iter = {hash, cso_hash_find_node(hash, key)};
    return iter;
 }
 
+struct cso_hash_iter cso_hash_find_next(struct cso_hash_iter iter)
+{
+   struct cso_hash_iter next = {iter.hash, NULL};
+   struct cso_node *node, *end;
+
+   if (!iter.node)
+      return next;
+
+   end = iter.hash->nodes + iter.hash->numNodes;
+   for (node = iter.node + 1;
+        node != end && node->state != CSO_NODE_EMPTY; ++node) {
+      if (node->state == CSO_NODE_USED && node->key == iter.node->key) {
+         next.node = node;
+         break;
+      }
+   }
+   return next;
+}
+
 unsigned cso_hash_iter_key(struct cso_hash_iter iter)
 {
-   if (!iter.node || iter.hash->data.e == iter.node)
+   if (!iter.node)
       return 0;
    return iter.node->key;
 }
 
 void * cso_hash_iter_data(struct cso_hash_iter iter)
 {
-   if (!iter.node || iter.hash->data.e == iter.node)
+   if (!iter.node)
       return 0;
    return iter.node->value;
 }
 
-static struct cso_node *cso_hash_data_next(struct cso_node *node)
+struct cso_hash_iter cso_hash_iter_next(struct cso_hash_iter iter)
 {
-   union {
-      struct cso_node *next;
-      struct cso_node *e;
-      struct cso_hash_data *d;
-   } a;
-   int start;
-   struct cso_node **bucket;
-   int n;
-
-   a.next = node->next;
-   if (!a.next) {
+   struct cso_hash_iter next = {iter.hash, NULL};
+   struct cso_node *node, *end;
+
+   if (!iter.node) {
       debug_printf("iterating beyond the last element\n");
-      return 0;
+      return next;
    }
-   if (a.next->next)
-      return a.next;
-
-   start = (node->key % a.d->numBuckets) + 1;
-   bucket = a.d->buckets + start;
-   n = a.d->numBuckets - start;
-   while (n--) {
-      if (*bucket != a.e)
-         return *bucket;
-      ++bucket;
-   }
-   return a.e;
-}
-
 
-static struct cso_node *cso_hash_data_prev(struct cso_node *node)
-{
-   union {
-      struct cso_node *e;
-      struct cso_hash_data *d;
-   } a;
-   int start;
-   struct cso_node *sentinel;
-   struct cso_node **bucket;
-
-   a.e = node;
-   while (a.e->next)
-      a.e = a.e->next;
-
-   if (node == a.e)
-      start = a.d->numBuckets - 1;
-   else
-      start = node->key % a.d->numBuckets;
-
-   sentinel = node;
-   bucket = a.d->buckets + start;
-   while (start >= 0) {
-      if (*bucket != sentinel) {
-         struct cso_node *prev = *bucket;
-         while (prev->next != sentinel)
-            prev = prev->next;
-         return prev;
+   end = iter.hash->nodes + iter.hash->numNodes;
+   for (node = iter.node + 1; node != end; ++node) {
+      if (node->state == CSO_NODE_USED) {
+         next.node = node;
+         break;
       }
-
-      sentinel = a.e;
-      --bucket;
-      --start;
    }
-   debug_printf("iterating backward beyond first element\n");
-   return a.e;
-}
-
-struct cso_hash_iter cso_hash_iter_next(struct cso_hash_iter iter)
-{
-   struct cso_hash_iter next = {iter.hash, cso_hash_data_next(iter.node)};
    return next;
 }
 
 int cso_hash_iter_is_null(struct cso_hash_iter iter)
 {
-   if (!iter.node || iter.node == iter.hash->data.e)
-      return 1;
-   return 0;
+   return iter.node == NULL;
 }
 
 void * cso_hash_take(struct cso_hash *hash,
                       unsigned akey)
 {
-   struct cso_node **node = cso_hash_find_node(hash, akey);
-   if (*node != hash->data.e) {
-      void *t = (*node)->value;
-      struct cso_node *next = (*node)->next;
-      cso_free_node(*node);
-      *node = next;
-      --hash->data.d->size;
-      cso_data_has_shrunk(hash->data.d);
-      return t;
-   }
-   return 0;
+   struct cso_node *node = cso_hash_find_node(hash, akey);
+   void *t;
+
+   if (!node)
+      return 0;
+
+   t = node->value;
+   cso_hash_remove_node(hash, node);
+
+   /* keep repeated take(first_node) loops from wading through tombstones */
+   if (hash->deleted > hash->size)
+      cso_hash_rehash(hash, cso_hash_bits_for_size(hash->size));
+
+   return t;
 }
 
 struct cso_hash_iter cso_hash_iter_prev(struct cso_hash_iter iter)
 {
-   struct cso_hash_iter prev = {iter.hash,
-                                 cso_hash_data_prev(iter.node)};
+   struct cso_hash_iter prev = {iter.hash, NULL};
+   struct cso_node *node;
+
+   if (!iter.node) {
+      debug_printf("iterating backward beyond first element\n");
+      return prev;
+   }
+
+   for (node = iter.node; node != iter.hash->nodes; ) {
+      --node;
+      if (node->state == CSO_NODE_USED) {
+         prev.node = node;
+         break;
+      }
+   }
    return prev;
 }
 
 struct cso_hash_iter cso_hash_first_node(struct cso_hash *hash)
 {
-   struct cso_hash_iter iter = {hash, cso_data_first_node(hash->data.d)};
+   struct cso_hash_iter iter = {hash, NULL};
+   int i;
+
+   if (hash->size == 0)
+      return iter;
+
+   for (i = 0; i < hash->numNodes; ++i) {
+      if (hash->nodes[i].state == CSO_NODE_USED) {
+         iter.node = &hash->nodes[i];
+         break;
+      }
+   }
    return iter;
 }
 
 int cso_hash_size(struct cso_hash *hash)
 {
-   return hash->data.d->size;
+   return hash->size;
 }
 
 struct cso_hash_iter cso_hash_erase(struct cso_hash *hash, struct cso_hash_iter iter)
 {
-   struct cso_hash_iter ret = iter;
-   struct cso_node *node = iter.node;
-   struct cso_node **node_ptr;
+   struct cso_hash_iter ret;
 
-   if (node == hash->data.e)
+   if (!iter.node)
       return iter;
 
-   ret = cso_hash_iter_next(ret);
-   node_ptr = (struct cso_node**)(&hash->data.d->buckets[node->key % hash->data.d->numBuckets]);
-   while (*node_ptr != node)
-      node_ptr = &(*node_ptr)->next;
-   *node_ptr = node->next;
-   cso_free_node(node);
-   --hash->data.d->size;
+   ret = cso_hash_iter_next(iter);
+   cso_hash_remove_node(hash, iter.node);
    return ret;
 }
 
 boolean cso_hash_contains(struct cso_hash *hash, unsigned key)
 {
-   struct cso_node **node = cso_hash_find_node(hash, key);
-   return (*node != hash->data.e);
+   return cso_hash_find_node(hash, key) != NULL;
 }
@@ -30,13 +30,13 @@
  * Hash table implementation.
  * 
  * This file provides a hash implementation that is capable of dealing
- * with collisions. It stores colliding entries in linked list. All
- * functions operating on the hash return an iterator. The iterator
- * itself points to the collision list. If there wasn't any collision
- * the list will have just one entry, otherwise client code should
- * iterate over the entries to find the exact entry among ones that
- * had the same key (e.g. memcmp could be used on the data to check
- * that)
+ * with collisions. It uses open addressing: all the entries are stored
+ * in a single array and colliding entries are placed in the following
+ * free slots. All functions operating on the hash return an iterator
+ * pointing to an entry. Several entries can share a key, so client code
+ * should walk them with cso_hash_find_next() to find the exact entry
+ * among ones that had the same key (e.g. memcmp could be used on the
+ * data to check that)
  * 
  * @author Zack Rusin <zackr@vmware.com>
  */
@@ -70,9 +70,9 @@ int              cso_hash_size(struct cso_hash *hash);
 
 /**
  * Adds a data with the given key to the hash. If entry with the given
- * key is already in the hash, this current entry is instered before it
- * in the collision list.
+ * key is already in the hash, the new entry is added alongside it.
  * Function returns iterator pointing to the inserted item in the hash.
+ * Inserting may move the entries, invalidating all other iterators.
  */
 struct cso_hash_iter cso_hash_insert(struct cso_hash *hash, unsigned key,
                                      void *data);
@@ -92,10 +92,18 @@ void  *cso_hash_take(struct cso_hash *hash, unsigned key);
 struct cso_hash_iter cso_hash_first_node(struct cso_hash *hash);
 
 /**
- * Return an iterator pointing to the first entry in the collision list.
+ * Return an iterator pointing to the first entry with the given key.
  */
 struct cso_hash_iter cso_hash_find(struct cso_hash *hash, unsigned key);
 
+/**
+ * Return an iterator pointing to the next entry with the same key as the
+ * one iter points to, or a null iterator if there are no more.
+ * cso_hash_iter_next() also reaches these entries, but visits every
+ * entry stored after them as well.
+ */
+struct cso_hash_iter cso_hash_find_next(struct cso_hash_iter iter);
+
 /**
  * Returns true if a value with the given key exists in the hash
  */
@@ -112,7 +120,7 @@ struct cso_hash_iter cso_hash_iter_prev(struct cso_hash_iter iter);
 
 
 /**
- * Convenience routine to iterate over the collision list while doing a memory
+ * Convenience routine to iterate over the entries with the key while doing a memory
  * comparison to see which entry in the list is a direct copy of our template
  * and returns that entry.
  */
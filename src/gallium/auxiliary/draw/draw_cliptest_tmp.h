@@ -31,6 +31,7 @@ static boolean TAG(do_cliptest)( struct pt_post_vs *pvs,
 {
    struct vertex_header *out = info->verts;
    /* const */ float (*plane)[4] = pvs->draw->plane;
+   const float *guard_band = pvs->draw->guard_band;
    const unsigned pos = draw_current_shader_position_output(pvs->draw);
    const unsigned cv = draw_current_shader_clipvertex_output(pvs->draw);
    unsigned cd[2];
@@ -98,10 +99,13 @@ static boolean TAG(do_cliptest)( struct pt_post_vs *pvs,
          /* Do the hardwired planes first:
           */
          if (flags & DO_CLIP_XY_GUARD_BAND) {
-            if (-0.50 * position[0] + position[3] < 0) mask |= (1<<0);
-            if ( 0.50 * position[0] + position[3] < 0) mask |= (1<<1);
-            if (-0.50 * position[1] + position[3] < 0) mask |= (1<<2);
-            if ( 0.50 * position[1] + position[3] < 0) mask |= (1<<3);
+            const float gb_x = guard_band[0] * position[0];
+            const float gb_y = guard_band[1] * position[1];
+
+            if (-gb_x + position[3] < 0) mask |= (1<<0);
+            if ( gb_x + position[3] < 0) mask |= (1<<1);
+            if (-gb_y + position[3] < 0) mask |= (1<<2);
+            if ( gb_y + position[3] < 0) mask |= (1<<3);
          }
          else if (flags & DO_CLIP_XY) {
             if (-position[0] + position[3] < 0) mask |= (1<<0);
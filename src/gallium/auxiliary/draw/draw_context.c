@@ -31,6 +31,8 @@
   */
 
 
+#include <float.h>
+
 #include "pipe/p_context.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
@@ -147,6 +149,8 @@ boolean draw_init(struct draw_context *draw)
    ASSIGN_4V( draw->plane[5],  0,  0, -1, 1 ); /* mesa's a bit wonky */
    draw->clip_xy = TRUE;
    draw->clip_z = TRUE;
+   draw->guard_band[0] = 1.0f;
+   draw->guard_band[1] = 1.0f;
 
    draw->pt.user.planes = (float (*) [DRAW_TOTAL_CLIP_PLANES][4]) &(draw->plane[0]);
    draw->pt.user.eltMax = ~0;
@@ -254,7 +258,11 @@ void draw_set_zs_format(struct draw_context *draw, enum pipe_format format)
 }
 
 
-static bool
+/**
+ * Whether the bound vertex shader outputs window space positions, which
+ * aren't clipped nor transformed by the viewport.
+ */
+boolean
 draw_is_vs_window_space(struct draw_context *draw)
 {
    if (draw->vs.vertex_shader) {
@@ -262,7 +270,7 @@ draw_is_vs_window_space(struct draw_context *draw)
 
       return info->properties[TGSI_PROPERTY_VS_WINDOW_SPACE_POSITION] != 0;
    }
-   return false;
+   return FALSE;
 }
 
 
@@ -273,20 +281,85 @@ draw_update_clip_flags(struct draw_context *draw)
 
    draw->clip_xy = !draw->driver.bypass_clip_xy && !window_space;
    draw->guard_band_xy = (!draw->driver.bypass_clip_xy &&
-                          draw->driver.guard_band_xy);
+                          (draw->driver.guard_band_xy ||
+                           draw->driver.guard_band_size[0] > 0.0f));
+   draw->guard_band_lines_xy = (!draw->driver.bypass_clip_xy &&
+                                draw->driver.guard_band_xy);
    draw->clip_z = (!draw->driver.bypass_clip_z &&
                    draw->rasterizer && draw->rasterizer->depth_clip) &&
                   !window_space;
    draw->clip_user = draw->rasterizer &&
                      draw->rasterizer->clip_plane_enable != 0 &&
                      !window_space;
-   draw->guard_band_points_xy = draw->guard_band_xy ||
+   draw->guard_band_points_xy = draw->guard_band_lines_xy ||
                                 (draw->driver.bypass_clip_points &&
                                 (draw->rasterizer &&
                                  draw->rasterizer->point_tri_clip));
 }
 
 
+/**
+ * Whether primitives of type prim (after the geometry shader) only need to
+ * be clipped when they leave the guard band.
+ *
+ * A guard band set with draw_set_guard_band() only applies to filled
+ * triangles: points are still discarded when their center is outside the
+ * viewport, and lines are clipped to it before they are widened.
+ */
+boolean
+draw_guard_band_xy(const struct draw_context *draw, unsigned prim)
+{
+   const struct pipe_rasterizer_state *rast = draw->rasterizer;
+
+   if (prim == PIPE_PRIM_POINTS ||
+       rast->fill_front == PIPE_POLYGON_MODE_POINT)
+      return draw->guard_band_points_xy;
+
+   if (u_reduced_prim(prim) == PIPE_PRIM_LINES ||
+       rast->fill_front != PIPE_POLYGON_MODE_FILL ||
+       rast->fill_back != PIPE_POLYGON_MODE_FILL)
+      return draw->guard_band_lines_xy;
+
+   return draw->guard_band_xy;
+}
+
+
+/**
+ * Compute the x/y scale factors of the guard band clip test.
+ *
+ * A guard band from draw_set_guard_band() is given in window coordinates,
+ * so the scale depends on the viewports.  It is the smallest one that
+ * keeps every viewport's vertices inside the driver's limits, and never
+ * makes the guard band smaller than the viewport.  Otherwise the guard
+ * band is twice the size of the viewport.
+ */
+static void
+draw_update_guard_band(struct draw_context *draw)
+{
+   unsigned i, j;
+
+   for (j = 0; j < 2; j++) {
+      const float size = draw->driver.guard_band_size[j];
+      float extent = draw->driver.guard_band_xy ? 2.0f : 1.0f;
+
+      if (size > 0.0f) {
+         extent = FLT_MAX;
+         for (i = 0; i < PIPE_MAX_VIEWPORTS; i++) {
+            const float scale = fabsf(draw->viewports[i].scale[j]);
+            const float translate = fabsf(draw->viewports[i].translate[j]);
+
+            if (scale != 0.0f)
+               extent = MIN2(extent, (size - translate) / scale);
+         }
+         if (extent == FLT_MAX || extent < 1.0f)
+            extent = 1.0f;
+      }
+
+      draw->guard_band[j] = 1.0f / extent;
+   }
+}
+
+
 void
 draw_update_viewport_flags(struct draw_context *draw)
 {
@@ -337,6 +410,31 @@ void draw_set_driver_clipping( struct draw_context *draw,
    draw->driver.guard_band_xy = guard_band_xy;
    draw->driver.bypass_clip_points = bypass_clip_points;
    draw_update_clip_flags(draw);
+   draw_update_guard_band(draw);
+}
+
+
+/**
+ * Tell draw that the driver rasterizes primitives whose window coordinates
+ * are within [-width, width] x [-height, height], and scissors them to the
+ * viewport itself.  Lines and triangles are then only clipped when they
+ * leave that guard band, which saves splitting large primitives which
+ * cross the edges of the viewport.  Zero disables the guard band.
+ */
+void draw_set_guard_band( struct draw_context *draw,
+                          float width,
+                          float height )
+{
+   /* the guard band scale is a parameter of the clip test, like the
+    * viewport
+    */
+   draw_do_flush( draw, DRAW_FLUSH_STATE_CHANGE |
+                        DRAW_FLUSH_PARAMETER_CHANGE );
+
+   draw->driver.guard_band_size[0] = width;
+   draw->driver.guard_band_size[1] = height;
+   draw_update_clip_flags(draw);
+   draw_update_guard_band(draw);
 }
 
 
@@ -391,6 +489,7 @@ void draw_set_viewport_states( struct draw_context *draw,
        viewport->translate[1] == 0.0f &&
        viewport->translate[2] == 0.0f);
    draw_update_viewport_flags(draw);
+   draw_update_guard_band(draw);
 }
 
 
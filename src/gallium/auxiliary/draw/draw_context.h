@@ -270,6 +270,12 @@ void draw_set_driver_clipping( struct draw_context *draw,
                                boolean guard_band_xy,
                                boolean bypass_clip_points);
 
+void draw_set_guard_band( struct draw_context *draw,
+                          float width,
+                          float height );
+
+boolean draw_is_vs_window_space(struct draw_context *draw);
+
 void draw_set_force_passthrough( struct draw_context *draw, 
                                  boolean enable );
 
@@ -41,6 +41,7 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_prim.h"
+#include "util/u_string.h"
 
 /* fixme: move it from here */
 #define MAX_PRIMITIVES 64
@@ -872,12 +873,18 @@ void draw_delete_geometry_shader(struct draw_context *draw,
       li = first_elem(&shader->variants);
       while(!at_end(&shader->variants, li)) {
          struct draw_gs_llvm_variant_list_item *next = next_elem(li);
-         draw_gs_llvm_destroy_variant(li->base);
+         draw_gs_llvm_destroy_variant(li->base, FALSE);
          li = next;
       }
 
       assert(shader->variants_cached == 0);
 
+      if (lp_variant_stats_enabled()) {
+         char name[32];
+         util_snprintf(name, sizeof name, "draw gs %p", (void *) dgs);
+         lp_variant_stats_dump(name, &shader->stats);
+      }
+
       if (dgs->llvm_prim_lengths) {
          unsigned i;
          for (i = 0; i < dgs->max_out_prims; ++i) {
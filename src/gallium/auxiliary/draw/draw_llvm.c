@@ -57,6 +57,11 @@
 #include "util/simple_list.h"
 
 
+DEBUG_GET_ONCE_NUM_OPTION(max_shader_variants, "DRAW_MAX_SHADER_VARIANTS",
+                          DRAW_MAX_SHADER_VARIANTS)
+DEBUG_GET_ONCE_NUM_OPTION(shader_cache_size, "DRAW_SHADER_CACHE_SIZE", 0)
+
+
 #define DEBUG_STORE 0
 
 
@@ -230,6 +235,7 @@ create_jit_context_type(struct gallivm_state *gallivm,
                                  PIPE_MAX_SHADER_SAMPLER_VIEWS); /* textures */
    elem_types[5] = LLVMArrayType(sampler_type,
                                  PIPE_MAX_SAMPLERS); /* samplers */
+   elem_types[6] = LLVMArrayType(float_type, 2); /* guard_band */
    context_type = LLVMStructTypeInContext(gallivm->context, elem_types,
                                           Elements(elem_types), 0);
    LP_CHECK_MEMBER_OFFSET(struct draw_jit_context, vs_constants,
@@ -246,6 +252,9 @@ create_jit_context_type(struct gallivm_state *gallivm,
    LP_CHECK_MEMBER_OFFSET(struct draw_jit_context, samplers,
                           target, context_type,
                           DRAW_JIT_CTX_SAMPLERS);
+   LP_CHECK_MEMBER_OFFSET(struct draw_jit_context, guard_band,
+                          target, context_type,
+                          DRAW_JIT_CTX_GUARD_BAND);
    LP_CHECK_STRUCT_SIZE(struct draw_jit_context,
                         target, context_type);
 
@@ -501,11 +510,15 @@ draw_llvm_create(struct draw_context *draw, LLVMContextRef context)
    if (!llvm->context)
       goto fail;
 
-   llvm->nr_variants = 0;
    make_empty_list(&llvm->vs_variants_list);
+   lp_variant_cache_init(&llvm->vs_variant_cache, "draw vs",
+                         debug_get_option_max_shader_variants(),
+                         debug_get_option_shader_cache_size() * 1024);
 
-   llvm->nr_gs_variants = 0;
    make_empty_list(&llvm->gs_variants_list);
+   lp_variant_cache_init(&llvm->gs_variant_cache, "draw gs",
+                         debug_get_option_max_shader_variants(),
+                         debug_get_option_shader_cache_size() * 1024);
 
    return llvm;
 
@@ -521,6 +534,11 @@ fail:
 void
 draw_llvm_destroy(struct draw_llvm *llvm)
 {
+   if (lp_variant_stats_enabled()) {
+      lp_variant_cache_dump(&llvm->vs_variant_cache);
+      lp_variant_cache_dump(&llvm->gs_variant_cache);
+   }
+
    if (llvm->context_owned)
       LLVMContextDispose(llvm->context);
    llvm->context = NULL;
@@ -552,6 +570,7 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
 
    variant->llvm = llvm;
    variant->shader = shader;
+   memset(&variant->info, 0, sizeof variant->info);
 
    util_snprintf(module_name, sizeof(module_name), "draw_llvm_vs_variant%u",
                  variant->shader->variants_cached);
@@ -745,7 +764,8 @@ generate_fetch(struct gallivm_state *gallivm,
                                     lp_float32_vec4_type(),
                                     FALSE,
                                     map_ptr,
-                                    zero, zero, zero);
+                                    zero, zero, zero,
+                                    FALSE);
       LLVMBuildStore(builder, val, temp_ptr);
    }
    lp_build_endif(&if_ctx);
@@ -1138,6 +1158,7 @@ generate_clipmask(struct draw_llvm *llvm,
                   boolean clip_z,
                   boolean clip_user,
                   boolean clip_halfz,
+                  boolean guard_band_xy,
                   unsigned ucp_enable,
                   LLVMValueRef context_ptr,
                   boolean *have_clipdist)
@@ -1196,27 +1217,52 @@ generate_clipmask(struct draw_llvm *llvm,
 
    /* Cliptest, for hardwired planes */
    if (clip_xy) {
+      LLVMValueRef clip_x = pos_x, clip_y = pos_y;
+
+      if (guard_band_xy) {
+         /* Test against the guard band by scaling x and y down */
+         LLVMValueRef gb_ptr = draw_jit_context_guard_band(gallivm, context_ptr);
+         LLVMTypeRef vs_type_llvm = lp_build_vec_type(gallivm, vs_type);
+         LLVMValueRef indices[2];
+         LLVMValueRef gb;
+
+         indices[0] = lp_build_const_int32(gallivm, 0);
+         indices[1] = lp_build_const_int32(gallivm, 0);
+         gb = LLVMBuildLoad(builder,
+                            LLVMBuildGEP(builder, gb_ptr, indices, 2, ""),
+                            "guard_band_x");
+         clip_x = LLVMBuildFMul(builder, pos_x,
+                                lp_build_broadcast(gallivm, vs_type_llvm, gb), "");
+
+         indices[1] = lp_build_const_int32(gallivm, 1);
+         gb = LLVMBuildLoad(builder,
+                            LLVMBuildGEP(builder, gb_ptr, indices, 2, ""),
+                            "guard_band_y");
+         clip_y = LLVMBuildFMul(builder, pos_y,
+                                lp_build_broadcast(gallivm, vs_type_llvm, gb), "");
+      }
+
       /* plane 1 */
-      test = lp_build_compare(gallivm, f32_type, PIPE_FUNC_GREATER, pos_x , pos_w);
+      test = lp_build_compare(gallivm, f32_type, PIPE_FUNC_GREATER, clip_x , pos_w);
       temp = shift;
       test = LLVMBuildAnd(builder, test, temp, "");
       mask = test;
 
       /* plane 2 */
-      test = LLVMBuildFAdd(builder, pos_x, pos_w, "");
+      test = LLVMBuildFAdd(builder, clip_x, pos_w, "");
       test = lp_build_compare(gallivm, f32_type, PIPE_FUNC_GREATER, zero, test);
       temp = LLVMBuildShl(builder, temp, shift, "");
       test = LLVMBuildAnd(builder, test, temp, "");
       mask = LLVMBuildOr(builder, mask, test, "");
 
       /* plane 3 */
-      test = lp_build_compare(gallivm, f32_type, PIPE_FUNC_GREATER, pos_y, pos_w);
+      test = lp_build_compare(gallivm, f32_type, PIPE_FUNC_GREATER, clip_y, pos_w);
       temp = LLVMBuildShl(builder, temp, shift, "");
       test = LLVMBuildAnd(builder, test, temp, "");
       mask = LLVMBuildOr(builder, mask, test, "");
 
       /* plane 4 */
-      test = LLVMBuildFAdd(builder, pos_y, pos_w, "");
+      test = LLVMBuildFAdd(builder, clip_y, pos_w, "");
       test = lp_build_compare(gallivm, f32_type, PIPE_FUNC_GREATER, zero, test);
       temp = LLVMBuildShl(builder, temp, shift, "");
       test = LLVMBuildAnd(builder, test, temp, "");
@@ -1775,6 +1821,7 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant,
                                          key->clip_z,
                                          key->clip_user,
                                          key->clip_halfz,
+                                         key->guard_band_xy,
                                          key->ucp_enable,
                                          context_ptr, &have_clipdist);
             temp = LLVMBuildOr(builder, clipmask, temp, "");
@@ -1816,7 +1863,8 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant,
 
 
 struct draw_llvm_variant_key *
-draw_llvm_make_variant_key(struct draw_llvm *llvm, char *store)
+draw_llvm_make_variant_key(struct draw_llvm *llvm, char *store,
+                           boolean guard_band_xy)
 {
    unsigned i;
    struct draw_llvm_variant_key *key;
@@ -1841,6 +1889,7 @@ draw_llvm_make_variant_key(struct draw_llvm *llvm, char *store)
    key->clip_user = llvm->draw->clip_user;
    key->bypass_viewport = llvm->draw->bypass_viewport;
    key->clip_halfz = llvm->draw->rasterizer->clip_halfz;
+   key->guard_band_xy = key->clip_xy && guard_band_xy;
    key->need_edgeflags = (llvm->draw->vs.edgeflag_output ? TRUE : FALSE);
    key->ucp_enable = llvm->draw->rasterizer->clip_plane_enable;
    key->has_gs = llvm->draw->gs.geometry_shader != NULL;
@@ -1893,6 +1942,7 @@ draw_llvm_dump_variant_key(struct draw_llvm_variant_key *key)
    debug_printf("clip_user = %u\n", key->clip_user);
    debug_printf("bypass_viewport = %u\n", key->bypass_viewport);
    debug_printf("clip_halfz = %u\n", key->clip_halfz);
+   debug_printf("guard_band_xy = %u\n", key->guard_band_xy);
    debug_printf("need_edgeflags = %u\n", key->need_edgeflags);
    debug_printf("has_gs = %u\n", key->has_gs);
    debug_printf("ucp_enable = %u\n", key->ucp_enable);
@@ -1991,8 +2041,12 @@ draw_llvm_set_sampler_state(struct draw_context *draw,
 }
 
 
+/**
+ * \param evicted  whether it's destroyed to make room for other variants
+ */
 void
-draw_llvm_destroy_variant(struct draw_llvm_variant *variant)
+draw_llvm_destroy_variant(struct draw_llvm_variant *variant,
+                          boolean evicted)
 {
    struct draw_llvm *llvm = variant->llvm;
 
@@ -2001,7 +2055,8 @@ draw_llvm_destroy_variant(struct draw_llvm_variant *variant)
    remove_from_list(&variant->list_item_local);
    variant->shader->variants_cached--;
    remove_from_list(&variant->list_item_global);
-   llvm->nr_variants--;
+   lp_variant_cache_remove(&llvm->vs_variant_cache, &variant->shader->stats,
+                           &variant->info, evicted);
    FREE(variant);
 }
 
@@ -2219,6 +2274,7 @@ draw_gs_llvm_create_variant(struct draw_llvm *llvm,
 
    variant->llvm = llvm;
    variant->shader = shader;
+   memset(&variant->info, 0, sizeof variant->info);
 
    util_snprintf(module_name, sizeof(module_name), "draw_llvm_gs_variant%u",
                  variant->shader->variants_cached);
@@ -2251,7 +2307,8 @@ draw_gs_llvm_create_variant(struct draw_llvm *llvm,
 }
 
 void
-draw_gs_llvm_destroy_variant(struct draw_gs_llvm_variant *variant)
+draw_gs_llvm_destroy_variant(struct draw_gs_llvm_variant *variant,
+                             boolean evicted)
 {
    struct draw_llvm *llvm = variant->llvm;
 
@@ -2260,7 +2317,8 @@ draw_gs_llvm_destroy_variant(struct draw_gs_llvm_variant *variant)
    remove_from_list(&variant->list_item_local);
    variant->shader->variants_cached--;
    remove_from_list(&variant->list_item_global);
-   llvm->nr_gs_variants--;
+   lp_variant_cache_remove(&llvm->gs_variant_cache, &variant->shader->stats,
+                           &variant->info, evicted);
    FREE(variant);
 }
 
@@ -35,6 +35,7 @@
 
 #include "gallivm/lp_bld_sample.h"
 #include "gallivm/lp_bld_limits.h"
+#include "gallivm/lp_bld_variant_cache.h"
 
 #include "pipe/p_context.h"
 #include "util/simple_list.h"
@@ -129,6 +130,8 @@ struct draw_jit_context
 
    struct draw_jit_texture textures[PIPE_MAX_SHADER_SAMPLER_VIEWS];
    struct draw_jit_sampler samplers[PIPE_MAX_SAMPLERS];
+
+   float guard_band[2];
 };
 
 enum {
@@ -138,6 +141,7 @@ enum {
    DRAW_JIT_CTX_VIEWPORT             = 3,
    DRAW_JIT_CTX_TEXTURES             = 4,
    DRAW_JIT_CTX_SAMPLERS             = 5,
+   DRAW_JIT_CTX_GUARD_BAND           = 6,
    DRAW_JIT_CTX_NUM_FIELDS
 };
 
@@ -153,6 +157,9 @@ enum {
 #define draw_jit_context_viewports(_gallivm, _ptr) \
    lp_build_struct_get(_gallivm, _ptr, DRAW_JIT_CTX_VIEWPORT, "viewports")
 
+#define draw_jit_context_guard_band(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, DRAW_JIT_CTX_GUARD_BAND, "guard_band")
+
 #define draw_jit_context_textures(_gallivm, _ptr) \
    lp_build_struct_get_ptr(_gallivm, _ptr, DRAW_JIT_CTX_TEXTURES, "textures")
 
@@ -319,7 +326,8 @@ struct draw_llvm_variant_key
     * (and all padding gets zeroed).
     */
    unsigned ucp_enable:PIPE_MAX_CLIP_PLANES;
-   unsigned pad1:24-PIPE_MAX_CLIP_PLANES;
+   unsigned guard_band_xy:1;
+   unsigned pad1:23-PIPE_MAX_CLIP_PLANES;
 
    /* Variable number of vertex elements:
     */
@@ -409,6 +417,9 @@ struct draw_llvm_variant
    struct draw_llvm_variant_list_item list_item_global;
    struct draw_llvm_variant_list_item list_item_local;
 
+   /* compile time, code size and uses, for the eviction policy */
+   struct lp_variant_info info;
+
    /* key is variable-sized, must be last */
    struct draw_llvm_variant_key key;
 };
@@ -435,6 +446,9 @@ struct draw_gs_llvm_variant
    struct draw_gs_llvm_variant_list_item list_item_global;
    struct draw_gs_llvm_variant_list_item list_item_local;
 
+   /* compile time, code size and uses, for the eviction policy */
+   struct lp_variant_info info;
+
    /* key is variable-sized, must be last */
    struct draw_gs_llvm_variant_key key;
 };
@@ -446,6 +460,7 @@ struct llvm_vertex_shader {
    struct draw_llvm_variant_list_item variants;
    unsigned variants_created;
    unsigned variants_cached;
+   struct lp_variant_stats stats;
 };
 
 struct llvm_geometry_shader {
@@ -455,6 +470,7 @@ struct llvm_geometry_shader {
    struct draw_gs_llvm_variant_list_item variants;
    unsigned variants_created;
    unsigned variants_cached;
+   struct lp_variant_stats stats;
 };
 
 
@@ -468,10 +484,10 @@ struct draw_llvm {
    struct draw_gs_jit_context gs_jit_context;
 
    struct draw_llvm_variant_list_item vs_variants_list;
-   int nr_variants;
+   struct lp_variant_cache vs_variant_cache;
 
    struct draw_gs_llvm_variant_list_item gs_variants_list;
-   int nr_gs_variants;
+   struct lp_variant_cache gs_variant_cache;
 };
 
 
@@ -502,10 +518,12 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
                          const struct draw_llvm_variant_key *key);
 
 void
-draw_llvm_destroy_variant(struct draw_llvm_variant *variant);
+draw_llvm_destroy_variant(struct draw_llvm_variant *variant,
+                          boolean evicted);
 
 struct draw_llvm_variant_key *
-draw_llvm_make_variant_key(struct draw_llvm *llvm, char *store);
+draw_llvm_make_variant_key(struct draw_llvm *llvm, char *store,
+                           boolean guard_band_xy);
 
 void
 draw_llvm_dump_variant_key(struct draw_llvm_variant_key *key);
@@ -517,7 +535,8 @@ draw_gs_llvm_create_variant(struct draw_llvm *llvm,
                             const struct draw_gs_llvm_variant_key *key);
 
 void
-draw_gs_llvm_destroy_variant(struct draw_gs_llvm_variant *variant);
+draw_gs_llvm_destroy_variant(struct draw_gs_llvm_variant *variant,
+                             boolean evicted);
 
 struct draw_gs_llvm_variant_key *
 draw_gs_llvm_make_variant_key(struct draw_llvm *llvm, char *store);
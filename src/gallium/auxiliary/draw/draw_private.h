@@ -69,6 +69,7 @@ struct tgsi_sampler;
 struct draw_pt_front_end;
 struct draw_assembler;
 struct draw_llvm;
+struct draw_workers;
 
 
 /**
@@ -101,7 +102,10 @@ struct vertex_header {
 #define UNDEFINED_VERTEX_ID 0xffff
 
 
-/* maximum number of shader variants we can cache */
+/* maximum number of shader variants we can cache, by default, see also
+ * the DRAW_MAX_SHADER_VARIANTS and DRAW_SHADER_CACHE_SIZE environment
+ * variables
+ */
 #define DRAW_MAX_SHADER_VARIANTS 128
 
 /**
@@ -163,6 +167,7 @@ struct draw_context
          struct draw_pt_middle_end *fetch_emit;
          struct draw_pt_middle_end *fetch_shade_emit;
          struct draw_pt_middle_end *general;
+         struct draw_pt_middle_end *fused;
          struct draw_pt_middle_end *llvm;
       } middle;
 
@@ -211,6 +216,17 @@ struct draw_context
 
       boolean test_fse;         /* enable FSE even though its not correct (eg for softpipe) */
       boolean no_fse;           /* disable FSE even when it is correct */
+      boolean no_fused;         /* disable the fused fetch/shade/cliptest path */
+      boolean dump_acmr;        /* print vertex shader invocations per prim */
+
+      /** counters for DRAW_ACMR, independent of the pipeline statistics */
+      struct {
+         uint64_t vs_invocations;
+         uint64_t prims;
+      } acmr;
+
+      /** threads shading large segments in parallel, NULL if disabled */
+      struct draw_workers *workers;
    } pt;
 
    struct {
@@ -218,6 +234,7 @@ struct draw_context
       boolean bypass_clip_z;
       boolean guard_band_xy;
       boolean bypass_clip_points;
+      float guard_band_size[2];  /**< see draw_set_guard_band() */
    } driver;
 
    boolean quads_always_flatshade_last;
@@ -232,8 +249,12 @@ struct draw_context
    boolean clip_z;
    boolean clip_user;
    boolean guard_band_xy;
+   boolean guard_band_lines_xy;
    boolean guard_band_points_xy;
 
+   /** x and y scale of the guard band clip test, 1.0 means the viewport */
+   float guard_band[2];
+
    boolean force_passthrough; /**< never clip or shade */
 
    boolean dump_vs;
@@ -480,6 +501,7 @@ draw_stats_clipper_primitives(struct draw_context *draw,
                               const struct draw_prim_info *prim_info);
 
 void draw_update_clip_flags(struct draw_context *draw);
+boolean draw_guard_band_xy(const struct draw_context *draw, unsigned prim);
 void draw_update_viewport_flags(struct draw_context *draw);
 
 /** 
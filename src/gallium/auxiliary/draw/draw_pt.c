@@ -36,6 +36,7 @@
 #include "draw/draw_pt.h"
 #include "draw/draw_vbuf.h"
 #include "draw/draw_vs.h"
+#include "draw/draw_workers.h"
 #include "tgsi/tgsi_dump.h"
 #include "util/u_math.h"
 #include "util/u_prim.h"
@@ -45,6 +46,9 @@
 
 DEBUG_GET_ONCE_BOOL_OPTION(draw_fse, "DRAW_FSE", FALSE)
 DEBUG_GET_ONCE_BOOL_OPTION(draw_no_fse, "DRAW_NO_FSE", FALSE)
+DEBUG_GET_ONCE_BOOL_OPTION(draw_no_fused, "DRAW_NO_FUSED", FALSE)
+DEBUG_GET_ONCE_BOOL_OPTION(draw_acmr, "DRAW_ACMR", FALSE)
+DEBUG_GET_ONCE_NUM_OPTION(draw_num_threads, "DRAW_NUM_THREADS", 0)
 
 /* Overall we split things into:
  *     - frontend -- prepare fetch_elts, draw_elts - eg vsplit
@@ -103,6 +107,8 @@ draw_pt_arrays(struct draw_context *draw,
          middle = draw->pt.middle.fetch_emit;
       else if (opt == PT_SHADE && !draw->pt.no_fse)
          middle = draw->pt.middle.fetch_shade_emit;
+      else if (!draw->pt.no_fused && draw_pt_fused_supported(draw, prim))
+         middle = draw->pt.middle.fused;
       else
          middle = draw->pt.middle.general;
    }
@@ -174,6 +180,8 @@ boolean draw_pt_init( struct draw_context *draw )
 {
    draw->pt.test_fse = debug_get_option_draw_fse();
    draw->pt.no_fse = debug_get_option_draw_no_fse();
+   draw->pt.no_fused = debug_get_option_draw_no_fused();
+   draw->pt.dump_acmr = debug_get_option_draw_acmr();
 
    draw->pt.front.vsplit = draw_pt_vsplit(draw);
    if (!draw->pt.front.vsplit)
@@ -191,9 +199,19 @@ boolean draw_pt_init( struct draw_context *draw )
    if (!draw->pt.middle.general)
       return FALSE;
 
+   draw->pt.middle.fused = draw_pt_fetch_shade_fused( draw );
+   if (!draw->pt.middle.fused)
+      return FALSE;
+
 #if HAVE_LLVM
-   if (draw->llvm)
+   if (draw->llvm) {
       draw->pt.middle.llvm = draw_pt_fetch_pipeline_or_emit_llvm( draw );
+
+      /* Only the llvm middle end can shade on several threads, the tgsi
+       * machine isn't reentrant.
+       */
+      draw->pt.workers = draw_workers_create( debug_get_option_draw_num_threads() );
+   }
 #endif
 
    return TRUE;
@@ -202,6 +220,9 @@ boolean draw_pt_init( struct draw_context *draw )
 
 void draw_pt_destroy( struct draw_context *draw )
 {
+   draw_workers_destroy( draw->pt.workers );
+   draw->pt.workers = NULL;
+
    if (draw->pt.middle.llvm) {
       draw->pt.middle.llvm->destroy( draw->pt.middle.llvm );
       draw->pt.middle.llvm = NULL;
@@ -212,6 +233,11 @@ void draw_pt_destroy( struct draw_context *draw )
       draw->pt.middle.general = NULL;
    }
 
+   if (draw->pt.middle.fused) {
+      draw->pt.middle.fused->destroy( draw->pt.middle.fused );
+      draw->pt.middle.fused = NULL;
+   }
+
    if (draw->pt.middle.fetch_emit) {
       draw->pt.middle.fetch_emit->destroy( draw->pt.middle.fetch_emit );
       draw->pt.middle.fetch_emit = NULL;
@@ -531,6 +557,10 @@ draw_vbo(struct draw_context *draw,
       }
    }
 
+   if (draw->pt.dump_acmr) {
+      memset(&draw->pt.acmr, 0, sizeof(draw->pt.acmr));
+   }
+
    /* If we're collecting stats then make sure we start from scratch */
    if (draw->collect_statistics) {
       memset(&draw->statistics, 0, sizeof(draw->statistics));
@@ -569,5 +599,16 @@ draw_vbo(struct draw_context *draw,
    if (draw->collect_statistics) {
       draw->render->pipeline_statistics(draw->render, &draw->statistics);
    }
+
+   if (draw->pt.dump_acmr) {
+      debug_printf("draw: %s count=%u: %u vs invocations, %u prims, "
+                   "ACMR %.3f\n",
+                   u_prim_name(info->mode), count,
+                   (unsigned) draw->pt.acmr.vs_invocations,
+                   (unsigned) draw->pt.acmr.prims,
+                   draw->pt.acmr.prims ?
+                   (double) draw->pt.acmr.vs_invocations /
+                   (double) draw->pt.acmr.prims : 0.0);
+   }
    util_fpstate_set(fpstate);
 }
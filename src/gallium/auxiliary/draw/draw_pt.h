@@ -151,11 +151,17 @@ struct draw_pt_front_end *draw_pt_vsplit(struct draw_context *draw);
  * The special case fetch_emit code avoids pipeline vertices
  * altogether and builds hardware vertices directly from API
  * vertex_elements.
+ *
+ * The fused middle end does the same job as the general one without
+ * llvm, but runs fetch, shade and cliptest over cache-sized chunks.
  */
 struct draw_pt_middle_end *draw_pt_fetch_emit( struct draw_context *draw );
 struct draw_pt_middle_end *draw_pt_middle_fse( struct draw_context *draw );
 struct draw_pt_middle_end *draw_pt_fetch_pipeline_or_emit(struct draw_context *draw);
 struct draw_pt_middle_end *draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw);
+struct draw_pt_middle_end *draw_pt_fetch_shade_fused(struct draw_context *draw);
+
+boolean draw_pt_fused_supported(struct draw_context *draw, unsigned prim);
 
 
 
@@ -0,0 +1,441 @@
+/**************************************************************************
+ *
+ * Copyright 2007 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Fused fetch / shade / cliptest middle end for the non-llvm path.
+ *
+ * The general middle end (draw_pt_fetch_shade_pipeline.c) runs each stage
+ * over the whole vertex batch and has the vertex shader write into a
+ * second, freshly allocated vertex buffer.  Here the three per-vertex
+ * stages run back to back over small chunks of the batch, with the
+ * shader working in place, so the data a stage produces is still in the
+ * L1 cache when the next stage consumes it and only one vertex buffer is
+ * needed.  The result is then emitted or sent down the pipeline exactly
+ * as the general middle end does.
+ *
+ * Only used when there is no geometry shader, stream output or primitive
+ * assembly, and when the vertex shader doesn't depend on the position of
+ * the vertex within the batch (vertex id).
+ */
+
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/u_prim.h"
+#include "draw/draw_context.h"
+#include "draw/draw_private.h"
+#include "draw/draw_vbuf.h"
+#include "draw/draw_vertex.h"
+#include "draw/draw_prim_assembler.h"
+#include "draw/draw_pt.h"
+#include "draw/draw_vs.h"
+
+
+/**
+ * Amount of vertex data processed per fetch/shade/cliptest step; chosen
+ * to comfortably fit in the L1 data cache along with the shader state.
+ */
+#define FUSED_CHUNK_BYTES (16 * 1024)
+
+
+struct fused_middle_end {
+   struct draw_pt_middle_end base;
+   struct draw_context *draw;
+
+   struct pt_emit *emit;
+   struct pt_fetch *fetch;
+   struct pt_post_vs *post_vs;
+
+   unsigned vertex_size;
+   unsigned chunk_size;
+   unsigned input_prim;
+   unsigned opt;
+
+   /** Vertex buffer kept across batches, grown as needed */
+   struct vertex_header *verts;
+   unsigned verts_size;
+};
+
+
+/** cast wrapper */
+static INLINE struct fused_middle_end *
+fused_middle_end(struct draw_pt_middle_end *middle)
+{
+   return (struct fused_middle_end *) middle;
+}
+
+
+/**
+ * Whether the fused middle end can handle the current draw state.
+ */
+boolean
+draw_pt_fused_supported(struct draw_context *draw, unsigned prim)
+{
+   const struct draw_vertex_shader *vs = draw->vs.vertex_shader;
+   struct draw_prim_info prim_info;
+
+   if (draw->llvm || draw->gs.geometry_shader || draw->so.num_targets)
+      return FALSE;
+
+   /* vertex ids are relative to the start of each run_linear call */
+   if (vs->info.uses_vertexid || vs->info.uses_vertexid_nobase)
+      return FALSE;
+
+   /* the cliptest picks the viewport from the leading vertex of each prim */
+   if (draw_current_shader_uses_viewport_index(draw))
+      return FALSE;
+
+   memset(&prim_info, 0, sizeof prim_info);
+   prim_info.prim = prim;
+   if (draw_prim_assembler_is_required(draw, &prim_info, NULL))
+      return FALSE;
+
+   return TRUE;
+}
+
+
+static void
+fused_prepare(struct draw_pt_middle_end *middle,
+              unsigned prim,
+              unsigned opt,
+              unsigned *max_vertices)
+{
+   struct fused_middle_end *fme = fused_middle_end(middle);
+   struct draw_context *draw = fme->draw;
+   struct draw_vertex_shader *vs = draw->vs.vertex_shader;
+   unsigned i;
+   unsigned instance_id_index = ~0;
+   const unsigned out_prim = u_assembled_prim(prim);
+   unsigned nr_vs_outputs = draw_total_vs_outputs(draw);
+   unsigned nr = MAX2(vs->info.num_inputs, nr_vs_outputs);
+
+   for (i = 0; i < vs->info.num_inputs; i++) {
+      if (vs->info.input_semantic_name[i] == TGSI_SEMANTIC_INSTANCEID) {
+         instance_id_index = i;
+         break;
+      }
+   }
+
+   fme->input_prim = prim;
+   fme->opt = opt;
+
+   /* Inputs and outputs share the same vertex, so it must be large
+    * enough for both.
+    */
+   fme->vertex_size = sizeof(struct vertex_header) + nr * 4 * sizeof(float);
+
+   /* Keep chunks a multiple of the tgsi_exec quad size */
+   fme->chunk_size = MAX2(FUSED_CHUNK_BYTES / fme->vertex_size, 4) & ~3;
+
+   draw_pt_fetch_prepare( fme->fetch,
+                          vs->info.num_inputs,
+                          fme->vertex_size,
+                          instance_id_index );
+   draw_pt_post_vs_prepare( fme->post_vs,
+                            draw->clip_xy,
+                            draw->clip_z,
+                            draw->clip_user,
+                            draw_guard_band_xy(draw, out_prim),
+                            draw->bypass_viewport,
+                            draw->rasterizer->clip_halfz,
+                            (draw->vs.edgeflag_output ? TRUE : FALSE) );
+
+   if (!(opt & PT_PIPELINE)) {
+      draw_pt_emit_prepare( fme->emit,
+                            out_prim,
+                            max_vertices );
+
+      *max_vertices = MAX2( *max_vertices, 4096 );
+   }
+   else {
+      /* limit max fetches by limiting max_vertices */
+      *max_vertices = 4096;
+   }
+
+   vs->prepare(vs, draw);
+}
+
+
+static void
+fused_bind_parameters(struct draw_pt_middle_end *middle)
+{
+   /* No-op since the vertex shader executor and drawing pipeline
+    * just grab the constants, viewport, etc. from the draw context state.
+    */
+}
+
+
+static void
+fused_run_generic(struct draw_pt_middle_end *middle,
+                  const struct draw_fetch_info *fetch_info,
+                  const struct draw_prim_info *prim_info)
+{
+   struct fused_middle_end *fme = fused_middle_end(middle);
+   struct draw_context *draw = fme->draw;
+   struct draw_vertex_shader *vshader = draw->vs.vertex_shader;
+   struct draw_vertex_info vert_info;
+   unsigned opt = fme->opt;
+   unsigned size = fme->vertex_size * align(fetch_info->count, 4);
+   unsigned i;
+
+   if (size > fme->verts_size) {
+      FREE(fme->verts);
+      fme->verts = (struct vertex_header *)MALLOC(size);
+      if (!fme->verts) {
+         fme->verts_size = 0;
+         assert(0);
+         return;
+      }
+      fme->verts_size = size;
+   }
+
+   vert_info.count = fetch_info->count;
+   vert_info.vertex_size = fme->vertex_size;
+   vert_info.stride = fme->vertex_size;
+   vert_info.verts = fme->verts;
+
+   if (draw->collect_statistics) {
+      draw->statistics.ia_vertices += prim_info->count;
+      draw->statistics.ia_primitives +=
+         u_decomposed_prims_for_vertices(prim_info->prim, fetch_info->count);
+      draw->statistics.vs_invocations += fetch_info->count;
+   }
+
+   if (draw->pt.dump_acmr) {
+      draw->pt.acmr.vs_invocations += fetch_info->count;
+      draw->pt.acmr.prims +=
+         u_decomposed_prims_for_vertices(prim_info->prim, fetch_info->count);
+   }
+
+   for (i = 0; i < fetch_info->count; i += fme->chunk_size) {
+      struct draw_vertex_info chunk;
+      char *verts = (char *)vert_info.verts + i * fme->vertex_size;
+
+      chunk.count = MIN2(fme->chunk_size, fetch_info->count - i);
+      chunk.vertex_size = fme->vertex_size;
+      chunk.stride = fme->vertex_size;
+      chunk.verts = (struct vertex_header *)verts;
+
+      if (fetch_info->linear)
+         draw_pt_fetch_run_linear( fme->fetch,
+                                   fetch_info->start + i,
+                                   chunk.count,
+                                   verts );
+      else
+         draw_pt_fetch_run( fme->fetch,
+                            fetch_info->elts + i,
+                            chunk.count,
+                            verts );
+
+      /* tgsi_exec reads each quad of inputs before writing its outputs,
+       * so the shader can safely overwrite the fetched data in place.
+       */
+      vshader->run_linear(vshader,
+                          (const float (*)[4])chunk.verts->data,
+                          (      float (*)[4])chunk.verts->data,
+                          draw->pt.user.vs_constants,
+                          draw->pt.user.vs_constants_size,
+                          chunk.count,
+                          fme->vertex_size,
+                          fme->vertex_size);
+
+      if (draw_current_shader_position_output(draw) != -1 &&
+          draw_pt_post_vs_run( fme->post_vs, &chunk, prim_info ))
+         opt |= PT_PIPELINE;
+   }
+
+   draw_stats_clipper_primitives(draw, prim_info);
+
+   if (draw_current_shader_position_output(draw) != -1) {
+      if (opt & PT_PIPELINE) {
+         if (prim_info->linear)
+            draw_pipeline_run_linear( draw, &vert_info, prim_info );
+         else
+            draw_pipeline_run( draw, &vert_info, prim_info );
+      }
+      else {
+         if (prim_info->linear)
+            draw_pt_emit_linear( fme->emit, &vert_info, prim_info );
+         else
+            draw_pt_emit( fme->emit, &vert_info, prim_info );
+      }
+   }
+}
+
+
+static void
+fused_run(struct draw_pt_middle_end *middle,
+          const unsigned *fetch_elts,
+          unsigned fetch_count,
+          const ushort *draw_elts,
+          unsigned draw_count,
+          unsigned prim_flags)
+{
+   struct fused_middle_end *fme = fused_middle_end(middle);
+   struct draw_fetch_info fetch_info;
+   struct draw_prim_info prim_info;
+
+   fetch_info.linear = FALSE;
+   fetch_info.start = 0;
+   fetch_info.elts = fetch_elts;
+   fetch_info.count = fetch_count;
+
+   prim_info.linear = FALSE;
+   prim_info.start = 0;
+   prim_info.count = draw_count;
+   prim_info.elts = draw_elts;
+   prim_info.prim = fme->input_prim;
+   prim_info.flags = prim_flags;
+   prim_info.primitive_count = 1;
+   prim_info.primitive_lengths = &draw_count;
+
+   fused_run_generic( middle, &fetch_info, &prim_info );
+}
+
+
+static void
+fused_run_linear(struct draw_pt_middle_end *middle,
+                 unsigned start,
+                 unsigned count,
+                 unsigned prim_flags)
+{
+   struct fused_middle_end *fme = fused_middle_end(middle);
+   struct draw_fetch_info fetch_info;
+   struct draw_prim_info prim_info;
+
+   fetch_info.linear = TRUE;
+   fetch_info.start = start;
+   fetch_info.count = count;
+   fetch_info.elts = NULL;
+
+   prim_info.linear = TRUE;
+   prim_info.start = 0;
+   prim_info.count = count;
+   prim_info.elts = NULL;
+   prim_info.prim = fme->input_prim;
+   prim_info.flags = prim_flags;
+   prim_info.primitive_count = 1;
+   prim_info.primitive_lengths = &count;
+
+   fused_run_generic( middle, &fetch_info, &prim_info );
+}
+
+
+static boolean
+fused_run_linear_elts(struct draw_pt_middle_end *middle,
+                      unsigned start,
+                      unsigned count,
+                      const ushort *draw_elts,
+                      unsigned draw_count,
+                      unsigned prim_flags)
+{
+   struct fused_middle_end *fme = fused_middle_end(middle);
+   struct draw_fetch_info fetch_info;
+   struct draw_prim_info prim_info;
+
+   fetch_info.linear = TRUE;
+   fetch_info.start = start;
+   fetch_info.count = count;
+   fetch_info.elts = NULL;
+
+   prim_info.linear = FALSE;
+   prim_info.start = 0;
+   prim_info.count = draw_count;
+   prim_info.elts = draw_elts;
+   prim_info.prim = fme->input_prim;
+   prim_info.flags = prim_flags;
+   prim_info.primitive_count = 1;
+   prim_info.primitive_lengths = &draw_count;
+
+   fused_run_generic( middle, &fetch_info, &prim_info );
+
+   return TRUE;
+}
+
+
+static void
+fused_finish( struct draw_pt_middle_end *middle )
+{
+   /* nothing to do */
+}
+
+
+static void
+fused_destroy( struct draw_pt_middle_end *middle )
+{
+   struct fused_middle_end *fme = fused_middle_end(middle);
+
+   if (fme->fetch)
+      draw_pt_fetch_destroy( fme->fetch );
+
+   if (fme->emit)
+      draw_pt_emit_destroy( fme->emit );
+
+   if (fme->post_vs)
+      draw_pt_post_vs_destroy( fme->post_vs );
+
+   FREE(fme->verts);
+   FREE(middle);
+}
+
+
+struct draw_pt_middle_end *
+draw_pt_fetch_shade_fused(struct draw_context *draw)
+{
+   struct fused_middle_end *fme = CALLOC_STRUCT( fused_middle_end );
+   if (!fme)
+      goto fail;
+
+   fme->base.prepare         = fused_prepare;
+   fme->base.bind_parameters = fused_bind_parameters;
+   fme->base.run             = fused_run;
+   fme->base.run_linear      = fused_run_linear;
+   fme->base.run_linear_elts = fused_run_linear_elts;
+   fme->base.finish          = fused_finish;
+   fme->base.destroy         = fused_destroy;
+
+   fme->draw = draw;
+
+   fme->fetch = draw_pt_fetch_create( draw );
+   if (!fme->fetch)
+      goto fail;
+
+   fme->post_vs = draw_pt_post_vs_create( draw );
+   if (!fme->post_vs)
+      goto fail;
+
+   fme->emit = draw_pt_emit_create( draw );
+   if (!fme->emit)
+      goto fail;
+
+   return &fme->base;
+
+ fail:
+   if (fme)
+      fused_destroy( &fme->base );
+
+   return NULL;
+}
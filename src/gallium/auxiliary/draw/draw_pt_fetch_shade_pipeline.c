@@ -82,8 +82,6 @@ fetch_pipeline_prepare(struct draw_pt_middle_end *middle,
                                  u_assembled_prim(prim));
    unsigned nr_vs_outputs = draw_total_vs_outputs(draw);
    unsigned nr = MAX2(vs->info.num_inputs, nr_vs_outputs);
-   unsigned point_clip = draw->rasterizer->fill_front == PIPE_POLYGON_MODE_POINT ||
-                         gs_out_prim == PIPE_PRIM_POINTS;
 
    if (gs) {
       nr = MAX2(nr, gs->info.num_outputs + 1);
@@ -115,8 +113,7 @@ fetch_pipeline_prepare(struct draw_pt_middle_end *middle,
                             draw->clip_xy,
                             draw->clip_z,
                             draw->clip_user,
-                            point_clip ? draw->guard_band_points_xy :
-                                         draw->guard_band_xy,
+                            draw_guard_band_xy(draw, gs_out_prim),
                             draw->bypass_viewport,
                             draw->rasterizer->clip_halfz,
                             (draw->vs.edgeflag_output ? TRUE : FALSE) );
@@ -263,6 +260,12 @@ fetch_pipeline_generic(struct draw_pt_middle_end *middle,
       draw->statistics.vs_invocations += fetch_info->count;
    }
 
+   if (draw->pt.dump_acmr) {
+      draw->pt.acmr.vs_invocations += fetch_info->count;
+      draw->pt.acmr.prims +=
+         u_decomposed_prims_for_vertices(prim_info->prim, fetch_info->count);
+   }
+
    /* Fetch into our vertex buffer.
     */
    fetch( fpme->fetch, fetch_info, (char *)fetched_vert_info.verts );
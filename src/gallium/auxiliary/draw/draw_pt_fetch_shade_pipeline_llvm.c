@@ -28,6 +28,8 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_prim.h"
+#include "util/simple_list.h"
+#include "os/os_time.h"
 #include "draw/draw_context.h"
 #include "draw/draw_gs.h"
 #include "draw/draw_vbuf.h"
@@ -36,9 +38,18 @@
 #include "draw/draw_prim_assembler.h"
 #include "draw/draw_vs.h"
 #include "draw/draw_llvm.h"
+#include "draw/draw_workers.h"
 #include "gallivm/lp_bld_init.h"
 
 
+/**
+ * Segments are only split across the worker threads if every thread gets
+ * at least this many vertices, below that the synchronization costs more
+ * than it saves.
+ */
+#define LLVM_MIN_VERTICES_PER_THREAD 512
+
+
 struct llvm_middle_end {
    struct draw_pt_middle_end base;
    struct draw_context *draw;
@@ -76,8 +87,8 @@ llvm_middle_end_prepare_gs(struct llvm_middle_end *fpme)
    struct draw_gs_llvm_variant *variant = NULL;
    struct draw_gs_llvm_variant_list_item *li;
    struct llvm_geometry_shader *shader = llvm_geometry_shader(gs);
+   struct lp_variant_cache *cache = &fpme->llvm->gs_variant_cache;
    char store[DRAW_GS_LLVM_MAX_VARIANT_KEY_SIZE];
-   unsigned i;
 
    key = draw_gs_llvm_make_variant_key(fpme->llvm, store);
 
@@ -95,36 +106,45 @@ llvm_middle_end_prepare_gs(struct llvm_middle_end *fpme)
       /* found the variant, move to head of global list (for LRU) */
       move_to_head(&fpme->llvm->gs_variants_list,
                    &variant->list_item_global);
+      lp_variant_cache_hit(cache, &shader->stats, &variant->info);
    }
    else {
       /* Need to create new variant */
+      int64_t t0;
 
-      /* First check if we've created too many variants.  If so, free
-       * 25% of the LRU to avoid using too much memory.
+      lp_variant_cache_miss(cache, &shader->stats);
+
+      /* First check if we've created too many variants.  If so, evict
+       * the lowest priority ones to avoid using too much memory.
        */
-      if (fpme->llvm->nr_gs_variants >= DRAW_MAX_SHADER_VARIANTS) {
+      if (lp_variant_cache_full(cache)) {
          /*
           * XXX: should we flush here ?
           */
-         for (i = 0; i < DRAW_MAX_SHADER_VARIANTS / 4; i++) {
-            struct draw_gs_llvm_variant_list_item *item;
-            if (is_empty_list(&fpme->llvm->gs_variants_list)) {
+         while (lp_variant_cache_over_target(cache)) {
+            struct draw_gs_llvm_variant_list_item *item, *victim = NULL;
+
+            foreach(item, &fpme->llvm->gs_variants_list) {
+               if (!victim ||
+                   item->base->info.priority <= victim->base->info.priority)
+                  victim = item;
+            }
+            if (!victim) {
                break;
             }
-            item = last_elem(&fpme->llvm->gs_variants_list);
-            assert(item);
-            assert(item->base);
-            draw_gs_llvm_destroy_variant(item->base);
+            draw_gs_llvm_destroy_variant(victim->base, TRUE);
          }
       }
 
+      t0 = os_time_get();
       variant = draw_gs_llvm_create_variant(fpme->llvm, gs->info.num_outputs, key);
 
       if (variant) {
          insert_at_head(&shader->variants, &variant->list_item_local);
          insert_at_head(&fpme->llvm->gs_variants_list,
                         &variant->list_item_global);
-         fpme->llvm->nr_gs_variants++;
+         lp_variant_cache_insert(cache, &shader->stats, &variant->info,
+                                 variant->gallivm, os_time_get() - t0);
          shader->variants_cached++;
       }
    }
@@ -149,8 +169,7 @@ llvm_middle_end_prepare( struct draw_pt_middle_end *middle,
    struct draw_geometry_shader *gs = draw->gs.geometry_shader;
    const unsigned out_prim = gs ? gs->output_primitive :
       u_assembled_prim(in_prim);
-   unsigned point_clip = draw->rasterizer->fill_front == PIPE_POLYGON_MODE_POINT ||
-                         out_prim == PIPE_PRIM_POINTS;
+   const boolean guard_band = draw_guard_band_xy(draw, out_prim);
    unsigned nr;
 
    fpme->input_prim = in_prim;
@@ -160,8 +179,7 @@ llvm_middle_end_prepare( struct draw_pt_middle_end *middle,
                             draw->clip_xy,
                             draw->clip_z,
                             draw->clip_user,
-                            point_clip ? draw->guard_band_points_xy :
-                                         draw->guard_band_xy,
+                            guard_band,
                             draw->bypass_viewport,
                             draw->rasterizer->clip_halfz,
                             (draw->vs.edgeflag_output ? TRUE : FALSE) );
@@ -200,10 +218,10 @@ llvm_middle_end_prepare( struct draw_pt_middle_end *middle,
       struct draw_llvm_variant *variant = NULL;
       struct draw_llvm_variant_list_item *li;
       struct llvm_vertex_shader *shader = llvm_vertex_shader(vs);
+      struct lp_variant_cache *cache = &fpme->llvm->vs_variant_cache;
       char store[DRAW_LLVM_MAX_VARIANT_KEY_SIZE];
-      unsigned i;
 
-      key = draw_llvm_make_variant_key(fpme->llvm, store);
+      key = draw_llvm_make_variant_key(fpme->llvm, store, guard_band);
 
       /* Search shader's list of variants for the key */
       li = first_elem(&shader->variants);
@@ -219,36 +237,45 @@ llvm_middle_end_prepare( struct draw_pt_middle_end *middle,
          /* found the variant, move to head of global list (for LRU) */
          move_to_head(&fpme->llvm->vs_variants_list,
                       &variant->list_item_global);
+         lp_variant_cache_hit(cache, &shader->stats, &variant->info);
       }
       else {
          /* Need to create new variant */
+         int64_t t0;
+
+         lp_variant_cache_miss(cache, &shader->stats);
 
-         /* First check if we've created too many variants.  If so, free
-          * 25% of the LRU to avoid using too much memory.
+         /* First check if we've created too many variants.  If so, evict
+          * the lowest priority ones to avoid using too much memory.
           */
-         if (fpme->llvm->nr_variants >= DRAW_MAX_SHADER_VARIANTS) {
+         if (lp_variant_cache_full(cache)) {
             /*
              * XXX: should we flush here ?
              */
-            for (i = 0; i < DRAW_MAX_SHADER_VARIANTS / 4; i++) {
-               struct draw_llvm_variant_list_item *item;
-               if (is_empty_list(&fpme->llvm->vs_variants_list)) {
+            while (lp_variant_cache_over_target(cache)) {
+               struct draw_llvm_variant_list_item *item, *victim = NULL;
+
+               foreach(item, &fpme->llvm->vs_variants_list) {
+                  if (!victim ||
+                      item->base->info.priority <= victim->base->info.priority)
+                     victim = item;
+               }
+               if (!victim) {
                   break;
                }
-               item = last_elem(&fpme->llvm->vs_variants_list);
-               assert(item);
-               assert(item->base);
-               draw_llvm_destroy_variant(item->base);
+               draw_llvm_destroy_variant(victim->base, TRUE);
             }
          }
 
+         t0 = os_time_get();
          variant = draw_llvm_create_variant(fpme->llvm, nr, key);
 
          if (variant) {
             insert_at_head(&shader->variants, &variant->list_item_local);
             insert_at_head(&fpme->llvm->vs_variants_list,
                            &variant->list_item_global);
-            fpme->llvm->nr_variants++;
+            lp_variant_cache_insert(cache, &shader->stats, &variant->info,
+                                    variant->gallivm, os_time_get() - t0);
             shader->variants_cached++;
          }
       }
@@ -303,6 +330,9 @@ llvm_middle_end_bind_parameters(struct draw_pt_middle_end *middle)
 
    llvm->jit_context.viewports = draw->viewports;
    llvm->gs_jit_context.viewports = draw->viewports;
+
+   llvm->jit_context.guard_band[0] = draw->guard_band[0];
+   llvm->jit_context.guard_band[1] = draw->guard_band[1];
 }
 
 
@@ -336,6 +366,115 @@ emit(struct pt_emit *emit,
 }
 
 
+/**
+ * Fetch, shade and cliptest vertices [first, first + count) of the
+ * segment into the corresponding slots of verts.
+ */
+static unsigned
+llvm_run_vs_range(struct llvm_middle_end *fpme,
+                  const struct draw_fetch_info *fetch_info,
+                  struct vertex_header *verts,
+                  unsigned first,
+                  unsigned count)
+{
+   struct draw_context *draw = fpme->draw;
+   struct vertex_header *io = (struct vertex_header *)
+      ((char *) verts + first * fpme->vertex_size);
+
+   if (fetch_info->linear)
+      return fpme->current_variant->jit_func( &fpme->llvm->jit_context,
+                                       io,
+                                       draw->pt.user.vbuffer,
+                                       fetch_info->start + first,
+                                       count,
+                                       fpme->vertex_size,
+                                       draw->pt.vertex_buffer,
+                                       draw->instance_id,
+                                       draw->start_index,
+                                       draw->start_instance);
+   else
+      return fpme->current_variant->jit_func_elts( &fpme->llvm->jit_context,
+                                            io,
+                                            draw->pt.user.vbuffer,
+                                            fetch_info->elts + first,
+                                            draw->pt.user.eltMax,
+                                            count,
+                                            fpme->vertex_size,
+                                            draw->pt.vertex_buffer,
+                                            draw->instance_id,
+                                            draw->pt.user.eltBias,
+                                            draw->start_instance);
+}
+
+
+struct llvm_vs_job {
+   struct llvm_middle_end *fpme;
+   const struct draw_fetch_info *fetch_info;
+   struct vertex_header *verts;
+   unsigned chunk_size;
+   unsigned clipped[DRAW_MAX_WORKER_THREADS + 1];
+};
+
+
+static void
+llvm_vs_task(void *data, unsigned task)
+{
+   struct llvm_vs_job *job = (struct llvm_vs_job *) data;
+   unsigned first = task * job->chunk_size;
+   unsigned count = MIN2(job->chunk_size, job->fetch_info->count - first);
+
+   job->clipped[task] = llvm_run_vs_range(job->fpme, job->fetch_info,
+                                          job->verts, first, count);
+}
+
+
+/**
+ * Run the vertex shader over the whole segment, splitting it across the
+ * draw worker threads if there are any and the segment is large enough.
+ *
+ * Every thread writes its own contiguous slice of verts, so the output is
+ * identical to the single threaded case and the primitives are handed to
+ * the pipeline/emit stages in their original order.  The slices are
+ * multiples of the vector length, as the jit function always writes whole
+ * vectors.
+ */
+static unsigned
+llvm_run_vs(struct llvm_middle_end *fpme,
+            const struct draw_fetch_info *fetch_info,
+            struct vertex_header *verts)
+{
+   struct draw_context *draw = fpme->draw;
+   const unsigned count = fetch_info->count;
+   unsigned num_tasks;
+
+   num_tasks = MIN2(draw_workers_num_threads(draw->pt.workers) + 1,
+                    count / LLVM_MIN_VERTICES_PER_THREAD);
+
+   if (num_tasks > 1) {
+      const unsigned vector_length = lp_native_vector_width / 32;
+      struct llvm_vs_job job;
+      unsigned clipped = 0;
+      unsigned i;
+
+      job.fpme = fpme;
+      job.fetch_info = fetch_info;
+      job.verts = verts;
+      job.chunk_size = align((count + num_tasks - 1) / num_tasks,
+                             vector_length);
+      num_tasks = (count + job.chunk_size - 1) / job.chunk_size;
+
+      draw_workers_run(draw->pt.workers, llvm_vs_task, &job, num_tasks);
+
+      for (i = 0; i < num_tasks; i++)
+         clipped |= job.clipped[i];
+
+      return clipped;
+   }
+
+   return llvm_run_vs_range(fpme, fetch_info, verts, 0, count);
+}
+
+
 static void
 llvm_pipeline_generic(struct draw_pt_middle_end *middle,
                       const struct draw_fetch_info *fetch_info,
@@ -373,29 +512,13 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
       draw->statistics.vs_invocations += fetch_info->count;
    }
 
-   if (fetch_info->linear)
-      clipped = fpme->current_variant->jit_func( &fpme->llvm->jit_context,
-                                       llvm_vert_info.verts,
-                                       draw->pt.user.vbuffer,
-                                       fetch_info->start,
-                                       fetch_info->count,
-                                       fpme->vertex_size,
-                                       draw->pt.vertex_buffer,
-                                       draw->instance_id,
-                                       draw->start_index,
-                                       draw->start_instance);
-   else
-      clipped = fpme->current_variant->jit_func_elts( &fpme->llvm->jit_context,
-                                            llvm_vert_info.verts,
-                                            draw->pt.user.vbuffer,
-                                            fetch_info->elts,
-                                            draw->pt.user.eltMax,
-                                            fetch_info->count,
-                                            fpme->vertex_size,
-                                            draw->pt.vertex_buffer,
-                                            draw->instance_id,
-                                            draw->pt.user.eltBias,
-                                            draw->start_instance);
+   if (draw->pt.dump_acmr) {
+      draw->pt.acmr.vs_invocations += fetch_info->count;
+      draw->pt.acmr.prims +=
+         u_decomposed_prims_for_vertices(prim_info->prim, prim_info->count);
+   }
+
+   clipped = llvm_run_vs( fpme, fetch_info, llvm_vert_info.verts );
 
    /* Finished with fetch and vs:
     */
@@ -87,6 +87,10 @@ dot4(const float *a, const float *b)
 #define TAG(x) x##_xy_gb_halfz_viewport
 #include "draw_cliptest_tmp.h"
 
+#define FLAGS (DO_CLIP_XY_GUARD_BAND | DO_CLIP_FULL_Z | DO_VIEWPORT)
+#define TAG(x) x##_xy_gb_fullz_viewport
+#include "draw_cliptest_tmp.h"
+
 #define FLAGS (DO_CLIP_FULL_Z | DO_VIEWPORT)
 #define TAG(x) x##_fullz_viewport
 #include "draw_cliptest_tmp.h"
@@ -135,25 +139,17 @@ void draw_pt_post_vs_prepare( struct pt_post_vs *pvs,
 {
    pvs->flags = 0;
 
-   /* This combination not currently tested/in use:
-    */
-   if (!clip_halfz)
-      guard_band = FALSE;
+   if (clip_xy) {
+      pvs->flags |= guard_band ? DO_CLIP_XY_GUARD_BAND : DO_CLIP_XY;
 
-   if (clip_xy && !guard_band) {
-      pvs->flags |= DO_CLIP_XY;
+      /* Primitives which leave the guard band are still clipped against
+       * the viewport.
+       */
       ASSIGN_4V( pvs->draw->plane[0], -1,  0,  0, 1 );
       ASSIGN_4V( pvs->draw->plane[1],  1,  0,  0, 1 );
       ASSIGN_4V( pvs->draw->plane[2],  0, -1,  0, 1 );
       ASSIGN_4V( pvs->draw->plane[3],  0,  1,  0, 1 );
    }
-   else if (clip_xy && guard_band) {
-      pvs->flags |= DO_CLIP_XY_GUARD_BAND;
-      ASSIGN_4V( pvs->draw->plane[0], -0.5,  0,  0, 1 );
-      ASSIGN_4V( pvs->draw->plane[1],  0.5,  0,  0, 1 );
-      ASSIGN_4V( pvs->draw->plane[2],  0, -0.5,  0, 1 );
-      ASSIGN_4V( pvs->draw->plane[3],  0,  0.5,  0, 1 );
-   }
 
    if (clip_z) {
       if (clip_halfz) {
@@ -193,6 +189,10 @@ void draw_pt_post_vs_prepare( struct pt_post_vs *pvs,
       pvs->run = do_cliptest_xy_gb_halfz_viewport;
       break;
 
+   case DO_CLIP_XY_GUARD_BAND | DO_CLIP_FULL_Z | DO_VIEWPORT:
+      pvs->run = do_cliptest_xy_gb_fullz_viewport;
+      break;
+
    case DO_CLIP_FULL_Z | DO_VIEWPORT:
       pvs->run = do_cliptest_fullz_viewport;
       break;
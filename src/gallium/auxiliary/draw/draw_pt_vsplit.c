@@ -31,7 +31,15 @@
 #include "draw/draw_pt.h"
 
 #define SEGMENT_SIZE 1024
-#define MAP_SIZE     256
+
+/* The fetch -> draw element map is a 2-way set associative cache with LRU
+ * replacement, so that two vertices whose indices collide in a set (e.g.
+ * the same column of neighbouring rows in a grid) don't keep evicting
+ * each other and getting shaded again.
+ */
+#define MAP_BITS     8
+#define MAP_SIZE     (1 << MAP_BITS)
+#define MAP_WAYS     2
 
 /* The largest possible index withing an index buffer */
 #define MAX_ELT_IDX 0xffffffff
@@ -54,8 +62,9 @@ struct vsplit_frontend {
 
    struct {
       /* map a fetch element to a draw element */
-      unsigned fetches[MAP_SIZE];
-      ushort draws[MAP_SIZE];
+      unsigned fetches[MAP_SIZE][MAP_WAYS];
+      ushort draws[MAP_SIZE][MAP_WAYS];
+      ubyte lru[MAP_SIZE]; /* least recently used way of each set */
       boolean has_max_fetch;
 
       ushort num_fetch_elts;
@@ -68,6 +77,7 @@ static void
 vsplit_clear_cache(struct vsplit_frontend *vsplit)
 {
    memset(vsplit->cache.fetches, 0xff, sizeof(vsplit->cache.fetches));
+   memset(vsplit->cache.lru, 0, sizeof(vsplit->cache.lru));
    vsplit->cache.has_max_fetch = FALSE;
    vsplit->cache.num_fetch_elts = 0;
    vsplit->cache.num_draw_elts = 0;
@@ -81,29 +91,51 @@ vsplit_flush_cache(struct vsplit_frontend *vsplit, unsigned flags)
          vsplit->draw_elts, vsplit->cache.num_draw_elts, flags);
 }
 
+/**
+ * Map a fetch element to its cache set.  Nearby indices go to different
+ * sets, while folding in the high bits keeps large power-of-two strides
+ * from all landing in the same set.
+ */
+static INLINE unsigned
+vsplit_hash(unsigned fetch)
+{
+   return (fetch ^ (fetch >> MAP_BITS)) % MAP_SIZE;
+}
+
 /**
  * Add a fetch element and add it to the draw elements.
  */
 static INLINE void
 vsplit_add_cache(struct vsplit_frontend *vsplit, unsigned fetch, unsigned ofbias)
 {
-   unsigned hash;
-
-   hash = fetch % MAP_SIZE;
+   unsigned hash = vsplit_hash(fetch);
+   unsigned way;
 
    /* If the value isn't in the cache or it's an overflow due to the
     * element bias */
-   if (vsplit->cache.fetches[hash] != fetch || ofbias) {
-      /* update cache */
-      vsplit->cache.fetches[hash] = fetch;
-      vsplit->cache.draws[hash] = vsplit->cache.num_fetch_elts;
-
-      /* add fetch */
-      assert(vsplit->cache.num_fetch_elts < vsplit->segment_size);
-      vsplit->fetch_elts[vsplit->cache.num_fetch_elts++] = fetch;
+   if (!ofbias) {
+      for (way = 0; way < MAP_WAYS; way++) {
+         if (vsplit->cache.fetches[hash][way] == fetch) {
+            vsplit->cache.lru[hash] = !way;
+            vsplit->draw_elts[vsplit->cache.num_draw_elts++] =
+               vsplit->cache.draws[hash][way];
+            return;
+         }
+      }
    }
 
-   vsplit->draw_elts[vsplit->cache.num_draw_elts++] = vsplit->cache.draws[hash];
+   /* update cache */
+   way = vsplit->cache.lru[hash];
+   vsplit->cache.lru[hash] = !way;
+   vsplit->cache.fetches[hash][way] = fetch;
+   vsplit->cache.draws[hash][way] = vsplit->cache.num_fetch_elts;
+
+   /* add fetch */
+   assert(vsplit->cache.num_fetch_elts < vsplit->segment_size);
+   vsplit->fetch_elts[vsplit->cache.num_fetch_elts++] = fetch;
+
+   vsplit->draw_elts[vsplit->cache.num_draw_elts++] =
+      vsplit->cache.draws[hash][way];
 }
 
 /**
@@ -203,8 +235,11 @@ vsplit_add_cache_uint(struct vsplit_frontend *vsplit, const uint *elts,
 
    /* special care for DRAW_MAX_FETCH_IDX */
    if (raw_elem_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = fetch % MAP_SIZE;
-      vsplit->cache.fetches[hash] = raw_elem_idx - 1; /* force update */
+      unsigned hash = vsplit_hash(elt_idx);
+      unsigned way;
+      /* force update, as the cache is initialized with that value */
+      for (way = 0; way < MAP_WAYS; way++)
+         vsplit->cache.fetches[hash][way] = raw_elem_idx - 1;
       vsplit->cache.has_max_fetch = TRUE;
    }
 
@@ -27,6 +27,7 @@
 
 #include "util/u_math.h"
 #include "util/u_memory.h"
+#include "util/u_string.h"
 #include "pipe/p_shader_tokens.h"
 #include "pipe/p_screen.h"
 
@@ -70,11 +71,17 @@ vs_llvm_delete( struct draw_vertex_shader *dvs )
    li = first_elem(&shader->variants);
    while(!at_end(&shader->variants, li)) {
       struct draw_llvm_variant_list_item *next = next_elem(li);
-      draw_llvm_destroy_variant(li->base);
+      draw_llvm_destroy_variant(li->base, FALSE);
       li = next;
    }
 
    assert(shader->variants_cached == 0);
+
+   if (lp_variant_stats_enabled()) {
+      char name[32];
+      util_snprintf(name, sizeof name, "draw vs %p", (void *) dvs);
+      lp_variant_stats_dump(name, &shader->stats);
+   }
    FREE((void*) dvs->state.tokens);
    FREE( dvs );
 }
@@ -0,0 +1,206 @@
+/**************************************************************************
+ *
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Worker thread pool for the draw module.
+ *
+ * Each thread has a pair of semaphores, like the llvmpipe rasterizer
+ * threads: the caller signals work_ready, the thread runs its task and
+ * signals work_done.  There is no queue, a run has at most one task per
+ * thread plus one for the caller.
+ */
+
+#include "os/os_thread.h"
+#include "util/u_debug.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/u_string.h"
+#include "draw/draw_workers.h"
+
+
+struct draw_worker
+{
+   struct draw_workers *workers;
+   unsigned index;
+
+   pipe_thread thread;
+   pipe_semaphore work_ready;
+   pipe_semaphore work_done;
+};
+
+
+struct draw_workers
+{
+   unsigned num_threads;
+   boolean exit_flag;
+
+   /* current job, only valid between work_ready and work_done */
+   draw_worker_func func;
+   void *data;
+
+   struct draw_worker worker[DRAW_MAX_WORKER_THREADS];
+};
+
+
+static PIPE_THREAD_ROUTINE( worker_thread, init_data )
+{
+   struct draw_worker *worker = (struct draw_worker *) init_data;
+   struct draw_workers *workers = worker->workers;
+   char thread_name[16];
+   unsigned fpstate;
+
+   util_snprintf(thread_name, sizeof thread_name, "draw-%u", worker->index);
+   pipe_thread_setname(thread_name);
+
+   /* Same floating point environment as draw_vbo() sets up for the
+    * calling thread.
+    */
+   fpstate = util_fpstate_get();
+   util_fpstate_set_denorms_to_zero(fpstate);
+
+   while (1) {
+      pipe_semaphore_wait(&worker->work_ready);
+
+      if (workers->exit_flag)
+         break;
+
+      /* task 0 is run by the calling thread */
+      workers->func(workers->data, worker->index + 1);
+
+      pipe_semaphore_signal(&worker->work_done);
+   }
+
+   return 0;
+}
+
+
+/**
+ * Create a pool of num_threads worker threads.  Returns NULL if
+ * num_threads is zero or on failure.
+ */
+struct draw_workers *
+draw_workers_create(unsigned num_threads)
+{
+   struct draw_workers *workers;
+   unsigned i;
+
+   num_threads = MIN2(num_threads, DRAW_MAX_WORKER_THREADS);
+   if (num_threads == 0)
+      return NULL;
+
+   workers = CALLOC_STRUCT(draw_workers);
+   if (!workers)
+      return NULL;
+
+   for (i = 0; i < num_threads; i++) {
+      struct draw_worker *worker = &workers->worker[i];
+
+      worker->workers = workers;
+      worker->index = i;
+      pipe_semaphore_init(&worker->work_ready, 0);
+      pipe_semaphore_init(&worker->work_done, 0);
+      worker->thread = pipe_thread_create(worker_thread, worker);
+      if (!worker->thread) {
+         pipe_semaphore_destroy(&worker->work_ready);
+         pipe_semaphore_destroy(&worker->work_done);
+         break;
+      }
+      workers->num_threads++;
+   }
+
+   if (workers->num_threads == 0) {
+      FREE(workers);
+      return NULL;
+   }
+
+   return workers;
+}
+
+
+unsigned
+draw_workers_num_threads(const struct draw_workers *workers)
+{
+   return workers ? workers->num_threads : 0;
+}
+
+
+/**
+ * Run func(data, task) for task in [0, num_tasks) and wait for all of
+ * them.  num_tasks must not exceed the number of threads plus one.
+ */
+void
+draw_workers_run(struct draw_workers *workers,
+                 draw_worker_func func,
+                 void *data,
+                 unsigned num_tasks)
+{
+   unsigned i;
+
+   if (num_tasks == 0)
+      return;
+
+   assert(workers || num_tasks == 1);
+   assert(!workers || num_tasks <= workers->num_threads + 1);
+
+   if (num_tasks > 1) {
+      workers->func = func;
+      workers->data = data;
+
+      for (i = 0; i < num_tasks - 1; i++)
+         pipe_semaphore_signal(&workers->worker[i].work_ready);
+   }
+
+   func(data, 0);
+
+   for (i = 0; i + 1 < num_tasks; i++)
+      pipe_semaphore_wait(&workers->worker[i].work_done);
+}
+
+
+void
+draw_workers_destroy(struct draw_workers *workers)
+{
+   unsigned i;
+
+   if (!workers)
+      return;
+
+   workers->exit_flag = TRUE;
+
+   for (i = 0; i < workers->num_threads; i++)
+      pipe_semaphore_signal(&workers->worker[i].work_ready);
+
+   for (i = 0; i < workers->num_threads; i++) {
+      pipe_thread_wait(workers->worker[i].thread);
+      pipe_semaphore_destroy(&workers->worker[i].work_ready);
+      pipe_semaphore_destroy(&workers->worker[i].work_done);
+   }
+
+   FREE(workers);
+}
@@ -0,0 +1,69 @@
+/**************************************************************************
+ *
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * A small pool of worker threads used to spread the vertex processing
+ * of a single draw segment over several cores.
+ *
+ * draw_workers_run() hands out task indices 1..num_tasks-1 to the worker
+ * threads, runs task 0 on the calling thread and returns once all of them
+ * are done, so callers can treat it like a plain (parallel) loop.
+ */
+
+#ifndef DRAW_WORKERS_H
+#define DRAW_WORKERS_H
+
+#include "pipe/p_compiler.h"
+
+
+/** Upper limit on the number of worker threads */
+#define DRAW_MAX_WORKER_THREADS 16
+
+struct draw_workers;
+
+typedef void (*draw_worker_func)(void *data, unsigned task);
+
+
+struct draw_workers *
+draw_workers_create(unsigned num_threads);
+
+unsigned
+draw_workers_num_threads(const struct draw_workers *workers);
+
+void
+draw_workers_run(struct draw_workers *workers,
+                 draw_worker_func func,
+                 void *data,
+                 unsigned num_tasks);
+
+void
+draw_workers_destroy(struct draw_workers *workers);
+
+
+#endif /* DRAW_WORKERS_H */
@@ -171,6 +171,21 @@ lp_build_min_simple(struct lp_build_context *bld,
             intrinsic = "llvm.x86.sse41.pminsd";
          }
       }
+      if (util_cpu_caps.has_avx2 && type.width * type.length > 128) {
+         intr_size = 256;
+         if (type.width == 8) {
+            intrinsic = type.sign ? "llvm.x86.avx2.pmins.b" :
+                                    "llvm.x86.avx2.pminu.b";
+         }
+         else if (type.width == 16) {
+            intrinsic = type.sign ? "llvm.x86.avx2.pmins.w" :
+                                    "llvm.x86.avx2.pminu.w";
+         }
+         else if (type.width == 32) {
+            intrinsic = type.sign ? "llvm.x86.avx2.pmins.d" :
+                                    "llvm.x86.avx2.pminu.d";
+         }
+      }
    } else if (util_cpu_caps.has_altivec) {
       intr_size = 128;
       if (type.width == 8) {
@@ -353,6 +368,21 @@ lp_build_max_simple(struct lp_build_context *bld,
             intrinsic = "llvm.x86.sse41.pmaxsd";
          }
       }
+      if (util_cpu_caps.has_avx2 && type.width * type.length > 128) {
+         intr_size = 256;
+         if (type.width == 8) {
+            intrinsic = type.sign ? "llvm.x86.avx2.pmaxs.b" :
+                                    "llvm.x86.avx2.pmaxu.b";
+         }
+         else if (type.width == 16) {
+            intrinsic = type.sign ? "llvm.x86.avx2.pmaxs.w" :
+                                    "llvm.x86.avx2.pmaxu.w";
+         }
+         else if (type.width == 32) {
+            intrinsic = type.sign ? "llvm.x86.avx2.pmaxs.d" :
+                                    "llvm.x86.avx2.pmaxu.d";
+         }
+      }
    } else if (util_cpu_caps.has_altivec) {
      intr_size = 128;
      if (type.width == 8) {
@@ -517,6 +547,14 @@ lp_build_add(struct lp_build_context *bld,
               intrinsic = type.sign ? "llvm.ppc.altivec.vaddshs" : "llvm.ppc.altivec.vadduhs";
          }
       }
+      else if (type.width * type.length == 256 &&
+               !type.floating && !type.fixed &&
+               util_cpu_caps.has_avx2) {
+         if(type.width == 8)
+            intrinsic = type.sign ? "llvm.x86.avx2.padds.b" : "llvm.x86.avx2.paddus.b";
+         if(type.width == 16)
+            intrinsic = type.sign ? "llvm.x86.avx2.padds.w" : "llvm.x86.avx2.paddus.w";
+      }
    
       if(intrinsic)
          return lp_build_intrinsic_binary(builder, intrinsic, lp_build_vec_type(bld->gallivm, bld->type), a, b);
@@ -809,6 +847,14 @@ lp_build_sub(struct lp_build_context *bld,
               intrinsic = type.sign ? "llvm.ppc.altivec.vsubshs" : "llvm.ppc.altivec.vsubuhs";
          }
       }
+      else if (type.width * type.length == 256 &&
+               !type.floating && !type.fixed &&
+               util_cpu_caps.has_avx2) {
+         if(type.width == 8)
+            intrinsic = type.sign ? "llvm.x86.avx2.psubs.b" : "llvm.x86.avx2.psubus.b";
+         if(type.width == 16)
+            intrinsic = type.sign ? "llvm.x86.avx2.psubs.w" : "llvm.x86.avx2.psubus.w";
+      }
    
       if(intrinsic)
          return lp_build_intrinsic_binary(builder, intrinsic, lp_build_vec_type(bld->gallivm, bld->type), a, b);
@@ -1512,6 +1558,16 @@ lp_build_abs(struct lp_build_context *bld,
          return lp_build_intrinsic_unary(builder, "llvm.x86.ssse3.pabs.d.128", vec_type, a);
       }
    }
+   else if (type.width*type.length == 256 && util_cpu_caps.has_avx2) {
+      switch(type.width) {
+      case 8:
+         return lp_build_intrinsic_unary(builder, "llvm.x86.avx2.pabs.b", vec_type, a);
+      case 16:
+         return lp_build_intrinsic_unary(builder, "llvm.x86.avx2.pabs.w", vec_type, a);
+      case 32:
+         return lp_build_intrinsic_unary(builder, "llvm.x86.avx2.pabs.d", vec_type, a);
+      }
+   }
    else if (type.width*type.length == 256 && util_cpu_caps.has_ssse3 &&
             (gallivm_debug & GALLIVM_DEBUG_PERF) &&
             (type.width == 8 || type.width == 16 || type.width == 32)) {
@@ -644,6 +644,30 @@ lp_build_conv(struct gallivm_state *gallivm,
 
          a = LLVMBuildFMul(builder, src[0], const_255f, "");
          a = lp_build_iround(&bld, a);
+
+         if (util_cpu_caps.has_avx2) {
+            /* Pack both 8x32 vectors at once with a 256bit pack */
+            struct lp_type int16x16_type = int16_type;
+            struct lp_type int32x8_type = int32_type;
+            LLVMValueRef ab;
+
+            int16x16_type.length *= 2;
+            int32x8_type.length *= 2;
+
+            if (num_srcs == 1) {
+               b = a;
+            }
+            else {
+               b = LLVMBuildFMul(builder, src[1], const_255f, "");
+               b = lp_build_iround(&bld, b);
+            }
+            ab = lp_build_pack2(gallivm, int32x8_type, int16x16_type, a, b);
+            lo = lp_build_extract_range(gallivm, ab, 0, 8);
+            hi = lp_build_extract_range(gallivm, ab, 8, 8);
+            dst[i] = lp_build_pack2(gallivm, int16_type, dst_type_ext, lo, hi);
+            continue;
+         }
+
          tmp[0] = lp_build_extract_range(gallivm, a, 0, 4);
          tmp[1] = lp_build_extract_range(gallivm, a, 4, 4);
          /* relying on clamping behavior of sse2 intrinsics here */
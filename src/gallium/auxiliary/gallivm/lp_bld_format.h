@@ -66,7 +66,8 @@ lp_build_fetch_rgba_aos(struct gallivm_state *gallivm,
                         LLVMValueRef base_ptr,
                         LLVMValueRef offset,
                         LLVMValueRef i,
-                        LLVMValueRef j);
+                        LLVMValueRef j,
+                        boolean use_cache);
 
 LLVMValueRef
 lp_build_fetch_rgba_aos_array(struct gallivm_state *gallivm,
@@ -76,6 +77,23 @@ lp_build_fetch_rgba_aos_array(struct gallivm_state *gallivm,
                         LLVMValueRef offset);
 
 
+/*
+ * Decoded compressed block cache
+ */
+
+boolean
+lp_format_cache_supported(const struct util_format_description *desc);
+
+void
+lp_format_cache_invalidate(void);
+
+void
+lp_format_cache_fetch_rgba_8unorm(const struct util_format_description *desc,
+                                  uint8_t *dst,
+                                  const uint8_t *src,
+                                  unsigned i, unsigned j);
+
+
 /*
  * SoA
  */
@@ -107,6 +125,7 @@ lp_build_fetch_rgba_soa(struct gallivm_state *gallivm,
                         LLVMValueRef offsets,
                         LLVMValueRef i,
                         LLVMValueRef j,
+                        boolean use_cache,
                         LLVMValueRef rgba_out[4]);
 
 /*
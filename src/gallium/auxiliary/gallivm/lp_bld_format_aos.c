@@ -360,6 +360,10 @@ lp_build_pack_rgba_aos(struct gallivm_state *gallivm,
  * \param ptr  address of the pixel block (or the texel if uncompressed)
  * \param i, j  the sub-block pixel coordinates.  For non-compressed formats
  *              these will always be (0, 0).
+ * \param use_cache  whether compressed blocks may be decoded through the
+ *                   texel cache.  Only for callers which invalidate it when
+ *                   the texture memory is written or freed, see
+ *                   lp_format_cache_invalidate().
  * \return  a 4 element vector with the pixel's RGBA values.
  */
 LLVMValueRef
@@ -370,7 +374,8 @@ lp_build_fetch_rgba_aos(struct gallivm_state *gallivm,
                         LLVMValueRef base_ptr,
                         LLVMValueRef offset,
                         LLVMValueRef i,
-                        LLVMValueRef j)
+                        LLVMValueRef j,
+                        boolean use_cache)
 {
    LLVMBuilderRef builder = gallivm->builder;
    unsigned num_pixels = type.length / 4;
@@ -519,41 +524,59 @@ lp_build_fetch_rgba_aos(struct gallivm_state *gallivm,
       LLVMTypeRef i8t = LLVMInt8TypeInContext(gallivm->context);
       LLVMTypeRef pi8t = LLVMPointerType(i8t, 0);
       LLVMTypeRef i32t = LLVMInt32TypeInContext(gallivm->context);
+      const boolean cached = use_cache &&
+                             lp_format_cache_supported(format_desc);
       LLVMValueRef function;
+      LLVMValueRef desc_ptr = NULL;
       LLVMValueRef tmp_ptr;
       LLVMValueRef tmp;
       LLVMValueRef res;
       unsigned k;
 
       if (gallivm_debug & GALLIVM_DEBUG_PERF) {
-         debug_printf("%s: falling back to util_format_%s_fetch_rgba_8unorm\n",
-                      __FUNCTION__, format_desc->short_name);
+         debug_printf("%s: falling back to %sutil_format_%s_fetch_rgba_8unorm\n",
+                      __FUNCTION__, cached ? "cached " : "",
+                      format_desc->short_name);
       }
 
       /*
-       * Declare and bind format_desc->fetch_rgba_8unorm().
+       * Declare and bind format_desc->fetch_rgba_8unorm(), or
+       * lp_format_cache_fetch_rgba_8unorm() for compressed formats.
        */
 
       {
          /*
           * Function to call looks like:
           *   fetch(uint8_t *dst, const uint8_t *src, unsigned i, unsigned j)
+          * with an additional leading format description argument for the
+          * cached fetch.
           */
          LLVMTypeRef ret_type;
-         LLVMTypeRef arg_types[4];
+         LLVMTypeRef arg_types[5];
          LLVMTypeRef function_type;
+         unsigned num_args = 0;
 
          ret_type = LLVMVoidTypeInContext(gallivm->context);
-         arg_types[0] = pi8t;
-         arg_types[1] = pi8t;
-         arg_types[2] = i32t;
-         arg_types[3] = i32t;
+         if (cached)
+            arg_types[num_args++] = pi8t;
+         arg_types[num_args++] = pi8t;
+         arg_types[num_args++] = pi8t;
+         arg_types[num_args++] = i32t;
+         arg_types[num_args++] = i32t;
          function_type = LLVMFunctionType(ret_type, arg_types,
-                                          Elements(arg_types), 0);
+                                          num_args, 0);
 
          /* make const pointer for the C fetch_rgba_8unorm function */
-         function = lp_build_const_int_pointer(gallivm,
-            func_to_pointer((func_pointer) format_desc->fetch_rgba_8unorm));
+         if (cached) {
+            function = lp_build_const_int_pointer(gallivm,
+               func_to_pointer((func_pointer) lp_format_cache_fetch_rgba_8unorm));
+            desc_ptr = LLVMBuildBitCast(builder,
+               lp_build_const_int_pointer(gallivm, format_desc), pi8t, "");
+         }
+         else {
+            function = lp_build_const_int_pointer(gallivm,
+               func_to_pointer((func_pointer) format_desc->fetch_rgba_8unorm));
+         }
 
          /* cast the callee pointer to the function's type */
          function = LLVMBuildBitCast(builder, function,
@@ -572,22 +595,25 @@ lp_build_fetch_rgba_aos(struct gallivm_state *gallivm,
 
       for (k = 0; k < num_pixels; ++k) {
          LLVMValueRef index = lp_build_const_int32(gallivm, k);
-         LLVMValueRef args[4];
+         LLVMValueRef args[5];
+         unsigned num_args = 0;
 
-         args[0] = LLVMBuildBitCast(builder, tmp_ptr, pi8t, "");
-         args[1] = lp_build_gather_elem_ptr(gallivm, num_pixels,
-                                            base_ptr, offset, k);
+         if (cached)
+            args[num_args++] = desc_ptr;
+         args[num_args++] = LLVMBuildBitCast(builder, tmp_ptr, pi8t, "");
+         args[num_args++] = lp_build_gather_elem_ptr(gallivm, num_pixels,
+                                                     base_ptr, offset, k);
 
          if (num_pixels == 1) {
-            args[2] = i;
-            args[3] = j;
+            args[num_args++] = i;
+            args[num_args++] = j;
          }
          else {
-            args[2] = LLVMBuildExtractElement(builder, i, index, "");
-            args[3] = LLVMBuildExtractElement(builder, j, index, "");
+            args[num_args++] = LLVMBuildExtractElement(builder, i, index, "");
+            args[num_args++] = LLVMBuildExtractElement(builder, j, index, "");
          }
 
-         LLVMBuildCall(builder, function, args, Elements(args), "");
+         LLVMBuildCall(builder, function, args, num_args, "");
 
          tmp = LLVMBuildLoad(builder, tmp_ptr, "");
 
@@ -0,0 +1,192 @@
+/**************************************************************************
+ *
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Cache of decoded compressed texture blocks.
+ *
+ * Compressed formats without a vectorized decoder are sampled by calling
+ * util_format_description::fetch_rgba_8unorm() for every texel, which
+ * repeats the work of decoding the block for each of the (up to 16)
+ * texels fetched from it.  Instead, the generated code can call
+ * lp_format_cache_fetch_rgba_8unorm(), which decodes whole blocks into a
+ * small direct mapped cache, one per thread so that the rasterizer
+ * threads don't need to synchronize.
+ *
+ * Blocks are identified by their address, so the cache must be
+ * invalidated with lp_format_cache_invalidate() whenever compressed
+ * texture memory is written or freed.  Only code generated with the
+ * texel_cache bit of lp_static_texture_state set uses the cache, so that
+ * drivers which don't do this (draw's vertex texturing for instance)
+ * never see stale blocks.
+ */
+
+#include "os/os_thread.h"
+#include "util/u_atomic.h"
+#include "util/u_debug.h"
+#include "util/u_format.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+
+#include "lp_bld_format.h"
+
+
+/** Number of cached blocks per thread, must be a power of two */
+#define LP_FORMAT_CACHE_SIZE 128
+
+#define LP_FORMAT_CACHE_MAX_TEXELS (4 * 4)
+
+
+struct lp_format_cache_entry
+{
+   const struct util_format_description *desc;
+   const uint8_t *block;
+   uint32_t texels[LP_FORMAT_CACHE_MAX_TEXELS];
+};
+
+
+struct lp_format_cache
+{
+   int generation;
+   struct lp_format_cache_entry entries[LP_FORMAT_CACHE_SIZE];
+};
+
+
+DEBUG_GET_ONCE_BOOL_OPTION(texel_cache, "GALLIVM_TEXEL_CACHE", TRUE)
+
+pipe_static_mutex(cache_mutex);
+static boolean cache_key_created = FALSE;
+static tss_t cache_key;
+
+/** Incremented to invalidate the caches of all threads */
+static int cache_generation = 0;
+
+
+static void
+lp_format_cache_destroy(void *cache)
+{
+   FREE(cache);
+}
+
+
+/**
+ * Whether fetches from the given format should go through the cache.
+ *
+ * Called when generating code, which also makes sure the thread specific
+ * storage exists before any of the generated code runs.
+ */
+boolean
+lp_format_cache_supported(const struct util_format_description *desc)
+{
+   if (!debug_get_option_texel_cache())
+      return FALSE;
+
+   if (desc->layout != UTIL_FORMAT_LAYOUT_S3TC &&
+       desc->layout != UTIL_FORMAT_LAYOUT_RGTC &&
+       desc->layout != UTIL_FORMAT_LAYOUT_ETC &&
+       desc->layout != UTIL_FORMAT_LAYOUT_BPTC)
+      return FALSE;
+
+   if (!desc->unpack_rgba_8unorm ||
+       desc->block.width * desc->block.height > LP_FORMAT_CACHE_MAX_TEXELS ||
+       !util_is_power_of_two(desc->block.bits))
+      return FALSE;
+
+   pipe_mutex_lock(cache_mutex);
+   if (!cache_key_created &&
+       tss_create(&cache_key, lp_format_cache_destroy) == thrd_success) {
+      cache_key_created = TRUE;
+   }
+   pipe_mutex_unlock(cache_mutex);
+
+   return cache_key_created;
+}
+
+
+/**
+ * Drop the decoded blocks of all threads.
+ */
+void
+lp_format_cache_invalidate(void)
+{
+   p_atomic_inc(&cache_generation);
+}
+
+
+/**
+ * Fetch a texel, decoding its block into the calling thread's cache first
+ * if it isn't there yet.
+ *
+ * Same as util_format_description::fetch_rgba_8unorm(), apart from the
+ * format argument.
+ */
+void
+lp_format_cache_fetch_rgba_8unorm(const struct util_format_description *desc,
+                                  uint8_t *dst,
+                                  const uint8_t *src,
+                                  unsigned i, unsigned j)
+{
+   struct lp_format_cache *cache = tss_get(cache_key);
+   const int generation = p_atomic_read(&cache_generation);
+   struct lp_format_cache_entry *entry;
+   uintptr_t index;
+
+   if (unlikely(!cache)) {
+      cache = CALLOC_STRUCT(lp_format_cache);
+      if (!cache || tss_set(cache_key, cache) != thrd_success) {
+         FREE(cache);
+         desc->fetch_rgba_8unorm(dst, src, i, j);
+         return;
+      }
+      cache->generation = generation;
+   }
+
+   if (cache->generation != generation) {
+      memset(cache->entries, 0, sizeof cache->entries);
+      cache->generation = generation;
+   }
+
+   /* Blocks are 8 or 16 bytes and laid out in rows, so consecutive blocks
+    * go to consecutive entries, and the block rows above and below mostly
+    * to different ones.
+    */
+   index = (uintptr_t) src >> util_logbase2(desc->block.bits / 8);
+   index ^= index >> 5;
+   entry = &cache->entries[index % LP_FORMAT_CACHE_SIZE];
+
+   if (entry->block != src || entry->desc != desc) {
+      desc->unpack_rgba_8unorm((uint8_t *) entry->texels,
+                               desc->block.width * 4,
+                               src, desc->block.bits / 8,
+                               desc->block.width, desc->block.height);
+      entry->block = src;
+      entry->desc = desc;
+   }
+
+   memcpy(dst, &entry->texels[j * desc->block.width + i], 4);
+}
@@ -35,8 +35,10 @@
 #include "os/os_time.h"
 #include "lp_bld.h"
 #include "lp_bld_debug.h"
+#include "lp_bld_jit_mem.h"
 #include "lp_bld_misc.h"
 #include "lp_bld_init.h"
+#include "lp_bld_type.h"
 
 #include <llvm-c/Analysis.h>
 #include <llvm-c/Transforms/Scalar.h>
@@ -78,6 +80,15 @@ DEBUG_GET_ONCE_FLAGS_OPTION(gallivm_debug, "GALLIVM_DEBUG", lp_bld_debug_flags,
 
 static boolean gallivm_initialized = FALSE;
 
+static enum gallivm_opt_level gallivm_opt_level = GALLIVM_OPT_FULL;
+static boolean gallivm_tiered = FALSE;
+
+static const char *gallivm_pass_group_names[GALLIVM_NUM_PASS_GROUPS] = {
+   "scalar",
+   "combine",
+   "gvn",
+};
+
 unsigned lp_native_vector_width;
 
 
@@ -99,20 +110,28 @@ enum LLVM_CodeGenOpt_Level {
 
 
 /**
- * Create the LLVM (optimization) pass manager and install
- * relevant optimization passes.
- * \return  TRUE for success, FALSE for failure
+ * Create a pass manager with the given group of optimization passes of
+ * the gallivm object's pipeline.
+ *
+ * The groups run one after the other, so that the time spent in each can
+ * be measured.  Since these are all function passes, this is the same as
+ * running all the passes on each function in turn.
+ *
+ * \return  the pass manager, or NULL if the group is empty
  */
-static boolean
-create_pass_manager(struct gallivm_state *gallivm)
+static LLVMPassManagerRef
+create_pass_manager(struct gallivm_state *gallivm, unsigned group)
 {
-   char *td_str;
-   assert(!gallivm->passmgr);
+   LLVMPassManagerRef passmgr;
+
    assert(gallivm->target);
 
-   gallivm->passmgr = LLVMCreateFunctionPassManagerForModule(gallivm->module);
-   if (!gallivm->passmgr)
-      return FALSE;
+   if (gallivm->opt_level != GALLIVM_OPT_FULL && group > 0)
+      return NULL;
+
+   passmgr = LLVMCreateFunctionPassManagerForModule(gallivm->module);
+   if (!passmgr)
+      return NULL;
    /*
     * TODO: some per module pass manager with IPO passes might be helpful -
     * the generated texture functions may benefit from inlining if they are
@@ -120,35 +139,96 @@ create_pass_manager(struct gallivm_state *gallivm)
     */
 
    // Old versions of LLVM get the DataLayout from the pass manager.
-   LLVMAddTargetData(gallivm->target, gallivm->passmgr);
+   LLVMAddTargetData(gallivm->target, passmgr);
 
-   // New ones from the Module.
-   td_str = LLVMCopyStringRepOfTargetData(gallivm->target);
-   LLVMSetDataLayout(gallivm->module, td_str);
-   free(td_str);
-
-   if ((gallivm_debug & GALLIVM_DEBUG_NO_OPT) == 0) {
+   switch (gallivm->opt_level) {
+   case GALLIVM_OPT_FULL:
       /* These are the passes currently listed in llvm-c/Transforms/Scalar.h,
        * but there are more on SVN.
        * TODO: Add more passes.
        */
-      LLVMAddScalarReplAggregatesPass(gallivm->passmgr);
-      LLVMAddLICMPass(gallivm->passmgr);
-      LLVMAddCFGSimplificationPass(gallivm->passmgr);
-      LLVMAddReassociatePass(gallivm->passmgr);
-      LLVMAddPromoteMemoryToRegisterPass(gallivm->passmgr);
-      LLVMAddConstantPropagationPass(gallivm->passmgr);
-      LLVMAddInstructionCombiningPass(gallivm->passmgr);
-      LLVMAddGVNPass(gallivm->passmgr);
-   }
-   else {
+      switch (group) {
+      case 0:
+         LLVMAddScalarReplAggregatesPass(passmgr);
+         LLVMAddLICMPass(passmgr);
+         LLVMAddCFGSimplificationPass(passmgr);
+         break;
+      case 1:
+         LLVMAddReassociatePass(passmgr);
+         LLVMAddPromoteMemoryToRegisterPass(passmgr);
+         LLVMAddConstantPropagationPass(passmgr);
+         LLVMAddInstructionCombiningPass(passmgr);
+         break;
+      case 2:
+         LLVMAddGVNPass(passmgr);
+         break;
+      }
+      break;
+   case GALLIVM_OPT_FAST:
+      /* Just enough to get rid of the allocas and the trivial branches the
+       * builders leave behind, codegen copes with the rest.
+       */
+      LLVMAddScalarReplAggregatesPass(passmgr);
+      LLVMAddPromoteMemoryToRegisterPass(passmgr);
+      LLVMAddCFGSimplificationPass(passmgr);
+      break;
+   case GALLIVM_OPT_NONE:
+   default:
       /* We need at least this pass to prevent the backends to fail in
        * unexpected ways.
        */
-      LLVMAddPromoteMemoryToRegisterPass(gallivm->passmgr);
+      LLVMAddPromoteMemoryToRegisterPass(passmgr);
+      break;
    }
 
-   return TRUE;
+   return passmgr;
+}
+
+
+/**
+ * Print how long the module took to build and compile, and how much
+ * memory its code takes.
+ */
+static void
+gallivm_report_compile_time(struct gallivm_state *gallivm)
+{
+   static const char *level_names[] = { "none", "fast", "full" };
+   char opt_str[128];
+   size_t code_size, data_size, jit_used, jit_mapped;
+   unsigned len = 0;
+   unsigned i;
+
+   for (i = 0; i < GALLIVM_NUM_PASS_GROUPS; i++) {
+      len += util_snprintf(opt_str + len, sizeof opt_str - len, "%s%s %u",
+                           i ? ", " : "", gallivm_pass_group_names[i],
+                           (unsigned) gallivm->opt_time[i]);
+   }
+
+   lp_get_generated_code_size(gallivm->memorymgr, &code_size, &data_size);
+   lp_jit_mem_stats(&jit_used, &jit_mapped);
+
+   debug_printf("gallivm: %s (%s): IR build %u us, opt (%s) us, "
+                "codegen %u us, %u instrs, %u bytes code, %u bytes data "
+                "(JIT memory %u KB used, %u KB mapped)\n",
+                lp_get_module_id(gallivm->module),
+                level_names[gallivm->opt_level],
+                (unsigned) gallivm->ir_time, opt_str,
+                (unsigned) gallivm->codegen_time,
+                lp_build_count_ir_module(gallivm->module),
+                (unsigned) code_size, (unsigned) data_size,
+                (unsigned) (jit_used / 1024), (unsigned) (jit_mapped / 1024));
+}
+
+
+/**
+ * Whether GALLIVM_OPT=tiered was requested, that is drivers should
+ * recompile variants with GALLIVM_OPT_FULL once they are used a lot.
+ */
+boolean
+gallivm_opt_tiered(void)
+{
+   lp_build_init();
+   return gallivm_tiered;
 }
 
 
@@ -159,8 +239,9 @@ create_pass_manager(struct gallivm_state *gallivm)
 void
 gallivm_free_ir(struct gallivm_state *gallivm)
 {
-   if (gallivm->passmgr) {
-      LLVMDisposePassManager(gallivm->passmgr);
+   if ((gallivm_debug & GALLIVM_DEBUG_PERF) &&
+       gallivm->compiled && gallivm->module) {
+      gallivm_report_compile_time(gallivm);
    }
 
    if (gallivm->engine) {
@@ -186,7 +267,6 @@ gallivm_free_ir(struct gallivm_state *gallivm)
    gallivm->engine = NULL;
    gallivm->target = NULL;
    gallivm->module = NULL;
-   gallivm->passmgr = NULL;
    gallivm->context = NULL;
    gallivm->builder = NULL;
 }
@@ -215,11 +295,17 @@ init_gallivm_engine(struct gallivm_state *gallivm)
       char *error = NULL;
       int ret;
 
-      if (gallivm_debug & GALLIVM_DEBUG_NO_OPT) {
-         optlevel = None;
-      }
-      else {
+      switch (gallivm->opt_level) {
+      case GALLIVM_OPT_FULL:
          optlevel = Default;
+         break;
+      case GALLIVM_OPT_FAST:
+         optlevel = Less;
+         break;
+      case GALLIVM_OPT_NONE:
+      default:
+         optlevel = None;
+         break;
       }
 
       ret = lp_build_create_jit_compiler_for_module(&gallivm->engine,
@@ -285,6 +371,8 @@ init_gallivm_state(struct gallivm_state *gallivm, const char *name,
       return FALSE;
 
    gallivm->context = context;
+   gallivm->opt_level = gallivm_opt_level;
+   gallivm->create_time = os_time_get();
 
    if (!gallivm->context)
       goto fail;
@@ -347,8 +435,11 @@ init_gallivm_state(struct gallivm_state *gallivm, const char *name,
    }
 #endif
 
-   if (!create_pass_manager(gallivm))
-      goto fail;
+   {
+      char *td_str = LLVMCopyStringRepOfTargetData(gallivm->target);
+      LLVMSetDataLayout(gallivm->module, td_str);
+      free(td_str);
+   }
 
    return TRUE;
 
@@ -369,6 +460,29 @@ lp_build_init(void)
    gallivm_debug = debug_get_option_gallivm_debug();
 #endif
 
+   {
+      const char *opt = debug_get_option("GALLIVM_OPT", "full");
+
+      if (!strcmp(opt, "none")) {
+         gallivm_opt_level = GALLIVM_OPT_NONE;
+      }
+      else if (!strcmp(opt, "fast")) {
+         gallivm_opt_level = GALLIVM_OPT_FAST;
+      }
+      else if (!strcmp(opt, "tiered")) {
+         gallivm_opt_level = GALLIVM_OPT_FAST;
+         gallivm_tiered = TRUE;
+      }
+      else {
+         gallivm_opt_level = GALLIVM_OPT_FULL;
+      }
+
+      if (gallivm_debug & GALLIVM_DEBUG_NO_OPT) {
+         gallivm_opt_level = GALLIVM_OPT_NONE;
+         gallivm_tiered = FALSE;
+      }
+   }
+
    lp_set_target_options();
 
 #if USE_MCJIT
@@ -385,9 +499,13 @@ lp_build_init(void)
     *
     * See also:
     * - http://www.anandtech.com/show/4955/the-bulldozer-review-amd-fx8150-tested/2
+    *
+    * AVX2 capable processors (from any vendor) have full 256bit integer
+    * units, so the integer parts of the pipeline (blend, packing, depth)
+    * also benefit from the wider vectors there.
     */
    if (util_cpu_caps.has_avx &&
-       util_cpu_caps.has_intel) {
+       (util_cpu_caps.has_intel || util_cpu_caps.has_avx2)) {
       lp_native_vector_width = 256;
    } else {
       /* Leave it at 128, even when no SIMD extensions are available.
@@ -441,6 +559,7 @@ lp_build_init(void)
    util_cpu_caps.has_ssse3 = 0;
    util_cpu_caps.has_sse4_1 = 0;
    util_cpu_caps.has_avx = 0;
+   util_cpu_caps.has_avx2 = 0;
    util_cpu_caps.has_f16c = 0;
 #endif
 
@@ -514,7 +633,8 @@ void
 gallivm_compile_module(struct gallivm_state *gallivm)
 {
    LLVMValueRef func;
-   int64_t time_begin = 0;
+   int64_t time_begin;
+   unsigned group;
 
    assert(!gallivm->compiled);
 
@@ -523,26 +643,32 @@ gallivm_compile_module(struct gallivm_state *gallivm)
       gallivm->builder = NULL;
    }
 
-   if (gallivm_debug & GALLIVM_DEBUG_PERF)
-      time_begin = os_time_get();
+   time_begin = os_time_get();
+   gallivm->ir_time = time_begin - gallivm->create_time;
 
    /* Run optimization passes */
-   LLVMInitializeFunctionPassManager(gallivm->passmgr);
-   func = LLVMGetFirstFunction(gallivm->module);
-   while (func) {
-      if (0) {
-         debug_printf("optimizing func %s...\n", LLVMGetValueName(func));
+   for (group = 0; group < GALLIVM_NUM_PASS_GROUPS; group++) {
+      LLVMPassManagerRef passmgr = create_pass_manager(gallivm, group);
+      int64_t time_end;
+
+      if (!passmgr)
+         continue;
+
+      LLVMInitializeFunctionPassManager(passmgr);
+      func = LLVMGetFirstFunction(gallivm->module);
+      while (func) {
+         if (0) {
+            debug_printf("optimizing func %s...\n", LLVMGetValueName(func));
+         }
+         LLVMRunFunctionPassManager(passmgr, func);
+         func = LLVMGetNextFunction(func);
       }
-      LLVMRunFunctionPassManager(gallivm->passmgr, func);
-      func = LLVMGetNextFunction(func);
-   }
-   LLVMFinalizeFunctionPassManager(gallivm->passmgr);
+      LLVMFinalizeFunctionPassManager(passmgr);
+      LLVMDisposePassManager(passmgr);
 
-   if (gallivm_debug & GALLIVM_DEBUG_PERF) {
-      int64_t time_end = os_time_get();
-      int time_msec = (int)(time_end - time_begin) / 1000;
-      debug_printf("optimizing module %s took %d msec\n",
-                   lp_get_module_id(gallivm->module), time_msec);
+      time_end = os_time_get();
+      gallivm->opt_time[group] = time_end - time_begin;
+      time_begin = time_end;
    }
 
    /* Dump byte code to a file */
@@ -557,6 +683,7 @@ gallivm_compile_module(struct gallivm_state *gallivm)
    if (!init_gallivm_engine(gallivm)) {
       assert(0);
    }
+   gallivm->codegen_time = os_time_get() - time_begin;
 #endif
    assert(gallivm->engine);
 
@@ -596,17 +723,38 @@ gallivm_compile_module(struct gallivm_state *gallivm)
 
 
 
+/**
+ * Size in bytes of the code and data generated for the module, or 0 when
+ * the memory manager doesn't track it.
+ */
+size_t
+gallivm_code_size(const struct gallivm_state *gallivm)
+{
+   size_t code_size, data_size;
+
+   lp_get_generated_code_size(gallivm->memorymgr, &code_size, &data_size);
+
+   return code_size + data_size;
+}
+
+
 func_pointer
 gallivm_jit_function(struct gallivm_state *gallivm,
                      LLVMValueRef func)
 {
    void *code;
    func_pointer jit_func;
+   int64_t time_begin;
 
    assert(gallivm->compiled);
    assert(gallivm->engine);
 
+   /* MC-JIT generates the machine code for the whole module on the first
+    * lookup.
+    */
+   time_begin = os_time_get();
    code = LLVMGetPointerToGlobal(gallivm->engine, func);
+   gallivm->codegen_time += os_time_get() - time_begin;
    assert(code);
    jit_func = pointer_to_func(code);
 
@@ -36,17 +36,40 @@
 #include <llvm-c/ExecutionEngine.h>
 
 
+/**
+ * Optimization pipelines, selected with the GALLIVM_OPT environment
+ * variable.  "tiered" compiles with GALLIVM_OPT_FAST, and lets drivers
+ * recompile frequently used variants with GALLIVM_OPT_FULL.
+ */
+enum gallivm_opt_level
+{
+   GALLIVM_OPT_NONE,   /**< only what the backends need, -O0 codegen */
+   GALLIVM_OPT_FAST,   /**< cheap cleanup passes, -O1 codegen */
+   GALLIVM_OPT_FULL    /**< all passes, -O2 codegen */
+};
+
+#define GALLIVM_NUM_PASS_GROUPS 3
+
+
 struct gallivm_state
 {
    LLVMModuleRef module;
    LLVMExecutionEngineRef engine;
    LLVMTargetDataRef target;
-   LLVMPassManagerRef passmgr;
    LLVMContextRef context;
    LLVMBuilderRef builder;
    LLVMMCJITMemoryManagerRef memorymgr;
    struct lp_generated_code *code;
    unsigned compiled;
+
+   /** Optimization pipeline, may be changed before gallivm_compile_module */
+   enum gallivm_opt_level opt_level;
+
+   /** Compile time break down in microseconds, see GALLIVM_DEBUG=perf */
+   int64_t create_time;
+   int64_t ir_time;
+   int64_t opt_time[GALLIVM_NUM_PASS_GROUPS];
+   int64_t codegen_time;
 };
 
 
@@ -54,6 +77,10 @@ boolean
 lp_build_init(void);
 
 
+boolean
+gallivm_opt_tiered(void);
+
+
 struct gallivm_state *
 gallivm_create(const char *name, LLVMContextRef context);
 
@@ -74,6 +101,9 @@ func_pointer
 gallivm_jit_function(struct gallivm_state *gallivm,
                      LLVMValueRef func);
 
+size_t
+gallivm_code_size(const struct gallivm_state *gallivm);
+
 void
 lp_set_load_alignment(LLVMValueRef Inst,
                        unsigned Align);
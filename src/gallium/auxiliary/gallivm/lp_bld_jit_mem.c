@@ -0,0 +1,267 @@
+/**************************************************************************
+ *
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+/**
+ * @file
+ * Pool of executable memory for the code generated by LLVM.
+ *
+ * By default MCJIT maps separate pages for the code, read-only data and
+ * read-write data of every module, so each of the many small shader
+ * variants drivers create costs several pages, most of them unused.
+ * Instead all modules allocate their sections from large chunks shared
+ * by all gallivm_state objects (see PooledMemoryManager in
+ * lp_bld_misc.cpp), which are sub-allocated with the generic memory
+ * manager code like rtasm_exec_malloc() does, and unmapped again once
+ * all the code in them has been freed.
+ *
+ * The chunks are mapped read/write/execute, as the sections of different
+ * modules share pages.
+ */
+
+
+#include "pipe/p_config.h"
+#include "os/os_thread.h"
+#include "util/u_debug.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/u_mm.h"
+
+#include "lp_bld_jit_mem.h"
+
+#if defined(PIPE_OS_UNIX)
+#include <sys/mman.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#elif defined(PIPE_OS_WINDOWS)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN 1
+#endif
+#include <windows.h>
+#endif
+
+
+/** Size of the chunks, bigger allocations get a chunk of their own */
+#define LP_JIT_MEM_CHUNK_SIZE (4*1024*1024)
+
+/** log2 of the alignment of all allocations */
+#define LP_JIT_MEM_ALIGN2 6
+
+
+struct lp_jit_mem_chunk
+{
+   struct lp_jit_mem_chunk *next;
+   struct mem_block *heap;
+   uint8_t *mem;
+   size_t size;
+   size_t used;
+};
+
+
+pipe_static_mutex(jit_mem_mutex);
+
+static struct lp_jit_mem_chunk *jit_mem_chunks = NULL;
+static size_t jit_mem_used = 0;
+static size_t jit_mem_mapped = 0;
+
+
+boolean
+lp_jit_mem_supported(void)
+{
+#if defined(PIPE_OS_UNIX) || defined(PIPE_OS_WINDOWS)
+   return TRUE;
+#else
+   return FALSE;
+#endif
+}
+
+
+static uint8_t *
+lp_jit_mem_map(size_t size)
+{
+#if defined(PIPE_OS_UNIX)
+   void *mem = mmap(NULL, size, PROT_EXEC | PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   return mem == MAP_FAILED ? NULL : (uint8_t *) mem;
+#elif defined(PIPE_OS_WINDOWS)
+   return (uint8_t *) VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE,
+                                   PAGE_EXECUTE_READWRITE);
+#else
+   return NULL;
+#endif
+}
+
+
+static void
+lp_jit_mem_unmap(uint8_t *mem, size_t size)
+{
+#if defined(PIPE_OS_UNIX)
+   munmap(mem, size);
+#elif defined(PIPE_OS_WINDOWS)
+   (void) size;
+   VirtualFree(mem, 0, MEM_RELEASE);
+#else
+   (void) mem;
+   (void) size;
+#endif
+}
+
+
+static struct lp_jit_mem_chunk *
+lp_jit_mem_chunk_create(size_t size)
+{
+   struct lp_jit_mem_chunk *chunk;
+
+   chunk = CALLOC_STRUCT(lp_jit_mem_chunk);
+   if (!chunk)
+      return NULL;
+
+   chunk->size = size;
+   chunk->mem = lp_jit_mem_map(size);
+   chunk->heap = u_mmInit(0, (int) size);
+   if (!chunk->mem || !chunk->heap) {
+      if (chunk->mem)
+         lp_jit_mem_unmap(chunk->mem, size);
+      if (chunk->heap)
+         u_mmDestroy(chunk->heap);
+      FREE(chunk);
+      return NULL;
+   }
+
+   jit_mem_mapped += size;
+
+   chunk->next = jit_mem_chunks;
+   jit_mem_chunks = chunk;
+
+   return chunk;
+}
+
+
+/**
+ * Allocate executable memory, aligned to 64 bytes.
+ */
+void *
+lp_jit_mem_alloc(size_t size)
+{
+   struct lp_jit_mem_chunk *chunk;
+   struct mem_block *block = NULL;
+   void *ptr = NULL;
+
+   size = align(MAX2(size, 1), 1 << LP_JIT_MEM_ALIGN2);
+
+   pipe_mutex_lock(jit_mem_mutex);
+
+   for (chunk = jit_mem_chunks; chunk; chunk = chunk->next) {
+      if (chunk->size - chunk->used >= size) {
+         block = u_mmAllocMem(chunk->heap, (int) size, LP_JIT_MEM_ALIGN2, 0);
+         if (block)
+            break;
+      }
+   }
+
+   if (!block) {
+      chunk = lp_jit_mem_chunk_create(MAX2(LP_JIT_MEM_CHUNK_SIZE,
+                                           align(size, 64*1024)));
+      if (chunk)
+         block = u_mmAllocMem(chunk->heap, (int) size, LP_JIT_MEM_ALIGN2, 0);
+   }
+
+   if (block) {
+      chunk->used += size;
+      jit_mem_used += size;
+      ptr = chunk->mem + block->ofs;
+   }
+   else {
+      debug_printf("%s: failed to allocate %u bytes\n",
+                   __FUNCTION__, (unsigned) size);
+   }
+
+   pipe_mutex_unlock(jit_mem_mutex);
+
+   return ptr;
+}
+
+
+/**
+ * Free memory returned by lp_jit_mem_alloc(), and unmap its chunk when it
+ * becomes empty (but keep the last one around).
+ */
+void
+lp_jit_mem_free(void *ptr)
+{
+   struct lp_jit_mem_chunk **link, *chunk;
+   struct mem_block *block;
+
+   if (!ptr)
+      return;
+
+   pipe_mutex_lock(jit_mem_mutex);
+
+   for (link = &jit_mem_chunks; (chunk = *link) != NULL; link = &chunk->next) {
+      if ((uint8_t *) ptr >= chunk->mem &&
+          (uint8_t *) ptr < chunk->mem + chunk->size)
+         break;
+   }
+
+   assert(chunk);
+   if (chunk) {
+      block = u_mmFindBlock(chunk->heap, (int) ((uint8_t *) ptr - chunk->mem));
+      assert(block);
+      if (block) {
+         chunk->used -= block->size;
+         jit_mem_used -= block->size;
+         u_mmFreeMem(block);
+      }
+
+      if (chunk->used == 0 &&
+          (chunk != jit_mem_chunks || chunk->next)) {
+         *link = chunk->next;
+         jit_mem_mapped -= chunk->size;
+         lp_jit_mem_unmap(chunk->mem, chunk->size);
+         u_mmDestroy(chunk->heap);
+         FREE(chunk);
+      }
+   }
+
+   pipe_mutex_unlock(jit_mem_mutex);
+}
+
+
+/**
+ * Bytes allocated for generated code and data, and bytes of memory mapped
+ * for the pool.
+ */
+void
+lp_jit_mem_stats(size_t *used, size_t *mapped)
+{
+   pipe_mutex_lock(jit_mem_mutex);
+   *used = jit_mem_used;
+   *mapped = jit_mem_mapped;
+   pipe_mutex_unlock(jit_mem_mutex);
+}
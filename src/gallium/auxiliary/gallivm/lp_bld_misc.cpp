@@ -59,6 +59,7 @@
 #include <llvm/ExecutionEngine/JITMemoryManager.h>
 #else
 #include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/Support/Memory.h>
 #endif
 #include <llvm/Support/CommandLine.h>
 #include <llvm/Support/Host.h>
@@ -74,6 +75,7 @@
 #include "util/u_debug.h"
 #include "util/u_cpu_detect.h"
 
+#include "lp_bld_jit_mem.h"
 #include "lp_bld_misc.h"
 
 namespace {
@@ -300,6 +302,16 @@ class DelegatingJITMemoryManager : public BaseMemoryManager {
          return mgr()->finalizeMemory(ErrMsg);
       }
 #endif
+#if HAVE_LLVM >= 0x0306
+      virtual bool needsToReserveAllocationSpace() {
+         return mgr()->needsToReserveAllocationSpace();
+      }
+      virtual void reserveAllocationSpace(uintptr_t CodeSize,
+                                          uintptr_t DataSizeRO,
+                                          uintptr_t DataSizeRW) {
+         mgr()->reserveAllocationSpace(CodeSize, DataSizeRO, DataSizeRW);
+      }
+#endif
 };
 
 
@@ -388,6 +400,116 @@ class ShaderMemoryManager : public DelegatingJITMemoryManager {
 };
 
 
+#if HAVE_LLVM >= 0x0306
+
+/*
+ * Allocate all the sections of a module from a single block of the shared
+ * executable memory pool in lp_bld_jit_mem.c, instead of mapping separate
+ * pages for each kind of section of each module like SectionMemoryManager.
+ * Keeping the sections together also keeps them within reach of each
+ * other's 32bit relocations.  The block is given back to the pool when
+ * the manager is destroyed, that is in lp_free_memory_manager().
+ */
+class PooledMemoryManager : public llvm::RTDyldMemoryManager {
+
+   uint8_t *Block;
+   uintptr_t BlockSize, BlockUsed;
+
+   /* allocations which didn't fit in the reserved block */
+   std::vector<void *> Extra;
+
+   size_t CodeSize, DataSize;
+
+   uint8_t *allocate(uintptr_t Size, unsigned Alignment) {
+      uintptr_t Offset;
+      uint8_t *Ptr;
+
+      if (Alignment < 16)
+         Alignment = 16;
+
+      if (Block) {
+         Offset = (BlockUsed + Alignment - 1) & ~(uintptr_t)(Alignment - 1);
+         if (Offset + Size <= BlockSize) {
+            BlockUsed = Offset + Size;
+            return Block + Offset;
+         }
+      }
+
+      Ptr = (uint8_t *) lp_jit_mem_alloc(Size + Alignment);
+      if (!Ptr)
+         return NULL;
+      Extra.push_back(Ptr);
+      return (uint8_t *) (((uintptr_t) Ptr + Alignment - 1) &
+                          ~(uintptr_t)(Alignment - 1));
+   }
+
+   public:
+
+      PooledMemoryManager() :
+         Block(NULL), BlockSize(0), BlockUsed(0), CodeSize(0), DataSize(0) {
+      }
+
+      virtual ~PooledMemoryManager() {
+         std::vector<void *>::iterator i;
+
+         lp_jit_mem_free(Block);
+         for (i = Extra.begin(); i != Extra.end(); ++i)
+            lp_jit_mem_free(*i);
+      }
+
+      size_t getCodeSize() const {
+         return CodeSize;
+      }
+
+      size_t getDataSize() const {
+         return DataSize;
+      }
+
+      virtual bool needsToReserveAllocationSpace() {
+         return true;
+      }
+
+      virtual void reserveAllocationSpace(uintptr_t CodeSize,
+                                          uintptr_t DataSizeRO,
+                                          uintptr_t DataSizeRW) {
+         /* Each kind of section is aligned separately */
+         uintptr_t Size = CodeSize + DataSizeRO + DataSizeRW + 3 * 64;
+
+         if (Block)
+            return;
+
+         Block = (uint8_t *) lp_jit_mem_alloc(Size);
+         BlockSize = Block ? Size : 0;
+      }
+
+      virtual uint8_t *allocateCodeSection(uintptr_t Size,
+                                           unsigned Alignment,
+                                           unsigned SectionID,
+                                           llvm::StringRef SectionName) {
+         CodeSize += Size;
+         return allocate(Size, Alignment);
+      }
+
+      virtual uint8_t *allocateDataSection(uintptr_t Size,
+                                           unsigned Alignment,
+                                           unsigned SectionID,
+                                           llvm::StringRef SectionName,
+                                           bool IsReadOnly) {
+         DataSize += Size;
+         return allocate(Size, Alignment);
+      }
+
+      virtual bool finalizeMemory(std::string *ErrMsg = 0) {
+         /* The pool is mapped executable already */
+         if (Block)
+            llvm::sys::Memory::InvalidateInstructionCache(Block, BlockUsed);
+         return false;
+      }
+};
+
+#endif /* HAVE_LLVM >= 0x0306 */
+
+
 /**
  * Same as LLVMCreateJITCompilerForModule, but:
  * - allows using MCJIT and enabling AVX feature where available.
@@ -473,6 +595,9 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
       if (util_cpu_caps.has_f16c) {
          MAttrs.push_back("+f16c");
       }
+      if (util_cpu_caps.has_avx2) {
+         MAttrs.push_back("+avx2");
+      }
       builder.setMAttrs(MAttrs);
    }
 
@@ -549,11 +674,36 @@ lp_get_default_memory_manager()
 #if HAVE_LLVM < 0x0306
    mm = llvm::JITMemoryManager::CreateDefaultMemManager();
 #else
-   mm = new llvm::SectionMemoryManager();
+   if (lp_jit_mem_supported())
+      mm = new PooledMemoryManager();
+   else
+      mm = new llvm::SectionMemoryManager();
 #endif
    return reinterpret_cast<LLVMMCJITMemoryManagerRef>(mm);
 }
 
+/**
+ * Size of the code and data sections generated with a memory manager
+ * returned by lp_get_default_memory_manager(), where known.
+ */
+extern "C"
+void
+lp_get_generated_code_size(LLVMMCJITMemoryManagerRef memorymgr,
+                           size_t *code_size, size_t *data_size)
+{
+   *code_size = 0;
+   *data_size = 0;
+#if HAVE_LLVM >= 0x0306
+   if (memorymgr && lp_jit_mem_supported()) {
+      PooledMemoryManager *mm =
+         static_cast<PooledMemoryManager *>(
+            reinterpret_cast<BaseMemoryManager *>(memorymgr));
+      *code_size = mm->getCodeSize();
+      *data_size = mm->getDataSize();
+   }
+#endif
+}
+
 extern "C"
 void
 lp_free_memory_manager(LLVMMCJITMemoryManagerRef memorymgr)
@@ -68,6 +68,10 @@ lp_get_default_memory_manager();
 extern void
 lp_free_memory_manager(LLVMMCJITMemoryManagerRef memorymgr);
 
+extern void
+lp_get_generated_code_size(LLVMMCJITMemoryManagerRef memorymgr,
+                           size_t *code_size, size_t *data_size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -460,6 +460,45 @@ lp_build_pack2(struct gallivm_state *gallivm,
    assert(src_type.width == dst_type.width * 2);
    assert(src_type.length * 2 == dst_type.length);
 
+   /*
+    * AVX2 has 256bit pack instructions, however (as with most AVX2 ops)
+    * they operate on the two 128bit lanes independently, so the result
+    * needs a cross-lane permute of the 64bit halves to get the elements
+    * into order (this is a single vpermq).
+    */
+   if (util_cpu_caps.has_avx2 &&
+       src_type.width * src_type.length == 256) {
+      const char *intrinsic = NULL;
+
+      switch(src_type.width) {
+      case 32:
+         intrinsic = dst_type.sign ? "llvm.x86.avx2.packssdw" :
+                                     "llvm.x86.avx2.packusdw";
+         break;
+      case 16:
+         intrinsic = dst_type.sign ? "llvm.x86.avx2.packsswb" :
+                                     "llvm.x86.avx2.packuswb";
+         break;
+      }
+      if (intrinsic) {
+         struct lp_type qtype = lp_type_uint_vec(64, 256);
+         LLVMValueRef shuffles[4];
+
+         res = lp_build_intrinsic_binary(builder, intrinsic,
+                                         lp_build_vec_type(gallivm, intr_type),
+                                         lo, hi);
+         res = LLVMBuildBitCast(builder, res,
+                                lp_build_vec_type(gallivm, qtype), "");
+         shuffles[0] = lp_build_const_int32(gallivm, 0);
+         shuffles[1] = lp_build_const_int32(gallivm, 2);
+         shuffles[2] = lp_build_const_int32(gallivm, 1);
+         shuffles[3] = lp_build_const_int32(gallivm, 3);
+         res = LLVMBuildShuffleVector(builder, res, res,
+                                      LLVMConstVector(shuffles, 4), "");
+         return LLVMBuildBitCast(builder, res, dst_vec_type, "");
+      }
+   }
+
    /* Check for special cases first */
    if((util_cpu_caps.has_sse2 || util_cpu_caps.has_altivec) &&
        src_type.width * src_type.length >= 128) {
@@ -128,6 +128,13 @@ struct lp_static_texture_state
    unsigned pot_height:1;
    unsigned pot_depth:1;
    unsigned level_zero_only:1;
+
+   /**
+    * May decoded compressed blocks be cached?  Only set by drivers which
+    * call lp_format_cache_invalidate() when texture memory is written or
+    * freed.
+    */
+   unsigned texel_cache:1;
 };
 
 
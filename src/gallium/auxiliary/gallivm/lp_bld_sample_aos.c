@@ -593,7 +593,8 @@ lp_build_sample_fetch_image_nearest(struct lp_build_sample_context *bld,
                                       TRUE,
                                       data_ptr, offset,
                                       x_subcoord,
-                                      y_subcoord);
+                                      y_subcoord,
+                                      bld->static_texture_state->texel_cache);
    }
 
    *colors = rgba8;
@@ -828,6 +829,7 @@ lp_build_sample_fetch_image_linear(struct lp_build_sample_context *bld,
                                    LLVMValueRef *colors)
 {
    const unsigned dims = bld->dims;
+   const boolean texel_cache = bld->static_texture_state->texel_cache;
    LLVMBuilderRef builder = bld->gallivm->builder;
    struct lp_build_context u8n;
    LLVMTypeRef u8n_vec_type;
@@ -933,7 +935,8 @@ lp_build_sample_fetch_image_linear(struct lp_build_sample_context *bld,
                                                TRUE,
                                                data_ptr, offset[k][j][i],
                                                x_subcoord[i],
-                                               y_subcoord[j]);
+                                               y_subcoord[j],
+                                               texel_cache);
             }
 
             neighbors[k][j][i] = rgba8;
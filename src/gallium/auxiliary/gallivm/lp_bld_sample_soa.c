@@ -161,6 +161,7 @@ lp_build_sample_texel_soa(struct lp_build_sample_context *bld,
                            bld->texel_type,
                            data_ptr, offset,
                            i, j,
+                           bld->static_texture_state->texel_cache,
                            texel_out);
 
    /*
@@ -2387,6 +2388,7 @@ lp_build_fetch_texel(struct lp_build_sample_context *bld,
                            bld->texel_type,
                            bld->base_ptr, offset,
                            i, j,
+                           bld->static_texture_state->texel_cache,
                            colors_out);
 
    if (out_of_bound_ret_zero) {
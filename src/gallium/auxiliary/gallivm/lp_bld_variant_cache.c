@@ -0,0 +1,226 @@
+/**************************************************************************
+ *
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+/**
+ * @file
+ * Eviction policy and statistics for caches of generated shader variants.
+ *
+ * Drivers keep their variants in LRU lists, and used to evict a fixed
+ * fraction of the least recently used ones once a maximum number of
+ * variants was reached.  That throws away variants which are expensive to
+ * compile and frequently used together with ones which are cheap or were
+ * used once.  Instead, variants are evicted by their priority, following
+ * the Greedy-Dual-Size-Frequency policy:
+ *
+ *    priority = clock + hits * compile time / code size
+ *
+ * where clock is the priority of the last evicted variant, so that
+ * variants which are no longer used eventually get evicted, however
+ * expensive they were.  Variants with the same priority are evicted in
+ * LRU order.
+ *
+ * Caches are limited both by number of variants and by the size of their
+ * generated code.  Once a limit is reached, variants are evicted until
+ * the cache is at 3/4 of both limits, so that the context flushes drivers
+ * need before freeing variants happen rarely.
+ *
+ * The per shader statistics are optional, setup variants for instance
+ * don't belong to a shader.
+ *
+ * GALLIVM_VARIANT_STATS=1 prints the hits, misses, compiles and evictions
+ * of every shader when it is deleted, and of every cache when it is
+ * destroyed.
+ */
+
+
+#include "util/u_debug.h"
+#include "util/u_math.h"
+
+#include "lp_bld_init.h"
+#include "lp_bld_variant_cache.h"
+
+
+DEBUG_GET_ONCE_BOOL_OPTION(variant_stats, "GALLIVM_VARIANT_STATS", FALSE)
+
+
+void
+lp_variant_cache_init(struct lp_variant_cache *cache,
+                      const char *name,
+                      unsigned max_variants,
+                      size_t max_code_size)
+{
+   memset(cache, 0, sizeof *cache);
+   cache->name = name;
+   cache->max_variants = MAX2(max_variants, 1);
+   cache->max_code_size = max_code_size;
+}
+
+
+/**
+ * Whether variants must be evicted before adding a new one.
+ */
+boolean
+lp_variant_cache_full(const struct lp_variant_cache *cache)
+{
+   return cache->nr_variants >= cache->max_variants ||
+          (cache->max_code_size &&
+           cache->code_size >= cache->max_code_size);
+}
+
+
+/**
+ * Whether to keep evicting variants.
+ */
+boolean
+lp_variant_cache_over_target(const struct lp_variant_cache *cache)
+{
+   return cache->nr_variants > cache->max_variants * 3 / 4 ||
+          (cache->max_code_size &&
+           cache->code_size > cache->max_code_size / 4 * 3);
+}
+
+
+static void
+update_priority(const struct lp_variant_cache *cache,
+                struct lp_variant_info *info)
+{
+   /* the code size is unknown with old LLVM versions */
+   double kbytes = MAX2(info->code_size / 1024.0, 1.0);
+   double cost = (double) MAX2(info->compile_time, 1);
+
+   info->priority = cache->clock + info->hits * cost / kbytes;
+}
+
+
+void
+lp_variant_cache_hit(struct lp_variant_cache *cache,
+                     struct lp_variant_stats *shader_stats,
+                     struct lp_variant_info *info)
+{
+   cache->stats.hits++;
+   if (shader_stats)
+      shader_stats->hits++;
+   info->hits++;
+   update_priority(cache, info);
+}
+
+
+void
+lp_variant_cache_miss(struct lp_variant_cache *cache,
+                      struct lp_variant_stats *shader_stats)
+{
+   cache->stats.misses++;
+   if (shader_stats)
+      shader_stats->misses++;
+}
+
+
+/**
+ * Account for a newly compiled variant.
+ */
+void
+lp_variant_cache_insert(struct lp_variant_cache *cache,
+                        struct lp_variant_stats *shader_stats,
+                        struct lp_variant_info *info,
+                        struct gallivm_state *gallivm,
+                        int64_t compile_time)
+{
+   cache->stats.compiles++;
+   cache->stats.compile_time += compile_time;
+   if (shader_stats) {
+      shader_stats->compiles++;
+      shader_stats->compile_time += compile_time;
+   }
+
+   info->compile_time = compile_time;
+   info->code_size = gallivm_code_size(gallivm);
+   info->hits = MAX2(info->hits, 1);
+   update_priority(cache, info);
+
+   cache->nr_variants++;
+   cache->code_size += info->code_size;
+}
+
+
+/**
+ * Account for a variant being freed, either evicted to make room for new
+ * ones, or because its shader was deleted.
+ */
+void
+lp_variant_cache_remove(struct lp_variant_cache *cache,
+                        struct lp_variant_stats *shader_stats,
+                        const struct lp_variant_info *info,
+                        boolean evicted)
+{
+   assert(cache->nr_variants > 0);
+   assert(cache->code_size >= info->code_size);
+
+   cache->nr_variants--;
+   cache->code_size -= info->code_size;
+
+   if (evicted) {
+      cache->stats.evictions++;
+      if (shader_stats)
+         shader_stats->evictions++;
+      cache->clock = MAX2(cache->clock, info->priority);
+   }
+}
+
+
+boolean
+lp_variant_stats_enabled(void)
+{
+   return debug_get_option_variant_stats();
+}
+
+
+void
+lp_variant_stats_dump(const char *name,
+                      const struct lp_variant_stats *stats)
+{
+   _debug_printf("%s: %u hits, %u misses, %u compiles (%u ms), "
+                 "%u evictions\n",
+                 name, stats->hits, stats->misses, stats->compiles,
+                 (unsigned) (stats->compile_time / 1000),
+                 stats->evictions);
+}
+
+
+void
+lp_variant_cache_dump(const struct lp_variant_cache *cache)
+{
+   _debug_printf("%s variants: %u of %u, %u KB of code",
+                 cache->name, cache->nr_variants, cache->max_variants,
+                 (unsigned) (cache->code_size / 1024));
+   if (cache->max_code_size)
+      _debug_printf(" of %u KB", (unsigned) (cache->max_code_size / 1024));
+   _debug_printf("\n");
+
+   lp_variant_stats_dump(cache->name, &cache->stats);
+}
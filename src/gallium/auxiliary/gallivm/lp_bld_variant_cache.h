@@ -0,0 +1,137 @@
+/**************************************************************************
+ *
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Eviction policy and statistics for caches of generated shader variants,
+ * shared by llvmpipe and draw.
+ */
+
+#ifndef LP_BLD_VARIANT_CACHE_H
+#define LP_BLD_VARIANT_CACHE_H
+
+
+#include <stddef.h>
+
+#include "pipe/p_compiler.h"
+
+
+struct gallivm_state;
+
+
+/**
+ * Per variant bookkeeping.
+ */
+struct lp_variant_info
+{
+   int64_t compile_time;   /**< microseconds */
+   size_t code_size;       /**< bytes of code and data, 0 if unknown */
+   unsigned hits;
+
+   /** The variant with the lowest priority is evicted first */
+   double priority;
+};
+
+
+/**
+ * Counters kept per cache, and per shader.
+ */
+struct lp_variant_stats
+{
+   unsigned hits;
+   unsigned misses;
+   unsigned compiles;
+   unsigned evictions;
+   int64_t compile_time;   /**< microseconds */
+};
+
+
+struct lp_variant_cache
+{
+   const char *name;
+
+   /** Limits, when either is reached variants are evicted */
+   unsigned max_variants;
+   size_t max_code_size;   /**< bytes, 0 for no limit */
+
+   unsigned nr_variants;
+   size_t code_size;
+
+   /** Priority of the last evicted variant, ages the remaining ones */
+   double clock;
+
+   struct lp_variant_stats stats;
+};
+
+
+void
+lp_variant_cache_init(struct lp_variant_cache *cache,
+                      const char *name,
+                      unsigned max_variants,
+                      size_t max_code_size);
+
+boolean
+lp_variant_cache_full(const struct lp_variant_cache *cache);
+
+boolean
+lp_variant_cache_over_target(const struct lp_variant_cache *cache);
+
+void
+lp_variant_cache_hit(struct lp_variant_cache *cache,
+                     struct lp_variant_stats *shader_stats,
+                     struct lp_variant_info *info);
+
+void
+lp_variant_cache_miss(struct lp_variant_cache *cache,
+                      struct lp_variant_stats *shader_stats);
+
+void
+lp_variant_cache_insert(struct lp_variant_cache *cache,
+                        struct lp_variant_stats *shader_stats,
+                        struct lp_variant_info *info,
+                        struct gallivm_state *gallivm,
+                        int64_t compile_time);
+
+void
+lp_variant_cache_remove(struct lp_variant_cache *cache,
+                        struct lp_variant_stats *shader_stats,
+                        const struct lp_variant_info *info,
+                        boolean evicted);
+
+boolean
+lp_variant_stats_enabled(void);
+
+void
+lp_variant_stats_dump(const char *name,
+                      const struct lp_variant_stats *stats);
+
+void
+lp_variant_cache_dump(const struct lp_variant_cache *cache);
+
+
+#endif /* !LP_BLD_VARIANT_CACHE_H */
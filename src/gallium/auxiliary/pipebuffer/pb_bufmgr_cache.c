@@ -28,6 +28,14 @@
 /**
  * \file
  * Buffer cache.
+ *
+ * Unused buffers are kept in two lists: the delayed list, in the order
+ * they were released, which is used to expire them and to enforce the
+ * cache size limit, and the list of their size bucket, which is used to
+ * find a buffer for a new request.  Each power of two of the size is split
+ * in PB_CACHE_BUCKETS_PER_POT buckets, so a request only looks at the few
+ * buckets which can hold buffers within size_factor of the requested
+ * size.
  * 
  * \author Jose Fonseca <jfonseca-at-vmware-dot-com>
  * \author Thomas Hellström <thellstom-at-vmware-dot-com>
@@ -37,6 +45,7 @@
 #include "pipe/p_compiler.h"
 #include "util/u_debug.h"
 #include "os/os_thread.h"
+#include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_double_list.h"
 #include "util/u_time.h"
@@ -51,6 +60,11 @@
 #define SUPER(__derived) (&(__derived)->base)
 
 
+#define PB_CACHE_BUCKETS_PER_POT_LOG2 2
+#define PB_CACHE_BUCKETS_PER_POT (1 << PB_CACHE_BUCKETS_PER_POT_LOG2)
+#define PB_CACHE_NUM_BUCKETS (sizeof(pb_size) * 8 * PB_CACHE_BUCKETS_PER_POT)
+
+
 struct pb_cache_manager;
 
 
@@ -67,7 +81,10 @@ struct pb_cache_buffer
    /** Caching time interval */
    int64_t start, end;
 
+   /** Link in pb_cache_manager::delayed */
    struct list_head head;
+   /** Link in pb_cache_manager::buckets */
+   struct list_head bucket_head;
 };
 
 
@@ -80,7 +97,10 @@ struct pb_cache_manager
    
    pipe_mutex mutex;
    
+   /** All the cached buffers, oldest first */
    struct list_head delayed;
+   /** The cached buffers by size, oldest first */
+   struct list_head buckets[PB_CACHE_NUM_BUCKETS];
    pb_size numDelayed;
    float size_factor;
    unsigned bypass_usage;
@@ -104,6 +124,27 @@ pb_cache_manager(struct pb_manager *mgr)
 }
 
 
+/**
+ * Index of the bucket for buffers of the given size: the power of two
+ * followed by the next bits of the size.
+ */
+static INLINE unsigned
+pb_cache_bucket_index(pb_size size)
+{
+   unsigned pot = util_logbase2(size);
+   unsigned sub;
+
+   if (pot >= PB_CACHE_BUCKETS_PER_POT_LOG2)
+      sub = (size >> (pot - PB_CACHE_BUCKETS_PER_POT_LOG2)) &
+            (PB_CACHE_BUCKETS_PER_POT - 1);
+   else
+      sub = (size << (PB_CACHE_BUCKETS_PER_POT_LOG2 - pot)) &
+            (PB_CACHE_BUCKETS_PER_POT - 1);
+
+   return pot * PB_CACHE_BUCKETS_PER_POT + sub;
+}
+
+
 /**
  * Actually destroy the buffer.
  */
@@ -113,6 +154,7 @@ _pb_cache_buffer_destroy(struct pb_cache_buffer *buf)
    struct pb_cache_manager *mgr = buf->mgr;
 
    LIST_DEL(&buf->head);
+   LIST_DEL(&buf->bucket_head);
    assert(mgr->numDelayed);
    --mgr->numDelayed;
    mgr->cache_size -= buf->base.size;
@@ -161,17 +203,28 @@ pb_cache_buffer_destroy(struct pb_buffer *_buf)
    
    _pb_cache_buffer_list_check_free(mgr);
 
-   /* Directly release any buffer that exceeds the limit. */
-   if (mgr->cache_size + buf->base.size > mgr->max_cache_size) {
+   /* Directly release any buffer that exceeds the limit by itself. */
+   if (buf->base.size > mgr->max_cache_size) {
       pb_reference(&buf->buffer, NULL);
       FREE(buf);
       pipe_mutex_unlock(mgr->mutex);
       return;
    }
 
+   /* Otherwise make room by releasing the oldest buffers, which are the
+    * least likely to be reused.
+    */
+   while (mgr->cache_size + buf->base.size > mgr->max_cache_size) {
+      assert(!LIST_IS_EMPTY(&mgr->delayed));
+      _pb_cache_buffer_destroy(LIST_ENTRY(struct pb_cache_buffer,
+                                          mgr->delayed.next, head));
+   }
+
    buf->start = os_time_get();
    buf->end = buf->start + mgr->usecs;
    LIST_ADDTAIL(&buf->head, &mgr->delayed);
+   LIST_ADDTAIL(&buf->bucket_head,
+                &mgr->buckets[pb_cache_bucket_index(buf->base.size)]);
    ++mgr->numDelayed;
    mgr->cache_size += buf->base.size;
    pipe_mutex_unlock(mgr->mutex);
@@ -240,9 +293,6 @@ pb_cache_is_buffer_compat(struct pb_cache_buffer *buf,
                           pb_size size,
                           const struct pb_desc *desc)
 {
-   if (desc->usage & buf->mgr->bypass_usage)
-      return 0;
-
    if(buf->base.size < size)
       return 0;
 
@@ -278,55 +328,55 @@ pb_cache_manager_create_buffer(struct pb_manager *_mgr,
                                const struct pb_desc *desc)
 {
    struct pb_cache_manager *mgr = pb_cache_manager(_mgr);
-   struct pb_cache_buffer *buf;
-   struct pb_cache_buffer *curr_buf;
-   struct list_head *curr, *next;
-   int64_t now;
-   int ret = 0;
+   struct pb_cache_buffer *buf = NULL;
+   unsigned first_bucket, last_bucket, i;
+   boolean busy = FALSE;
+   pb_size max_size;
+
+   if (desc->usage & mgr->bypass_usage)
+      goto create;
+
+   /* be lenient with size */
+   if (mgr->size_factor * size < (float) ~(pb_size)0)
+      max_size = (pb_size) (mgr->size_factor * size);
+   else
+      max_size = ~(pb_size)0;
+   if (max_size < size)
+      goto create;
+
+   first_bucket = pb_cache_bucket_index(size);
+   last_bucket = pb_cache_bucket_index(max_size);
 
    pipe_mutex_lock(mgr->mutex);
 
-   buf = NULL;
-   curr = mgr->delayed.next;
-   next = curr->next;
-   
-   /* search in the expired buffers, freeing them in the process */
-   now = os_time_get();
-   while(curr != &mgr->delayed) {
-      curr_buf = LIST_ENTRY(struct pb_cache_buffer, curr, head);
-      if(!buf && (ret = pb_cache_is_buffer_compat(curr_buf, size, desc) > 0))
-         buf = curr_buf;
-      else if(os_time_timeout(curr_buf->start, curr_buf->end, now))
-         _pb_cache_buffer_destroy(curr_buf);
-      else
-         /* This buffer (and all hereafter) are still hot in cache */
-         break;
-      if (ret == -1)
-         break;
-      curr = next; 
-      next = curr->next;
-   }
+   _pb_cache_buffer_list_check_free(mgr);
 
-   /* keep searching in the hot buffers */
-   if(!buf && ret != -1) {
-      while(curr != &mgr->delayed) {
-         curr_buf = LIST_ENTRY(struct pb_cache_buffer, curr, head);
-         ret = pb_cache_is_buffer_compat(curr_buf, size, desc);
+   for (i = first_bucket; i <= last_bucket && !buf && !busy; ++i) {
+      struct list_head *bucket = &mgr->buckets[i];
+      struct list_head *curr;
+
+      for (curr = bucket->next; curr != bucket; curr = curr->next) {
+         struct pb_cache_buffer *curr_buf =
+            LIST_ENTRY(struct pb_cache_buffer, curr, bucket_head);
+         int ret = pb_cache_is_buffer_compat(curr_buf, size, desc);
          if (ret > 0) {
             buf = curr_buf;
             break;
          }
-         if (ret == -1)
+         /* The newer buffers are likely busy too, and checking is not
+          * free, so give up.
+          */
+         if (ret == -1) {
+            busy = TRUE;
             break;
-         /* no need to check the timeout here */
-         curr = next;
-         next = curr->next;
+         }
       }
    }
-   
+
    if(buf) {
       mgr->cache_size -= buf->base.size;
       LIST_DEL(&buf->head);
+      LIST_DEL(&buf->bucket_head);
       --mgr->numDelayed;
       pipe_mutex_unlock(mgr->mutex);
       /* Increase refcount */
@@ -336,6 +386,7 @@ pb_cache_manager_create_buffer(struct pb_manager *_mgr,
    
    pipe_mutex_unlock(mgr->mutex);
 
+create:
    buf = CALLOC_STRUCT(pb_cache_buffer);
    if(!buf)
       return NULL;
@@ -423,6 +474,7 @@ pb_cache_manager_create(struct pb_manager *provider,
                         uint64_t maximum_cache_size)
 {
    struct pb_cache_manager *mgr;
+   unsigned i;
 
    if(!provider)
       return NULL;
@@ -439,6 +491,8 @@ pb_cache_manager_create(struct pb_manager *provider,
    mgr->size_factor = size_factor;
    mgr->bypass_usage = bypass_usage;
    LIST_INITHEAD(&mgr->delayed);
+   for (i = 0; i < PB_CACHE_NUM_BUCKETS; i++)
+      LIST_INITHEAD(&mgr->buckets[i]);
    mgr->numDelayed = 0;
    mgr->max_cache_size = maximum_cache_size;
    pipe_mutex_init(mgr->mutex);
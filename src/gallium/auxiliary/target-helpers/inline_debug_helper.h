@@ -8,7 +8,7 @@
 
 
 /* Helper function to wrap a screen with
- * one or more debug driver: rbug, trace.
+ * one or more debug driver: rbug, trace, and the threaded wrapper.
  */
 
 #ifdef GALLIUM_TRACE
@@ -23,6 +23,10 @@
 #include "noop/noop_public.h"
 #endif
 
+#ifdef GALLIUM_THREADED
+#include "threaded/tc_public.h"
+#endif
+
 /*
  * TODO: Audit the following *screen_create() - all of
  * them should return the original screen on failuire.
@@ -42,6 +46,10 @@ debug_screen_wrap(struct pipe_screen *screen)
    screen = noop_screen_create(screen);
 #endif
 
+#if defined(GALLIUM_THREADED)
+   screen = threaded_screen_create(screen);
+#endif
+
    if (debug_get_bool_option("GALLIUM_TESTS", FALSE))
       util_run_tests(screen);
 
@@ -38,6 +38,22 @@
 #include "u_upload_mgr.h"
 
 
+/** Number of exhausted buffers kept around for reuse */
+#define U_UPLOAD_RING_SIZE 4
+
+
+/**
+ * A full, still persistently mapped, upload buffer waiting for the GPU
+ * to be done with it.
+ */
+struct u_upload_ring_entry {
+   struct pipe_resource *buffer;
+   struct pipe_transfer *transfer;
+   uint8_t *map;
+   struct pipe_fence_handle *fence; /* NULL until the next u_upload_fence */
+};
+
+
 struct u_upload_mgr {
    struct pipe_context *pipe;
 
@@ -52,6 +68,13 @@ struct u_upload_mgr {
    uint8_t *map;    /* Pointer to the mapped upload buffer. */
    unsigned offset; /* Aligned offset to the upload buffer, pointing
                      * at the first unused byte. */
+
+   /* Retired buffers, oldest first, only used with persistent mappings. */
+   struct u_upload_ring_entry ring[U_UPLOAD_RING_SIZE];
+   unsigned ring_head;
+   unsigned ring_count;
+
+   struct u_upload_stats stats;
 };
 
 
@@ -116,19 +139,151 @@ void u_upload_unmap( struct u_upload_mgr *upload )
 
 static void u_upload_release_buffer(struct u_upload_mgr *upload)
 {
+   if (upload->buffer)
+      upload->stats.buffers_released++;
+
    /* Unmap and unreference the upload buffer. */
    upload_unmap_internal(upload, TRUE);
    pipe_resource_reference( &upload->buffer, NULL );
 }
 
 
+static void u_upload_release_ring_entry(struct u_upload_mgr *upload,
+                                        struct u_upload_ring_entry *entry)
+{
+   struct pipe_screen *screen = upload->pipe->screen;
+
+   pipe_transfer_unmap(upload->pipe, entry->transfer);
+   pipe_resource_reference(&entry->buffer, NULL);
+   screen->fence_reference(screen, &entry->fence, NULL);
+   entry->transfer = NULL;
+   entry->map = NULL;
+   upload->stats.buffers_released++;
+}
+
+
 void u_upload_destroy( struct u_upload_mgr *upload )
 {
+   while (upload->ring_count) {
+      u_upload_release_ring_entry(upload, &upload->ring[upload->ring_head]);
+      upload->ring_head = (upload->ring_head + 1) % U_UPLOAD_RING_SIZE;
+      upload->ring_count--;
+   }
+
    u_upload_release_buffer( upload );
    FREE( upload );
 }
 
 
+void u_upload_fence( struct u_upload_mgr *upload,
+                     struct pipe_fence_handle *fence )
+{
+   struct pipe_screen *screen = upload->pipe->screen;
+   unsigned i;
+
+   /* The newest entries are the ones still without a fence. */
+   for (i = upload->ring_count; i > 0; i--) {
+      struct u_upload_ring_entry *entry =
+         &upload->ring[(upload->ring_head + i - 1) % U_UPLOAD_RING_SIZE];
+
+      if (entry->fence)
+         break;
+
+      screen->fence_reference(screen, &entry->fence, fence);
+   }
+}
+
+
+boolean u_upload_needs_fence( struct u_upload_mgr *upload )
+{
+   /* The newest entry is the last one to get a fence. */
+   return upload->ring_count &&
+          !upload->ring[(upload->ring_head + upload->ring_count - 1) %
+                        U_UPLOAD_RING_SIZE].fence;
+}
+
+
+void u_upload_get_stats( struct u_upload_mgr *upload,
+                         struct u_upload_stats *stats,
+                         boolean reset )
+{
+   *stats = upload->stats;
+
+   if (reset)
+      memset(&upload->stats, 0, sizeof upload->stats);
+}
+
+
+/**
+ * Move the current, full upload buffer to the ring, releasing the oldest
+ * ring entry if there's no room.
+ */
+static void u_upload_retire_buffer(struct u_upload_mgr *upload)
+{
+   struct u_upload_ring_entry *entry;
+
+   assert(upload->map_persistent);
+
+   if (!upload->buffer || !upload->transfer) {
+      u_upload_release_buffer(upload);
+      return;
+   }
+
+   if (upload->ring_count == U_UPLOAD_RING_SIZE) {
+      u_upload_release_ring_entry(upload, &upload->ring[upload->ring_head]);
+      upload->ring_head = (upload->ring_head + 1) % U_UPLOAD_RING_SIZE;
+      upload->ring_count--;
+   }
+
+   entry = &upload->ring[(upload->ring_head + upload->ring_count) %
+                         U_UPLOAD_RING_SIZE];
+   entry->buffer = upload->buffer;
+   entry->transfer = upload->transfer;
+   entry->map = upload->map;
+   entry->fence = NULL;
+   upload->ring_count++;
+
+   /* The ring entry holds the references now */
+   upload->buffer = NULL;
+   upload->transfer = NULL;
+   upload->map = NULL;
+}
+
+
+/**
+ * Make the oldest ring buffer current again if it is big enough and the
+ * GPU is done with it.
+ */
+static boolean u_upload_recycle_buffer(struct u_upload_mgr *upload,
+                                       unsigned size)
+{
+   struct pipe_screen *screen = upload->pipe->screen;
+   struct u_upload_ring_entry *entry = &upload->ring[upload->ring_head];
+
+   if (!upload->ring_count ||
+       !entry->fence ||
+       entry->buffer->width0 < size ||
+       !screen->fence_signalled(screen, entry->fence))
+      return FALSE;
+
+   assert(!upload->buffer);
+   upload->buffer = entry->buffer;
+   upload->transfer = entry->transfer;
+   upload->map = entry->map;
+   upload->offset = 0;
+
+   screen->fence_reference(screen, &entry->fence, NULL);
+   entry->buffer = NULL;
+   entry->transfer = NULL;
+   entry->map = NULL;
+   upload->ring_head = (upload->ring_head + 1) % U_UPLOAD_RING_SIZE;
+   upload->ring_count--;
+
+   upload->stats.buffers_recycled++;
+   return TRUE;
+}
+
+
 static enum pipe_error 
 u_upload_alloc_buffer( struct u_upload_mgr *upload,
                        unsigned min_size )
@@ -137,13 +292,22 @@ u_upload_alloc_buffer( struct u_upload_mgr *upload,
    struct pipe_resource buffer;
    unsigned size;
 
-   /* Release the old buffer, if present:
+   size = align(MAX2(upload->default_size, min_size), 4096);
+
+   /* Release the old buffer, if present, or keep it mapped for reuse:
     */
-   u_upload_release_buffer( upload );
+   if (upload->map_persistent) {
+      u_upload_retire_buffer( upload );
+
+      if (u_upload_recycle_buffer( upload, size ))
+         return PIPE_OK;
+   }
+   else {
+      u_upload_release_buffer( upload );
+   }
 
    /* Allocate a new one: 
     */
-   size = align(MAX2(upload->default_size, min_size), 4096);
 
    memset(&buffer, 0, sizeof buffer);
    buffer.target = PIPE_BUFFER;
@@ -176,6 +340,7 @@ u_upload_alloc_buffer( struct u_upload_mgr *upload,
    }
 
    upload->offset = 0;
+   upload->stats.buffers_allocated++;
    return PIPE_OK;
 }
 
@@ -233,6 +398,7 @@ enum pipe_error u_upload_alloc( struct u_upload_mgr *upload,
    *out_offset = offset;
 
    upload->offset = offset + alloc_size;
+   upload->stats.bytes_uploaded += size;
    return PIPE_OK;
 }
 
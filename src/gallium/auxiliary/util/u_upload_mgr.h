@@ -36,6 +36,19 @@
 
 struct pipe_context;
 struct pipe_resource;
+struct pipe_fence_handle;
+
+
+/**
+ * Upload counters, see u_upload_get_stats().
+ */
+struct u_upload_stats
+{
+   uint64_t bytes_uploaded;     /**< bytes sub-allocated */
+   unsigned buffers_allocated;  /**< new upload buffers created */
+   unsigned buffers_recycled;   /**< idle ring buffers reused */
+   unsigned buffers_released;   /**< upload buffers unreferenced */
+};
 
 
 /**
@@ -68,6 +81,39 @@ void u_upload_destroy( struct u_upload_mgr *upload );
  */
 void u_upload_unmap( struct u_upload_mgr *upload );
 
+/**
+ * Tell the upload manager about a fence covering all the commands issued
+ * so far.
+ *
+ * \param upload           Upload manager
+ * \param fence            Fence returned by the last pipe_context::flush
+ *
+ * With persistent mappings, exhausted upload buffers are kept mapped in a
+ * small ring instead of being released and get reused once the fence that
+ * followed their last use has signalled.  Without this call, or without
+ * persistent mapping support, buffers are simply released when full.
+ */
+void u_upload_fence( struct u_upload_mgr *upload,
+                     struct pipe_fence_handle *fence );
+
+/**
+ * Whether u_upload_fence would do anything, i.e. whether there are retired
+ * persistent buffers still waiting for a fence.  Lets the caller avoid
+ * creating a fence when no uploader needs one.
+ */
+boolean u_upload_needs_fence( struct u_upload_mgr *upload );
+
+/**
+ * Return the upload counters accumulated since creation or the last reset.
+ *
+ * \param upload           Upload manager
+ * \param stats            Where the counters are returned.
+ * \param reset            Whether to zero the counters, e.g. once per frame.
+ */
+void u_upload_get_stats( struct u_upload_mgr *upload,
+                         struct u_upload_stats *stats,
+                         boolean reset );
+
 /**
  * Sub-allocate new memory from the upload buffer.
  *
@@ -0,0 +1,352 @@
+/**************************************************************************
+ *
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Post-transform vertex cache simulation and triangle reordering.
+ *
+ * The reordering follows Tom Forsyth, "Linear-Speed Vertex Cache
+ * Optimisation", 2006: every vertex gets a score from its position in a
+ * modelled LRU cache and from the number of triangles still using it,
+ * and the triangle with the highest total score among those touching
+ * cached vertices is emitted next.
+ */
+
+#include "util/u_debug.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/u_vertex_cache.h"
+
+
+#define CACHE_DECAY_POWER   1.5f
+#define LAST_TRI_SCORE      0.75f
+#define VALENCE_BOOST_SCALE 2.0f
+#define VALENCE_BOOST_POWER 0.5f
+
+
+struct vc_vertex
+{
+   int cache_pos;          /**< position in the modelled cache, or -1 */
+   unsigned active_tris;   /**< number of triangles not emitted yet */
+   unsigned tri_offset;    /**< start of this vertex's triangle list */
+   float score;
+};
+
+
+static INLINE unsigned
+get_index(unsigned index_size, const void *indices, unsigned i)
+{
+   switch (index_size) {
+   case 1:
+      return ((const ubyte *) indices)[i];
+   case 2:
+      return ((const ushort *) indices)[i];
+   default:
+      assert(index_size == 4);
+      return ((const uint *) indices)[i];
+   }
+}
+
+
+static INLINE void
+set_index(unsigned index_size, void *indices, unsigned i, unsigned value)
+{
+   switch (index_size) {
+   case 1:
+      ((ubyte *) indices)[i] = (ubyte) value;
+      break;
+   case 2:
+      ((ushort *) indices)[i] = (ushort) value;
+      break;
+   default:
+      assert(index_size == 4);
+      ((uint *) indices)[i] = value;
+      break;
+   }
+}
+
+
+/**
+ * Count the vertex shader invocations needed to draw a triangle list with
+ * a FIFO post-transform cache of cache_size entries.
+ */
+unsigned
+util_vertex_cache_misses(unsigned index_size, const void *indices,
+                         unsigned count, unsigned cache_size)
+{
+   unsigned fifo[UTIL_VERTEX_CACHE_MAX_SIZE];
+   unsigned head = 0, filled = 0, misses = 0;
+   unsigned i, j;
+
+   cache_size = CLAMP(cache_size, 1, UTIL_VERTEX_CACHE_MAX_SIZE);
+
+   for (i = 0; i < count; i++) {
+      unsigned index = get_index(index_size, indices, i);
+
+      for (j = 0; j < filled; j++) {
+         if (fifo[j] == index)
+            break;
+      }
+
+      if (j == filled) {
+         misses++;
+         fifo[head] = index;
+         head = (head + 1) % cache_size;
+         if (filled < cache_size)
+            filled++;
+      }
+   }
+
+   return misses;
+}
+
+
+/**
+ * Average cache miss ratio: vertex shader invocations per triangle.
+ * 0.5 is the best possible for large regular meshes, 3.0 the worst.
+ */
+float
+util_vertex_cache_acmr(unsigned index_size, const void *indices,
+                       unsigned count, unsigned cache_size)
+{
+   unsigned num_tris = count / 3;
+
+   if (!num_tris)
+      return 0.0f;
+
+   return (float) util_vertex_cache_misses(index_size, indices,
+                                           num_tris * 3, cache_size) /
+          (float) num_tris;
+}
+
+
+static float
+vertex_score(const struct vc_vertex *vertex, unsigned cache_size)
+{
+   float score = 0.0f;
+
+   if (vertex->active_tris == 0) {
+      /* no triangles left, never pick it */
+      return -1.0f;
+   }
+
+   if (vertex->cache_pos >= 0) {
+      if (vertex->cache_pos < 3) {
+         /* Used by the last triangle: give it a fixed score so that
+          * the same triangle's vertices don't get a bonus for being
+          * added in a particular order.
+          */
+         score = LAST_TRI_SCORE;
+      }
+      else {
+         const float scaler = 1.0f / (float) (cache_size - 3);
+         score = 1.0f - (float) (vertex->cache_pos - 3) * scaler;
+         score = powf(score, CACHE_DECAY_POWER);
+      }
+   }
+
+   /* Boost vertices with few triangles left, to get rid of lone triangles */
+   score += VALENCE_BOOST_SCALE *
+            powf((float) vertex->active_tris, -VALENCE_BOOST_POWER);
+
+   return score;
+}
+
+
+/**
+ * Reorder the triangles of a triangle list in place for better post
+ * transform cache use.  Indices must be less than num_vertices.  Any
+ * trailing indices that don't form a whole triangle are left alone.
+ *
+ * \return FALSE if out of memory or the indices are out of range, in which
+ * case the index buffer is unchanged.
+ */
+boolean
+util_optimize_vertex_cache(unsigned index_size, void *indices,
+                           unsigned count, unsigned num_vertices,
+                           unsigned cache_size)
+{
+   const unsigned num_tris = count / 3;
+   struct vc_vertex *vertices = NULL;
+   unsigned *tri_indices = NULL;
+   unsigned *tri_lists = NULL;
+   unsigned *order = NULL;
+   ubyte *tri_added = NULL;
+   unsigned cache[UTIL_VERTEX_CACHE_MAX_SIZE + 3];
+   unsigned new_cache[UTIL_VERTEX_CACHE_MAX_SIZE + 3];
+   unsigned cache_len = 0;
+   unsigned next_unadded = 0;
+   int best_tri = -1;
+   float best_score = -1.0f;
+   boolean ret = FALSE;
+   unsigned i, j, n;
+
+   if (num_tris < 2)
+      return TRUE;
+
+   cache_size = CLAMP(cache_size, 4, UTIL_VERTEX_CACHE_MAX_SIZE);
+
+   vertices = CALLOC(num_vertices, sizeof *vertices);
+   tri_indices = MALLOC(num_tris * 3 * sizeof *tri_indices);
+   tri_lists = MALLOC(num_tris * 3 * sizeof *tri_lists);
+   order = MALLOC(num_tris * sizeof *order);
+   tri_added = CALLOC(num_tris, sizeof *tri_added);
+   if (!vertices || !tri_indices || !tri_lists || !order || !tri_added)
+      goto out;
+
+   /* Build the vertex -> triangle adjacency */
+   for (i = 0; i < num_tris * 3; i++) {
+      unsigned index = get_index(index_size, indices, i);
+      if (index >= num_vertices)
+         goto out;
+      tri_indices[i] = index;
+      vertices[index].active_tris++;
+   }
+
+   for (i = 0, n = 0; i < num_vertices; i++) {
+      vertices[i].tri_offset = n;
+      vertices[i].cache_pos = -1;
+      n += vertices[i].active_tris;
+      vertices[i].active_tris = 0;
+   }
+
+   for (i = 0; i < num_tris * 3; i++) {
+      struct vc_vertex *vertex = &vertices[tri_indices[i]];
+      tri_lists[vertex->tri_offset + vertex->active_tris++] = i / 3;
+   }
+
+   for (i = 0; i < num_vertices; i++)
+      vertices[i].score = vertex_score(&vertices[i], cache_size);
+
+   for (i = 0; i < num_tris; i++) {
+      float score = vertices[tri_indices[i * 3 + 0]].score +
+                    vertices[tri_indices[i * 3 + 1]].score +
+                    vertices[tri_indices[i * 3 + 2]].score;
+      if (score > best_score) {
+         best_score = score;
+         best_tri = i;
+      }
+   }
+
+   for (n = 0; n < num_tris; n++) {
+      unsigned new_cache_len = 0;
+
+      if (best_tri < 0) {
+         /* Nothing adjacent to the cache left, take the next unused one */
+         while (tri_added[next_unadded])
+            next_unadded++;
+         best_tri = next_unadded;
+      }
+
+      order[n] = best_tri;
+      tri_added[best_tri] = 1;
+
+      /* Remove the triangle from its vertices and put those in front of
+       * the cache.
+       */
+      for (i = 0; i < 3; i++) {
+         unsigned index = tri_indices[best_tri * 3 + i];
+         struct vc_vertex *vertex = &vertices[index];
+         unsigned *list = &tri_lists[vertex->tri_offset];
+
+         for (j = 0; j < vertex->active_tris; j++) {
+            if (list[j] == (unsigned) best_tri) {
+               list[j] = list[--vertex->active_tris];
+               break;
+            }
+         }
+
+         for (j = 0; j < new_cache_len; j++) {
+            if (new_cache[j] == index)
+               break;
+         }
+         if (j == new_cache_len)
+            new_cache[new_cache_len++] = index;
+      }
+
+      for (i = 0; i < cache_len; i++) {
+         unsigned index = cache[i];
+
+         for (j = 0; j < 3; j++) {
+            if (tri_indices[best_tri * 3 + j] == index)
+               break;
+         }
+         if (j == 3)
+            new_cache[new_cache_len++] = index;
+      }
+
+      /* Update the scores of everything that moved, including the
+       * vertices that just fell out of the cache.
+       */
+      for (i = 0; i < new_cache_len; i++) {
+         struct vc_vertex *vertex = &vertices[new_cache[i]];
+
+         vertex->cache_pos = i < cache_size ? (int) i : -1;
+         vertex->score = vertex_score(vertex, cache_size);
+      }
+
+      best_tri = -1;
+      best_score = -1.0f;
+
+      for (i = 0; i < new_cache_len; i++) {
+         const struct vc_vertex *vertex = &vertices[new_cache[i]];
+         const unsigned *list = &tri_lists[vertex->tri_offset];
+
+         for (j = 0; j < vertex->active_tris; j++) {
+            unsigned tri = list[j];
+            float score = vertices[tri_indices[tri * 3 + 0]].score +
+                          vertices[tri_indices[tri * 3 + 1]].score +
+                          vertices[tri_indices[tri * 3 + 2]].score;
+
+            if (score > best_score) {
+               best_score = score;
+               best_tri = tri;
+            }
+         }
+      }
+
+      cache_len = MIN2(new_cache_len, cache_size);
+      memcpy(cache, new_cache, cache_len * sizeof cache[0]);
+   }
+
+   for (n = 0; n < num_tris; n++) {
+      for (i = 0; i < 3; i++) {
+         set_index(index_size, indices, n * 3 + i,
+                   tri_indices[order[n] * 3 + i]);
+      }
+   }
+
+   ret = TRUE;
+
+out:
+   FREE(vertices);
+   FREE(tri_indices);
+   FREE(tri_lists);
+   FREE(order);
+   FREE(tri_added);
+   return ret;
+}
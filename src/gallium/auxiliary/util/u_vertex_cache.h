@@ -0,0 +1,76 @@
+/**************************************************************************
+ *
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Post-transform vertex cache helpers for triangle list index buffers.
+ *
+ * util_vertex_cache_misses() simulates a FIFO post-transform cache of a
+ * given size, which gives the number of vertex shader invocations a
+ * typical hardware (or the draw module's vsplit) would need; divided by
+ * the triangle count that's the average cache miss ratio (ACMR).
+ *
+ * util_optimize_vertex_cache() reorders the triangles of an index buffer
+ * to improve its cache locality, using Tom Forsyth's "Linear-Speed Vertex
+ * Cache Optimisation" algorithm.  It is meant to be applied once to static
+ * index buffers by state trackers or tools, not on every draw.
+ */
+
+#ifndef U_VERTEX_CACHE_H
+#define U_VERTEX_CACHE_H
+
+#include "pipe/p_compiler.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/** Largest cache size the optimizer models */
+#define UTIL_VERTEX_CACHE_MAX_SIZE 64
+
+
+unsigned
+util_vertex_cache_misses(unsigned index_size, const void *indices,
+                         unsigned count, unsigned cache_size);
+
+float
+util_vertex_cache_acmr(unsigned index_size, const void *indices,
+                       unsigned count, unsigned cache_size);
+
+boolean
+util_optimize_vertex_cache(unsigned index_size, void *indices,
+                           unsigned count, unsigned num_vertices,
+                           unsigned cache_size);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* U_VERTEX_CACHE_H */
@@ -33,10 +33,12 @@
 #include "draw/draw_context.h"
 #include "draw/draw_vbuf.h"
 #include "pipe/p_defines.h"
+#include "util/u_atomic.h"
 #include "util/u_inlines.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/simple_list.h"
+#include "gallivm/lp_bld_variant_cache.h"
 #include "lp_clear.h"
 #include "lp_context.h"
 #include "lp_flush.h"
@@ -44,6 +46,7 @@
 #include "lp_state.h"
 #include "lp_surface.h"
 #include "lp_query.h"
+#include "lp_screen.h"
 #include "lp_setup.h"
 
 /* This is only safe if there's just one concurrent context */
@@ -51,6 +54,12 @@
 #define USE_GLOBAL_LLVM_CONTEXT
 #endif
 
+DEBUG_GET_ONCE_NUM_OPTION(max_shader_variants, "LP_MAX_SHADER_VARIANTS",
+                          LP_MAX_SHADER_VARIANTS)
+DEBUG_GET_ONCE_NUM_OPTION(shader_cache_size, "LP_SHADER_CACHE_SIZE", 0)
+DEBUG_GET_ONCE_NUM_OPTION(max_setup_variants, "LP_MAX_SETUP_VARIANTS",
+                          LP_MAX_SETUP_VARIANTS)
+
 static void llvmpipe_destroy( struct pipe_context *pipe )
 {
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
@@ -95,13 +104,21 @@ static void llvmpipe_destroy( struct pipe_context *pipe )
       pipe_resource_reference(&llvmpipe->vertex_buffer[i].buffer, NULL);
    }
 
+   if (lp_variant_stats_enabled()) {
+      lp_variant_cache_dump(&llvmpipe->fs_variant_cache);
+      lp_variant_cache_dump(&llvmpipe->setup_variant_cache);
+   }
+
    lp_delete_setup_variants(llvmpipe);
+   llvmpipe_free_retired_fs_variants(llvmpipe);
 
 #ifndef USE_GLOBAL_LLVM_CONTEXT
    LLVMContextDispose(llvmpipe->context);
 #endif
    llvmpipe->context = NULL;
 
+   p_atomic_dec(&llvmpipe_screen(pipe->screen)->num_contexts);
+
    align_free( llvmpipe );
 }
 
@@ -141,12 +158,19 @@ llvmpipe_create_context( struct pipe_screen *screen, void *priv )
    memset(llvmpipe, 0, sizeof *llvmpipe);
 
    make_empty_list(&llvmpipe->fs_variants_list);
+   make_empty_list(&llvmpipe->fs_variants_retired);
+   lp_variant_cache_init(&llvmpipe->fs_variant_cache, "llvmpipe fs",
+                         debug_get_option_max_shader_variants(),
+                         debug_get_option_shader_cache_size() * 1024);
 
    make_empty_list(&llvmpipe->setup_variants_list);
+   lp_variant_cache_init(&llvmpipe->setup_variant_cache, "llvmpipe setup",
+                         debug_get_option_max_setup_variants(), 0);
 
 
    llvmpipe->pipe.screen = screen;
    llvmpipe->pipe.priv = priv;
+   p_atomic_inc(&llvmpipe_screen(screen)->num_contexts);
 
    /* Init the pipe context methods */
    llvmpipe->pipe.destroy = llvmpipe_destroy;
@@ -194,6 +218,8 @@ llvmpipe_create_context( struct pipe_screen *screen, void *priv )
    if (!llvmpipe->setup)
       goto fail;
 
+   llvmpipe_update_guard_band(llvmpipe);
+
    llvmpipe->blitter = util_blitter_create(&llvmpipe->pipe);
    if (!llvmpipe->blitter) {
       goto fail;
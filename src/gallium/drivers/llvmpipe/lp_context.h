@@ -80,6 +80,7 @@ struct llvmpipe_context {
    struct pipe_sampler_view *sampler_views[PIPE_SHADER_TYPES][PIPE_MAX_SHADER_SAMPLER_VIEWS];
 
    struct pipe_viewport_state viewports[PIPE_MAX_VIEWPORTS];
+   boolean guard_band;   /**< draw only clips to the guard band */
    struct pipe_vertex_buffer vertex_buffer[PIPE_MAX_ATTRIBS];
    struct pipe_index_buffer index_buffer;
    struct pipe_resource *mapped_vs_tex[PIPE_MAX_SHADER_SAMPLER_VIEWS];
@@ -143,11 +144,15 @@ struct llvmpipe_context {
 
    /** List of all fragment shader variants */
    struct lp_fs_variant_list_item fs_variants_list;
-   unsigned nr_fs_variants;
+   struct lp_fragment_shader_variant *fs_variant;   /**< currently bound */
+
+   /** Replaced variants which the scene may still use, freed on flush */
+   struct lp_fs_variant_list_item fs_variants_retired;
+   struct lp_variant_cache fs_variant_cache;
    unsigned nr_fs_instrs;
 
    struct lp_setup_variant_list_item setup_variants_list;
-   unsigned nr_setup_variants;
+   struct lp_variant_cache setup_variant_cache;
 
    /** Conditional query object and mode */
    struct pipe_query *render_cond_query;
@@ -37,6 +37,7 @@
 #include "lp_flush.h"
 #include "lp_context.h"
 #include "lp_setup.h"
+#include "lp_state.h"
 
 
 /**
@@ -54,6 +55,9 @@ llvmpipe_flush( struct pipe_context *pipe,
    /* ask the setup module to flush */
    lp_setup_flush(llvmpipe->setup, fence, reason);
 
+   /* the scene has been rasterized, nothing uses these anymore */
+   llvmpipe_free_retired_fs_variants(llvmpipe);
+
    /* Enable to dump BMPs of the color/depth buffers each frame */
    if (0) {
       static unsigned frame_no = 1;
@@ -54,6 +54,13 @@
 #define LP_MAX_TEXTURE_LEVELS LP_MAX_TEXTURE_2D_LEVELS
 
 
+/**
+ * Largest resource which gets new storage instead of waiting for the scene
+ * when mapped for writing while a scene reads from it.
+ */
+#define LP_MAX_RENAME_SIZE (16 * 1024 * 1024)
+
+
 /**
  * Max drawing surface size is the max texture size
  */
@@ -71,7 +78,8 @@
 
 /**
  * Max number of shader variants (for all shaders combined,
- * per context) that will be kept around.
+ * per context) that will be kept around by default, see also the
+ * LP_MAX_SHADER_VARIANTS and LP_SHADER_CACHE_SIZE environment variables.
  */
 #define LP_MAX_SHADER_VARIANTS 1024
 
@@ -83,13 +91,20 @@
  */
 #define LP_MAX_SHADER_INSTRUCTIONS MAX2(256*1024, 512*LP_MAX_SHADER_VARIANTS)
 
+/**
+ * With GALLIVM_OPT=tiered, number of draws after which a fragment shader
+ * variant compiled with the fast pipeline is recompiled fully optimized.
+ */
+#define LP_FS_RECOMPILE_DRAWS 64
+
 /**
  * Max number of setup variants that will be kept around.
  *
  * These are determined by the combination of the fragment shader
  * input signature and a small amount of rasterization state (eg
  * flatshading).  It is likely that many active fragment shaders will
- * share the same setup variant.
+ * share the same setup variant.  Can be changed with the
+ * LP_MAX_SETUP_VARIANTS environment variable.
  */
 #define LP_MAX_SETUP_VARIANTS 64
 
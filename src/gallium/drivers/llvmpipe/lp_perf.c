@@ -99,9 +99,14 @@ lp_print_counters(void)
       debug_printf("llvmpipe:   nr_non_empty_4x4:           %9u (%3.0f%% of %u)\n", lp_count.nr_non_empty_4, p4, total_4);
 
       debug_printf("llvmpipe: nr_color_tile_clear:          %9u\n", lp_count.nr_color_tile_clear);
+      debug_printf("llvmpipe:   elided:                     %9u\n", lp_count.nr_color_tile_clear_elided);
+      debug_printf("llvmpipe:   streamed:                   %9u\n", lp_count.nr_color_tile_clear_streamed);
       debug_printf("llvmpipe: nr_color_tile_load:           %9u\n", lp_count.nr_color_tile_load);
       debug_printf("llvmpipe: nr_color_tile_store:          %9u\n", lp_count.nr_color_tile_store);
 
+      debug_printf("llvmpipe: nr_flushes_avoided_rename:    %9u\n", lp_count.nr_flushes_avoided_rename);
+      debug_printf("llvmpipe: nr_flushes_avoided_region:    %9u\n", lp_count.nr_flushes_avoided_region);
+
       debug_printf("llvmpipe: nr_llvm_compiles:             %u\n", lp_count.nr_llvm_compiles);
       debug_printf("llvmpipe: total LLVM compile time:      %.2f sec\n", lp_count.llvm_compile_time / 1000000.0);
       debug_printf("llvmpipe: average LLVM compile time:    %.2f sec\n", lp_count.llvm_compile_time / 1000000.0 / lp_count.nr_llvm_compiles);
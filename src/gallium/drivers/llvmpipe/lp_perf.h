@@ -60,8 +60,13 @@ struct lp_counters
    int64_t llvm_compile_time;  /**< total, in microseconds */
 
    unsigned nr_color_tile_clear;
+   unsigned nr_color_tile_clear_elided;  /**< overwritten before being done */
+   unsigned nr_color_tile_clear_streamed;  /**< clear-only tiles */
    unsigned nr_color_tile_load;
    unsigned nr_color_tile_store;
+
+   unsigned nr_flushes_avoided_rename;  /**< writes to renamed storage */
+   unsigned nr_flushes_avoided_region;  /**< writes outside drawn tiles */
 };
 
 
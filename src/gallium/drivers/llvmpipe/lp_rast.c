@@ -47,6 +47,10 @@
 #include "lp_scene.h"
 #include "lp_tex_sample.h"
 
+#if defined(PIPE_ARCH_SSE)
+#include <emmintrin.h>
+#endif
+
 
 #ifdef DEBUG
 int jit_line = 0;
@@ -81,6 +85,76 @@ lp_rast_end( struct lp_rasterizer *rast )
 }
 
 
+/**
+ * Copy the current tile of a framebuffer surface into a swizzled tile
+ * buffer, or back into the surface.
+ */
+static void
+swizzle_tile(uint8_t *tile_buf,
+             uint8_t *linear, unsigned stride, unsigned bytes,
+             unsigned width, unsigned height,
+             boolean store)
+{
+   unsigned x, y;
+
+   for (y = 0; y < height; y++) {
+      uint8_t *row = linear + y * stride;
+      uint8_t *block_row = tile_buf +
+                           lp_rast_swizzled_block_offset(0, y, bytes) +
+                           (y % 4) * 4 * bytes;
+
+      for (x = 0; x < width; x += 4) {
+         const unsigned size = MIN2(4, width - x) * bytes;
+
+         if (store)
+            memcpy(row + x * bytes, block_row + x * 4 * bytes, size);
+         else
+            memcpy(block_row + x * 4 * bytes, row + x * bytes, size);
+      }
+   }
+}
+
+
+/**
+ * Find the buffers which the bin clears completely before touching them
+ * otherwise, so their contents don't need to be loaded into the tile
+ * buffers.
+ */
+static void
+find_cleared_buffers(const struct lp_scene *scene,
+                     const struct cmd_bin *bin,
+                     unsigned *color_mask,
+                     boolean *depth)
+{
+   const struct cmd_block *block = bin->head;
+   unsigned k;
+
+   *color_mask = 0;
+   *depth = FALSE;
+
+   for (k = 0; k < block->count; k++) {
+      const union lp_rast_cmd_arg arg = block->arg[k];
+
+      switch (block->cmd[k]) {
+      case LP_RAST_OP_CLEAR_COLOR:
+         *color_mask |= 1 << arg.clear_rb->cbuf;
+         break;
+      case LP_RAST_OP_CLEAR_ZSTENCIL:
+         if (arg.clear_zstencil.mask ==
+             util_pack64_mask_z_stencil(scene->fb.zsbuf->format, ~0, 0xff))
+            *depth = TRUE;
+         break;
+      case LP_RAST_OP_BEGIN_QUERY:
+      case LP_RAST_OP_END_QUERY:
+      case LP_RAST_OP_SET_STATE:
+         break;
+      default:
+         return;
+      }
+   }
+}
+
+
 /**
  * Begining rasterization of a tile.
  * \param x  window X position of the tile, in pixels
@@ -106,6 +180,7 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
 
    task->thread_data.vis_counter = 0;
    task->ps_invocations = 0;
+   assert(!task->pending_clears);
 
    for (i = 0; i < task->scene->fb.nr_cbufs; i++) {
       if (task->scene->fb.cbufs[i]) {
@@ -119,29 +194,103 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
                          scene->zsbuf.stride * task->y +
                          scene->zsbuf.format_bytes * task->x;
    }
+
+   if (task->swizzled) {
+      unsigned cleared;
+      boolean depth_cleared;
+
+      find_cleared_buffers(scene, bin, &cleared, &depth_cleared);
+
+      task->color_tile_store = 0;
+      for (i = 0; i < scene->fb.nr_cbufs; i++) {
+         if (scene->fb.cbufs[i]) {
+            task->color_tile_store |= 1 << i;
+            if (!(cleared & (1 << i))) {
+               swizzle_tile(task->color_tile_buf[i], task->color_tiles[i],
+                            scene->cbufs[i].stride,
+                            scene->cbufs[i].format_bytes,
+                            task->width, task->height, FALSE);
+               LP_COUNT(nr_color_tile_load);
+            }
+         }
+      }
+      if (scene->fb.zsbuf && !depth_cleared) {
+         swizzle_tile(task->depth_tile_buf, task->depth_tile,
+                      scene->zsbuf.stride, scene->zsbuf.format_bytes,
+                      task->width, task->height, FALSE);
+      }
+   }
 }
 
 
+#if defined(PIPE_ARCH_SSE)
+
 /**
- * Clear the rasterizer's current color tile.
- * This is a bin command called during bin processing.
- * Clear commands always clear all bound layers.
+ * Fill the current tile of a color buffer with non-temporal stores.
+ * \return FALSE if the tile layout isn't suitable
+ */
+static boolean
+stream_fill_color_tile(struct lp_rasterizer_task *task,
+                       unsigned cbuf,
+                       const union util_color *uc)
+{
+   const struct lp_scene *scene = task->scene;
+   const unsigned bytes = scene->cbufs[cbuf].format_bytes;
+   const unsigned stride = scene->cbufs[cbuf].stride;
+   const unsigned layer_stride = scene->cbufs[cbuf].layer_stride;
+   const unsigned row_bytes = task->width * bytes;
+   uint8_t *dst_layer = task->color_tiles[cbuf];
+   uint8_t pattern[16];
+   __m128i value;
+   unsigned layer, i, j;
+
+   if ((bytes != 4 && bytes != 8 && bytes != 16) ||
+       row_bytes % 16 != 0 ||
+       ((uintptr_t) dst_layer | stride) % 16 != 0 ||
+       (scene->fb_max_layer && layer_stride % 16 != 0))
+      return FALSE;
+
+   for (i = 0; i < 16; i += bytes)
+      memcpy(pattern + i, uc, bytes);
+   value = _mm_loadu_si128((const __m128i *) pattern);
+
+   for (layer = 0; layer <= scene->fb_max_layer; layer++) {
+      uint8_t *dst = dst_layer;
+
+      for (i = 0; i < task->height; i++) {
+         for (j = 0; j < row_bytes; j += 16)
+            _mm_stream_si128((__m128i *) (dst + j), value);
+         dst += stride;
+      }
+      dst_layer += layer_stride;
+   }
+
+   /* order the stores before the scene is signalled as done */
+   _mm_sfence();
+
+   return TRUE;
+}
+
+#endif /* PIPE_ARCH_SSE */
+
+
+/**
+ * Fill the current tile of a color buffer with the clear value, in all
+ * bound layers.
+ * \param stream  nothing is going to touch the tile again in this scene
  */
 static void
-lp_rast_clear_color(struct lp_rasterizer_task *task,
-                    const union lp_rast_cmd_arg arg)
+clear_color_tile(struct lp_rasterizer_task *task,
+                 const struct lp_rast_clear_rb *clear_rb,
+                 boolean stream)
 {
    const struct lp_scene *scene = task->scene;
-   unsigned cbuf = arg.clear_rb->cbuf;
+   unsigned cbuf = clear_rb->cbuf;
    union util_color uc;
    enum pipe_format format;
 
-   /* we never bin clear commands for non-existing buffers */
-   assert(cbuf < scene->fb.nr_cbufs);
-   assert(scene->fb.cbufs[cbuf]);
-
    format = scene->fb.cbufs[cbuf]->format;
-   uc = arg.clear_rb->color_val;
+   uc = clear_rb->color_val;
 
    /*
     * this is pretty rough since we have target format (bunch of bytes...) here.
@@ -150,6 +299,28 @@ lp_rast_clear_color(struct lp_rasterizer_task *task,
    LP_DBG(DEBUG_RAST, "%s clear value (target format %d) raw 0x%x,0x%x,0x%x,0x%x\n",
           __FUNCTION__, format, uc.ui[0], uc.ui[1], uc.ui[2], uc.ui[3]);
 
+   /* this will increase for each rb which probably doesn't mean much */
+   LP_COUNT(nr_color_tile_clear);
+
+   if (task->swizzled) {
+      if (!stream) {
+         /* the order of the pixels doesn't matter */
+         util_fill_rect(task->color_tile_buf[cbuf], format,
+                        TILE_SIZE * scene->cbufs[cbuf].format_bytes,
+                        0, 0, TILE_SIZE, TILE_SIZE, &uc);
+         return;
+      }
+
+      /* write the framebuffer directly, the tile buffer is stale now */
+      task->color_tile_store &= ~(1 << cbuf);
+   }
+
+#if defined(PIPE_ARCH_SSE)
+   if (stream && stream_fill_color_tile(task, cbuf, &uc)) {
+      LP_COUNT(nr_color_tile_clear_streamed);
+      return;
+   }
+#endif
 
    util_fill_box(scene->cbufs[cbuf].map,
                  format,
@@ -162,9 +333,85 @@ lp_rast_clear_color(struct lp_rasterizer_task *task,
                  task->height,
                  scene->fb_max_layer + 1,
                  &uc);
+}
 
-   /* this will increase for each rb which probably doesn't mean much */
-   LP_COUNT(nr_color_tile_clear);
+
+/**
+ * Do the color clears of the current tile which were deferred by
+ * lp_rast_clear_color().
+ */
+static void
+do_pending_clears(struct lp_rasterizer_task *task, boolean stream)
+{
+   while (task->pending_clears) {
+      unsigned cbuf = u_bit_scan(&task->pending_clears);
+      clear_color_tile(task, task->pending_clear[cbuf], stream);
+   }
+}
+
+
+/**
+ * Called before each command of a bin while there are pending clears:
+ * do the clears if the command is going to touch the color tiles, or
+ * drop the ones it overwrites completely.
+ */
+static void
+resolve_pending_clears(struct lp_rasterizer_task *task,
+                       unsigned cmd,
+                       const union lp_rast_cmd_arg arg)
+{
+   switch (cmd) {
+   case LP_RAST_OP_CLEAR_COLOR:
+   case LP_RAST_OP_CLEAR_ZSTENCIL:
+   case LP_RAST_OP_BEGIN_QUERY:
+   case LP_RAST_OP_END_QUERY:
+   case LP_RAST_OP_SET_STATE:
+      return;
+   case LP_RAST_OP_SHADE_TILE_OPAQUE:
+      /*
+       * Opaque shading writes every pixel of the first color buffer, but
+       * only in one layer while clears cover all of them.
+       */
+      if ((task->pending_clears & 1) &&
+          !arg.shade_tile->disable &&
+          task->scene->fb_max_layer == 0) {
+         task->pending_clears &= ~1;
+         LP_COUNT(nr_color_tile_clear_elided);
+      }
+      break;
+   default:
+      break;
+   }
+
+   do_pending_clears(task, FALSE);
+}
+
+
+/**
+ * Clear the rasterizer's current color tile.
+ * This is a bin command called during bin processing.
+ * Clear commands always clear all bound layers.
+ * The clear is only recorded here, and done once something else is about
+ * to touch the tile (see resolve_pending_clears()), or at the end of the
+ * tile.  Clears which are overwritten before that are never done.
+ */
+static void
+lp_rast_clear_color(struct lp_rasterizer_task *task,
+                    const union lp_rast_cmd_arg arg)
+{
+   const struct lp_scene *scene = task->scene;
+   unsigned cbuf = arg.clear_rb->cbuf;
+
+   /* we never bin clear commands for non-existing buffers */
+   assert(cbuf < scene->fb.nr_cbufs);
+   assert(scene->fb.cbufs[cbuf]);
+   (void) scene;
+
+   if (task->pending_clears & (1 << cbuf))
+      LP_COUNT(nr_color_tile_clear_elided);
+
+   task->pending_clear[cbuf] = arg.clear_rb;
+   task->pending_clears |= 1 << cbuf;
 }
 
 
@@ -182,9 +429,9 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
    uint64_t clear_mask64 = arg.clear_zstencil.mask;
    uint32_t clear_value = (uint32_t) clear_value64;
    uint32_t clear_mask = (uint32_t) clear_mask64;
-   const unsigned height = task->height;
-   const unsigned width = task->width;
-   const unsigned dst_stride = scene->zsbuf.stride;
+   unsigned height = task->height;
+   unsigned width = task->width;
+   unsigned dst_stride = scene->zsbuf.stride;
    uint8_t *dst;
    unsigned i, j;
    unsigned block_size;
@@ -201,6 +448,13 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
       uint8_t *dst_layer = task->depth_tile;
       block_size = util_format_get_blocksize(scene->fb.zsbuf->format);
 
+      if (task->swizzled) {
+         /* the order of the pixels doesn't matter */
+         dst_layer = task->depth_tile_buf;
+         width = height = TILE_SIZE;
+         dst_stride = TILE_SIZE * block_size;
+      }
+
       clear_value &= clear_mask;
 
       for (layer = 0; layer <= scene->fb_max_layer; layer++) {
@@ -326,7 +580,7 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
          /* color buffer */
          for (i = 0; i < scene->fb.nr_cbufs; i++){
             if (scene->fb.cbufs[i]) {
-               stride[i] = scene->cbufs[i].stride;
+               stride[i] = task->color_stride[i];
                color[i] = lp_rast_get_color_block_pointer(task, i, tile_x + x,
                                                           tile_y + y, inputs->layer);
             }
@@ -340,7 +594,7 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
          if (scene->zsbuf.map) {
             depth = lp_rast_get_depth_block_pointer(task, tile_x + x,
                                                     tile_y + y, inputs->layer);
-            depth_stride = scene->zsbuf.stride;
+            depth_stride = task->depth_stride;
          }
 
          /* Propagate non-interpolated raster state. */
@@ -421,7 +675,7 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
    /* color buffer */
    for (i = 0; i < scene->fb.nr_cbufs; i++) {
       if (scene->fb.cbufs[i]) {
-         stride[i] = scene->cbufs[i].stride;
+         stride[i] = task->color_stride[i];
          color[i] = lp_rast_get_color_block_pointer(task, i, x, y,
                                                     inputs->layer);
       }
@@ -433,7 +687,7 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
 
    /* depth buffer */
    if (scene->zsbuf.map) {
-      depth_stride = scene->zsbuf.stride;
+      depth_stride = task->depth_stride;
       depth = lp_rast_get_depth_block_pointer(task, x, y, inputs->layer);
    }
 
@@ -547,6 +801,26 @@ lp_rast_tile_end(struct lp_rasterizer_task *task)
 {
    unsigned i;
 
+   /* nothing but clears have touched these color tiles */
+   do_pending_clears(task, TRUE);
+
+   if (task->swizzled) {
+      const struct lp_scene *scene = task->scene;
+
+      while (task->color_tile_store) {
+         i = u_bit_scan(&task->color_tile_store);
+         swizzle_tile(task->color_tile_buf[i], task->color_tiles[i],
+                      scene->cbufs[i].stride, scene->cbufs[i].format_bytes,
+                      task->width, task->height, TRUE);
+         LP_COUNT(nr_color_tile_store);
+      }
+      if (scene->fb.zsbuf) {
+         swizzle_tile(task->depth_tile_buf, task->depth_tile,
+                      scene->zsbuf.stride, scene->zsbuf.format_bytes,
+                      task->width, task->height, TRUE);
+      }
+   }
+
    for (i = 0; i < task->scene->num_active_queries; ++i) {
       lp_rast_end_query(task, lp_rast_arg_query(task->scene->active_queries[i]));
    }
@@ -605,6 +879,9 @@ do_rasterize_bin(struct lp_rasterizer_task *task,
 
    for (block = bin->head; block; block = block->next) {
       for (k = 0; k < block->count; k++) {
+         if (task->pending_clears)
+            resolve_pending_clears(task, block->cmd[k], block->arg[k]);
+
          dispatch[block->cmd[k]]( task, block->arg[k] );
       }
    }
@@ -654,6 +931,70 @@ is_empty_bin( const struct cmd_bin *bin )
 }
 
 
+/**
+ * Can the scene be shaded into swizzled tile buffers?  They only hold one
+ * layer, and the 4x4 blocks must have power of two row strides to keep
+ * the alignment the fragment shader expects.
+ */
+static boolean
+scene_can_use_tile_buffers(const struct lp_scene *scene)
+{
+   unsigned i;
+
+   if (scene->fb_max_layer)
+      return FALSE;
+
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      if (scene->fb.cbufs[i] &&
+          (!llvmpipe_resource_is_texture(scene->fb.cbufs[i]->texture) ||
+           !util_is_power_of_two(scene->cbufs[i].format_bytes)))
+         return FALSE;
+   }
+
+   if (scene->fb.zsbuf &&
+       !util_is_power_of_two(scene->zsbuf.format_bytes))
+      return FALSE;
+
+   return TRUE;
+}
+
+
+/**
+ * Decide whether the task shades into its swizzled tile buffers for this
+ * scene, allocating them on first use, and set up the row strides passed
+ * to the fragment shader accordingly.
+ */
+static void
+init_tile_buffers(struct lp_rasterizer_task *task)
+{
+   const struct lp_scene *scene = task->scene;
+   unsigned i;
+
+   task->swizzled = task->rast->tile_buffers &&
+                    scene_can_use_tile_buffers(scene);
+
+   for (i = 0; i < scene->fb.nr_cbufs && task->swizzled; i++) {
+      if (scene->fb.cbufs[i] && !task->color_tile_buf[i]) {
+         task->color_tile_buf[i] = align_malloc(LP_TILE_BUF_SIZE, 64);
+         task->swizzled = task->color_tile_buf[i] != NULL;
+      }
+   }
+   if (scene->fb.zsbuf && task->swizzled && !task->depth_tile_buf) {
+      task->depth_tile_buf = align_malloc(LP_TILE_BUF_SIZE, 64);
+      task->swizzled = task->depth_tile_buf != NULL;
+   }
+
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      task->color_stride[i] = task->swizzled ?
+                              4 * scene->cbufs[i].format_bytes :
+                              scene->cbufs[i].stride;
+   }
+   task->depth_stride = task->swizzled ?
+                        4 * scene->zsbuf.format_bytes :
+                        scene->zsbuf.stride;
+}
+
+
 /**
  * Rasterize/execute all bins within a scene.
  * Called per thread.
@@ -665,6 +1006,8 @@ rasterize_scene(struct lp_rasterizer_task *task,
    task->scene = scene;
 
    if (!task->rast->no_rast && !scene->discard) {
+      init_tile_buffers(task);
+
       /* loop over scene bins, rasterize each */
       {
          struct cmd_bin *bin;
@@ -875,6 +1218,7 @@ lp_rast_create( unsigned num_threads )
    rast->num_threads = num_threads;
 
    rast->no_rast = debug_get_bool_option("LP_NO_RAST", FALSE);
+   rast->tile_buffers = debug_get_bool_option("LP_TILE_BUFFERS", FALSE);
 
    create_rast_threads(rast);
 
@@ -924,6 +1268,15 @@ void lp_rast_destroy( struct lp_rasterizer *rast )
       pipe_semaphore_destroy(&rast->tasks[i].work_done);
    }
 
+   for (i = 0; i < Elements(rast->tasks); i++) {
+      struct lp_rasterizer_task *task = &rast->tasks[i];
+      unsigned j;
+
+      for (j = 0; j < PIPE_MAX_COLOR_BUFS; j++)
+         align_free(task->color_tile_buf[j]);
+      align_free(task->depth_tile_buf);
+   }
+
    /* for synchronizing rasterization threads */
    pipe_barrier_destroy( &rast->barrier );
 
@@ -63,6 +63,14 @@ struct cmd_bin;
 
 #define MAX_FIXED_LENGTH32 (1 << (((32/2) - 1) - FIXED_ORDER))
 
+/** Guard band, in pixels.
+ *  Window coordinates from the draw module are within +/-LP_GUARD_BAND.
+ *  Triangle setup shifts the fixed point edge deltas up by another
+ *  FIXED_ORDER bits into 32-bit ints, so deltas must stay below
+ *  2^(31 - 2*FIXED_ORDER) pixels; the margin leaves room for wide lines.
+ */
+#define LP_GUARD_BAND ((1 << ((31 - 2*FIXED_ORDER) - 1)) - 512)
+
 /* Rasterizer output size going to jit fs, width/height */
 #define LP_RASTER_BLOCK_SIZE 4
 
@@ -76,6 +76,9 @@ extern const struct lp_rasterizer_task *jit_task;
 struct lp_rasterizer;
 struct cmd_bin;
 
+/** Size of a swizzled tile buffer, enough for the widest pixel format */
+#define LP_TILE_BUF_SIZE (TILE_SIZE * TILE_SIZE * 16)
+
 /**
  * Per-thread rasterization state
  */
@@ -91,6 +94,23 @@ struct lp_rasterizer_task
    uint8_t *color_tiles[PIPE_MAX_COLOR_BUFS];
    uint8_t *depth_tile;
 
+   /**
+    * Row strides passed to the fragment shader: those of the framebuffer,
+    * or of a 4x4 block when shading into the swizzled tile buffers.
+    */
+   unsigned color_stride[PIPE_MAX_COLOR_BUFS];
+   unsigned depth_stride;
+
+   /** Shading into the buffers below, see lp_rasterizer::tile_buffers */
+   boolean swizzled;
+   uint8_t *color_tile_buf[PIPE_MAX_COLOR_BUFS];
+   uint8_t *depth_tile_buf;
+   unsigned color_tile_store;  /**< bitmask of tile buffers to write back */
+
+   /** Color clears of the current tile not done yet, see lp_rast_clear_color */
+   const struct lp_rast_clear_rb *pending_clear[PIPE_MAX_COLOR_BUFS];
+   unsigned pending_clears;  /**< bitmask of the above */
+
    /** "back" pointer */
    struct lp_rasterizer *rast;
 
@@ -117,6 +137,13 @@ struct lp_rasterizer
    boolean exit_flag;
    boolean no_rast;  /**< For debugging/profiling */
 
+   /**
+    * Shade into per-thread tile buffers where each 4x4 block is
+    * contiguous, copied from/to the framebuffer at the start/end of each
+    * tile (LP_TILE_BUFFERS).
+    */
+   boolean tile_buffers;
+
    /** The incoming queue of scenes ready to rasterize */
    struct lp_scene_queue *full_scenes;
 
@@ -141,6 +168,19 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
                          unsigned mask);
 
 
+/**
+ * Offset of a 4x4 block within a swizzled tile buffer: the blocks are
+ * stored one after the other in row-major order, and so are the pixels
+ * within each block.
+ * \param px, py  location of the 4x4 block within the tile
+ */
+static INLINE unsigned
+lp_rast_swizzled_block_offset(unsigned px, unsigned py, unsigned bytes)
+{
+   return ((py / 4) * (TILE_SIZE / 4) + px / 4) * 16 * bytes;
+}
+
+
 /**
  * Get the pointer to a 4x4 color block (within a 64x64 tile).
  * \param x, y location of 4x4 block in window coords
@@ -169,6 +209,13 @@ lp_rast_get_color_block_pointer(struct lp_rasterizer_task *task,
    px = x % TILE_SIZE;
    py = y % TILE_SIZE;
 
+   if (task->swizzled) {
+      assert(!layer);
+      return task->color_tile_buf[buf] +
+             lp_rast_swizzled_block_offset(px, py,
+                                           task->scene->cbufs[buf].format_bytes);
+   }
+
    pixel_offset = px * task->scene->cbufs[buf].format_bytes +
                   py * task->scene->cbufs[buf].stride;
    color = task->color_tiles[buf] + pixel_offset;
@@ -203,6 +250,13 @@ lp_rast_get_depth_block_pointer(struct lp_rasterizer_task *task,
    px = x % TILE_SIZE;
    py = y % TILE_SIZE;
 
+   if (task->swizzled) {
+      assert(!layer);
+      return task->depth_tile_buf +
+             lp_rast_swizzled_block_offset(px, py,
+                                           task->scene->zsbuf.format_bytes);
+   }
+
    pixel_offset = px * task->scene->zsbuf.format_bytes +
                   py * task->scene->zsbuf.stride;
    depth = task->depth_tile + pixel_offset;
@@ -239,7 +293,7 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
    /* color buffer */
    for (i = 0; i < scene->fb.nr_cbufs; i++) {
       if (scene->fb.cbufs[i]) {
-         stride[i] = scene->cbufs[i].stride;
+         stride[i] = task->color_stride[i];
          color[i] = lp_rast_get_color_block_pointer(task, i, x, y,
                                                     inputs->layer);
       }
@@ -251,7 +305,7 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
 
    if (scene->zsbuf.map) {
       depth = lp_rast_get_depth_block_pointer(task, x, y, inputs->layer);
-      depth_stride = scene->zsbuf.stride;
+      depth_stride = task->depth_stride;
    }
 
    /*
@@ -31,6 +31,7 @@
 #include "util/u_inlines.h"
 #include "util/simple_list.h"
 #include "util/u_format.h"
+#include "gallivm/lp_bld_format.h"
 #include "lp_scene.h"
 #include "lp_fence.h"
 #include "lp_debug.h"
@@ -46,6 +47,14 @@ struct resource_ref {
 };
 
 
+/** Storage which the scene may still read from, see llvmpipe_transfer_map */
+struct retired_storage {
+   void *data;
+   boolean compressed;    /**< may have decoded blocks in the texel cache */
+   struct retired_storage *next;
+};
+
+
 /**
  * Create a new scene object.
  * \param queue  the queue to put newly rendered/emptied scenes into
@@ -83,12 +92,35 @@ lp_scene_create( struct pipe_context *pipe )
 }
 
 
+/**
+ * Free the storage retired by lp_scene_retire_storage().
+ */
+static void
+free_retired_storage(struct lp_scene *scene)
+{
+   struct retired_storage *retired;
+   boolean compressed = FALSE;
+
+   for (retired = scene->retired; retired; retired = retired->next) {
+      align_free(retired->data);
+      compressed |= retired->compressed;
+   }
+
+   /* the memory may be reused for other compressed blocks */
+   if (compressed)
+      lp_format_cache_invalidate();
+
+   scene->retired = NULL;
+}
+
+
 /**
  * Free all data associated with the given scene, and the scene itself.
  */
 void
 lp_scene_destroy(struct lp_scene *scene)
 {
+   free_retired_storage(scene);
    lp_fence_reference(&scene->fence, NULL);
    pipe_mutex_destroy(scene->mutex);
    assert(scene->data.head->next == NULL);
@@ -274,6 +306,9 @@ lp_scene_end_rasterization(struct lp_scene *scene )
                       j, scene->resource_reference_size);
    }
 
+   /* The list nodes live in the data blocks freed below */
+   free_retired_storage(scene);
+
    /* Free all scene data blocks:
     */
    {
@@ -427,6 +462,49 @@ lp_scene_add_resource_reference(struct lp_scene *scene,
 }
 
 
+/**
+ * Keep the old storage of a renamed resource alive until the scene, which
+ * may still read from it, has been rasterized.  The storage must have been
+ * allocated with align_malloc().
+ *
+ * The scene only reads the old storage from now on, so the resource itself
+ * is dropped from the referenced resources until a later command binds its
+ * new storage.  Mapping it again before that needs neither a wait nor
+ * another rename.
+ */
+boolean
+lp_scene_retire_storage(struct lp_scene *scene,
+                        struct pipe_resource *resource,
+                        void *data)
+{
+   struct retired_storage *retired = lp_scene_alloc(scene, sizeof *retired);
+   struct resource_ref *ref;
+   int i;
+
+   if (!retired)
+      return FALSE;
+
+   retired->data = data;
+   retired->compressed = util_format_is_compressed(resource->format);
+   retired->next = scene->retired;
+   scene->retired = retired;
+
+   for (ref = scene->resources; ref; ref = ref->next) {
+      for (i = 0; i < ref->count; i++) {
+         if (ref->resource[i] == resource) {
+            scene->resource_reference_size -= llvmpipe_resource_size(resource);
+            pipe_resource_reference(&ref->resource[i], NULL);
+            ref->resource[i] = ref->resource[--ref->count];
+            ref->resource[ref->count] = NULL;
+            return TRUE;
+         }
+      }
+   }
+
+   return TRUE;
+}
+
+
 /**
  * Does this scene have a reference to the given resource?
  */
@@ -523,6 +601,11 @@ void lp_scene_begin_binning( struct lp_scene *scene,
    assert(scene->tiles_x <= TILES_X);
    assert(scene->tiles_y <= TILES_Y);
 
+   scene->binned.x0 = scene->tiles_x;
+   scene->binned.y0 = scene->tiles_y;
+   scene->binned.x1 = -1;
+   scene->binned.y1 = -1;
+
    /*
     * Determine how many layers the fb has (used for clamping layer value).
     * OpenGL (but not d3d10) permits different amount of layers per rt, however
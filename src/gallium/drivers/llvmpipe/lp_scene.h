@@ -36,6 +36,7 @@
 #define LP_SCENE_H
 
 #include "os/os_thread.h"
+#include "util/u_rect.h"
 #include "lp_rast.h"
 #include "lp_debug.h"
 
@@ -116,6 +117,7 @@ struct data_block_list {
 };
 
 struct resource_ref;
+struct retired_storage;
 
 /**
  * All bins and bin data are contained here.
@@ -154,6 +156,9 @@ struct lp_scene {
    /** list of resources referenced by the scene commands */
    struct resource_ref *resources;
 
+   /** storage of renamed resources, freed once the scene is rasterized */
+   struct retired_storage *retired;
+
    /** Total memory used by the scene (in bytes).  This sums all the
     * data blocks and counts all bins, state, resource references and
     * other random allocations within the scene.
@@ -173,6 +178,9 @@ struct lp_scene {
     */
    unsigned tiles_x, tiles_y;
 
+   /** Bounds of the bins which have commands, in tiles (may be empty) */
+   struct u_rect binned;
+
    int curr_x, curr_y;  /**< for iterating over bins */
    pipe_mutex mutex;
 
@@ -202,6 +210,10 @@ boolean lp_scene_add_resource_reference(struct lp_scene *scene,
 boolean lp_scene_is_resource_referenced(const struct lp_scene *scene,
                                         const struct pipe_resource *resource );
 
+boolean lp_scene_retire_storage(struct lp_scene *scene,
+                                struct pipe_resource *resource,
+                                void *data);
+
 
 /**
  * Allocate space for a command/data in the bin's data buffer.
@@ -310,6 +322,14 @@ lp_scene_bin_command( struct lp_scene *scene,
    assert(cmd < LP_RAST_OP_MAX);
 
    if (tail == NULL || tail->count == CMD_BLOCK_MAX) {
+      if (tail == NULL) {
+         /* first command in this bin */
+         scene->binned.x0 = MIN2(scene->binned.x0, (int) x);
+         scene->binned.y0 = MIN2(scene->binned.y0, (int) y);
+         scene->binned.x1 = MAX2(scene->binned.x1, (int) x);
+         scene->binned.y1 = MAX2(scene->binned.y1, (int) y);
+      }
+
       tail = lp_scene_new_cmd_block( scene, bin );
       if (!tail) {
          return FALSE;
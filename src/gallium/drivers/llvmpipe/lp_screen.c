@@ -81,6 +81,7 @@ static const struct debug_named_value lp_perf_flags[] = {
    { "no_blend",       PERF_NO_BLEND, NULL },
    { "no_depth",       PERF_NO_DEPTH, NULL },
    { "no_alphatest",   PERF_NO_ALPHATEST, NULL },
+   { "no_guard_band",  PERF_NO_GUARD_BAND, NULL },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -350,9 +351,10 @@ llvmpipe_get_paramf(struct pipe_screen *screen, enum pipe_capf param)
       return 16.0; /* arbitrary */
    case PIPE_CAPF_GUARD_BAND_LEFT:
    case PIPE_CAPF_GUARD_BAND_TOP:
+      return (LP_PERF & PERF_NO_GUARD_BAND) ? 0.0 : -LP_GUARD_BAND;
    case PIPE_CAPF_GUARD_BAND_RIGHT:
    case PIPE_CAPF_GUARD_BAND_BOTTOM:
-      return 0.0;
+      return (LP_PERF & PERF_NO_GUARD_BAND) ? 0.0 : LP_GUARD_BAND;
    }
    /* should only get here on unhandled cases */
    debug_printf("Unexpected PIPE_CAP %d query\n", param);
@@ -503,6 +505,7 @@ llvmpipe_destroy_screen( struct pipe_screen *_screen )
    if(winsys->destroy)
       winsys->destroy(winsys);
 
+   pipe_condvar_destroy(screen->rast_cond);
    pipe_mutex_destroy(screen->rast_mutex);
 
    FREE(screen);
@@ -620,6 +623,7 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
       return NULL;
    }
    pipe_mutex_init(screen->rast_mutex);
+   pipe_condvar_init(screen->rast_cond);
 
    util_format_s3tc_init();
 
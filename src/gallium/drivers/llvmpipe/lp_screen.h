@@ -57,6 +57,19 @@ struct llvmpipe_screen
 
    struct lp_rasterizer *rast;
    pipe_mutex rast_mutex;
+
+   /* The rasterizer is handed to contexts in FIFO order, so that one busy
+    * context can't starve the others sharing the screen.
+    */
+   pipe_condvar rast_cond;
+   unsigned rast_next_ticket;
+   unsigned rast_now_serving;
+
+   /* Number of contexts created on this screen (atomic).  Resources are
+    * only renamed while there is a single context, since the scenes of
+    * other contexts may read from the old storage too.
+    */
+   int32_t num_contexts;
 };
 
 
@@ -146,6 +146,35 @@ void lp_setup_reset( struct lp_setup_context *setup )
 }
 
 
+/**
+ * Wait for our turn on the rasterizer shared by all contexts of the
+ * screen.  Unlike a plain mutex this serves contexts in the order they
+ * asked, so with many contexts flushing at once none of them can take
+ * the rasterizer over repeatedly.
+ */
+static void
+lp_setup_acquire_rasterizer( struct llvmpipe_screen *screen )
+{
+   unsigned ticket;
+
+   pipe_mutex_lock(screen->rast_mutex);
+   ticket = screen->rast_next_ticket++;
+   while (ticket != screen->rast_now_serving)
+      pipe_condvar_wait(screen->rast_cond, screen->rast_mutex);
+   pipe_mutex_unlock(screen->rast_mutex);
+}
+
+
+static void
+lp_setup_release_rasterizer( struct llvmpipe_screen *screen )
+{
+   pipe_mutex_lock(screen->rast_mutex);
+   screen->rast_now_serving++;
+   pipe_condvar_broadcast(screen->rast_cond);
+   pipe_mutex_unlock(screen->rast_mutex);
+}
+
+
 /** Rasterize all scene's bins */
 static void
 lp_setup_rasterize_scene( struct lp_setup_context *setup )
@@ -164,7 +193,7 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
    if (setup->last_fence)
       setup->last_fence->issued = TRUE;
 
-   pipe_mutex_lock(screen->rast_mutex);
+   lp_setup_acquire_rasterizer(screen);
 
    /* FIXME: We enqueue the scene then wait on the rasterizer to finish.
     * This means we never actually run any vertex stuff in parallel to
@@ -178,7 +207,7 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
     */
    lp_rast_queue_scene(screen->rast, scene);
    lp_rast_finish(screen->rast);
-   pipe_mutex_unlock(screen->rast_mutex);
+   lp_setup_release_rasterizer(screen);
 
    lp_scene_end_rasterization(setup->scene);
    lp_setup_reset( setup );
@@ -579,9 +608,14 @@ lp_setup_set_triangle_state( struct lp_setup_context *setup,
    setup->ccw_is_frontface = ccw_is_frontface;
    setup->cullmode = cull_mode;
    setup->triangle = first_triangle;
-   setup->pixel_offset = half_pixel_center ? 0.5f : 0.0f;
    setup->bottom_edge_rule = bottom_edge_rule;
 
+   if (setup->pixel_offset != (half_pixel_center ? 0.5f : 0.0f)) {
+      setup->pixel_offset = half_pixel_center ? 0.5f : 0.0f;
+      if (setup->viewport_clip)
+         setup->dirty |= LP_SETUP_NEW_SCISSOR;
+   }
+
    if (setup->scissor_test != scissor) {
       setup->dirty |= LP_SETUP_NEW_SCISSOR;
       setup->scissor_test = scissor;
@@ -761,8 +795,22 @@ lp_setup_set_viewports(struct lp_setup_context *setup,
     * For use in lp_state_fs.c, propagate the viewport values for all viewports.
     */
    for (i = 0; i < num_viewports; i++) {
+      const float *scale = viewports[i].scale;
+      const float *translate = viewports[i].translate;
       float min_depth;
       float max_depth;
+      float bounds[4];
+
+      bounds[0] = translate[0] - fabsf(scale[0]);
+      bounds[1] = translate[1] - fabsf(scale[1]);
+      bounds[2] = translate[0] + fabsf(scale[0]);
+      bounds[3] = translate[1] + fabsf(scale[1]);
+
+      if (memcmp(setup->viewport_bounds[i], bounds, sizeof bounds) != 0) {
+         memcpy(setup->viewport_bounds[i], bounds, sizeof bounds);
+         if (setup->viewport_clip)
+            setup->dirty |= LP_SETUP_NEW_SCISSOR;
+      }
 
       if (lp->rasterizer->clip_halfz == 0) {
          float half_depth = viewports[i].scale[2];
@@ -783,6 +831,23 @@ lp_setup_set_viewports(struct lp_setup_context *setup,
 }
 
 
+/**
+ * Whether triangles have to be scissored to the viewports, because draw
+ * only clips them to the guard band.
+ */
+void
+lp_setup_set_viewport_clip(struct lp_setup_context *setup,
+                           boolean viewport_clip)
+{
+   LP_DBG(DEBUG_SETUP, "%s %d\n", __FUNCTION__, viewport_clip);
+
+   if (setup->viewport_clip != viewport_clip) {
+      setup->viewport_clip = viewport_clip;
+      setup->dirty |= LP_SETUP_NEW_SCISSOR;
+   }
+}
+
+
 /**
  * Called during state validation when LP_NEW_SAMPLER_VIEW is set.
  */
@@ -954,36 +1019,101 @@ lp_setup_set_fragment_sampler_state(struct lp_setup_context *setup,
 
 
 /**
- * Is the given texture referenced by any scene?
- * Note: we have to check all scenes including any scenes currently
- * being rendered and the current scene being built.
+ * Does the scene being built write to the given region of a render target
+ * surface?  Clears which are still pending cover the whole surface,
+ * otherwise only the bins which have commands are rasterized.
+ */
+static boolean
+surface_region_referenced(const struct lp_setup_context *setup,
+                          const struct pipe_surface *surf,
+                          unsigned clear_flags,
+                          unsigned level,
+                          const struct pipe_box *box)
+{
+   const struct u_rect *binned = &setup->scene->binned;
+
+   if (!box || !llvmpipe_resource_is_texture(surf->texture))
+      return TRUE;
+
+   if (surf->u.tex.level != level ||
+       box->z > (int) surf->u.tex.last_layer ||
+       box->z + box->depth <= (int) surf->u.tex.first_layer)
+      return FALSE;
+
+   if (setup->clear.flags & clear_flags)
+      return TRUE;
+
+   return box->x < (binned->x1 + 1) * TILE_SIZE &&
+          box->x + box->width > binned->x0 * TILE_SIZE &&
+          box->y < (binned->y1 + 1) * TILE_SIZE &&
+          box->y + box->height > binned->y0 * TILE_SIZE;
+}
+
+
+/**
+ * Is the given region of a texture referenced by the scene being built?
+ * Scenes are rasterized to completion when they are flushed, so there is
+ * nothing outstanding unless a scene is being built.
+ * A NULL box stands for the whole resource.
  */
 unsigned
-lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
-                                const struct pipe_resource *texture )
+lp_setup_is_resource_region_referenced(const struct lp_setup_context *setup,
+                                       const struct pipe_resource *texture,
+                                       unsigned level,
+                                       const struct pipe_box *box)
 {
    unsigned i;
 
+   if (!setup->scene)
+      return LP_UNREFERENCED;
+
    /* check the render targets */
    for (i = 0; i < setup->fb.nr_cbufs; i++) {
-      if (setup->fb.cbufs[i] && setup->fb.cbufs[i]->texture == texture)
+      const struct pipe_surface *cbuf = setup->fb.cbufs[i];
+      if (cbuf && cbuf->texture == texture &&
+          surface_region_referenced(setup, cbuf, PIPE_CLEAR_COLOR0 << i,
+                                    level, box))
          return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
    }
-   if (setup->fb.zsbuf && setup->fb.zsbuf->texture == texture) {
+   if (setup->fb.zsbuf && setup->fb.zsbuf->texture == texture &&
+       surface_region_referenced(setup, setup->fb.zsbuf,
+                                 PIPE_CLEAR_DEPTHSTENCIL, level, box)) {
       return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
    }
 
    /* check textures referenced by the scene */
-   for (i = 0; i < Elements(setup->scenes); i++) {
-      if (lp_scene_is_resource_referenced(setup->scenes[i], texture)) {
-         return LP_REFERENCED_FOR_READ;
-      }
-   }
+   if (lp_scene_is_resource_referenced(setup->scene, texture))
+      return LP_REFERENCED_FOR_READ;
 
    return LP_UNREFERENCED;
 }
 
 
+/**
+ * Is the given texture referenced by any scene?
+ */
+unsigned
+lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
+                                const struct pipe_resource *texture )
+{
+   return lp_setup_is_resource_region_referenced(setup, texture, 0, NULL);
+}
+
+
+/**
+ * Keep the old storage of a resource which the scene being built reads
+ * from alive until the scene has been rasterized.
+ */
+boolean
+lp_setup_retire_storage(struct lp_setup_context *setup,
+                        struct pipe_resource *resource,
+                        void *data)
+{
+   assert(setup->scene);
+   return lp_scene_retire_storage(setup->scene, resource, data);
+}
+
+
 /**
  * Called by vbuf code when we're about to draw something.
  *
@@ -1163,11 +1293,37 @@ try_update_scene_state( struct lp_setup_context *setup )
    if (setup->dirty & LP_SETUP_NEW_SCISSOR) {
       unsigned i;
       for (i = 0; i < PIPE_MAX_VIEWPORTS; ++i) {
+         struct u_rect *clip = &setup->clip_rects[i];
+
          setup->draw_regions[i] = setup->framebuffer;
          if (setup->scissor_test) {
             u_rect_possible_intersection(&setup->scissors[i],
                                          &setup->draw_regions[i]);
          }
+
+         /*
+          * Triangles are clipped to the guard band only, so they also need
+          * to be scissored to the pixels whose centers are inside the
+          * viewport.  The result may be empty, in which case the scissor
+          * planes reject everything.
+          */
+         *clip = setup->framebuffer;
+         if (setup->scissor_test) {
+            clip->x0 = MAX2(clip->x0, setup->scissors[i].x0);
+            clip->x1 = MIN2(clip->x1, setup->scissors[i].x1);
+            clip->y0 = MAX2(clip->y0, setup->scissors[i].y0);
+            clip->y1 = MIN2(clip->y1, setup->scissors[i].y1);
+         }
+         if (setup->viewport_clip) {
+            const float *bounds = setup->viewport_bounds[i];
+            const float offset = setup->pixel_offset;
+            const float gb = (float) LP_GUARD_BAND;
+
+            clip->x0 = MAX2(clip->x0, (int) ceilf(CLAMP(bounds[0] - offset, -gb, gb)));
+            clip->y0 = MAX2(clip->y0, (int) ceilf(CLAMP(bounds[1] - offset, -gb, gb)));
+            clip->x1 = MIN2(clip->x1, (int) ceilf(CLAMP(bounds[2] - offset, -gb, gb)) - 1);
+            clip->y1 = MIN2(clip->y1, (int) ceilf(CLAMP(bounds[3] - offset, -gb, gb)) - 1);
+         }
       }
    }
 
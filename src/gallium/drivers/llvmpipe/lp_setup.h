@@ -35,6 +35,7 @@ struct vertex_info;
 
 
 struct pipe_resource;
+struct pipe_box;
 struct pipe_query;
 struct pipe_surface;
 struct pipe_blend_color;
@@ -125,6 +126,10 @@ lp_setup_set_viewports(struct lp_setup_context *setup,
                        unsigned num_viewports,
                        const struct pipe_viewport_state *viewports);
 
+void
+lp_setup_set_viewport_clip(struct lp_setup_context *setup,
+                           boolean viewport_clip);
+
 void
 lp_setup_set_fragment_sampler_views(struct lp_setup_context *setup,
                                     unsigned num,
@@ -139,6 +144,17 @@ unsigned
 lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
                                 const struct pipe_resource *texture );
 
+unsigned
+lp_setup_is_resource_region_referenced(const struct lp_setup_context *setup,
+                                       const struct pipe_resource *texture,
+                                       unsigned level,
+                                       const struct pipe_box *box);
+
+boolean
+lp_setup_retire_storage(struct lp_setup_context *setup,
+                        struct pipe_resource *resource,
+                        void *data);
+
 void
 lp_setup_set_flatshade_first( struct lp_setup_context *setup, 
                               boolean flatshade_first );
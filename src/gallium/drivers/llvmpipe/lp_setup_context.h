@@ -98,6 +98,7 @@ struct lp_setup_context
    boolean flatshade_first;
    boolean ccw_is_frontface;
    boolean scissor_test;
+   boolean viewport_clip;   /**< scissor triangles to the viewports */
    boolean point_size_per_vertex;
    boolean rasterizer_discard;
    unsigned cullmode;
@@ -114,6 +115,8 @@ struct lp_setup_context
    struct u_rect framebuffer;
    struct u_rect scissors[PIPE_MAX_VIEWPORTS];
    struct u_rect draw_regions[PIPE_MAX_VIEWPORTS];   /* intersection of fb & scissor */
+   struct u_rect clip_rects[PIPE_MAX_VIEWPORTS];     /* draw_regions & viewport, may be empty */
+   float viewport_bounds[PIPE_MAX_VIEWPORTS][4];     /* xmin, ymin, xmax, ymax */
    struct lp_jit_viewport viewports[PIPE_MAX_VIEWPORTS];
 
    struct {
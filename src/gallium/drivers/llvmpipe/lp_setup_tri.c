@@ -283,16 +283,12 @@ do_triangle_ccw(struct lp_setup_context *setup,
    if (0)
       lp_setup_print_triangle(setup, v0, v1, v2);
 
-   if (setup->scissor_test) {
-      nr_planes = 7;
+   if (setup->scissor_test || setup->viewport_clip) {
       if (setup->viewport_index_slot > 0) {
          unsigned *udata = (unsigned*)v0[setup->viewport_index_slot];
          viewport_index = lp_clamp_viewport_idx(*udata);
       }
    }
-   else {
-      nr_planes = 3;
-   }
    if (setup->layer_slot > 0) {
       layer = *(unsigned*)v1[setup->layer_slot];
       layer = MIN2(layer, scene->fb_max_layer);
@@ -323,18 +319,21 @@ do_triangle_ccw(struct lp_setup_context *setup,
       return TRUE;
    }
 
-   if (!u_rect_test_intersection(&setup->draw_regions[viewport_index], &bbox)) {
+   if (!u_rect_test_intersection(&setup->draw_regions[viewport_index], &bbox) ||
+       (setup->viewport_clip &&
+        !u_rect_test_intersection(&setup->clip_rects[viewport_index], &bbox))) {
       if (0) debug_printf("offscreen\n");
       LP_COUNT(nr_culled_tris);
       return TRUE;
    }
 
-   /* Can safely discard negative regions, but need to keep hold of
-    * information about when the triangle extends past screen
-    * boundaries.  See trimmed_box in lp_setup_bin_triangle().
+   /* Only need the scissor planes if the triangle isn't entirely inside
+    * the scissor rect and viewport.
     */
-   bbox.x0 = MAX2(bbox.x0, 0);
-   bbox.y0 = MAX2(bbox.y0, 0);
+   if ((setup->scissor_test || setup->viewport_clip) &&
+       !u_rect_contains(&setup->clip_rects[viewport_index], &bbox)) {
+      nr_planes = 7;
+   }
 
    tri = lp_setup_alloc_triangle(scene,
                                  key->num_inputs,
@@ -379,8 +378,13 @@ do_triangle_ccw(struct lp_setup_context *setup,
    plane = GET_PLANES(tri);
 
 #if defined(PIPE_ARCH_SSE)
+   /* The edge constants are computed with 32 bit multiplies, so the
+    * vertices must be close to the origin.
+    */
    if (setup->fb.width <= MAX_FIXED_LENGTH32 &&
        setup->fb.height <= MAX_FIXED_LENGTH32 &&
+       bbox.x0 >= 0 &&
+       bbox.y0 >= 0 &&
        (bbox.x1 - bbox.x0) <= MAX_FIXED_LENGTH32 &&
        (bbox.y1 - bbox.y0) <= MAX_FIXED_LENGTH32) {
       __m128i vertx, verty;
@@ -531,8 +535,8 @@ do_triangle_ccw(struct lp_setup_context *setup,
 
    /* 
     * When rasterizing scissored tris, use the intersection of the
-    * triangle bounding box and the scissor rect to generate the
-    * scissor planes.
+    * framebuffer, the scissor rect and (with the guard band) the viewport
+    * to generate the scissor planes.
     *
     * This permits us to cut off the triangle "tails" that are present
     * in the intermediate recursive levels caused when two of the
@@ -548,7 +552,7 @@ do_triangle_ccw(struct lp_setup_context *setup,
     * these planes elsewhere.
     */
    if (nr_planes == 7) {
-      const struct u_rect *scissor = &setup->scissors[viewport_index];
+      const struct u_rect *scissor = &setup->clip_rects[viewport_index];
 
       plane[3].dcdx = -1;
       plane[3].dcdy = 0;
@@ -609,20 +613,39 @@ lp_setup_bin_triangle( struct lp_setup_context *setup,
                        unsigned viewport_index )
 {
    struct lp_scene *scene = setup->scene;
-   struct u_rect trimmed_box = *bbox;   
-   int i;
+   struct u_rect box, trimmed_box;
+   int i, dx, max_sz, sz;
+   boolean use_32bits;
+
+   /* The 32 bit rasterizer works with edge values relative to the tile,
+    * which only fit if the whole triangle is small, not just the part of
+    * it on screen.
+    */
+   use_32bits = (bbox->x1 - (bbox->x0 & ~3)) <= MAX_FIXED_LENGTH32 &&
+                (bbox->y1 - (bbox->y0 & ~3)) <= MAX_FIXED_LENGTH32;
+
+   /* Can safely discard negative regions, but need to keep hold of
+    * information about when the triangle extends past screen
+    * boundaries.  See trimmed_box below.
+    */
+   box = *bbox;
+   box.x0 = MAX2(box.x0, 0);
+   box.y0 = MAX2(box.y0, 0);
+   bbox = &box;
+   trimmed_box = box;
+
    /* What is the largest power-of-two boundary this triangle crosses:
     */
-   int dx = floor_pot((bbox->x0 ^ bbox->x1) |
-		      (bbox->y0 ^ bbox->y1));
+   dx = floor_pot((bbox->x0 ^ bbox->x1) |
+                  (bbox->y0 ^ bbox->y1));
 
    /* The largest dimension of the rasterized area of the triangle
     * (aligned to a 4x4 grid), rounded down to the nearest power of two:
     */
-   int max_sz = ((bbox->x1 - (bbox->x0 & ~3)) |
-                 (bbox->y1 - (bbox->y0 & ~3)));
-   int sz = floor_pot(max_sz);
-   boolean use_32bits = max_sz <= MAX_FIXED_LENGTH32;
+   max_sz = ((bbox->x1 - (bbox->x0 & ~3)) |
+             (bbox->y1 - (bbox->y0 & ~3)));
+   sz = floor_pot(max_sz);
+   use_32bits = use_32bits && max_sz <= MAX_FIXED_LENGTH32;
 
    /* Now apply scissor, etc to the bounding box.  Could do this
     * earlier, but it confuses the logic for tri-16 and would force
@@ -28,6 +28,9 @@
 /* Authors:  Keith Whitwell <keithw@vmware.com>
  */
 #include "lp_context.h"
+#include "lp_debug.h"
+#include "lp_rast.h"
+#include "lp_setup.h"
 #include "lp_state.h"
 #include "draw/draw_context.h"
 
@@ -95,6 +98,36 @@ llvmpipe_set_polygon_stipple(struct pipe_context *pipe,
 
 
 
+/**
+ * Let draw only clip the triangles which leave the guard band, and have
+ * setup scissor them to the viewports instead.
+ *
+ * Window space positions aren't clipped at all.  Smooth lines and points
+ * are turned into triangles by draw, and their edges may extend past the
+ * viewport.
+ */
+void
+llvmpipe_update_guard_band(struct llvmpipe_context *llvmpipe)
+{
+   const struct pipe_rasterizer_state *rast = llvmpipe->rasterizer;
+   boolean guard_band = !(LP_PERF & PERF_NO_GUARD_BAND);
+
+   if (rast && (rast->line_smooth || rast->point_smooth))
+      guard_band = FALSE;
+
+   if (draw_is_vs_window_space(llvmpipe->draw))
+      guard_band = FALSE;
+
+   if (llvmpipe->guard_band != guard_band) {
+      const float size = guard_band ? LP_GUARD_BAND : 0.0f;
+
+      llvmpipe->guard_band = guard_band;
+      draw_set_guard_band(llvmpipe->draw, size, size);
+      lp_setup_set_viewport_clip(llvmpipe->setup, guard_band);
+   }
+}
+
+
 void
 llvmpipe_init_clip_funcs(struct llvmpipe_context *llvmpipe)
 {
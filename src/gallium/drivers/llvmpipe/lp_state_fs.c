@@ -2540,7 +2540,8 @@ lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant)
 static struct lp_fragment_shader_variant *
 generate_variant(struct llvmpipe_context *lp,
                  struct lp_fragment_shader *shader,
-                 const struct lp_fragment_shader_variant_key *key)
+                 const struct lp_fragment_shader_variant_key *key,
+                 boolean optimize)
 {
    struct lp_fragment_shader_variant *variant;
    const struct util_format_description *cbuf0_format_desc;
@@ -2560,6 +2561,13 @@ generate_variant(struct llvmpipe_context *lp,
       return NULL;
    }
 
+   if (optimize) {
+      variant->gallivm->opt_level = GALLIVM_OPT_FULL;
+   }
+   else if (gallivm_opt_tiered()) {
+      variant->fast_compiled = TRUE;
+   }
+
    variant->shader = shader;
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
@@ -2751,12 +2759,13 @@ llvmpipe_bind_fs_state(struct pipe_context *pipe, void *fs)
 
 
 /**
- * Remove shader variant from two lists: the shader's variant list
- * and the context's variant list.
+ * Take the variant off the shader's and the context's lists and out of
+ * the variant cache, without freeing it.
  */
-void
-llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
-                               struct lp_fragment_shader_variant *variant)
+static void
+unlink_shader_variant(struct llvmpipe_context *lp,
+                      struct lp_fragment_shader_variant *variant,
+                      boolean evicted)
 {
    if (gallivm_debug & GALLIVM_DEBUG_IR) {
       debug_printf("llvmpipe: del fs #%u var #%u v created #%u v cached"
@@ -2765,10 +2774,11 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                    variant->no,
                    variant->shader->variants_created,
                    variant->shader->variants_cached,
-                   lp->nr_fs_variants);
+                   lp->fs_variant_cache.nr_variants);
    }
 
-   gallivm_destroy(variant->gallivm);
+   if (lp->fs_variant == variant)
+      lp->fs_variant = NULL;
 
    /* remove from shader's list */
    remove_from_list(&variant->list_item_local);
@@ -2776,13 +2786,48 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
 
    /* remove from context's list */
    remove_from_list(&variant->list_item_global);
-   lp->nr_fs_variants--;
+   lp_variant_cache_remove(&lp->fs_variant_cache, &variant->shader->stats,
+                           &variant->info, evicted);
    lp->nr_fs_instrs -= variant->nr_instrs;
+}
 
+
+/**
+ * Remove shader variant from two lists: the shader's variant list
+ * and the context's variant list.
+ * \param evicted  whether it's removed to make room for other variants
+ */
+void
+llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
+                               struct lp_fragment_shader_variant *variant,
+                               boolean evicted)
+{
+   unlink_shader_variant(lp, variant, evicted);
+
+   gallivm_destroy(variant->gallivm);
    FREE(variant);
 }
 
 
+/**
+ * Free the variants retired by llvmpipe_fs_variant_drawn().  Must only be
+ * called when no scene is being built or rasterized.
+ */
+void
+llvmpipe_free_retired_fs_variants(struct llvmpipe_context *lp)
+{
+   struct lp_fs_variant_list_item *li, *next;
+
+   foreach_s(li, next, &lp->fs_variants_retired) {
+      struct lp_fragment_shader_variant *variant = li->base;
+
+      remove_from_list(li);
+      gallivm_destroy(variant->gallivm);
+      FREE(variant);
+   }
+}
+
+
 static void
 llvmpipe_delete_fs_state(struct pipe_context *pipe, void *fs)
 {
@@ -2803,10 +2848,16 @@ llvmpipe_delete_fs_state(struct pipe_context *pipe, void *fs)
    li = first_elem(&shader->variants);
    while(!at_end(&shader->variants, li)) {
       struct lp_fs_variant_list_item *next = next_elem(li);
-      llvmpipe_remove_shader_variant(llvmpipe, li->base);
+      llvmpipe_remove_shader_variant(llvmpipe, li->base, FALSE);
       li = next;
    }
 
+   if (lp_variant_stats_enabled()) {
+      char name[32];
+      util_snprintf(name, sizeof name, "llvmpipe fs #%u", shader->no);
+      lp_variant_stats_dump(name, &shader->stats);
+   }
+
    /* Delete draw module's data */
    draw_delete_fragment_shader(llvmpipe->draw, shader->draw_data);
 
@@ -3055,6 +3106,8 @@ make_variant_key(struct llvmpipe_context *lp,
          if(shader->info.base.file_mask[TGSI_FILE_SAMPLER_VIEW] & (1 << i)) {
             lp_sampler_static_texture_state(&key->state[i].texture_state,
                                             lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
+            /* lp_texture.c invalidates the texel cache */
+            key->state[i].texture_state.texel_cache = 1;
          }
       }
    }
@@ -3064,6 +3117,8 @@ make_variant_key(struct llvmpipe_context *lp,
          if(shader->info.base.file_mask[TGSI_FILE_SAMPLER] & (1 << i)) {
             lp_sampler_static_texture_state(&key->state[i].texture_state,
                                             lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
+            /* lp_texture.c invalidates the texel cache */
+            key->state[i].texture_state.texel_cache = 1;
          }
       }
    }
@@ -3096,30 +3151,32 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
    }
 
    if (variant) {
-      /* Move this variant to the head of the list to implement LRU
-       * deletion of shader's when we have too many.
+      /* Move this variant to the head of the list, so that variants of
+       * the same priority are evicted in LRU order.
        */
       move_to_head(&lp->fs_variants_list, &variant->list_item_global);
+      lp_variant_cache_hit(&lp->fs_variant_cache, &shader->stats,
+                           &variant->info);
    }
    else {
       /* variant not found, create it now */
+      struct lp_variant_cache *cache = &lp->fs_variant_cache;
       int64_t t0, t1, dt;
-      unsigned i;
-      unsigned variants_to_cull;
+
+      lp_variant_cache_miss(cache, &shader->stats);
 
       if (0) {
          debug_printf("%u variants,\t%u instrs,\t%u instrs/variant\n",
-                      lp->nr_fs_variants,
+                      cache->nr_variants,
                       lp->nr_fs_instrs,
-                      lp->nr_fs_variants ? lp->nr_fs_instrs / lp->nr_fs_variants : 0);
+                      cache->nr_variants ? lp->nr_fs_instrs / cache->nr_variants : 0);
       }
 
-      /* First, check if we've exceeded the max number of shader variants.
-       * If so, free 25% of them (the least recently used ones).
+      /* First, check if we've exceeded the max number or size of shader
+       * variants.  If so, evict the lowest priority ones until we're at
+       * 3/4 of the limits.
        */
-      variants_to_cull = lp->nr_fs_variants >= LP_MAX_SHADER_VARIANTS ? LP_MAX_SHADER_VARIANTS / 4 : 0;
-
-      if (variants_to_cull ||
+      if (lp_variant_cache_full(cache) ||
           lp->nr_fs_instrs >= LP_MAX_SHADER_INSTRUCTIONS) {
          struct pipe_context *pipe = &lp->pipe;
 
@@ -3131,20 +3188,24 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
          llvmpipe_finish(pipe, __FUNCTION__);
 
          /*
-          * We need to re-check lp->nr_fs_variants because an arbitrarliy large
+          * We need to re-check the number of variants because an arbitrarliy large
           * number of shader variants (potentially all of them) could be
           * pending for destruction on flush.
           */
 
-         for (i = 0; i < variants_to_cull || lp->nr_fs_instrs >= LP_MAX_SHADER_INSTRUCTIONS; i++) {
-            struct lp_fs_variant_list_item *item;
-            if (is_empty_list(&lp->fs_variants_list)) {
+         while (lp_variant_cache_over_target(cache) ||
+                lp->nr_fs_instrs >= LP_MAX_SHADER_INSTRUCTIONS) {
+            struct lp_fs_variant_list_item *item, *victim = NULL;
+
+            foreach(item, &lp->fs_variants_list) {
+               if (!victim ||
+                   item->base->info.priority <= victim->base->info.priority)
+                  victim = item;
+            }
+            if (!victim) {
                break;
             }
-            item = last_elem(&lp->fs_variants_list);
-            assert(item);
-            assert(item->base);
-            llvmpipe_remove_shader_variant(lp, item->base);
+            llvmpipe_remove_shader_variant(lp, victim->base, TRUE);
          }
       }
 
@@ -3152,7 +3213,7 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
        * Generate the new variant.
        */
       t0 = os_time_get();
-      variant = generate_variant(lp, shader, &key);
+      variant = generate_variant(lp, shader, &key, FALSE);
       t1 = os_time_get();
       dt = t1 - t0;
       LP_COUNT_ADD(llvm_compile_time, dt);
@@ -3162,17 +3223,65 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
       if (variant) {
          insert_at_head(&shader->variants, &variant->list_item_local);
          insert_at_head(&lp->fs_variants_list, &variant->list_item_global);
-         lp->nr_fs_variants++;
+         lp_variant_cache_insert(cache, &shader->stats, &variant->info,
+                                 variant->gallivm, dt);
          lp->nr_fs_instrs += variant->nr_instrs;
          shader->variants_cached++;
       }
    }
 
    /* Bind this variant */
+   lp->fs_variant = variant;
    lp_setup_set_fs_variant(lp->setup, variant);
 }
 
 
+/**
+ * Called for every draw.  Replaces the bound variant with a fully
+ * optimized one once it has been used in enough draws, if it was
+ * compiled with the fast pipeline.  The fast variant may still be binned,
+ * so it is only freed at the next flush instead of waiting for the scene
+ * here.
+ */
+void
+llvmpipe_fs_variant_drawn(struct llvmpipe_context *lp)
+{
+   struct lp_fragment_shader_variant *variant = lp->fs_variant;
+   struct lp_fragment_shader_variant *optimized;
+   int64_t t0, t1;
+
+   if (!variant || !variant->fast_compiled ||
+       ++variant->draws < LP_FS_RECOMPILE_DRAWS)
+      return;
+
+   /* Don't try again if it fails */
+   variant->fast_compiled = FALSE;
+
+   t0 = os_time_get();
+   optimized = generate_variant(lp, variant->shader, &variant->key, TRUE);
+   t1 = os_time_get();
+   LP_COUNT_ADD(llvm_compile_time, t1 - t0);
+   LP_COUNT_ADD(nr_llvm_compiles, 2);
+
+   if (!optimized)
+      return;
+
+   insert_at_head(&variant->shader->variants, &optimized->list_item_local);
+   insert_at_head(&lp->fs_variants_list, &optimized->list_item_global);
+   optimized->info.hits = variant->info.hits;
+   lp_variant_cache_insert(&lp->fs_variant_cache, &variant->shader->stats,
+                           &optimized->info, optimized->gallivm, t1 - t0);
+   lp->nr_fs_instrs += optimized->nr_instrs;
+   variant->shader->variants_cached++;
+
+   unlink_shader_variant(lp, variant, FALSE);
+   insert_at_head(&lp->fs_variants_retired, &variant->list_item_global);
+
+   lp->fs_variant = optimized;
+   lp_setup_set_fs_variant(lp->setup, optimized);
+}
+
+
 
 
 
@@ -35,6 +35,7 @@
 #include "tgsi/tgsi_scan.h" /* for tgsi_shader_info */
 #include "gallivm/lp_bld_sample.h" /* for struct lp_sampler_static_state */
 #include "gallivm/lp_bld_tgsi.h" /* for lp_tgsi_info */
+#include "gallivm/lp_bld_variant_cache.h"
 #include "lp_bld_interp.h" /* for struct lp_shader_input */
 
 
@@ -113,6 +114,15 @@ struct lp_fragment_shader_variant
    /* Total number of LLVM instructions generated */
    unsigned nr_instrs;
 
+   /* Compile time, code size and uses, for the eviction policy */
+   struct lp_variant_info info;
+
+   /* Compiled with the fast pipeline, to be recompiled once it's used
+    * in LP_FS_RECOMPILE_DRAWS draws.
+    */
+   boolean fast_compiled;
+   unsigned draws;
+
    struct lp_fs_variant_list_item list_item_global, list_item_local;
    struct lp_fragment_shader *shader;
 
@@ -137,6 +147,7 @@ struct lp_fragment_shader
    unsigned no;
    unsigned variants_created;
    unsigned variants_cached;
+   struct lp_variant_stats stats;
 
    /** Fragment shader input interpolation info */
    struct lp_shader_input inputs[PIPE_MAX_SHADER_INPUTS];
@@ -148,7 +159,14 @@ lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant);
 
 void
 llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
-                               struct lp_fragment_shader_variant *variant);
+                               struct lp_fragment_shader_variant *variant,
+                               boolean evicted);
+
+void
+llvmpipe_fs_variant_drawn(struct llvmpipe_context *lp);
+
+void
+llvmpipe_free_retired_fs_variants(struct llvmpipe_context *lp);
 
 boolean
 llvmpipe_rasterization_disabled(struct llvmpipe_context *lp);
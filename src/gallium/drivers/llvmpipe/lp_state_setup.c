@@ -889,11 +889,12 @@ lp_make_setup_variant_key(struct llvmpipe_context *lp,
 
 static void
 remove_setup_variant(struct llvmpipe_context *lp,
-                     struct lp_setup_variant *variant)
+                     struct lp_setup_variant *variant,
+                     boolean evicted)
 {
    if (gallivm_debug & GALLIVM_DEBUG_IR) {
       debug_printf("llvmpipe: del setup_variant #%u total %u\n",
-                   variant->no, lp->nr_setup_variants);
+                   variant->no, lp->setup_variant_cache.nr_variants);
    }
 
    if (variant->gallivm) {
@@ -901,20 +902,20 @@ remove_setup_variant(struct llvmpipe_context *lp,
    }
 
    remove_from_list(&variant->list_item_global);
-   lp->nr_setup_variants--;
+   lp_variant_cache_remove(&lp->setup_variant_cache, NULL, &variant->info,
+                           evicted);
    FREE(variant);
 }
 
 
 
-/* When the number of setup variants exceeds a threshold, cull a
- * fraction (currently a quarter) of them.
+/* When the number of setup variants reaches the limit, evict the lowest
+ * priority ones until we're at 3/4 of it.
  */
 static void
 cull_setup_variants(struct llvmpipe_context *lp)
 {
    struct pipe_context *pipe = &lp->pipe;
-   int i;
 
    /*
     * XXX: we need to flush the context until we have some sort of reference
@@ -923,15 +924,18 @@ cull_setup_variants(struct llvmpipe_context *lp)
     */
    llvmpipe_finish(pipe, __FUNCTION__);
 
-   for (i = 0; i < LP_MAX_SETUP_VARIANTS / 4; i++) {
-      struct lp_setup_variant_list_item *item;
-      if (is_empty_list(&lp->setup_variants_list)) {
+   while (lp_variant_cache_over_target(&lp->setup_variant_cache)) {
+      struct lp_setup_variant_list_item *item, *victim = NULL;
+
+      foreach(item, &lp->setup_variants_list) {
+         if (!victim ||
+             item->base->info.priority <= victim->base->info.priority)
+            victim = item;
+      }
+      if (!victim) {
          break;
       }
-      item = last_elem(&lp->setup_variants_list);
-      assert(item);
-      assert(item->base);
-      remove_setup_variant(lp, item->base);
+      remove_setup_variant(lp, victim->base, TRUE);
    }
 }
 
@@ -960,16 +964,24 @@ llvmpipe_update_setup(struct llvmpipe_context *lp)
 
    if (variant) {
       move_to_head(&lp->setup_variants_list, &variant->list_item_global);
+      lp_variant_cache_hit(&lp->setup_variant_cache, NULL, &variant->info);
    }
    else {
-      if (lp->nr_setup_variants >= LP_MAX_SETUP_VARIANTS) {
+      int64_t t0;
+
+      lp_variant_cache_miss(&lp->setup_variant_cache, NULL);
+
+      if (lp_variant_cache_full(&lp->setup_variant_cache)) {
          cull_setup_variants(lp);
       }
 
+      t0 = os_time_get();
       variant = generate_setup_variant(key, lp);
       if (variant) {
          insert_at_head(&lp->setup_variants_list, &variant->list_item_global);
-         lp->nr_setup_variants++;
+         lp_variant_cache_insert(&lp->setup_variant_cache, NULL,
+                                 &variant->info, variant->gallivm,
+                                 os_time_get() - t0);
       }
    }
 
@@ -983,7 +995,7 @@ lp_delete_setup_variants(struct llvmpipe_context *lp)
    li = first_elem(&lp->setup_variants_list);
    while(!at_end(&lp->setup_variants_list, li)) {
       struct lp_setup_variant_list_item *next = next_elem(li);
-      remove_setup_variant(lp, li->base);
+      remove_setup_variant(lp, li->base, FALSE);
       li = next;
    }
 }
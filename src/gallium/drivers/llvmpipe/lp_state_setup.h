@@ -2,6 +2,7 @@
 #define LP_STATE_SETUP_H
 
 #include "lp_bld_interp.h"
+#include "gallivm/lp_bld_variant_cache.h"
 
 
 struct llvmpipe_context;
@@ -71,6 +72,8 @@ struct lp_setup_variant {
     */
    lp_jit_setup_triangle jit_function;
 
+   struct lp_variant_info info;
+
    unsigned no;
 };
 
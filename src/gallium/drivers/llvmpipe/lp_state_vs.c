@@ -71,6 +71,7 @@ llvmpipe_bind_vs_state(struct pipe_context *pipe, void *_vs)
    draw_bind_vertex_shader(llvmpipe->draw, vs);
 
    llvmpipe->vs = vs;
+   llvmpipe_update_guard_band(llvmpipe);
 
    llvmpipe->dirty |= LP_NEW_VS;
 }
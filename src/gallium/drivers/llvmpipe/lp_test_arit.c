@@ -48,7 +48,29 @@ write_tsv_header(FILE *fp)
 {
    fprintf(fp,
            "result\t"
-           "format\n");
+           "cycles_per_channel\t"
+           "test\t"
+           "type\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp,
+              const char *name,
+              struct lp_type type,
+              double cycles,
+              boolean success)
+{
+   fprintf(fp, "%s\t", success ? "pass" : "fail");
+
+   fprintf(fp, "%.1f\t", cycles / type.length);
+
+   fprintf(fp, "%s\t", name);
+
+   dump_type(fp, type);
+   fprintf(fp, "\n");
 
    fflush(fp);
 }
@@ -449,6 +471,319 @@ test_unary(unsigned verbose, FILE *fp, const struct unary_test_t *test)
 }
 
 
+/*
+ * Integer test cases.
+ *
+ * These exercise the min/max, saturated add/sub and abs paths for each
+ * integer width, both with 128bit vectors and with 256bit vectors (which
+ * use the AVX2 instructions when available), and time each of them.
+ */
+
+typedef void (*int_func_t)(void *out, const void *a, const void *b);
+
+
+struct int_test_t
+{
+   const char *name;
+
+   /* exactly one of these is set */
+   LLVMValueRef
+   (*binary)(struct lp_build_context *bld, LLVMValueRef a, LLVMValueRef b);
+   LLVMValueRef
+   (*unary)(struct lp_build_context *bld, LLVMValueRef a);
+
+   /*
+    * Reference function, lo and hi being the range of the type.
+    */
+   int64_t
+   (*ref)(int64_t a, int64_t b, int64_t lo, int64_t hi);
+};
+
+
+static int64_t int_min_ref(int64_t a, int64_t b, int64_t lo, int64_t hi)
+{
+   return MIN2(a, b);
+}
+
+
+static int64_t int_max_ref(int64_t a, int64_t b, int64_t lo, int64_t hi)
+{
+   return MAX2(a, b);
+}
+
+
+static int64_t int_adds_ref(int64_t a, int64_t b, int64_t lo, int64_t hi)
+{
+   return CLAMP(a + b, lo, hi);
+}
+
+
+static int64_t int_subs_ref(int64_t a, int64_t b, int64_t lo, int64_t hi)
+{
+   return CLAMP(a - b, lo, hi);
+}
+
+
+static int64_t int_abs_ref(int64_t a, int64_t b, int64_t lo, int64_t hi)
+{
+   /* the most negative value has no positive counterpart and wraps */
+   return a < 0 && a != lo ? -a : a;
+}
+
+
+static const struct int_test_t
+int_tests[] = {
+   {"min", &lp_build_min, NULL, &int_min_ref},
+   {"max", &lp_build_max, NULL, &int_max_ref},
+   {"add", &lp_build_add, NULL, &int_adds_ref},
+   {"sub", &lp_build_sub, NULL, &int_subs_ref},
+   {"abs", NULL, &lp_build_abs, &int_abs_ref},
+};
+
+
+/*
+ * Build LLVM function that exercises an integer builder.
+ */
+static LLVMValueRef
+build_int_test_func(struct gallivm_state *gallivm,
+                    const struct int_test_t *test,
+                    struct lp_type type)
+{
+   LLVMContextRef context = gallivm->context;
+   LLVMModuleRef module = gallivm->module;
+   LLVMTypeRef vec_type = lp_build_vec_type(gallivm, type);
+   LLVMTypeRef args[3] = { LLVMPointerType(vec_type, 0),
+                           LLVMPointerType(vec_type, 0),
+                           LLVMPointerType(vec_type, 0) };
+   LLVMValueRef func = LLVMAddFunction(module, test->name,
+                                       LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                                        args, Elements(args), 0));
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMBasicBlockRef block = LLVMAppendBasicBlockInContext(context, func, "entry");
+   LLVMValueRef a, b, ret;
+   struct lp_build_context bld;
+
+   lp_build_context_init(&bld, gallivm, type);
+
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   a = LLVMBuildLoad(builder, LLVMGetParam(func, 1), "");
+   b = LLVMBuildLoad(builder, LLVMGetParam(func, 2), "");
+
+   if (test->binary)
+      ret = test->binary(&bld, a, b);
+   else
+      ret = test->unary(&bld, a);
+
+   LLVMBuildStore(builder, ret, LLVMGetParam(func, 0));
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, func);
+
+   return func;
+}
+
+
+static int64_t
+read_int_elem(struct lp_type type, const void *ptr, unsigned i)
+{
+   switch (type.width) {
+   case 8:
+      return type.sign ? ((const int8_t *)ptr)[i] : ((const uint8_t *)ptr)[i];
+   case 16:
+      return type.sign ? ((const int16_t *)ptr)[i] : ((const uint16_t *)ptr)[i];
+   default:
+      return type.sign ? ((const int32_t *)ptr)[i] : ((const uint32_t *)ptr)[i];
+   }
+}
+
+
+static void
+write_int_elem(struct lp_type type, void *ptr, unsigned i, int64_t val)
+{
+   switch (type.width) {
+   case 8:
+      ((uint8_t *)ptr)[i] = (uint8_t)val;
+      break;
+   case 16:
+      ((uint16_t *)ptr)[i] = (uint16_t)val;
+      break;
+   default:
+      ((uint32_t *)ptr)[i] = (uint32_t)val;
+      break;
+   }
+}
+
+
+static int64_t
+random_int(int64_t range)
+{
+   /* rand() may only give 15 bits */
+   uint64_t r = ((uint64_t)rand() << 30) ^ ((uint64_t)rand() << 15) ^ rand();
+   return (int64_t)(r % (uint64_t)range);
+}
+
+
+/*
+ * Test one LLVM integer builder function with one type.
+ */
+static boolean
+test_int(unsigned verbose, FILE *fp, const struct int_test_t *test,
+         struct lp_type type)
+{
+   struct gallivm_state *gallivm;
+   LLVMValueRef test_func;
+   int_func_t test_func_jit;
+   boolean success = TRUE;
+   const unsigned n = LP_TEST_NUM_SAMPLES;
+   int64_t cycles[LP_TEST_NUM_SAMPLES];
+   double cycles_avg = 0.0;
+   unsigned size = type.width * type.length / 8;
+   int64_t lo = type.sign ? -((int64_t)1 << (type.width - 1)) : 0;
+   int64_t hi = type.sign ? ((int64_t)1 << (type.width - 1)) - 1 :
+                            ((int64_t)1 << type.width) - 1;
+   void *a, *b, *out;
+   unsigned i, j;
+
+   /* ends of the range and values around them, then random ones */
+   const int64_t edges[] = { lo, lo + 1, -1, 0, 1, hi - 1, hi };
+
+   if (!type.sign && test->unary == &lp_build_abs)
+      return TRUE;
+
+   a = align_malloc(size, size);
+   b = align_malloc(size, size);
+   out = align_malloc(size, size);
+
+   gallivm = gallivm_create("test_module", LLVMGetGlobalContext());
+
+   test_func = build_int_test_func(gallivm, test, type);
+
+   gallivm_compile_module(gallivm);
+
+   test_func_jit = (int_func_t) gallivm_jit_function(gallivm, test_func);
+
+   gallivm_free_ir(gallivm);
+
+   for (j = 0; j < n; j++) {
+      int64_t start_counter, end_counter;
+
+      for (i = 0; i < type.length; i++) {
+         unsigned k = j * type.length + i;
+         int64_t va, vb;
+
+         if (k < Elements(edges) * Elements(edges)) {
+            va = edges[k % Elements(edges)];
+            vb = edges[k / Elements(edges)];
+         }
+         else {
+            va = lo + random_int(hi - lo + 1);
+            vb = lo + random_int(hi - lo + 1);
+         }
+         write_int_elem(type, a, i, CLAMP(va, lo, hi));
+         write_int_elem(type, b, i, CLAMP(vb, lo, hi));
+      }
+
+      start_counter = rdtsc();
+      test_func_jit(out, a, b);
+      end_counter = rdtsc();
+
+      cycles[j] = end_counter - start_counter;
+
+      for (i = 0; i < type.length; i++) {
+         int64_t va = read_int_elem(type, a, i);
+         int64_t vb = read_int_elem(type, b, i);
+         int64_t ref = test->ref(va, vb, lo, hi);
+         int64_t res = read_int_elem(type, out, i);
+         boolean pass = res == ref;
+
+         if (!pass || verbose) {
+            printf("%s.%s%ux%u(%lld, %lld): ref = %lld, out = %lld, %s\n",
+                   test->name, type.sign ? "i" : "u", type.width, type.length,
+                   (long long)va, (long long)vb, (long long)ref,
+                   (long long)res, pass ? "PASS" : "FAIL");
+            fflush(stdout);
+         }
+
+         if (!pass) {
+            success = FALSE;
+         }
+      }
+   }
+
+   /*
+    * Drop the cycle counter outliers, as lp_test_conv does.
+    */
+   {
+      double sum = 0.0, sum2 = 0.0;
+      double avg, std;
+      unsigned m;
+
+      for (j = 0; j < n; ++j) {
+         sum += cycles[j];
+         sum2 += cycles[j]*cycles[j];
+      }
+
+      avg = sum/n;
+      std = sqrtf((sum2 - n*avg*avg)/n);
+
+      m = 0;
+      sum = 0.0;
+      for (j = 0; j < n; ++j) {
+         if (fabs(cycles[j] - avg) <= 4.0*std) {
+            sum += cycles[j];
+            ++m;
+         }
+      }
+
+      cycles_avg = sum/m;
+   }
+
+   if (fp)
+      write_tsv_row(fp, test->name, type, cycles_avg, success);
+
+   gallivm_destroy(gallivm);
+
+   align_free(a);
+   align_free(b);
+   align_free(out);
+
+   return success;
+}
+
+
+static boolean
+test_int_all_types(unsigned verbose, FILE *fp, const struct int_test_t *test)
+{
+   static const unsigned widths[] = { 8, 16, 32 };
+   static const unsigned vector_widths[] = { 128, 256 };
+   boolean success = TRUE;
+   unsigned i, j, sign;
+
+   for (i = 0; i < Elements(vector_widths); ++i) {
+      for (j = 0; j < Elements(widths); ++j) {
+         for (sign = 0; sign < 2; ++sign) {
+            struct lp_type type = sign ?
+               lp_type_int_vec(widths[j], vector_widths[i]) :
+               lp_type_uint_vec(widths[j], vector_widths[i]);
+
+            /* saturate on add/sub */
+            type.norm = TRUE;
+
+            if (!test_int(verbose, fp, test, type)) {
+               success = FALSE;
+            }
+         }
+      }
+   }
+
+   return success;
+}
+
+
 boolean
 test_all(unsigned verbose, FILE *fp)
 {
@@ -461,6 +796,12 @@ test_all(unsigned verbose, FILE *fp)
       }
    }
 
+   for (i = 0; i < Elements(int_tests); ++i) {
+      if (!test_int_all_types(verbose, fp, &int_tests[i])) {
+         success = FALSE;
+      }
+   }
+
    return success;
 }
 
@@ -622,6 +622,8 @@ const struct lp_type blend_types[] = {
    /* float, fixed,  sign,  norm, width, len */
    {   TRUE, FALSE,  TRUE, FALSE,    32,   4 }, /* f32 x 4 */
    {  FALSE, FALSE, FALSE,  TRUE,     8,  16 }, /* u8n x 16 */
+   {   TRUE, FALSE,  TRUE, FALSE,    32,   8 }, /* f32 x 8 */
+   {  FALSE, FALSE, FALSE,  TRUE,     8,  32 }, /* u8n x 32 */
 };
 
 
@@ -368,11 +368,21 @@ const struct lp_type conv_types[] = {
    {  FALSE, FALSE, FALSE,  TRUE,    16,   8 },
    {  FALSE, FALSE, FALSE, FALSE,    16,   8 },
 
+   {  FALSE, FALSE,  TRUE,  TRUE,    16,  16 },
+   {  FALSE, FALSE,  TRUE, FALSE,    16,  16 },
+   {  FALSE, FALSE, FALSE,  TRUE,    16,  16 },
+   {  FALSE, FALSE, FALSE, FALSE,    16,  16 },
+
    {  FALSE, FALSE,  TRUE,  TRUE,     8,  16 },
    {  FALSE, FALSE,  TRUE, FALSE,     8,  16 },
    {  FALSE, FALSE, FALSE,  TRUE,     8,  16 },
    {  FALSE, FALSE, FALSE, FALSE,     8,  16 },
 
+   {  FALSE, FALSE,  TRUE,  TRUE,     8,  32 },
+   {  FALSE, FALSE,  TRUE, FALSE,     8,  32 },
+   {  FALSE, FALSE, FALSE,  TRUE,     8,  32 },
+   {  FALSE, FALSE, FALSE, FALSE,     8,  32 },
+
    {  FALSE, FALSE,  TRUE,  TRUE,     8,   4 },
    {  FALSE, FALSE,  TRUE, FALSE,     8,   4 },
    {  FALSE, FALSE, FALSE,  TRUE,     8,   4 },
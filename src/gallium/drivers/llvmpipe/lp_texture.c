@@ -35,6 +35,7 @@
 #include "pipe/p_context.h"
 #include "pipe/p_defines.h"
 
+#include "util/u_atomic.h"
 #include "util/u_inlines.h"
 #include "util/u_cpu_detect.h"
 #include "util/u_format.h"
@@ -42,9 +43,12 @@
 #include "util/u_memory.h"
 #include "util/simple_list.h"
 #include "util/u_transfer.h"
+#include "gallivm/lp_bld_format.h"
 
 #include "lp_context.h"
 #include "lp_flush.h"
+#include "lp_limits.h"
+#include "lp_perf.h"
 #include "lp_screen.h"
 #include "lp_texture.h"
 #include "lp_setup.h"
@@ -60,6 +64,30 @@ static struct llvmpipe_resource resource_list;
 static unsigned id_counter = 0;
 
 
+/**
+ * Alignment of the storage of regular textures.
+ */
+static INLINE unsigned
+llvmpipe_texture_data_align(void)
+{
+   return MAX2(64, util_cpu_caps.cacheline);
+}
+
+
+/**
+ * Size of the storage allocated for a buffer of the given size.
+ *
+ * Reserve some extra storage since if we'd render to a buffer we
+ * read/write always LP_RASTER_BLOCK_SIZE pixels, but the element
+ * offset doesn't need to be aligned to LP_RASTER_BLOCK_SIZE.
+ */
+static INLINE unsigned
+llvmpipe_buffer_data_size(unsigned bytes)
+{
+   return bytes + (LP_RASTER_BLOCK_SIZE - 1) * 4 * sizeof(float);
+}
+
+
 /**
  * Conventional allocation path for non-display textures:
  * Compute strides and allocate data (unless asked not to).
@@ -83,7 +111,7 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
     * of a block for all formats) though this should not be strictly necessary
     * neither. In any case it can only affect compressed or 1d textures.
     */
-   unsigned mip_align = MAX2(64, util_cpu_caps.cacheline);
+   unsigned mip_align = llvmpipe_texture_data_align();
 
    assert(LP_MAX_TEXTURE_2D_LEVELS <= LP_MAX_TEXTURE_LEVELS);
    assert(LP_MAX_TEXTURE_3D_LEVELS <= LP_MAX_TEXTURE_LEVELS);
@@ -174,6 +202,7 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
       else {
          memset(lpr->tex_data, 0, total_size);
       }
+      lpr->total_alloc_size = (unsigned) total_size;
    }
 
    return TRUE;
@@ -270,12 +299,7 @@ llvmpipe_resource_create(struct pipe_screen *_screen,
       assert(templat->height0 == 1);
       assert(templat->depth0 == 1);
       assert(templat->last_level == 0);
-      /*
-       * Reserve some extra storage since if we'd render to a buffer we
-       * read/write always LP_RASTER_BLOCK_SIZE pixels, but the element
-       * offset doesn't need to be aligned to LP_RASTER_BLOCK_SIZE.
-       */
-      lpr->data = align_malloc(bytes + (LP_RASTER_BLOCK_SIZE - 1) * 4 * sizeof(float), 64);
+      lpr->data = align_malloc(llvmpipe_buffer_data_size(bytes), 64);
 
       /*
        * buffers don't really have stride but it's probably safer
@@ -309,6 +333,10 @@ llvmpipe_resource_destroy(struct pipe_screen *pscreen,
    struct llvmpipe_screen *screen = llvmpipe_screen(pscreen);
    struct llvmpipe_resource *lpr = llvmpipe_resource(pt);
 
+   /* the memory may be reused for other compressed blocks */
+   if (util_format_is_compressed(pt->format))
+      lp_format_cache_invalidate();
+
    if (lpr->dt) {
       /* display target */
       struct sw_winsys *winsys = screen->winsys;
@@ -354,6 +382,11 @@ llvmpipe_resource_map(struct pipe_resource *resource,
           tex_usage == LP_TEX_USAGE_READ_WRITE ||
           tex_usage == LP_TEX_USAGE_WRITE_ALL);
 
+   /* drop the decoded blocks which are about to be overwritten */
+   if (tex_usage != LP_TEX_USAGE_READ &&
+       util_format_is_compressed(resource->format))
+      lp_format_cache_invalidate();
+
    if (lpr->dt) {
       /* display target */
       struct llvmpipe_screen *screen = llvmpipe_screen(resource->screen);
@@ -474,6 +507,69 @@ no_lpr:
 }
 
 
+/**
+ * Wrap user memory as a (tightly packed) display target, so rendering goes
+ * straight into it.  Only single level 2D textures are supported, not
+ * buffers, hence PIPE_CAP_RESOURCE_FROM_USER_MEMORY stays off.
+ */
+static struct pipe_resource *
+llvmpipe_resource_from_user_memory(struct pipe_screen *screen,
+                                   const struct pipe_resource *templat,
+                                   void *user_memory)
+{
+   struct sw_winsys *winsys = llvmpipe_screen(screen)->winsys;
+   struct llvmpipe_resource *lpr;
+   unsigned stride;
+
+   if (!winsys->displaytarget_create_mapped ||
+       (templat->target != PIPE_TEXTURE_2D &&
+        templat->target != PIPE_TEXTURE_RECT) ||
+       templat->last_level != 0 ||
+       templat->depth0 != 1 ||
+       templat->array_size != 1) {
+      return NULL;
+   }
+
+   /* The rasterizer reads and writes whole 4x4 blocks */
+   if (templat->width0 % LP_RASTER_BLOCK_SIZE ||
+       templat->height0 % LP_RASTER_BLOCK_SIZE) {
+      return NULL;
+   }
+
+   stride = util_format_get_stride(templat->format, templat->width0);
+
+   lpr = CALLOC_STRUCT(llvmpipe_resource);
+   if (!lpr) {
+      return NULL;
+   }
+
+   lpr->base = *templat;
+   pipe_reference_init(&lpr->base.reference, 1);
+   lpr->base.screen = screen;
+
+   lpr->dt = winsys->displaytarget_create_mapped(winsys,
+                                                 templat->bind,
+                                                 templat->format,
+                                                 templat->width0,
+                                                 templat->height0,
+                                                 stride,
+                                                 user_memory);
+   if (!lpr->dt) {
+      FREE(lpr);
+      return NULL;
+   }
+
+   lpr->row_stride[0] = stride;
+   lpr->id = id_counter++;
+
+#ifdef DEBUG
+   insert_at_tail(&resource_list, lpr);
+#endif
+
+   return &lpr->base;
+}
+
+
 static boolean
 llvmpipe_resource_get_handle(struct pipe_screen *screen,
                             struct pipe_resource *pt,
@@ -490,6 +586,68 @@ llvmpipe_resource_get_handle(struct pipe_screen *screen,
 }
 
 
+/**
+ * Give a resource which the scene being built only reads from new storage,
+ * so that the CPU can write to it without waiting for the scene.  The scene
+ * keeps sampling from the old storage, which is freed with the scene.
+ * \return FALSE if the resource can't be renamed
+ */
+static boolean
+llvmpipe_resource_rename(struct llvmpipe_context *llvmpipe,
+                         struct llvmpipe_resource *lpr,
+                         unsigned usage)
+{
+   void **data;
+   void *new_data;
+   unsigned size, alignment;
+
+   /* the storage must not be reachable through any other pointer */
+   if (lpr->dt || lpr->userBuffer ||
+       (lpr->base.bind & PIPE_BIND_SHARED) ||
+       (lpr->base.flags & PIPE_RESOURCE_FLAG_MAP_PERSISTENT))
+      return FALSE;
+
+   /* only this context's scene is known to be done with the old storage */
+   if (p_atomic_read(&llvmpipe_screen(llvmpipe->pipe.screen)->num_contexts) > 1)
+      return FALSE;
+
+   if (llvmpipe_resource_is_texture(&lpr->base)) {
+      data = &lpr->tex_data;
+      size = lpr->total_alloc_size;
+      alignment = llvmpipe_texture_data_align();
+   }
+   else {
+      data = &lpr->data;
+      size = llvmpipe_buffer_data_size(lpr->base.width0);
+      alignment = 64;
+   }
+
+   /* waiting is cheaper than copying big resources */
+   if (size > LP_MAX_RENAME_SIZE &&
+       !(usage & PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE))
+      return FALSE;
+
+   new_data = align_malloc(size, alignment);
+   if (!new_data)
+      return FALSE;
+
+   if (!lp_setup_retire_storage(llvmpipe->setup, &lpr->base, *data)) {
+      align_free(new_data);
+      return FALSE;
+   }
+
+   if (!(usage & PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE))
+      memcpy(new_data, *data, size);
+
+   *data = new_data;
+
+   /* make the following draws sample from the new storage */
+   llvmpipe->dirty |= LP_NEW_SAMPLER_VIEW;
+
+   return TRUE;
+}
+
+
 static void *
 llvmpipe_transfer_map( struct pipe_context *pipe,
                        struct pipe_resource *resource,
@@ -518,17 +676,34 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
    if (!(usage & PIPE_TRANSFER_UNSYNCHRONIZED)) {
       boolean read_only = !(usage & PIPE_TRANSFER_WRITE);
       boolean do_not_block = !!(usage & PIPE_TRANSFER_DONTBLOCK);
-      if (!llvmpipe_flush_resource(pipe, resource,
-                                   level,
-                                   read_only,
-                                   TRUE, /* cpu_access */
-                                   do_not_block,
-                                   __FUNCTION__)) {
+      unsigned referenced =
+         llvmpipe_is_resource_referenced(pipe, resource, level);
+
+      if (referenced & LP_REFERENCED_FOR_WRITE) {
+         /* Bound as a render target: only the mapped region matters. */
+         unsigned region_referenced =
+            llvmpipe_is_resource_region_referenced(pipe, resource,
+                                                   level, box);
+         if (!(region_referenced & LP_REFERENCED_FOR_WRITE) &&
+             (read_only || !region_referenced))
+            LP_COUNT(nr_flushes_avoided_region);
+         referenced = region_referenced;
+      }
+      else if (referenced && !read_only &&
+               llvmpipe_resource_rename(llvmpipe, lpr, usage)) {
+         LP_COUNT(nr_flushes_avoided_rename);
+         referenced = LP_UNREFERENCED;
+      }
+
+      if ((referenced & LP_REFERENCED_FOR_WRITE) ||
+          ((referenced & LP_REFERENCED_FOR_READ) && !read_only)) {
          /*
           * It would have blocked, but state tracker requested no to.
           */
-         assert(do_not_block);
-         return NULL;
+         if (do_not_block)
+            return NULL;
+
+         llvmpipe_finish(pipe, __FUNCTION__);
       }
    }
 
@@ -615,6 +790,11 @@ llvmpipe_transfer_unmap(struct pipe_context *pipe,
                            transfer->level,
                            transfer->box.z);
 
+   /* unsynchronized writes may have raced with the rasterizer threads */
+   if ((transfer->usage & PIPE_TRANSFER_WRITE) &&
+       util_format_is_compressed(transfer->resource->format))
+      lp_format_cache_invalidate();
+
    /* Effectively do the texture_update work here - if texture images
     * needed post-processing to put them into hardware layout, this is
     * where it would happen.  For llvmpipe, nothing to do.
@@ -628,6 +808,20 @@ unsigned int
 llvmpipe_is_resource_referenced( struct pipe_context *pipe,
                                  struct pipe_resource *presource,
                                  unsigned level)
+{
+   return llvmpipe_is_resource_region_referenced(pipe, presource, level, NULL);
+}
+
+
+/**
+ * As above, but only consider rendering to the given region of the
+ * resource.  A NULL box stands for the whole resource.
+ */
+unsigned int
+llvmpipe_is_resource_region_referenced(struct pipe_context *pipe,
+                                       struct pipe_resource *presource,
+                                       unsigned level,
+                                       const struct pipe_box *box)
 {
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
 
@@ -642,7 +836,8 @@ llvmpipe_is_resource_referenced( struct pipe_context *pipe,
                             PIPE_BIND_SAMPLER_VIEW)))
       return LP_UNREFERENCED;
 
-   return lp_setup_is_resource_referenced(llvmpipe->setup, presource);
+   return lp_setup_is_resource_region_referenced(llvmpipe->setup, presource,
+                                                 level, box);
 }
 
 
@@ -799,6 +994,7 @@ llvmpipe_init_screen_resource_funcs(struct pipe_screen *screen)
    screen->resource_create = llvmpipe_resource_create;
    screen->resource_destroy = llvmpipe_resource_destroy;
    screen->resource_from_handle = llvmpipe_resource_from_handle;
+   screen->resource_from_user_memory = llvmpipe_resource_from_user_memory;
    screen->resource_get_handle = llvmpipe_resource_get_handle;
    screen->can_create_resource = llvmpipe_can_create_resource;
 }
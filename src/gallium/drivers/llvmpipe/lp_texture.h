@@ -42,6 +42,7 @@ enum lp_texture_usage
 };
 
 
+struct pipe_box;
 struct pipe_context;
 struct pipe_screen;
 struct llvmpipe_context;
@@ -233,6 +234,12 @@ llvmpipe_is_resource_referenced( struct pipe_context *pipe,
                                  struct pipe_resource *presource,
                                  unsigned level);
 
+unsigned int
+llvmpipe_is_resource_region_referenced(struct pipe_context *pipe,
+                                       struct pipe_resource *presource,
+                                       unsigned level,
+                                       const struct pipe_box *box);
+
 unsigned
 llvmpipe_get_format_alignment(enum pipe_format format);
 
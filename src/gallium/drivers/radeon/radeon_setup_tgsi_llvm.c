@@ -1593,28 +1593,29 @@ void radeon_llvm_create_func(struct radeon_llvm_context * ctx,
 void radeon_llvm_finalize_module(struct radeon_llvm_context * ctx)
 {
 	struct gallivm_state * gallivm = ctx->soa.bld_base.base.gallivm;
+	LLVMPassManagerRef passmgr;
+
 	/* End the main function with Return*/
 	LLVMBuildRetVoid(gallivm->builder);
 
 	/* Create the pass manager */
-	ctx->gallivm.passmgr = LLVMCreateFunctionPassManagerForModule(
-							gallivm->module);
+	passmgr = LLVMCreateFunctionPassManagerForModule(gallivm->module);
 
 	/* This pass should eliminate all the load and store instructions */
-	LLVMAddPromoteMemoryToRegisterPass(gallivm->passmgr);
+	LLVMAddPromoteMemoryToRegisterPass(passmgr);
 
 	/* Add some optimization passes */
-	LLVMAddScalarReplAggregatesPass(gallivm->passmgr);
-	LLVMAddLICMPass(gallivm->passmgr);
-	LLVMAddAggressiveDCEPass(gallivm->passmgr);
-	LLVMAddCFGSimplificationPass(gallivm->passmgr);
-	LLVMAddInstructionCombiningPass(gallivm->passmgr);
+	LLVMAddScalarReplAggregatesPass(passmgr);
+	LLVMAddLICMPass(passmgr);
+	LLVMAddAggressiveDCEPass(passmgr);
+	LLVMAddCFGSimplificationPass(passmgr);
+	LLVMAddInstructionCombiningPass(passmgr);
 
 	/* Run the pass */
-	LLVMRunFunctionPassManager(gallivm->passmgr, ctx->main_fn);
+	LLVMRunFunctionPassManager(passmgr, ctx->main_fn);
 
 	LLVMDisposeBuilder(gallivm->builder);
-	LLVMDisposePassManager(gallivm->passmgr);
+	LLVMDisposePassManager(passmgr);
 
 }
 
@@ -239,6 +239,59 @@ softpipe_resource_from_handle(struct pipe_screen *screen,
 }
 
 
+/**
+ * Wrap user memory as a (tightly packed) display target, so rendering goes
+ * straight into it.  Only single level 2D textures are supported, not
+ * buffers, hence PIPE_CAP_RESOURCE_FROM_USER_MEMORY stays off.
+ */
+static struct pipe_resource *
+softpipe_resource_from_user_memory(struct pipe_screen *screen,
+                                   const struct pipe_resource *templat,
+                                   void *user_memory)
+{
+   struct sw_winsys *winsys = softpipe_screen(screen)->winsys;
+   struct softpipe_resource *spr;
+   unsigned stride;
+
+   if (!winsys->displaytarget_create_mapped ||
+       (templat->target != PIPE_TEXTURE_2D &&
+        templat->target != PIPE_TEXTURE_RECT) ||
+       templat->last_level != 0 ||
+       templat->depth0 != 1 ||
+       templat->array_size != 1)
+      return NULL;
+
+   stride = util_format_get_stride(templat->format, templat->width0);
+
+   spr = CALLOC_STRUCT(softpipe_resource);
+   if (!spr)
+      return NULL;
+
+   spr->base = *templat;
+   pipe_reference_init(&spr->base.reference, 1);
+   spr->base.screen = screen;
+
+   spr->pot = (util_is_power_of_two(templat->width0) &&
+               util_is_power_of_two(templat->height0));
+
+   spr->dt = winsys->displaytarget_create_mapped(winsys,
+                                                 templat->bind,
+                                                 templat->format,
+                                                 templat->width0,
+                                                 templat->height0,
+                                                 stride,
+                                                 user_memory);
+   if (!spr->dt) {
+      FREE(spr);
+      return NULL;
+   }
+
+   spr->stride[0] = stride;
+
+   return &spr->base;
+}
+
+
 static boolean
 softpipe_resource_get_handle(struct pipe_screen *screen,
                              struct pipe_resource *pt,
@@ -516,6 +569,7 @@ softpipe_init_screen_texture_funcs(struct pipe_screen *screen)
    screen->resource_create = softpipe_resource_create;
    screen->resource_destroy = softpipe_resource_destroy;
    screen->resource_from_handle = softpipe_resource_from_handle;
+   screen->resource_from_user_memory = softpipe_resource_from_user_memory;
    screen->resource_get_handle = softpipe_resource_get_handle;
    screen->can_create_resource = softpipe_can_create_resource;
 }
@@ -0,0 +1,1881 @@
+/**************************************************************************
+ *
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * \file tc_context.c
+ * Threaded pipe_context wrapper.
+ *
+ * Every call which doesn't return anything is recorded into the current
+ * batch, copying its state by value and taking references on the
+ * resources, surfaces, sampler views and stream output targets it uses;
+ * the driver thread makes the call and drops the references.  Data the
+ * driver would read later from application memory (user constant buffers,
+ * inline writes) is copied as well.
+ *
+ * Write-only transfers which discard the mapped range are staged: the
+ * caller gets a malloc'ed copy, which becomes a recorded
+ * transfer_inline_write when it is flushed or unmapped, so they never wait
+ * for the driver.  Any other transfer waits for the batch fence of
+ * everything recorded so far and is then mapped directly; the driver does
+ * its own waiting for rendering which is still in flight on the resource.
+ *
+ * Sampler views, surfaces and stream output targets are created by the
+ * driver but point back at the wrapper context, so their destroy
+ * callbacks are deferred when the last reference goes away on the
+ * application thread.
+ */
+
+#include "util/hash_table.h"
+#include "util/u_box.h"
+#include "util/u_debug.h"
+#include "util/u_format.h"
+#include "util/u_framebuffer.h"
+#include "util/u_inlines.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/u_surface.h"
+
+#include "tc_context.h"
+#include "tc_screen.h"
+
+
+/*
+ * Resource tracking.
+ *
+ * Batch numbers are stored in the busy table truncated to a pointer.
+ * Entries are pruned long before the truncation could matter.
+ */
+
+#define TC_MAX_BUSY_ENTRIES 1024
+
+/** Drop the busy entries of batches older than 'executed' */
+static void
+tc_prune_busy(struct threaded_context *tc, uint64_t executed)
+{
+   struct hash_entry *entry;
+
+   if (!tc->busy->entries)
+      return;
+
+   hash_table_foreach(tc->busy, entry) {
+      if ((uintptr_t) entry->data < (uintptr_t) executed)
+         _mesa_hash_table_remove(tc->busy, entry);
+   }
+}
+
+
+/** Note that the given batch uses the resource */
+static void
+tc_mark_busy_at(struct threaded_context *tc, struct pipe_resource *resource,
+                uint64_t batch)
+{
+   struct hash_entry *entry;
+
+   if (!resource)
+      return;
+
+   entry = _mesa_hash_table_search(tc->busy, resource);
+   if (!entry)
+      _mesa_hash_table_insert(tc->busy, resource, (void *) (uintptr_t) batch);
+   else if ((uintptr_t) entry->data < (uintptr_t) batch)
+      entry->data = (void *) (uintptr_t) batch;
+}
+
+
+/**
+ * Note that the call being recorded uses the resource.  Must come after
+ * the call has been added, which may have moved on to the next batch.
+ */
+static INLINE void
+tc_mark_busy(struct threaded_context *tc, struct pipe_resource *resource)
+{
+   tc_mark_busy_at(tc, resource, tc->submitted);
+}
+
+
+/** pipe_resource_reference for recorded calls */
+static INLINE void
+tc_set_resource(struct threaded_context *tc, struct pipe_resource **dst,
+                struct pipe_resource *src)
+{
+   pipe_resource_reference(dst, src);
+   tc_mark_busy(tc, src);
+}
+
+
+/**
+ * Update a binding slot.  Draws recorded while the old resource was bound
+ * keep using it.
+ */
+static INLINE void
+tc_bind(struct threaded_context *tc, struct pipe_resource **slot,
+        struct pipe_resource *resource)
+{
+   if (*slot != resource) {
+      tc_mark_busy_at(tc, *slot, tc->last_draw);
+      *slot = resource;
+   }
+   tc_mark_busy(tc, resource);
+}
+
+
+/*
+ * Ring management.
+ */
+
+static INLINE struct tc_batch *
+tc_current_batch(struct threaded_context *tc)
+{
+   return &tc->batches[tc->submitted % TC_MAX_BATCHES];
+}
+
+
+static INLINE boolean
+tc_is_driver_thread(struct threaded_context *tc)
+{
+   return thrd_equal(thrd_current(), tc->thread);
+}
+
+
+/**
+ * Whether the driver context may be entered directly from this thread
+ * without going through the ring.
+ */
+static INLINE boolean
+tc_calls_driver_directly(struct threaded_context *tc)
+{
+   return tc->stopped || tc_is_driver_thread(tc);
+}
+
+
+/**
+ * Hand the current batch to the driver thread and start recording into the
+ * next ring slot, waiting for the driver if the ring is full.
+ */
+static void
+tc_submit_batch(struct threaded_context *tc)
+{
+   uint64_t executed;
+
+   pipe_mutex_lock(tc->mutex);
+   tc->submitted++;
+   pipe_condvar_signal(tc->batch_submitted);
+   while (tc->submitted - tc->executed >= TC_MAX_BATCHES)
+      pipe_condvar_wait(tc->batch_executed, tc->mutex);
+   executed = tc->executed;
+   pipe_mutex_unlock(tc->mutex);
+
+   tc_current_batch(tc)->used = 0;
+   tc->stats.batches++;
+
+   if (tc->busy->entries > TC_MAX_BUSY_ENTRIES)
+      tc_prune_busy(tc, executed);
+}
+
+
+/**
+ * Wait until the driver thread has executed everything recorded so far.
+ * Afterwards the driver context may be called directly from this thread
+ * until the next call is recorded.
+ */
+static void
+tc_sync(struct threaded_context *tc)
+{
+   if (tc_current_batch(tc)->used)
+      tc_submit_batch(tc);
+
+   pipe_mutex_lock(tc->mutex);
+   if (tc->executed != tc->submitted) {
+      tc->stats.syncs++;
+      while (tc->executed != tc->submitted)
+         pipe_condvar_wait(tc->batch_executed, tc->mutex);
+   }
+   pipe_mutex_unlock(tc->mutex);
+
+   tc_prune_busy(tc, tc->submitted);
+}
+
+
+/** Whether the resource is bound once everything recorded has executed */
+static boolean
+tc_is_bound(struct threaded_context *tc, struct pipe_resource *resource)
+{
+   struct pipe_resource **slots = (struct pipe_resource **) &tc->bound;
+   unsigned i;
+
+   for (i = 0; i < sizeof tc->bound / sizeof slots[0]; i++) {
+      if (slots[i] == resource)
+         return TRUE;
+   }
+   return FALSE;
+}
+
+
+/**
+ * Whether a call which hasn't been executed yet uses the resource.
+ */
+static boolean
+tc_is_busy(struct threaded_context *tc, struct pipe_resource *resource)
+{
+   struct hash_entry *entry;
+   uint64_t executed;
+
+   pipe_mutex_lock(tc->mutex);
+   executed = tc->executed;
+   pipe_mutex_unlock(tc->mutex);
+
+   if (executed == tc->submitted && !tc_current_batch(tc)->used)
+      return FALSE;
+
+   entry = _mesa_hash_table_search(tc->busy, resource);
+   if (entry && (uintptr_t) entry->data >= (uintptr_t) executed)
+      return TRUE;
+
+   return tc->last_draw >= executed && tc_is_bound(tc, resource);
+}
+
+
+static struct tc_call *
+tc_add_call(struct threaded_context *tc, tc_execute execute, unsigned size)
+{
+   struct tc_batch *batch = tc_current_batch(tc);
+   struct tc_call *call;
+
+   assert(!tc->stopped);
+   size = align(size, 8);
+   assert(size <= TC_BATCH_SIZE);
+
+   if (batch->used + size > TC_BATCH_SIZE) {
+      tc_submit_batch(tc);
+      batch = tc_current_batch(tc);
+   }
+
+   call = (struct tc_call *) ((uint8_t *) batch->buffer + batch->used);
+   batch->used += size;
+   call->execute = execute;
+   call->size = size;
+   tc->stats.calls++;
+   return call;
+}
+
+#define tc_add_struct(tc, execute, type) \
+   ((type *) tc_add_call(tc, execute, sizeof(type)))
+
+#define tc_add_array(tc, execute, type, slot, count) \
+   ((type *) tc_add_call(tc, execute, \
+                         offsetof(type, slot) + (count) * sizeof(((type *) 0)->slot[0])))
+
+
+static PIPE_THREAD_ROUTINE(tc_thread_func, param)
+{
+   struct threaded_context *tc = (struct threaded_context *) param;
+
+   pipe_thread_setname("tc_driver");
+
+   pipe_mutex_lock(tc->mutex);
+   for (;;) {
+      struct tc_batch *batch;
+      unsigned offset;
+
+      while (tc->executed == tc->submitted && !tc->shutdown)
+         pipe_condvar_wait(tc->batch_submitted, tc->mutex);
+
+      if (tc->executed == tc->submitted)
+         break;
+
+      batch = &tc->batches[tc->executed % TC_MAX_BATCHES];
+      pipe_mutex_unlock(tc->mutex);
+
+      pipe_mutex_lock(tc->driver_mutex);
+      for (offset = 0; offset < batch->used; ) {
+         struct tc_call *call =
+            (struct tc_call *) ((uint8_t *) batch->buffer + offset);
+
+         call->execute(tc, call);
+         offset += call->size;
+      }
+      pipe_mutex_unlock(tc->driver_mutex);
+
+      pipe_mutex_lock(tc->mutex);
+      tc->executed++;
+      pipe_condvar_broadcast(tc->batch_executed);
+   }
+   pipe_mutex_unlock(tc->mutex);
+
+   return 0;
+}
+
+
+/*
+ * Generic recorded calls.
+ */
+
+struct tc_ptr_call
+{
+   struct tc_call base;
+   void *ptr;
+};
+
+struct tc_uint_call
+{
+   struct tc_call base;
+   unsigned value;
+};
+
+struct tc_resource_call
+{
+   struct tc_call base;
+   struct pipe_resource *resource;
+};
+
+
+/** Recorded call taking a single object handle, e.g. bind/delete */
+#define TC_FUNC_PTR(func, type) \
+   static void \
+   tc_call_##func(struct threaded_context *tc, struct tc_call *call) \
+   { \
+      tc->pipe->func(tc->pipe, (type) ((struct tc_ptr_call *) call)->ptr); \
+   } \
+   \
+   static void \
+   tc_##func(struct pipe_context *_pipe, type ptr) \
+   { \
+      struct threaded_context *tc = threaded_context(_pipe); \
+      struct tc_ptr_call *p = \
+         tc_add_struct(tc, tc_call_##func, struct tc_ptr_call); \
+      \
+      p->ptr = (void *) ptr; \
+   }
+
+/** Recorded call taking a single unsigned */
+#define TC_FUNC_UINT(func) \
+   static void \
+   tc_call_##func(struct threaded_context *tc, struct tc_call *call) \
+   { \
+      tc->pipe->func(tc->pipe, ((struct tc_uint_call *) call)->value); \
+   } \
+   \
+   static void \
+   tc_##func(struct pipe_context *_pipe, unsigned value) \
+   { \
+      struct threaded_context *tc = threaded_context(_pipe); \
+      struct tc_uint_call *p = \
+         tc_add_struct(tc, tc_call_##func, struct tc_uint_call); \
+      \
+      p->value = value; \
+   }
+
+/** Recorded call taking a single state struct, copied by value */
+#define TC_FUNC_STRUCT(func, type) \
+   struct tc_##func \
+   { \
+      struct tc_call base; \
+      type state; \
+   }; \
+   \
+   static void \
+   tc_call_##func(struct threaded_context *tc, struct tc_call *call) \
+   { \
+      tc->pipe->func(tc->pipe, &((struct tc_##func *) call)->state); \
+   } \
+   \
+   static void \
+   tc_##func(struct pipe_context *_pipe, const type *state) \
+   { \
+      struct threaded_context *tc = threaded_context(_pipe); \
+      struct tc_##func *p = tc_add_struct(tc, tc_call_##func, struct tc_##func); \
+      \
+      p->state = *state; \
+   }
+
+/** Recorded call taking a single resource */
+#define TC_FUNC_RESOURCE(func) \
+   static void \
+   tc_call_##func(struct threaded_context *tc, struct tc_call *call) \
+   { \
+      struct tc_resource_call *p = (struct tc_resource_call *) call; \
+      \
+      tc->pipe->func(tc->pipe, p->resource); \
+      pipe_resource_reference(&p->resource, NULL); \
+   } \
+   \
+   static void \
+   tc_##func(struct pipe_context *_pipe, struct pipe_resource *resource) \
+   { \
+      struct threaded_context *tc = threaded_context(_pipe); \
+      struct tc_resource_call *p = \
+         tc_add_struct(tc, tc_call_##func, struct tc_resource_call); \
+      \
+      p->resource = NULL; \
+      tc_set_resource(tc, &p->resource, resource); \
+   }
+
+/** Object creation: wait for the driver thread, then call directly */
+#define TC_FUNC_CREATE(func, type) \
+   static void * \
+   tc_##func(struct pipe_context *_pipe, const type *state) \
+   { \
+      struct threaded_context *tc = threaded_context(_pipe); \
+      \
+      tc_sync(tc); \
+      return tc->pipe->func(tc->pipe, state); \
+   }
+
+
+TC_FUNC_CREATE(create_blend_state, struct pipe_blend_state)
+TC_FUNC_PTR(bind_blend_state, void *)
+TC_FUNC_PTR(delete_blend_state, void *)
+
+TC_FUNC_CREATE(create_sampler_state, struct pipe_sampler_state)
+TC_FUNC_PTR(delete_sampler_state, void *)
+
+TC_FUNC_CREATE(create_rasterizer_state, struct pipe_rasterizer_state)
+TC_FUNC_PTR(bind_rasterizer_state, void *)
+TC_FUNC_PTR(delete_rasterizer_state, void *)
+
+TC_FUNC_CREATE(create_depth_stencil_alpha_state,
+               struct pipe_depth_stencil_alpha_state)
+TC_FUNC_PTR(bind_depth_stencil_alpha_state, void *)
+TC_FUNC_PTR(delete_depth_stencil_alpha_state, void *)
+
+TC_FUNC_CREATE(create_fs_state, struct pipe_shader_state)
+TC_FUNC_PTR(bind_fs_state, void *)
+TC_FUNC_PTR(delete_fs_state, void *)
+
+TC_FUNC_CREATE(create_vs_state, struct pipe_shader_state)
+TC_FUNC_PTR(bind_vs_state, void *)
+TC_FUNC_PTR(delete_vs_state, void *)
+
+TC_FUNC_CREATE(create_gs_state, struct pipe_shader_state)
+TC_FUNC_PTR(bind_gs_state, void *)
+TC_FUNC_PTR(delete_gs_state, void *)
+
+TC_FUNC_PTR(bind_vertex_elements_state, void *)
+TC_FUNC_PTR(delete_vertex_elements_state, void *)
+
+TC_FUNC_PTR(destroy_query, struct pipe_query *)
+TC_FUNC_PTR(begin_query, struct pipe_query *)
+TC_FUNC_PTR(end_query, struct pipe_query *)
+
+TC_FUNC_STRUCT(set_blend_color, struct pipe_blend_color)
+TC_FUNC_STRUCT(set_stencil_ref, struct pipe_stencil_ref)
+TC_FUNC_STRUCT(set_clip_state, struct pipe_clip_state)
+TC_FUNC_STRUCT(set_polygon_stipple, struct pipe_poly_stipple)
+
+TC_FUNC_UINT(set_sample_mask)
+TC_FUNC_UINT(set_min_samples)
+TC_FUNC_UINT(memory_barrier)
+
+TC_FUNC_RESOURCE(flush_resource)
+TC_FUNC_RESOURCE(invalidate_resource)
+
+
+static void *
+tc_create_vertex_elements_state(struct pipe_context *_pipe,
+                                unsigned num_elements,
+                                const struct pipe_vertex_element *elements)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+
+   tc_sync(tc);
+   return tc->pipe->create_vertex_elements_state(tc->pipe, num_elements,
+                                                 elements);
+}
+
+
+static void
+tc_call_texture_barrier(struct threaded_context *tc, struct tc_call *call)
+{
+   tc->pipe->texture_barrier(tc->pipe);
+}
+
+static void
+tc_texture_barrier(struct pipe_context *_pipe)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+
+   tc_add_call(tc, tc_call_texture_barrier, sizeof(struct tc_call));
+}
+
+
+/*
+ * Queries.
+ */
+
+static struct pipe_query *
+tc_create_query(struct pipe_context *_pipe, unsigned query_type,
+                unsigned index)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+
+   tc_sync(tc);
+   return tc->pipe->create_query(tc->pipe, query_type, index);
+}
+
+
+static boolean
+tc_get_query_result(struct pipe_context *_pipe, struct pipe_query *query,
+                    boolean wait, union pipe_query_result *result)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+
+   tc_sync(tc);
+   return tc->pipe->get_query_result(tc->pipe, query, wait, result);
+}
+
+
+struct tc_render_condition
+{
+   struct tc_call base;
+   struct pipe_query *query;
+   boolean condition;
+   uint mode;
+};
+
+static void
+tc_call_render_condition(struct threaded_context *tc, struct tc_call *call)
+{
+   struct tc_render_condition *p = (struct tc_render_condition *) call;
+
+   tc->pipe->render_condition(tc->pipe, p->query, p->condition, p->mode);
+}
+
+static void
+tc_render_condition(struct pipe_context *_pipe, struct pipe_query *query,
+                    boolean condition, uint mode)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_render_condition *p =
+      tc_add_struct(tc, tc_call_render_condition, struct tc_render_condition);
+
+   p->query = query;
+   p->condition = condition;
+   p->mode = mode;
+}
+
+
+/*
+ * Parameter-like state.
+ */
+
+struct tc_sampler_states
+{
+   struct tc_call base;
+   unsigned shader, start, count;
+   void *slot[PIPE_MAX_SAMPLERS];
+};
+
+static void
+tc_call_bind_sampler_states(struct threaded_context *tc, struct tc_call *call)
+{
+   struct tc_sampler_states *p = (struct tc_sampler_states *) call;
+
+   tc->pipe->bind_sampler_states(tc->pipe, p->shader, p->start, p->count,
+                                 p->slot);
+}
+
+static void
+tc_bind_sampler_states(struct pipe_context *_pipe, unsigned shader,
+                       unsigned start, unsigned count, void **states)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_sampler_states *p;
+   unsigned i;
+
+   assert(count <= PIPE_MAX_SAMPLERS);
+
+   p = tc_add_array(tc, tc_call_bind_sampler_states,
+                    struct tc_sampler_states, slot, count);
+   p->shader = shader;
+   p->start = start;
+   p->count = count;
+   for (i = 0; i < count; i++)
+      p->slot[i] = states ? states[i] : NULL;
+}
+
+
+struct tc_constant_buffer
+{
+   struct tc_call base;
+   uint shader, index;
+   boolean is_null;
+   struct pipe_constant_buffer cb;
+};
+
+static void
+tc_call_set_constant_buffer(struct threaded_context *tc, struct tc_call *call)
+{
+   struct tc_constant_buffer *p = (struct tc_constant_buffer *) call;
+   void *old_copy = tc->user_constants[p->shader][p->index];
+
+   tc->pipe->set_constant_buffer(tc->pipe, p->shader, p->index,
+                                 p->is_null ? NULL : &p->cb);
+   pipe_resource_reference(&p->cb.buffer, NULL);
+
+   /* The driver may keep pointing at the copy until the slot is rebound */
+   tc->user_constants[p->shader][p->index] = (void *) p->cb.user_buffer;
+   FREE(old_copy);
+}
+
+static void
+tc_set_constant_buffer(struct pipe_context *_pipe, uint shader, uint index,
+                       struct pipe_constant_buffer *cb)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_constant_buffer *p =
+      tc_add_struct(tc, tc_call_set_constant_buffer,
+                    struct tc_constant_buffer);
+
+   assert(shader < PIPE_SHADER_TYPES);
+   assert(index < PIPE_MAX_CONSTANT_BUFFERS);
+
+   p->shader = shader;
+   p->index = index;
+   p->is_null = cb == NULL;
+   memset(&p->cb, 0, sizeof p->cb);
+   tc_bind(tc, &tc->bound.constant_buffers[shader][index],
+           cb ? cb->buffer : NULL);
+
+   if (cb) {
+      p->cb.buffer_offset = cb->buffer_offset;
+      p->cb.buffer_size = cb->buffer_size;
+      pipe_resource_reference(&p->cb.buffer, cb->buffer);
+
+      if (cb->user_buffer) {
+         unsigned size = cb->buffer_offset + cb->buffer_size;
+         void *copy = MALLOC(size);
+
+         if (copy)
+            memcpy(copy, cb->user_buffer, size);
+         p->cb.user_buffer = copy;
+      }
+   }
+}
+
+
+struct tc_framebuffer
+{
+   struct tc_call base;
+   struct pipe_framebuffer_state state;
+};
+
+static void
+tc_call_set_framebuffer_state(struct threaded_context *tc,
+                              struct tc_call *call)
+{
+   struct tc_framebuffer *p = (struct tc_framebuffer *) call;
+
+   tc->pipe->set_framebuffer_state(tc->pipe, &p->state);
+   util_unreference_framebuffer_state(&p->state);
+}
+
+static void
+tc_set_framebuffer_state(struct pipe_context *_pipe,
+                         const struct pipe_framebuffer_state *state)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_framebuffer *p =
+      tc_add_struct(tc, tc_call_set_framebuffer_state, struct tc_framebuffer);
+
+   unsigned i;
+
+   memset(&p->state, 0, sizeof p->state);
+   util_copy_framebuffer_state(&p->state, state);
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
+      struct pipe_surface *surf = i < state->nr_cbufs ? state->cbufs[i] : NULL;
+
+      tc_bind(tc, &tc->bound.framebuffer[i], surf ? surf->texture : NULL);
+   }
+   tc_bind(tc, &tc->bound.framebuffer[PIPE_MAX_COLOR_BUFS],
+           state->zsbuf ? state->zsbuf->texture : NULL);
+}
+
+
+struct tc_scissors
+{
+   struct tc_call base;
+   unsigned start, count;
+   struct pipe_scissor_state slot[PIPE_MAX_VIEWPORTS];
+};
+
+static void
+tc_call_set_scissor_states(struct threaded_context *tc, struct tc_call *call)
+{
+   struct tc_scissors *p = (struct tc_scissors *) call;
+
+   tc->pipe->set_scissor_states(tc->pipe, p->start, p->count, p->slot);
+}
+
+static void
+tc_set_scissor_states(struct pipe_context *_pipe, unsigned start,
+                      unsigned count, const struct pipe_scissor_state *states)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_scissors *p;
+
+   assert(count <= PIPE_MAX_VIEWPORTS);
+
+   p = tc_add_array(tc, tc_call_set_scissor_states,
+                    struct tc_scissors, slot, count);
+   p->start = start;
+   p->count = count;
+   memcpy(p->slot, states, count * sizeof states[0]);
+}
+
+
+struct tc_viewports
+{
+   struct tc_call base;
+   unsigned start, count;
+   struct pipe_viewport_state slot[PIPE_MAX_VIEWPORTS];
+};
+
+static void
+tc_call_set_viewport_states(struct threaded_context *tc, struct tc_call *call)
+{
+   struct tc_viewports *p = (struct tc_viewports *) call;
+
+   tc->pipe->set_viewport_states(tc->pipe, p->start, p->count, p->slot);
+}
+
+static void
+tc_set_viewport_states(struct pipe_context *_pipe, unsigned start,
+                       unsigned count, const struct pipe_viewport_state *states)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_viewports *p;
+
+   assert(count <= PIPE_MAX_VIEWPORTS);
+
+   p = tc_add_array(tc, tc_call_set_viewport_states,
+                    struct tc_viewports, slot, count);
+   p->start = start;
+   p->count = count;
+   memcpy(p->slot, states, count * sizeof states[0]);
+}
+
+
+struct tc_sampler_views
+{
+   struct tc_call base;
+   unsigned shader, start, count;
+   struct pipe_sampler_view *slot[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+};
+
+static void
+tc_call_set_sampler_views(struct threaded_context *tc, struct tc_call *call)
+{
+   struct tc_sampler_views *p = (struct tc_sampler_views *) call;
+   unsigned i;
+
+   tc->pipe->set_sampler_views(tc->pipe, p->shader, p->start, p->count,
+                               p->slot);
+   for (i = 0; i < p->count; i++)
+      pipe_sampler_view_reference(&p->slot[i], NULL);
+}
+
+static void
+tc_set_sampler_views(struct pipe_context *_pipe, unsigned shader,
+                     unsigned start, unsigned count,
+                     struct pipe_sampler_view **views)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_sampler_views *p;
+   unsigned i;
+
+   assert(start + count <= PIPE_MAX_SHADER_SAMPLER_VIEWS);
+
+   p = tc_add_array(tc, tc_call_set_sampler_views,
+                    struct tc_sampler_views, slot, count);
+   p->shader = shader;
+   p->start = start;
+   p->count = count;
+   for (i = 0; i < count; i++) {
+      p->slot[i] = NULL;
+      if (views)
+         pipe_sampler_view_reference(&p->slot[i], views[i]);
+      tc_bind(tc, &tc->bound.sampler_views[shader][start + i],
+              p->slot[i] ? p->slot[i]->texture : NULL);
+   }
+}
+
+
+struct tc_vertex_buffers
+{
+   struct tc_call base;
+   unsigned start, count;
+   boolean is_null;
+   struct pipe_vertex_buffer slot[PIPE_MAX_ATTRIBS];
+};
+
+static void
+tc_call_set_vertex_buffers(struct threaded_context *tc, struct tc_call *call)
+{
+   struct tc_vertex_buffers *p = (struct tc_vertex_buffers *) call;
+   unsigned i;
+
+   tc->pipe->set_vertex_buffers(tc->pipe, p->start, p->count,
+                                p->is_null ? NULL : p->slot);
+   for (i = 0; i < p->count; i++)
+      pipe_resource_reference(&p->slot[i].buffer, NULL);
+}
+
+static void
+tc_set_vertex_buffers(struct pipe_context *_pipe, unsigned start,
+                      unsigned count, const struct pipe_vertex_buffer *buffers)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_vertex_buffers *p;
+   unsigned i;
+
+   assert(start + count <= PIPE_MAX_ATTRIBS);
+
+   p = tc_add_array(tc, tc_call_set_vertex_buffers,
+                    struct tc_vertex_buffers, slot, count);
+   p->start = start;
+   p->count = count;
+   p->is_null = buffers == NULL;
+   for (i = 0; i < count; i++) {
+      memset(&p->slot[i], 0, sizeof p->slot[i]);
+      if (buffers) {
+         /* PIPE_CAP_USER_VERTEX_BUFFERS is off */
+         assert(!buffers[i].user_buffer);
+         p->slot[i].stride = buffers[i].stride;
+         p->slot[i].buffer_offset = buffers[i].buffer_offset;
+         pipe_resource_reference(&p->slot[i].buffer, buffers[i].buffer);
+      }
+      tc_bind(tc, &tc->bound.vertex_buffers[start + i], p->slot[i].buffer);
+   }
+}
+
+
+struct tc_index_buffer
+{
+   struct tc_call base;
+   boolean is_null;
+   struct pipe_index_buffer ib;
+};
+
+static void
+tc_call_set_index_buffer(struct threaded_context *tc, struct tc_call *call)
+{
+   struct tc_index_buffer *p = (struct tc_index_buffer *) call;
+
+   tc->pipe->set_index_buffer(tc->pipe, p->is_null ? NULL : &p->ib);
+   pipe_resource_reference(&p->ib.buffer, NULL);
+}
+
+static void
+tc_set_index_buffer(struct pipe_context *_pipe,
+                    const struct pipe_index_buffer *ib)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_index_buffer *p =
+      tc_add_struct(tc, tc_call_set_index_buffer, struct tc_index_buffer);
+
+   p->is_null = ib == NULL;
+   memset(&p->ib, 0, sizeof p->ib);
+   if (ib) {
+      /* PIPE_CAP_USER_INDEX_BUFFERS is off */
+      assert(!ib->user_buffer);
+      p->ib.index_size = ib->index_size;
+      p->ib.offset = ib->offset;
+      pipe_resource_reference(&p->ib.buffer, ib->buffer);
+   }
+   tc_bind(tc, &tc->bound.index_buffer, p->ib.buffer);
+}
+
+
+/*
+ * Views and stream output targets.  The driver creates them, but they
+ * point back at the wrapper so that the final unreference comes here.
+ */
+
+static struct pipe_sampler_view *
+tc_create_sampler_view(struct pipe_context *_pipe,
+                       struct pipe_resource *resource,
+                       const struct pipe_sampler_view *templat)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct pipe_sampler_view *view;
+
+   tc_sync(tc);
+   view = tc->pipe->create_sampler_view(tc->pipe, resource, templat);
+   if (view)
+      view->context = _pipe;
+   return view;
+}
+
+static void
+tc_call_sampler_view_destroy(struct threaded_context *tc,
+                             struct tc_call *call)
+{
+   struct pipe_sampler_view *view =
+      (struct pipe_sampler_view *) ((struct tc_ptr_call *) call)->ptr;
+
+   tc->pipe->sampler_view_destroy(tc->pipe, view);
+}
+
+static void
+tc_sampler_view_destroy(struct pipe_context *_pipe,
+                        struct pipe_sampler_view *view)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_ptr_call *p;
+
+   if (tc_calls_driver_directly(tc)) {
+      tc->pipe->sampler_view_destroy(tc->pipe, view);
+      return;
+   }
+
+   p = tc_add_struct(tc, tc_call_sampler_view_destroy, struct tc_ptr_call);
+   p->ptr = view;
+}
+
+
+static struct pipe_surface *
+tc_create_surface(struct pipe_context *_pipe,
+                  struct pipe_resource *resource,
+                  const struct pipe_surface *templat)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct pipe_surface *surface;
+
+   tc_sync(tc);
+   surface = tc->pipe->create_surface(tc->pipe, resource, templat);
+   if (surface)
+      surface->context = _pipe;
+   return surface;
+}
+
+static void
+tc_call_surface_destroy(struct threaded_context *tc, struct tc_call *call)
+{
+   struct pipe_surface *surface =
+      (struct pipe_surface *) ((struct tc_ptr_call *) call)->ptr;
+
+   tc->pipe->surface_destroy(tc->pipe, surface);
+}
+
+static void
+tc_surface_destroy(struct pipe_context *_pipe, struct pipe_surface *surface)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_ptr_call *p;
+
+   if (tc_calls_driver_directly(tc)) {
+      tc->pipe->surface_destroy(tc->pipe, surface);
+      return;
+   }
+
+   p = tc_add_struct(tc, tc_call_surface_destroy, struct tc_ptr_call);
+   p->ptr = surface;
+}
+
+
+static struct pipe_stream_output_target *
+tc_create_stream_output_target(struct pipe_context *_pipe,
+                               struct pipe_resource *resource,
+                               unsigned buffer_offset,
+                               unsigned buffer_size)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct pipe_stream_output_target *target;
+
+   tc_sync(tc);
+   target = tc->pipe->create_stream_output_target(tc->pipe, resource,
+                                                  buffer_offset, buffer_size);
+   if (target)
+      target->context = _pipe;
+   return target;
+}
+
+static void
+tc_call_stream_output_target_destroy(struct threaded_context *tc,
+                                     struct tc_call *call)
+{
+   struct pipe_stream_output_target *target =
+      (struct pipe_stream_output_target *) ((struct tc_ptr_call *) call)->ptr;
+
+   tc->pipe->stream_output_target_destroy(tc->pipe, target);
+}
+
+static void
+tc_stream_output_target_destroy(struct pipe_context *_pipe,
+                                struct pipe_stream_output_target *target)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_ptr_call *p;
+
+   if (tc_calls_driver_directly(tc)) {
+      tc->pipe->stream_output_target_destroy(tc->pipe, target);
+      return;
+   }
+
+   p = tc_add_struct(tc, tc_call_stream_output_target_destroy,
+                     struct tc_ptr_call);
+   p->ptr = target;
+}
+
+
+struct tc_so_targets
+{
+   struct tc_call base;
+   unsigned count;
+   struct pipe_stream_output_target *targets[PIPE_MAX_SO_BUFFERS];
+   unsigned offsets[PIPE_MAX_SO_BUFFERS];
+};
+
+static void
+tc_call_set_stream_output_targets(struct threaded_context *tc,
+                                  struct tc_call *call)
+{
+   struct tc_so_targets *p = (struct tc_so_targets *) call;
+   unsigned i;
+
+   tc->pipe->set_stream_output_targets(tc->pipe, p->count, p->targets,
+                                       p->offsets);
+   for (i = 0; i < p->count; i++)
+      pipe_so_target_reference(&p->targets[i], NULL);
+}
+
+static void
+tc_set_stream_output_targets(struct pipe_context *_pipe, unsigned count,
+                             struct pipe_stream_output_target **targets,
+                             const unsigned *offsets)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_so_targets *p =
+      tc_add_struct(tc, tc_call_set_stream_output_targets,
+                    struct tc_so_targets);
+   unsigned i;
+
+   assert(count <= PIPE_MAX_SO_BUFFERS);
+
+   p->count = count;
+   for (i = 0; i < count; i++) {
+      p->targets[i] = NULL;
+      pipe_so_target_reference(&p->targets[i], targets[i]);
+      p->offsets[i] = offsets ? offsets[i] : 0;
+   }
+   for (i = 0; i < PIPE_MAX_SO_BUFFERS; i++) {
+      struct pipe_stream_output_target *target =
+         i < count ? targets[i] : NULL;
+
+      tc_bind(tc, &tc->bound.so_targets[i], target ? target->buffer : NULL);
+   }
+}
+
+
+/*
+ * Drawing, clears and blits.
+ */
+
+struct tc_draw_vbo
+{
+   struct tc_call base;
+   struct pipe_draw_info info;
+};
+
+static void
+tc_call_draw_vbo(struct threaded_context *tc, struct tc_call *call)
+{
+   struct tc_draw_vbo *p = (struct tc_draw_vbo *) call;
+
+   tc->pipe->draw_vbo(tc->pipe, &p->info);
+   pipe_so_target_reference(&p->info.count_from_stream_output, NULL);
+   pipe_resource_reference(&p->info.indirect, NULL);
+}
+
+static void
+tc_draw_vbo(struct pipe_context *_pipe, const struct pipe_draw_info *info)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_draw_vbo *p =
+      tc_add_struct(tc, tc_call_draw_vbo, struct tc_draw_vbo);
+
+   p->info = *info;
+   p->info.count_from_stream_output = NULL;
+   p->info.indirect = NULL;
+   pipe_so_target_reference(&p->info.count_from_stream_output,
+                            info->count_from_stream_output);
+   if (info->count_from_stream_output)
+      tc_mark_busy(tc, info->count_from_stream_output->buffer);
+   tc_set_resource(tc, &p->info.indirect, info->indirect);
+   tc->last_draw = tc->submitted;
+}
+
+
+struct tc_resource_copy_region
+{
+   struct tc_call base;
+   struct pipe_resource *dst;
+   unsigned dst_level;
+   unsigned dstx, dsty, dstz;
+   struct pipe_resource *src;
+   unsigned src_level;
+   struct pipe_box src_box;
+};
+
+static void
+tc_call_resource_copy_region(struct threaded_context *tc,
+                             struct tc_call *call)
+{
+   struct tc_resource_copy_region *p =
+      (struct tc_resource_copy_region *) call;
+
+   tc->pipe->resource_copy_region(tc->pipe, p->dst, p->dst_level,
+                                  p->dstx, p->dsty, p->dstz,
+                                  p->src, p->src_level, &p->src_box);
+   pipe_resource_reference(&p->dst, NULL);
+   pipe_resource_reference(&p->src, NULL);
+}
+
+static void
+tc_resource_copy_region(struct pipe_context *_pipe,
+                        struct pipe_resource *dst, unsigned dst_level,
+                        unsigned dstx, unsigned dsty, unsigned dstz,
+                        struct pipe_resource *src, unsigned src_level,
+                        const struct pipe_box *src_box)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_resource_copy_region *p =
+      tc_add_struct(tc, tc_call_resource_copy_region,
+                    struct tc_resource_copy_region);
+
+   p->dst = NULL;
+   tc_set_resource(tc, &p->dst, dst);
+   p->dst_level = dst_level;
+   p->dstx = dstx;
+   p->dsty = dsty;
+   p->dstz = dstz;
+   p->src = NULL;
+   tc_set_resource(tc, &p->src, src);
+   p->src_level = src_level;
+   p->src_box = *src_box;
+}
+
+
+struct tc_blit
+{
+   struct tc_call base;
+   struct pipe_blit_info info;
+};
+
+static void
+tc_call_blit(struct threaded_context *tc, struct tc_call *call)
+{
+   struct tc_blit *p = (struct tc_blit *) call;
+
+   tc->pipe->blit(tc->pipe, &p->info);
+   pipe_resource_reference(&p->info.dst.resource, NULL);
+   pipe_resource_reference(&p->info.src.resource, NULL);
+}
+
+static void
+tc_blit(struct pipe_context *_pipe, const struct pipe_blit_info *info)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_blit *p = tc_add_struct(tc, tc_call_blit, struct tc_blit);
+
+   p->info = *info;
+   p->info.dst.resource = NULL;
+   p->info.src.resource = NULL;
+   tc_set_resource(tc, &p->info.dst.resource, info->dst.resource);
+   tc_set_resource(tc, &p->info.src.resource, info->src.resource);
+}
+
+
+struct tc_clear
+{
+   struct tc_call base;
+   unsigned buffers;
+   union pipe_color_union color;
+   double depth;
+   unsigned stencil;
+};
+
+static void
+tc_call_clear(struct threaded_context *tc, struct tc_call *call)
+{
+   struct tc_clear *p = (struct tc_clear *) call;
+
+   tc->pipe->clear(tc->pipe, p->buffers, &p->color, p->depth, p->stencil);
+}
+
+static void
+tc_clear(struct pipe_context *_pipe, unsigned buffers,
+         const union pipe_color_union *color, double depth, unsigned stencil)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_clear *p = tc_add_struct(tc, tc_call_clear, struct tc_clear);
+
+   p->buffers = buffers;
+   if (color)
+      p->color = *color;
+   else
+      memset(&p->color, 0, sizeof p->color);
+   p->depth = depth;
+   p->stencil = stencil;
+   tc->last_draw = tc->submitted;
+}
+
+
+struct tc_clear_render_target
+{
+   struct tc_call base;
+   struct pipe_surface *dst;
+   union pipe_color_union color;
+   unsigned dstx, dsty, width, height;
+};
+
+static void
+tc_call_clear_render_target(struct threaded_context *tc, struct tc_call *call)
+{
+   struct tc_clear_render_target *p = (struct tc_clear_render_target *) call;
+
+   tc->pipe->clear_render_target(tc->pipe, p->dst, &p->color,
+                                 p->dstx, p->dsty, p->width, p->height);
+   pipe_surface_reference(&p->dst, NULL);
+}
+
+static void
+tc_clear_render_target(struct pipe_context *_pipe, struct pipe_surface *dst,
+                       const union pipe_color_union *color,
+                       unsigned dstx, unsigned dsty,
+                       unsigned width, unsigned height)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_clear_render_target *p =
+      tc_add_struct(tc, tc_call_clear_render_target,
+                    struct tc_clear_render_target);
+
+   p->dst = NULL;
+   pipe_surface_reference(&p->dst, dst);
+   tc_mark_busy(tc, dst->texture);
+   p->color = *color;
+   p->dstx = dstx;
+   p->dsty = dsty;
+   p->width = width;
+   p->height = height;
+}
+
+
+struct tc_clear_depth_stencil
+{
+   struct tc_call base;
+   struct pipe_surface *dst;
+   unsigned clear_flags;
+   double depth;
+   unsigned stencil;
+   unsigned dstx, dsty, width, height;
+};
+
+static void
+tc_call_clear_depth_stencil(struct threaded_context *tc, struct tc_call *call)
+{
+   struct tc_clear_depth_stencil *p = (struct tc_clear_depth_stencil *) call;
+
+   tc->pipe->clear_depth_stencil(tc->pipe, p->dst, p->clear_flags,
+                                 p->depth, p->stencil,
+                                 p->dstx, p->dsty, p->width, p->height);
+   pipe_surface_reference(&p->dst, NULL);
+}
+
+static void
+tc_clear_depth_stencil(struct pipe_context *_pipe, struct pipe_surface *dst,
+                       unsigned clear_flags, double depth, unsigned stencil,
+                       unsigned dstx, unsigned dsty,
+                       unsigned width, unsigned height)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_clear_depth_stencil *p =
+      tc_add_struct(tc, tc_call_clear_depth_stencil,
+                    struct tc_clear_depth_stencil);
+
+   p->dst = NULL;
+   pipe_surface_reference(&p->dst, dst);
+   tc_mark_busy(tc, dst->texture);
+   p->clear_flags = clear_flags;
+   p->depth = depth;
+   p->stencil = stencil;
+   p->dstx = dstx;
+   p->dsty = dsty;
+   p->width = width;
+   p->height = height;
+}
+
+
+struct tc_clear_buffer
+{
+   struct tc_call base;
+   struct pipe_resource *res;
+   unsigned offset, size;
+   int clear_value_size;
+   uint32_t clear_value[4];
+};
+
+static void
+tc_call_clear_buffer(struct threaded_context *tc, struct tc_call *call)
+{
+   struct tc_clear_buffer *p = (struct tc_clear_buffer *) call;
+
+   tc->pipe->clear_buffer(tc->pipe, p->res, p->offset, p->size,
+                          p->clear_value, p->clear_value_size);
+   pipe_resource_reference(&p->res, NULL);
+}
+
+static void
+tc_clear_buffer(struct pipe_context *_pipe, struct pipe_resource *res,
+                unsigned offset, unsigned size,
+                const void *clear_value, int clear_value_size)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_clear_buffer *p =
+      tc_add_struct(tc, tc_call_clear_buffer, struct tc_clear_buffer);
+
+   assert(clear_value_size <= (int) sizeof p->clear_value);
+
+   p->res = NULL;
+   tc_set_resource(tc, &p->res, res);
+   p->offset = offset;
+   p->size = size;
+   p->clear_value_size = clear_value_size;
+   memcpy(p->clear_value, clear_value, clear_value_size);
+}
+
+
+static void
+tc_call_flush(struct threaded_context *tc, struct tc_call *call)
+{
+   tc->pipe->flush(tc->pipe, NULL, ((struct tc_uint_call *) call)->value);
+}
+
+/**
+ * Flushes without a fence are recorded like anything else, and start the
+ * driver thread on the current batch.  A fence has to be returned now, so
+ * that case waits for the driver thread.
+ */
+static void
+tc_flush(struct pipe_context *_pipe, struct pipe_fence_handle **fence,
+         unsigned flags)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_uint_call *p;
+
+   if (fence) {
+      tc_sync(tc);
+      tc->pipe->flush(tc->pipe, fence, flags);
+      return;
+   }
+
+   p = tc_add_struct(tc, tc_call_flush, struct tc_uint_call);
+   p->value = flags;
+   tc_submit_batch(tc);
+}
+
+
+static void
+tc_get_sample_position(struct pipe_context *_pipe, unsigned sample_count,
+                       unsigned sample_index, float *out_value)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+
+   tc_sync(tc);
+   tc->pipe->get_sample_position(tc->pipe, sample_count, sample_index,
+                                 out_value);
+}
+
+
+/*
+ * Transfers.
+ */
+
+/**
+ * Layout of a tightly packed copy of the given box of the resource.
+ * \return size in bytes
+ */
+static unsigned
+tc_packed_layout(struct pipe_resource *resource, const struct pipe_box *box,
+                 unsigned *stride, unsigned *layer_stride)
+{
+   if (resource->target == PIPE_BUFFER) {
+      *stride = box->width;
+      *layer_stride = box->width;
+      return box->width;
+   }
+
+   *stride = util_format_get_stride(resource->format, box->width);
+   *layer_stride = *stride * util_format_get_nblocksy(resource->format,
+                                                      box->height);
+   return *layer_stride * box->depth;
+}
+
+
+struct tc_transfer_write
+{
+   struct tc_call base;
+   struct pipe_resource *resource;
+   unsigned level, usage;
+   struct pipe_box box;
+   unsigned stride, layer_stride;
+   void *data;                  /**< align_malloc'ed, freed after the call */
+};
+
+static void
+tc_call_transfer_write(struct threaded_context *tc, struct tc_call *call)
+{
+   struct tc_transfer_write *p = (struct tc_transfer_write *) call;
+
+   tc->pipe->transfer_inline_write(tc->pipe, p->resource, p->level,
+                                   p->usage, &p->box, p->data,
+                                   p->stride, p->layer_stride);
+   pipe_resource_reference(&p->resource, NULL);
+   align_free(p->data);
+}
+
+/**
+ * Record a write of tightly packed data to the resource.  The data
+ * becomes owned by the recorded call.
+ */
+static void
+tc_record_write(struct threaded_context *tc, struct pipe_resource *resource,
+                unsigned level, unsigned usage, const struct pipe_box *box,
+                void *data, unsigned stride, unsigned layer_stride)
+{
+   struct tc_transfer_write *p =
+      tc_add_struct(tc, tc_call_transfer_write, struct tc_transfer_write);
+
+   p->resource = NULL;
+   tc_set_resource(tc, &p->resource, resource);
+   p->level = level;
+   p->usage = PIPE_TRANSFER_WRITE |
+              (usage & (PIPE_TRANSFER_DISCARD_RANGE |
+                        PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE |
+                        PIPE_TRANSFER_UNSYNCHRONIZED));
+   p->box = *box;
+   p->data = data;
+   p->stride = stride;
+   p->layer_stride = layer_stride;
+}
+
+
+/**
+ * Whether a map can be staged: the caller only writes, and either every
+ * byte of the range is going to be replaced or only explicitly flushed
+ * ranges of a buffer matter.  Anything else needs the current contents.
+ */
+static boolean
+tc_can_stage(struct pipe_resource *resource, unsigned usage)
+{
+   if ((usage & (PIPE_TRANSFER_READ |
+                 PIPE_TRANSFER_WRITE |
+                 PIPE_TRANSFER_MAP_DIRECTLY |
+                 PIPE_TRANSFER_PERSISTENT |
+                 PIPE_TRANSFER_COHERENT)) != PIPE_TRANSFER_WRITE)
+      return FALSE;
+
+   if (resource->nr_samples > 1)
+      return FALSE;
+
+   if (usage & (PIPE_TRANSFER_DISCARD_RANGE |
+                PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE))
+      return !(usage & PIPE_TRANSFER_FLUSH_EXPLICIT) ||
+             resource->target == PIPE_BUFFER;
+
+   return (usage & PIPE_TRANSFER_FLUSH_EXPLICIT) &&
+          resource->target == PIPE_BUFFER;
+}
+
+
+static void *
+tc_transfer_map(struct pipe_context *_pipe,
+                struct pipe_resource *resource, unsigned level,
+                unsigned usage, const struct pipe_box *box,
+                struct pipe_transfer **out_transfer)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_transfer *ttrans;
+   struct pipe_transfer *transfer;
+   void *map;
+
+   ttrans = CALLOC_STRUCT(tc_transfer);
+   if (!ttrans)
+      return NULL;
+
+   if (tc_can_stage(resource, usage)) {
+      unsigned size = tc_packed_layout(resource, box, &ttrans->base.stride,
+                                       &ttrans->base.layer_stride);
+
+      ttrans->staging = align_malloc(MAX2(size, 1), 64);
+      if (!ttrans->staging) {
+         FREE(ttrans);
+         return NULL;
+      }
+
+      pipe_resource_reference(&ttrans->base.resource, resource);
+      ttrans->base.level = level;
+      ttrans->base.usage = usage;
+      ttrans->base.box = *box;
+      tc->stats.staged_bytes += size;
+
+      *out_transfer = &ttrans->base;
+      return ttrans->staging;
+   }
+
+   if (tc_is_busy(tc, resource)) {
+      tc_sync(tc);
+      map = tc->pipe->transfer_map(tc->pipe, resource, level, usage, box,
+                                   &transfer);
+   }
+   else {
+      /* Nothing recorded uses the resource, so the map may overtake the
+       * queued calls.  Just keep out of the driver thread's way.
+       */
+      pipe_mutex_lock(tc->driver_mutex);
+      map = tc->pipe->transfer_map(tc->pipe, resource, level, usage, box,
+                                   &transfer);
+      pipe_mutex_unlock(tc->driver_mutex);
+      tc->stats.unsynced_maps++;
+   }
+   if (!map) {
+      FREE(ttrans);
+      return NULL;
+   }
+
+   /* The driver transfer holds the resource reference */
+   ttrans->base = *transfer;
+   ttrans->transfer = transfer;
+
+   *out_transfer = &ttrans->base;
+   return map;
+}
+
+
+struct tc_transfer_flush_region
+{
+   struct tc_call base;
+   struct pipe_transfer *transfer;
+   struct pipe_box box;
+};
+
+static void
+tc_call_transfer_flush_region(struct threaded_context *tc,
+                              struct tc_call *call)
+{
+   struct tc_transfer_flush_region *p =
+      (struct tc_transfer_flush_region *) call;
+
+   tc->pipe->transfer_flush_region(tc->pipe, p->transfer, &p->box);
+}
+
+static void
+tc_transfer_flush_region(struct pipe_context *_pipe,
+                         struct pipe_transfer *transfer,
+                         const struct pipe_box *box)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_transfer *ttrans = (struct tc_transfer *) transfer;
+
+   if (ttrans->staging) {
+      /* Staged explicit flushes are only done for buffers.  The box is
+       * relative to the mapped range.
+       */
+      struct pipe_box dst_box;
+      void *data;
+
+      assert(transfer->resource->target == PIPE_BUFFER);
+      if (!box->width)
+         return;
+
+      data = align_malloc(box->width, 64);
+      if (!data)
+         return;
+      memcpy(data, (uint8_t *) ttrans->staging + box->x, box->width);
+
+      u_box_1d(transfer->box.x + box->x, box->width, &dst_box);
+      tc_record_write(tc, transfer->resource, transfer->level,
+                      transfer->usage, &dst_box, data,
+                      box->width, box->width);
+      return;
+   }
+
+   {
+      struct tc_transfer_flush_region *p =
+         tc_add_struct(tc, tc_call_transfer_flush_region,
+                       struct tc_transfer_flush_region);
+
+      p->transfer = ttrans->transfer;
+      p->box = *box;
+      tc_mark_busy(tc, transfer->resource);
+   }
+}
+
+
+static void
+tc_call_transfer_unmap(struct threaded_context *tc, struct tc_call *call)
+{
+   struct pipe_transfer *transfer =
+      (struct pipe_transfer *) ((struct tc_ptr_call *) call)->ptr;
+
+   tc->pipe->transfer_unmap(tc->pipe, transfer);
+}
+
+static void
+tc_transfer_unmap(struct pipe_context *_pipe, struct pipe_transfer *transfer)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct tc_transfer *ttrans = (struct tc_transfer *) transfer;
+
+   if (ttrans->staging) {
+      if (transfer->usage & PIPE_TRANSFER_FLUSH_EXPLICIT)
+         align_free(ttrans->staging);
+      else
+         tc_record_write(tc, transfer->resource, transfer->level,
+                         transfer->usage, &transfer->box, ttrans->staging,
+                         transfer->stride, transfer->layer_stride);
+      pipe_resource_reference(&transfer->resource, NULL);
+   }
+   else {
+      struct tc_ptr_call *p =
+         tc_add_struct(tc, tc_call_transfer_unmap, struct tc_ptr_call);
+
+      p->ptr = ttrans->transfer;
+      tc_mark_busy(tc, transfer->resource);
+   }
+
+   FREE(ttrans);
+}
+
+
+/**
+ * Inline writes are recorded with a tightly packed copy of the data.
+ */
+static void
+tc_transfer_inline_write(struct pipe_context *_pipe,
+                         struct pipe_resource *resource,
+                         unsigned level, unsigned usage,
+                         const struct pipe_box *box,
+                         const void *data,
+                         unsigned stride, unsigned layer_stride)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   unsigned packed_stride, packed_layer_stride, size;
+   void *copy;
+
+   size = tc_packed_layout(resource, box, &packed_stride,
+                           &packed_layer_stride);
+   if (!size)
+      return;
+
+   copy = align_malloc(size, 64);
+   if (!copy)
+      return;
+
+   if (resource->target == PIPE_BUFFER)
+      memcpy(copy, data, size);
+   else
+      util_copy_box(copy, resource->format,
+                    packed_stride, packed_layer_stride, 0, 0, 0,
+                    box->width, box->height, box->depth,
+                    data, stride, layer_stride, 0, 0, 0);
+
+   tc->stats.staged_bytes += size;
+   tc_record_write(tc, resource, level, usage, box, copy,
+                   packed_stride, packed_layer_stride);
+}
+
+
+/*
+ * Context.
+ */
+
+static void
+tc_destroy(struct pipe_context *_pipe)
+{
+   struct threaded_context *tc = threaded_context(_pipe);
+   struct pipe_context *pipe = tc->pipe;
+   unsigned i, j;
+
+   if (tc_current_batch(tc)->used)
+      tc_submit_batch(tc);
+
+   pipe_mutex_lock(tc->mutex);
+   tc->shutdown = TRUE;
+   pipe_condvar_signal(tc->batch_submitted);
+   pipe_mutex_unlock(tc->mutex);
+   pipe_thread_wait(tc->thread);
+
+   /* The driver releases its bindings in destroy, which ends up in our
+    * sampler view, surface and stream output target destroy hooks.
+    */
+   tc->stopped = TRUE;
+
+   if (tc->print_stats) {
+      debug_printf("threaded: %llu calls in %llu batches, %llu syncs, "
+                   "%llu unsynchronized maps, %llu bytes staged\n",
+                   (unsigned long long) tc->stats.calls,
+                   (unsigned long long) tc->stats.batches,
+                   (unsigned long long) tc->stats.syncs,
+                   (unsigned long long) tc->stats.unsynced_maps,
+                   (unsigned long long) tc->stats.staged_bytes);
+   }
+
+   pipe->destroy(pipe);
+
+   for (i = 0; i < PIPE_SHADER_TYPES; i++)
+      for (j = 0; j < PIPE_MAX_CONSTANT_BUFFERS; j++)
+         FREE(tc->user_constants[i][j]);
+
+   _mesa_hash_table_destroy(tc->busy, NULL);
+   pipe_condvar_destroy(tc->batch_executed);
+   pipe_condvar_destroy(tc->batch_submitted);
+   pipe_mutex_destroy(tc->driver_mutex);
+   pipe_mutex_destroy(tc->mutex);
+   FREE(tc);
+}
+
+
+struct pipe_context *
+threaded_context_create(struct threaded_screen *tscreen,
+                        struct pipe_context *pipe)
+{
+   struct threaded_context *tc;
+
+   tc = CALLOC_STRUCT(threaded_context);
+   if (!tc)
+      return pipe;
+
+   tc->busy = _mesa_hash_table_create(NULL, _mesa_hash_pointer,
+                                      _mesa_key_pointer_equal);
+   if (!tc->busy) {
+      FREE(tc);
+      return pipe;
+   }
+
+   tc->base.priv = pipe->priv;
+   tc->base.screen = &tscreen->base;
+   tc->base.destroy = tc_destroy;
+
+#define TC_CTX_INIT(_member) \
+   tc->base._member = pipe->_member ? tc_##_member : NULL
+
+   TC_CTX_INIT(draw_vbo);
+   TC_CTX_INIT(render_condition);
+   TC_CTX_INIT(create_query);
+   TC_CTX_INIT(destroy_query);
+   TC_CTX_INIT(begin_query);
+   TC_CTX_INIT(end_query);
+   TC_CTX_INIT(get_query_result);
+   TC_CTX_INIT(create_blend_state);
+   TC_CTX_INIT(bind_blend_state);
+   TC_CTX_INIT(delete_blend_state);
+   TC_CTX_INIT(create_sampler_state);
+   TC_CTX_INIT(bind_sampler_states);
+   TC_CTX_INIT(delete_sampler_state);
+   TC_CTX_INIT(create_rasterizer_state);
+   TC_CTX_INIT(bind_rasterizer_state);
+   TC_CTX_INIT(delete_rasterizer_state);
+   TC_CTX_INIT(create_depth_stencil_alpha_state);
+   TC_CTX_INIT(bind_depth_stencil_alpha_state);
+   TC_CTX_INIT(delete_depth_stencil_alpha_state);
+   TC_CTX_INIT(create_fs_state);
+   TC_CTX_INIT(bind_fs_state);
+   TC_CTX_INIT(delete_fs_state);
+   TC_CTX_INIT(create_vs_state);
+   TC_CTX_INIT(bind_vs_state);
+   TC_CTX_INIT(delete_vs_state);
+   TC_CTX_INIT(create_gs_state);
+   TC_CTX_INIT(bind_gs_state);
+   TC_CTX_INIT(delete_gs_state);
+   TC_CTX_INIT(create_vertex_elements_state);
+   TC_CTX_INIT(bind_vertex_elements_state);
+   TC_CTX_INIT(delete_vertex_elements_state);
+   TC_CTX_INIT(set_blend_color);
+   TC_CTX_INIT(set_stencil_ref);
+   TC_CTX_INIT(set_sample_mask);
+   TC_CTX_INIT(set_min_samples);
+   TC_CTX_INIT(set_clip_state);
+   TC_CTX_INIT(set_constant_buffer);
+   TC_CTX_INIT(set_framebuffer_state);
+   TC_CTX_INIT(set_polygon_stipple);
+   TC_CTX_INIT(set_scissor_states);
+   TC_CTX_INIT(set_viewport_states);
+   TC_CTX_INIT(set_sampler_views);
+   TC_CTX_INIT(set_vertex_buffers);
+   TC_CTX_INIT(set_index_buffer);
+   TC_CTX_INIT(create_stream_output_target);
+   TC_CTX_INIT(stream_output_target_destroy);
+   TC_CTX_INIT(set_stream_output_targets);
+   TC_CTX_INIT(resource_copy_region);
+   TC_CTX_INIT(blit);
+   TC_CTX_INIT(clear);
+   TC_CTX_INIT(clear_render_target);
+   TC_CTX_INIT(clear_depth_stencil);
+   TC_CTX_INIT(clear_buffer);
+   TC_CTX_INIT(flush);
+   TC_CTX_INIT(create_sampler_view);
+   TC_CTX_INIT(sampler_view_destroy);
+   TC_CTX_INIT(create_surface);
+   TC_CTX_INIT(surface_destroy);
+   TC_CTX_INIT(transfer_map);
+   TC_CTX_INIT(transfer_flush_region);
+   TC_CTX_INIT(transfer_unmap);
+   TC_CTX_INIT(transfer_inline_write);
+   TC_CTX_INIT(texture_barrier);
+   TC_CTX_INIT(memory_barrier);
+   TC_CTX_INIT(get_sample_position);
+   TC_CTX_INIT(flush_resource);
+   TC_CTX_INIT(invalidate_resource);
+
+#undef TC_CTX_INIT
+
+   /* Compute, video and shader resource entry points are left unset */
+
+   tc->pipe = pipe;
+   tc->print_stats = debug_get_bool_option("GALLIUM_THREADED_STATS", FALSE);
+
+   pipe_mutex_init(tc->mutex);
+   pipe_mutex_init(tc->driver_mutex);
+   pipe_condvar_init(tc->batch_submitted);
+   pipe_condvar_init(tc->batch_executed);
+
+   tc->thread = pipe_thread_create(tc_thread_func, tc);
+   if (!tc->thread) {
+      /* Run unthreaded rather than not at all */
+      pipe_condvar_destroy(tc->batch_executed);
+      pipe_condvar_destroy(tc->batch_submitted);
+      pipe_mutex_destroy(tc->driver_mutex);
+      pipe_mutex_destroy(tc->mutex);
+      _mesa_hash_table_destroy(tc->busy, NULL);
+      FREE(tc);
+      return pipe;
+   }
+
+   return &tc->base;
+}
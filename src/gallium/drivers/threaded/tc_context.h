@@ -0,0 +1,184 @@
+/**************************************************************************
+ *
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * \file tc_context.h
+ * Threaded pipe_context wrapper.
+ *
+ * The state tracker's calls are recorded into a small ring of command
+ * batches which a driver thread replays on the wrapped context, in order.
+ * Calls which must return something from the driver (object creation,
+ * query results, fences) first wait for the driver thread to drain the
+ * ring and then call the driver directly.  Non-staged maps only wait if
+ * recorded work still uses the resource; otherwise they take the driver
+ * mutex, so the driver context is never entered by both threads at once.
+ */
+
+#ifndef TC_CONTEXT_H
+#define TC_CONTEXT_H
+
+#include "pipe/p_context.h"
+#include "pipe/p_state.h"
+#include "os/os_thread.h"
+
+
+struct hash_table;
+struct threaded_context;
+struct threaded_screen;
+struct tc_call;
+
+
+/** Size of one command batch in bytes */
+#define TC_BATCH_SIZE (16 * 1024)
+
+/** Number of batches in the ring */
+#define TC_MAX_BATCHES 8
+
+
+typedef void (*tc_execute)(struct threaded_context *tc, struct tc_call *call);
+
+
+/**
+ * Header of every recorded call.  Calls are 8-byte aligned and size
+ * includes the header.
+ */
+struct tc_call
+{
+   tc_execute execute;
+   unsigned size;
+};
+
+
+struct tc_batch
+{
+   unsigned used;               /**< bytes of buffer in use */
+   uint64_t buffer[TC_BATCH_SIZE / 8];
+};
+
+
+/**
+ * Transfer handed out by the wrapper.  Staged transfers point the caller
+ * at a malloc'ed copy which is turned into a recorded write on flush or
+ * unmap; other transfers wrap a transfer the driver mapped directly.
+ */
+struct tc_transfer
+{
+   struct pipe_transfer base;
+   struct pipe_transfer *transfer;      /**< driver transfer, or NULL */
+   void *staging;                       /**< staging copy, or NULL */
+};
+
+
+struct threaded_context
+{
+   struct pipe_context base;
+
+   /** The wrapped driver context */
+   struct pipe_context *pipe;
+
+   pipe_thread thread;
+   pipe_mutex mutex;
+   pipe_condvar batch_submitted;        /**< submitted or shutdown changed */
+   pipe_condvar batch_executed;         /**< executed changed */
+
+   /** Held while a thread is inside the driver context */
+   pipe_mutex driver_mutex;
+
+   /**
+    * Batch sequence numbers, protected by the mutex.  Batch n lives in
+    * batches[n % TC_MAX_BATCHES]; batch number 'submitted' is the one the
+    * application thread is recording into.
+    */
+   uint64_t submitted;
+   uint64_t executed;
+   boolean shutdown;
+
+   /**
+    * Set once the driver thread has been joined in tc_destroy.  From then
+    * on the destroy hooks the driver reaches through view->context and
+    * friends call the driver directly instead of recording.
+    */
+   boolean stopped;
+
+   struct tc_batch batches[TC_MAX_BATCHES];
+
+   /**
+    * Number of the last batch which uses each resource, keyed by
+    * pipe_resource pointer.  Only entries for batches which haven't
+    * executed yet matter; older ones are dropped now and then.
+    * Application thread only.
+    */
+   struct hash_table *busy;
+
+   /**
+    * Resources bound in the driver once everything recorded so far has
+    * executed.  Weak pointers, only compared against.  Application thread
+    * only.
+    */
+   struct {
+      struct pipe_resource *vertex_buffers[PIPE_MAX_ATTRIBS];
+      struct pipe_resource *index_buffer;
+      struct pipe_resource *constant_buffers[PIPE_SHADER_TYPES][PIPE_MAX_CONSTANT_BUFFERS];
+      struct pipe_resource *sampler_views[PIPE_SHADER_TYPES][PIPE_MAX_SHADER_SAMPLER_VIEWS];
+      struct pipe_resource *framebuffer[PIPE_MAX_COLOR_BUFS + 1];
+      struct pipe_resource *so_targets[PIPE_MAX_SO_BUFFERS];
+   } bound;
+
+   /** Last batch with a call which uses the bound resources (draws, clears) */
+   uint64_t last_draw;
+
+   /**
+    * Copies of user constant buffers currently bound in the driver.
+    * Only touched by the driver thread.
+    */
+   void *user_constants[PIPE_SHADER_TYPES][PIPE_MAX_CONSTANT_BUFFERS];
+
+   /* Statistics, application thread only */
+   struct {
+      uint64_t calls;
+      uint64_t batches;
+      uint64_t syncs;
+      uint64_t unsynced_maps;
+      uint64_t staged_bytes;
+   } stats;
+   boolean print_stats;
+};
+
+
+static INLINE struct threaded_context *
+threaded_context(struct pipe_context *pipe)
+{
+   return (struct threaded_context *) pipe;
+}
+
+
+struct pipe_context *
+threaded_context_create(struct threaded_screen *tscreen,
+                        struct pipe_context *pipe);
+
+
+#endif /* TC_CONTEXT_H */
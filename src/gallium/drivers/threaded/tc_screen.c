@@ -0,0 +1,361 @@
+/**************************************************************************
+ *
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * \file tc_screen.c
+ * Screen of the threaded wrapper driver.
+ *
+ * Screen functions are thread safe in the drivers this is used with
+ * (llvmpipe, softpipe), so they are simply forwarded; resources, fences
+ * and queries are the driver's own objects.  Only context creation is
+ * intercepted, plus a few caps: user vertex and index buffers are turned
+ * off because the size of the client memory they point at isn't known when
+ * the call is recorded, so the state tracker uploads them instead.
+ */
+
+#include "util/u_debug.h"
+#include "util/u_memory.h"
+
+#include "tc_context.h"
+#include "tc_public.h"
+#include "tc_screen.h"
+
+
+static void
+tc_screen_destroy(struct pipe_screen *_screen)
+{
+   struct threaded_screen *tscreen = threaded_screen(_screen);
+   struct pipe_screen *screen = tscreen->screen;
+
+   screen->destroy(screen);
+   FREE(tscreen);
+}
+
+
+static const char *
+tc_screen_get_name(struct pipe_screen *_screen)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->get_name(screen);
+}
+
+
+static const char *
+tc_screen_get_vendor(struct pipe_screen *_screen)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->get_vendor(screen);
+}
+
+
+static const char *
+tc_screen_get_device_vendor(struct pipe_screen *_screen)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->get_device_vendor(screen);
+}
+
+
+static int
+tc_screen_get_param(struct pipe_screen *_screen, enum pipe_cap param)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   switch (param) {
+   case PIPE_CAP_USER_VERTEX_BUFFERS:
+   case PIPE_CAP_USER_INDEX_BUFFERS:
+      return 0;
+   default:
+      return screen->get_param(screen, param);
+   }
+}
+
+
+static float
+tc_screen_get_paramf(struct pipe_screen *_screen, enum pipe_capf param)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->get_paramf(screen, param);
+}
+
+
+static int
+tc_screen_get_shader_param(struct pipe_screen *_screen, unsigned shader,
+                           enum pipe_shader_cap param)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->get_shader_param(screen, shader, param);
+}
+
+
+static int
+tc_screen_get_video_param(struct pipe_screen *_screen,
+                          enum pipe_video_profile profile,
+                          enum pipe_video_entrypoint entrypoint,
+                          enum pipe_video_cap param)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->get_video_param(screen, profile, entrypoint, param);
+}
+
+
+static int
+tc_screen_get_compute_param(struct pipe_screen *_screen,
+                            enum pipe_compute_cap param, void *ret)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->get_compute_param(screen, param, ret);
+}
+
+
+static uint64_t
+tc_screen_get_timestamp(struct pipe_screen *_screen)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->get_timestamp(screen);
+}
+
+
+static struct pipe_context *
+tc_screen_context_create(struct pipe_screen *_screen, void *priv)
+{
+   struct threaded_screen *tscreen = threaded_screen(_screen);
+   struct pipe_screen *screen = tscreen->screen;
+   struct pipe_context *pipe;
+
+   pipe = screen->context_create(screen, priv);
+   if (!pipe)
+      return NULL;
+
+   return threaded_context_create(tscreen, pipe);
+}
+
+
+static boolean
+tc_screen_is_format_supported(struct pipe_screen *_screen,
+                              enum pipe_format format,
+                              enum pipe_texture_target target,
+                              unsigned sample_count,
+                              unsigned bindings)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->is_format_supported(screen, format, target, sample_count,
+                                      bindings);
+}
+
+
+static boolean
+tc_screen_is_video_format_supported(struct pipe_screen *_screen,
+                                    enum pipe_format format,
+                                    enum pipe_video_profile profile,
+                                    enum pipe_video_entrypoint entrypoint)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->is_video_format_supported(screen, format, profile,
+                                            entrypoint);
+}
+
+
+static boolean
+tc_screen_can_create_resource(struct pipe_screen *_screen,
+                              const struct pipe_resource *templat)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->can_create_resource(screen, templat);
+}
+
+
+static struct pipe_resource *
+tc_screen_resource_create(struct pipe_screen *_screen,
+                          const struct pipe_resource *templat)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->resource_create(screen, templat);
+}
+
+
+static struct pipe_resource *
+tc_screen_resource_from_handle(struct pipe_screen *_screen,
+                               const struct pipe_resource *templat,
+                               struct winsys_handle *handle)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->resource_from_handle(screen, templat, handle);
+}
+
+
+static struct pipe_resource *
+tc_screen_resource_from_user_memory(struct pipe_screen *_screen,
+                                    const struct pipe_resource *templat,
+                                    void *user_memory)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->resource_from_user_memory(screen, templat, user_memory);
+}
+
+
+static boolean
+tc_screen_resource_get_handle(struct pipe_screen *_screen,
+                              struct pipe_resource *resource,
+                              struct winsys_handle *handle)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->resource_get_handle(screen, resource, handle);
+}
+
+
+static void
+tc_screen_resource_destroy(struct pipe_screen *_screen,
+                           struct pipe_resource *resource)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   screen->resource_destroy(screen, resource);
+}
+
+
+static void
+tc_screen_flush_frontbuffer(struct pipe_screen *_screen,
+                            struct pipe_resource *resource,
+                            unsigned level, unsigned layer,
+                            void *winsys_drawable_handle,
+                            struct pipe_box *subbox)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   screen->flush_frontbuffer(screen, resource, level, layer,
+                             winsys_drawable_handle, subbox);
+}
+
+
+static void
+tc_screen_fence_reference(struct pipe_screen *_screen,
+                          struct pipe_fence_handle **ptr,
+                          struct pipe_fence_handle *fence)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   screen->fence_reference(screen, ptr, fence);
+}
+
+
+static boolean
+tc_screen_fence_signalled(struct pipe_screen *_screen,
+                          struct pipe_fence_handle *fence)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->fence_signalled(screen, fence);
+}
+
+
+static boolean
+tc_screen_fence_finish(struct pipe_screen *_screen,
+                       struct pipe_fence_handle *fence,
+                       uint64_t timeout)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->fence_finish(screen, fence, timeout);
+}
+
+
+static int
+tc_screen_get_driver_query_info(struct pipe_screen *_screen,
+                                unsigned index,
+                                struct pipe_driver_query_info *info)
+{
+   struct pipe_screen *screen = threaded_screen(_screen)->screen;
+
+   return screen->get_driver_query_info(screen, index, info);
+}
+
+
+struct pipe_screen *
+threaded_screen_create(struct pipe_screen *screen)
+{
+   struct threaded_screen *tscreen;
+
+   if (!screen)
+      return screen;
+
+   if (!debug_get_bool_option("GALLIUM_THREADED", FALSE))
+      return screen;
+
+   tscreen = CALLOC_STRUCT(threaded_screen);
+   if (!tscreen)
+      return screen;
+
+#define TC_SCR_INIT(_member) \
+   tscreen->base._member = screen->_member ? tc_screen_##_member : NULL
+
+   TC_SCR_INIT(destroy);
+   TC_SCR_INIT(get_name);
+   TC_SCR_INIT(get_vendor);
+   TC_SCR_INIT(get_device_vendor);
+   TC_SCR_INIT(get_param);
+   TC_SCR_INIT(get_paramf);
+   TC_SCR_INIT(get_shader_param);
+   TC_SCR_INIT(get_video_param);
+   TC_SCR_INIT(get_compute_param);
+   TC_SCR_INIT(get_timestamp);
+   TC_SCR_INIT(context_create);
+   TC_SCR_INIT(is_format_supported);
+   TC_SCR_INIT(is_video_format_supported);
+   TC_SCR_INIT(can_create_resource);
+   TC_SCR_INIT(resource_create);
+   TC_SCR_INIT(resource_from_handle);
+   TC_SCR_INIT(resource_from_user_memory);
+   TC_SCR_INIT(resource_get_handle);
+   TC_SCR_INIT(resource_destroy);
+   TC_SCR_INIT(flush_frontbuffer);
+   TC_SCR_INIT(fence_reference);
+   TC_SCR_INIT(fence_signalled);
+   TC_SCR_INIT(fence_finish);
+   TC_SCR_INIT(get_driver_query_info);
+
+#undef TC_SCR_INIT
+
+   tscreen->screen = screen;
+
+   return &tscreen->base;
+}
@@ -101,6 +101,22 @@ struct sw_winsys
                                  struct winsys_handle *whandle,
                                  unsigned *stride );
 
+   /**
+    * Create a display target around memory owned by the caller, which must
+    * stay valid until the display target is destroyed.  Rows are stride
+    * bytes apart.  Used to implement resource_from_user_memory for
+    * textures.
+    *
+    * Optional, may be NULL.
+    */
+   struct sw_displaytarget *
+   (*displaytarget_create_mapped)( struct sw_winsys *ws,
+                                   unsigned tex_usage,
+                                   enum pipe_format format,
+                                   unsigned width, unsigned height,
+                                   unsigned stride,
+                                   void *data );
+
    /**
     * Used to implement texture_get_handle.
     */
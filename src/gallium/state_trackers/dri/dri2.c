@@ -1251,6 +1251,10 @@ static __DRIimageExtension dri2ImageExtension = {
     .getCapabilities              = dri2_get_capabilities,
 };
 
+static const __DRInoErrorExtension dri2NoErrorExtension = {
+   .base = { __DRI2_NO_ERROR, 1 }
+};
+
 /*
  * Backend function init_screen.
  */
@@ -1262,6 +1266,7 @@ static const __DRIextension *dri_screen_extensions[] = {
    &dri2RendererQueryExtension.base,
    &dri2ConfigQueryExtension.base,
    &dri2ThrottleExtension.base,
+   &dri2NoErrorExtension.base,
    NULL
 };
 
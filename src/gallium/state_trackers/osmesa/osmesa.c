@@ -31,16 +31,24 @@
  * Otherwise we use softpipe.  The GALLIUM_DRIVER environment variable
  * may be set to "softpipe" or "llvmpipe" to override.
  *
- * With softpipe we could render directly into the user's buffer by using a
- * display target resource.  However, softpipe doesn't suport "upside-down"
- * rendering which would be needed for the OSMESA_Y_UP=TRUE case.
+ * When possible we render directly into the user's buffer, by wrapping it
+ * in a user memory display target (pipe_screen::resource_from_user_memory).
+ * That needs the buffer rows to be tightly packed (no OSMESA_ROW_LENGTH
+ * padding) and top-to-bottom (OSMESA_Y_UP=FALSE), since neither driver
+ * supports "upside-down" rendering, and llvmpipe additionally needs the
+ * width and height to be multiples of 4.  flush_front() then only has to
+ * wait for rendering to finish.
  *
- * With llvmpipe we could only render directly into the user's buffer when its
- * width and height is a multiple of the tile size (64 pixels).
+ * Otherwise we render into ordinary resources then copy the results to the
+ * user's buffer in the flush_front() function which is called when the app
+ * calls glFlush/Finish.  OSMESA_FORCE_COPY=1 always takes this path.
  *
- * Because of these constraints we always render into ordinary resources then
- * copy the results to the user's buffer in the flush_front() function which
- * is called when the app calls glFlush/Finish.
+ * All contexts share one pipe_screen, so with llvmpipe they share a single
+ * pool of rasterizer threads, which takes scenes from the contexts in the
+ * order they were flushed.  Contexts may be created, used and destroyed on
+ * different threads concurrently; each context only ever uses the
+ * osmesa_buffers it created.  Contexts created with a sharelist also share
+ * their shader and program objects.
  *
  * In general, the OSMesa interface is pretty ugly and not a good match
  * for Gallium.  But we're interested in doing the best we can to preserve
@@ -58,9 +66,12 @@
 #include "pipe/p_screen.h"
 #include "pipe/p_state.h"
 
+#include "os/os_thread.h"
+
 #include "util/u_atomic.h"
 #include "util/u_box.h"
 #include "util/u_debug.h"
+#include "util/u_inlines.h"
 #include "util/u_format.h"
 #include "util/u_memory.h"
 
@@ -87,6 +98,12 @@ struct osmesa_buffer
 
    void *map;
 
+   /** Is the color buffer rendered straight into map? */
+   boolean in_place;
+
+   /** The context that created the buffer, the only one using it */
+   struct osmesa_context *owner;
+
    struct osmesa_buffer *next;  /**< next in linked list */
 };
 
@@ -123,6 +140,15 @@ struct osmesa_context
  */
 static struct osmesa_buffer *BufferList = NULL;
 
+/**
+ * Protects BufferList and the st_api/st_manager singletons, so that
+ * contexts can be created and used on several threads at once.
+ */
+pipe_static_mutex(OSMesaMutex);
+
+
+DEBUG_GET_ONCE_BOOL_OPTION(osmesa_force_copy, "OSMESA_FORCE_COPY", FALSE)
+
 
 /**
  * Called from the ST manager.
@@ -143,7 +169,11 @@ get_st_api(void)
 {
    static struct st_api *stapi = NULL;
    if (!stapi) {
-      stapi = st_gl_api_create();
+      pipe_mutex_lock(OSMesaMutex);
+      if (!stapi) {
+         stapi = st_gl_api_create();
+      }
+      pipe_mutex_unlock(OSMesaMutex);
    }
    return stapi;
 }
@@ -157,12 +187,17 @@ get_st_manager(void)
 {
    static struct st_manager *stmgr = NULL;
    if (!stmgr) {
-      stmgr = CALLOC_STRUCT(st_manager);
-      if (stmgr) {
-         stmgr->screen = osmesa_create_screen();
-         stmgr->get_param = osmesa_st_get_param;
-         stmgr->get_egl_image = NULL;
-      }         
+      pipe_mutex_lock(OSMesaMutex);
+      if (!stmgr) {
+         struct st_manager *mgr = CALLOC_STRUCT(st_manager);
+         if (mgr) {
+            mgr->screen = osmesa_create_screen();
+            mgr->get_param = osmesa_st_get_param;
+            mgr->get_egl_image = NULL;
+         }
+         stmgr = mgr;
+      }
+      pipe_mutex_unlock(OSMesaMutex);
    }
    return stmgr;
 }
@@ -299,6 +334,45 @@ stfbi_to_osbuffer(struct st_framebuffer_iface *stfbi)
 }
 
 
+/**
+ * Can the color buffer of osbuffer be the user's memory itself, given the
+ * context's pixel store settings?  See the notes at the top of the file.
+ */
+static boolean
+osmesa_can_render_in_place(const struct osmesa_context *osmesa,
+                           const struct osmesa_buffer *osbuffer)
+{
+   struct pipe_screen *screen = get_st_manager()->screen;
+
+   return screen->resource_from_user_memory &&
+          !debug_get_option_osmesa_force_copy() &&
+          !osmesa->y_up &&
+          (osmesa->user_row_length == 0 ||
+           osmesa->user_row_length == (GLint) osbuffer->width) &&
+          ((uintptr_t) osbuffer->map & 15) == 0;
+}
+
+
+/**
+ * Make the state tracker revalidate the framebuffer if the color buffer
+ * has to switch between the in-place and copy modes, or to a different
+ * user buffer.
+ */
+static void
+osmesa_check_in_place(struct osmesa_context *osmesa,
+                      struct osmesa_buffer *osbuffer,
+                      boolean map_changed)
+{
+   if (!osbuffer)
+      return;
+
+   if (osbuffer->in_place != osmesa_can_render_in_place(osmesa, osbuffer) ||
+       (osbuffer->in_place && map_changed)) {
+      p_atomic_inc(&osbuffer->stfb->stamp);
+   }
+}
+
+
 /**
  * Called via glFlush/glFinish.  This is where we copy the contents
  * of the driver's color buffer into the user-specified buffer.
@@ -341,6 +415,19 @@ osmesa_st_framebuffer_flush_front(struct st_context_iface *stctx,
       pp_run(osmesa->pp, res, res, zsbuf);
    }
 
+   if (osbuffer->in_place && statt == ST_ATTACHMENT_FRONT_LEFT) {
+      /* The image is already in the user's buffer, just wait for it. */
+      struct pipe_screen *screen = pipe->screen;
+      struct pipe_fence_handle *fence = NULL;
+
+      pipe->flush(pipe, &fence, 0);
+      if (fence) {
+         screen->fence_finish(screen, fence, PIPE_TIMEOUT_INFINITE);
+         screen->fence_reference(screen, &fence, NULL);
+      }
+      return TRUE;
+   }
+
    u_box_2d(0, 0, res->width0, res->height0, &box);
 
    map = pipe->transfer_map(pipe, res, 0, PIPE_TRANSFER_READ, &box,
@@ -390,6 +477,8 @@ osmesa_st_framebuffer_validate(struct st_context_iface *stctx,
    struct pipe_screen *screen = get_st_manager()->screen;
    enum st_attachment_type i;
    struct osmesa_buffer *osbuffer = stfbi_to_osbuffer(stfbi);
+   struct osmesa_context *osmesa =
+      (struct osmesa_context *) stctx->st_manager_private;
    struct pipe_resource templat;
 
    memset(&templat, 0, sizeof(templat));
@@ -416,6 +505,22 @@ osmesa_st_framebuffer_validate(struct st_context_iface *stctx,
       if (statts[i] == ST_ATTACHMENT_FRONT_LEFT) {
          format = osbuffer->visual.color_format;
          bind = PIPE_BIND_RENDER_TARGET;
+
+         osbuffer->in_place = FALSE;
+
+         if (osmesa_can_render_in_place(osmesa, osbuffer)) {
+            templat.format = format;
+            templat.bind = bind | PIPE_BIND_DISPLAY_TARGET;
+            out[i] = screen->resource_from_user_memory(screen, &templat,
+                                                       osbuffer->map);
+            if (out[i]) {
+               pipe_resource_reference(&osbuffer->textures[statts[i]],
+                                       out[i]);
+               osbuffer->in_place = TRUE;
+               continue;
+            }
+            /* else fall back to rendering into an ordinary resource */
+         }
       }
       else if (statts[i] == ST_ATTACHMENT_DEPTH_STENCIL) {
          format = osbuffer->visual.depth_stencil_format;
@@ -432,8 +537,12 @@ osmesa_st_framebuffer_validate(struct st_context_iface *stctx,
 
       templat.format = format;
       templat.bind = bind;
-      out[i] = osbuffer->textures[statts[i]] =
-         screen->resource_create(screen, &templat);
+      out[i] = screen->resource_create(screen, &templat);
+
+      /* The reference returned in out[] belongs to the caller, the buffer
+       * keeps one of its own (and drops the one of the previous resource).
+       */
+      pipe_resource_reference(&osbuffer->textures[statts[i]], out[i]);
    }
 
    return TRUE;
@@ -457,23 +566,31 @@ osmesa_create_st_framebuffer(void)
  * Create new buffer and add to linked list.
  */
 static struct osmesa_buffer *
-osmesa_create_buffer(enum pipe_format color_format,
+osmesa_create_buffer(struct osmesa_context *owner,
+                     enum pipe_format color_format,
                      enum pipe_format ds_format,
                      enum pipe_format accum_format)
 {
    struct osmesa_buffer *osbuffer = CALLOC_STRUCT(osmesa_buffer);
    if (osbuffer) {
       osbuffer->stfb = osmesa_create_st_framebuffer();
+      if (!osbuffer->stfb) {
+         FREE(osbuffer);
+         return NULL;
+      }
 
       osbuffer->stfb->st_manager_private = osbuffer;
       osbuffer->stfb->visual = &osbuffer->visual;
+      osbuffer->owner = owner;
 
       osmesa_init_st_visual(&osbuffer->visual, color_format,
                             ds_format, accum_format);
 
       /* insert into linked list */
+      pipe_mutex_lock(OSMesaMutex);
       osbuffer->next = BufferList;
       BufferList = osbuffer;
+      pipe_mutex_unlock(OSMesaMutex);
    }
 
    return osbuffer;
@@ -481,38 +598,76 @@ osmesa_create_buffer(enum pipe_format color_format,
 
 
 /**
- * Search linked list for a buffer with matching pixel formats and size.
+ * Search linked list for a buffer of the given context with matching
+ * pixel formats and size.  Buffers aren't shared between contexts, as
+ * those may be rendering on different threads at the same time.
  */
 static struct osmesa_buffer *
-osmesa_find_buffer(enum pipe_format color_format,
+osmesa_find_buffer(struct osmesa_context *owner,
+                   enum pipe_format color_format,
                    enum pipe_format ds_format,
                    enum pipe_format accum_format,
                    GLsizei width, GLsizei height)
 {
    struct osmesa_buffer *b;
 
+   pipe_mutex_lock(OSMesaMutex);
+
    /* Check if we already have a suitable buffer for the given formats */
    for (b = BufferList; b; b = b->next) {
-      if (b->visual.color_format == color_format &&
+      if (b->owner == owner &&
+          b->visual.color_format == color_format &&
           b->visual.depth_stencil_format == ds_format &&
           b->visual.accum_format == accum_format &&
           b->width == width &&
           b->height == height) {
-         return b;
+         break;
       }
    }
-   return NULL;
+
+   pipe_mutex_unlock(OSMesaMutex);
+   return b;
 }
 
 
 static void
 osmesa_destroy_buffer(struct osmesa_buffer *osbuffer)
 {
+   unsigned i;
+
+   for (i = 0; i < ST_ATTACHMENT_COUNT; i++)
+      pipe_resource_reference(&osbuffer->textures[i], NULL);
+
    FREE(osbuffer->stfb);
    FREE(osbuffer);
 }
 
 
+/**
+ * Remove and free all the buffers of a context that's being destroyed.
+ */
+static void
+osmesa_destroy_context_buffers(struct osmesa_context *owner)
+{
+   struct osmesa_buffer **prev, *b;
+
+   pipe_mutex_lock(OSMesaMutex);
+
+   prev = &BufferList;
+   while ((b = *prev) != NULL) {
+      if (b->owner == owner) {
+         *prev = b->next;
+         osmesa_destroy_buffer(b);
+      }
+      else {
+         prev = &b->next;
+      }
+   }
+
+   pipe_mutex_unlock(OSMesaMutex);
+}
+
+
 
 /**********************************************************************/
 /*****                    Public Functions                        *****/
@@ -543,12 +698,46 @@ OSMesaCreateContext(GLenum format, OSMesaContext sharelist)
 GLAPI OSMesaContext GLAPIENTRY
 OSMesaCreateContextExt(GLenum format, GLint depthBits, GLint stencilBits,
                        GLint accumBits, OSMesaContext sharelist)
+{
+   int attribs[100], n = 0;
+
+   attribs[n++] = OSMESA_FORMAT;
+   attribs[n++] = format;
+   attribs[n++] = OSMESA_DEPTH_BITS;
+   attribs[n++] = depthBits;
+   attribs[n++] = OSMESA_STENCIL_BITS;
+   attribs[n++] = stencilBits;
+   attribs[n++] = OSMESA_ACCUM_BITS;
+   attribs[n++] = accumBits;
+   attribs[n++] = 0;
+
+   return OSMesaCreateContextAttribs(attribs, sharelist);
+}
+
+
+/**
+ * New in Mesa 10.6
+ *
+ * Create context with attribute list.  All contexts share the screen
+ * created by the st manager, and with it the driver's rasterizer threads.
+ */
+GLAPI OSMesaContext GLAPIENTRY
+OSMesaCreateContextAttribs(const int *attribList, OSMesaContext sharelist)
 {
    OSMesaContext osmesa;
    struct st_context_iface *st_shared;
    enum st_context_error st_error = 0;
    struct st_context_attribs attribs;
    struct st_api *stapi = get_st_api();
+   struct st_manager *stmgr = get_st_manager();
+   GLenum format = GL_RGBA;
+   int depthBits = 0, stencilBits = 0, accumBits = 0;
+   int profile = OSMESA_COMPAT_PROFILE, version_major = 1, version_minor = 0;
+   int i;
+
+   if (!stmgr || !stmgr->screen) {
+      return NULL;
+   }
 
    if (sharelist) {
       st_shared = sharelist->stctx;
@@ -557,6 +746,64 @@ OSMesaCreateContextExt(GLenum format, GLint depthBits, GLint stencilBits,
       st_shared = NULL;
    }
 
+   for (i = 0; attribList[i]; i += 2) {
+      switch (attribList[i]) {
+      case OSMESA_FORMAT:
+         format = attribList[i+1];
+         switch (format) {
+         case OSMESA_COLOR_INDEX:
+         case OSMESA_RGBA:
+         case OSMESA_BGRA:
+         case OSMESA_ARGB:
+         case OSMESA_RGB:
+         case OSMESA_BGR:
+         case OSMESA_RGB_565:
+            /* legal */
+            break;
+         default:
+            return NULL;
+         }
+         break;
+      case OSMESA_DEPTH_BITS:
+         depthBits = attribList[i+1];
+         if (depthBits < 0)
+            return NULL;
+         break;
+      case OSMESA_STENCIL_BITS:
+         stencilBits = attribList[i+1];
+         if (stencilBits < 0)
+            return NULL;
+         break;
+      case OSMESA_ACCUM_BITS:
+         accumBits = attribList[i+1];
+         if (accumBits < 0)
+            return NULL;
+         break;
+      case OSMESA_PROFILE:
+         profile = attribList[i+1];
+         if (profile != OSMESA_CORE_PROFILE &&
+             profile != OSMESA_COMPAT_PROFILE)
+            return NULL;
+         break;
+      case OSMESA_CONTEXT_MAJOR_VERSION:
+         version_major = attribList[i+1];
+         if (version_major < 1)
+            return NULL;
+         break;
+      case OSMESA_CONTEXT_MINOR_VERSION:
+         version_minor = attribList[i+1];
+         if (version_minor < 0)
+            return NULL;
+         break;
+      case 0:
+         /* end of list */
+         break;
+      default:
+         fprintf(stderr, "Bad attribute in OSMesaCreateContextAttribs()\n");
+         return NULL;
+      }
+   }
+
    osmesa = (OSMesaContext) CALLOC_STRUCT(osmesa_context);
    if (!osmesa)
       return NULL;
@@ -581,9 +828,11 @@ OSMesaCreateContextExt(GLenum format, GLint depthBits, GLint stencilBits,
    /*
     * Create the rendering context
     */
-   attribs.profile = ST_PROFILE_DEFAULT;
-   attribs.major = 2;
-   attribs.minor = 1;
+   memset(&attribs, 0, sizeof(attribs));
+   attribs.profile = (profile == OSMESA_CORE_PROFILE)
+      ? ST_PROFILE_OPENGL_CORE : ST_PROFILE_DEFAULT;
+   attribs.major = version_major;
+   attribs.minor = version_minor;
    attribs.flags = 0;  /* ST_CONTEXT_FLAG_x */
    attribs.options.force_glsl_extensions_warn = FALSE;
    attribs.options.disable_blend_func_extended = FALSE;
@@ -597,8 +846,13 @@ OSMesaCreateContextExt(GLenum format, GLint depthBits, GLint stencilBits,
                          osmesa->depth_stencil_format,
                          osmesa->accum_format);
 
-   osmesa->stctx = stapi->create_context(stapi, get_st_manager(),
+   /* Context creation does one-time global initialization in a few places
+    * (LLVM, glapi) which isn't safe to race with.
+    */
+   pipe_mutex_lock(OSMesaMutex);
+   osmesa->stctx = stapi->create_context(stapi, stmgr,
                                          &attribs, &st_error, st_shared);
+   pipe_mutex_unlock(OSMesaMutex);
    if (!osmesa->stctx) {
       FREE(osmesa);
       return NULL;
@@ -625,6 +879,7 @@ OSMesaDestroyContext(OSMesaContext osmesa)
    if (osmesa) {
       pp_free(osmesa->pp);
       osmesa->stctx->destroy(osmesa->stctx);
+      osmesa_destroy_context_buffers(osmesa);
       FREE(osmesa);
    }
 }
@@ -675,22 +930,28 @@ OSMesaMakeCurrent(OSMesaContext osmesa, void *buffer, GLenum type,
    }
 
    /* See if we already have a buffer that uses these pixel formats */
-   osbuffer = osmesa_find_buffer(color_format,
+   osbuffer = osmesa_find_buffer(osmesa, color_format,
                                  osmesa->depth_stencil_format,
                                  osmesa->accum_format, width, height);
    if (!osbuffer) {
-      /* Existing buffer found, create new buffer */
-      osbuffer = osmesa_create_buffer(color_format,
+      /* No existing buffer found, create new buffer */
+      osbuffer = osmesa_create_buffer(osmesa, color_format,
                                       osmesa->depth_stencil_format,
                                       osmesa->accum_format);
+      if (!osbuffer)
+         return GL_FALSE;
    }
 
    osbuffer->width = width;
    osbuffer->height = height;
-   osbuffer->map = buffer;
 
-   /* XXX unused for now */
-   (void) osmesa_destroy_buffer;
+   if (osbuffer->map != buffer) {
+      osbuffer->map = buffer;
+      osmesa_check_in_place(osmesa, osbuffer, TRUE);
+   }
+   else {
+      osmesa_check_in_place(osmesa, osbuffer, FALSE);
+   }
 
    osmesa->current_buffer = osbuffer;
    osmesa->type = type;
@@ -751,6 +1012,8 @@ OSMesaPixelStore(GLint pname, GLint value)
       fprintf(stderr, "Invalid pname in OSMesaPixelStore()\n");
       return;
    }
+
+   osmesa_check_in_place(osmesa, osmesa->current_buffer, FALSE);
 }
 
 
@@ -883,6 +1146,7 @@ struct name_function
 static struct name_function functions[] = {
    { "OSMesaCreateContext", (OSMESAproc) OSMesaCreateContext },
    { "OSMesaCreateContextExt", (OSMESAproc) OSMesaCreateContextExt },
+   { "OSMesaCreateContextAttribs", (OSMESAproc) OSMesaCreateContextAttribs },
    { "OSMesaDestroyContext", (OSMESAproc) OSMesaDestroyContext },
    { "OSMesaMakeCurrent", (OSMESAproc) OSMesaMakeCurrent },
    { "OSMesaGetCurrentContext", (OSMESAproc) OSMesaGetCurrentContext },
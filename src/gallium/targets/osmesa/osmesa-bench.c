@@ -0,0 +1,220 @@
+/*
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Helpers shared by the OSMesa benchmarks.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "osmesa-bench.h"
+
+
+/** Set in the children, which run the workload themselves */
+#define CHILD_ENV "OSMESA_BENCH_CHILD"
+
+
+/**
+ * Replace the defaults in args with the positive integers given on the
+ * command line, in order.
+ */
+void
+osmesa_bench_parse_args(int argc, char **argv,
+                        unsigned num_args, unsigned *args)
+{
+   unsigned i;
+
+   for (i = 0; i < num_args && i + 1 < (unsigned) argc; i++) {
+      if (atoi(argv[i + 1]) > 0)
+         args[i] = atoi(argv[i + 1]);
+   }
+}
+
+
+/**
+ * Create an RGBA context and a width x height color buffer, and make them
+ * current.
+ *
+ * \return the context, or NULL after printing why not
+ */
+OSMesaContext
+osmesa_bench_create_context(GLint depth_bits, OSMesaContext share,
+                            unsigned width, unsigned height, void **buffer)
+{
+   OSMesaContext ctx;
+
+   ctx = OSMesaCreateContextExt(OSMESA_RGBA, depth_bits, 0, 0, share);
+   if (!ctx) {
+      fprintf(stderr, "OSMesaCreateContextExt failed\n");
+      return NULL;
+   }
+
+   *buffer = malloc(width * height * 4);
+   if (!*buffer) {
+      fprintf(stderr, "out of memory\n");
+      OSMesaDestroyContext(ctx);
+      return NULL;
+   }
+
+   if (!OSMesaMakeCurrent(ctx, *buffer, GL_UNSIGNED_BYTE, width, height)) {
+      fprintf(stderr, "OSMesaMakeCurrent failed\n");
+      free(*buffer);
+      OSMesaDestroyContext(ctx);
+      return NULL;
+   }
+
+   return ctx;
+}
+
+
+void
+osmesa_bench_destroy_context(OSMesaContext ctx, void *buffer)
+{
+   OSMesaMakeCurrent(NULL, NULL, 0, 0, 0);
+   OSMesaDestroyContext(ctx);
+   free(buffer);
+}
+
+
+/**
+ * Run the benchmark again, with the same arguments, in a child process
+ * which has the environment variable 'name' set to 'value', or unset if
+ * value is NULL.
+ *
+ * \return exit status of the child, or 1 if it couldn't be run
+ */
+static int
+run_child(char **argv, const char *name, const char *value)
+{
+   pid_t pid;
+   int status;
+
+   fflush(stdout);
+
+   pid = fork();
+   if (pid < 0) {
+      perror("fork");
+      return 1;
+   }
+
+   if (pid == 0) {
+      if (value)
+         setenv(name, value, 1);
+      else
+         unsetenv(name);
+      setenv(CHILD_ENV, "1", 1);
+      /* argv[0] needn't be a path, e.g. when run from $PATH */
+      execv("/proc/self/exe", argv);
+      execvp(argv[0], argv);
+      perror("execvp");
+      _exit(1);
+   }
+
+   if (waitpid(pid, &status, 0) < 0 ||
+       !WIFEXITED(status))
+      return 1;
+
+   return WEXITSTATUS(status);
+}
+
+
+/**
+ * Like run_child, but append the value to the user's setting of the
+ * variable, separated by a comma.
+ */
+static int
+run_child_appended(char **argv, const char *name, const char *value)
+{
+   const char *user = getenv(name);
+   char *list;
+   int ret;
+
+   if (!user || !user[0])
+      return run_child(argv, name, value);
+   if (!value || !value[0])
+      return run_child(argv, name, user);
+
+   list = malloc(strlen(user) + strlen(value) + 2);
+   if (!list)
+      return 1;
+   sprintf(list, "%s,%s", user, value);
+
+   ret = run_child(argv, name, list);
+   free(list);
+   return ret;
+}
+
+
+static int
+run_in_context(const struct osmesa_bench *bench, const unsigned *args)
+{
+   OSMesaContext ctx;
+   void *buffer;
+   int ret;
+
+   ctx = osmesa_bench_create_context(bench->depth_bits, NULL,
+                                     bench->width, bench->height, &buffer);
+   if (!ctx)
+      return 1;
+
+   ret = bench->run_all(args);
+
+   osmesa_bench_destroy_context(ctx, buffer);
+   return ret;
+}
+
+
+int
+osmesa_bench_main(const struct osmesa_bench *bench, int argc, char **argv)
+{
+   unsigned args[OSMESA_BENCH_MAX_ARGS];
+   unsigned i;
+
+   memcpy(args, bench->args, sizeof args);
+   osmesa_bench_parse_args(argc, argv, bench->num_args, args);
+
+   if (!bench->num_settings ||
+       getenv(CHILD_ENV) ||
+       (!bench->append && getenv(bench->env_name)))
+      return run_in_context(bench, args);
+
+   for (i = 0; i < bench->num_settings; i++) {
+      const struct osmesa_bench_setting *setting = &bench->settings[i];
+      int ret;
+
+      printf("%s%s:\n", i ? "\n" : "", setting->label);
+
+      if (bench->append)
+         ret = run_child_appended(argv, bench->env_name, setting->value);
+      else
+         ret = run_child(argv, bench->env_name, setting->value);
+      if (ret)
+         return ret;
+   }
+
+   return 0;
+}
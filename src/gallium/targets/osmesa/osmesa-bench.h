@@ -0,0 +1,96 @@
+/*
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Helpers shared by the OSMesa benchmarks.
+ *
+ * A benchmark describes itself with a struct osmesa_bench and calls
+ * osmesa_bench_main(), which parses the command line, creates the context
+ * and runs the workload.  Settings which the driver only reads once, when
+ * the screen or context is created, are compared by running the benchmark
+ * again in a child process for each value.
+ */
+
+#ifndef OSMESA_BENCH_H
+#define OSMESA_BENCH_H
+
+#include "GL/osmesa.h"
+#include "GL/gl.h"
+
+
+#define OSMESA_BENCH_MAX_ARGS 4
+#define OSMESA_BENCH_MAX_SETTINGS 4
+
+
+struct osmesa_bench_setting
+{
+   const char *label;   /**< printed before the child's output */
+   const char *value;   /**< or NULL to unset the variable */
+};
+
+
+struct osmesa_bench
+{
+   /** Size of the color buffer, and depth buffer bits */
+   unsigned width, height;
+   GLint depth_bits;
+
+   /** Positional command line arguments, set to their defaults */
+   unsigned num_args;
+   unsigned args[OSMESA_BENCH_MAX_ARGS];
+
+   /**
+    * Environment variable to compare the values of.  Unless it is set in
+    * the environment already, the benchmark runs in a child process once
+    * per setting.  With 'append', the values are appended to the user's
+    * setting of a comma separated list instead, and always compared.
+    */
+   const char *env_name;
+   GLboolean append;
+   unsigned num_settings;
+   struct osmesa_bench_setting settings[OSMESA_BENCH_MAX_SETTINGS];
+
+   /**
+    * The workload, run with the context current.
+    * \return 0 on success
+    */
+   int (*run_all)(const unsigned *args);
+};
+
+
+void
+osmesa_bench_parse_args(int argc, char **argv,
+                        unsigned num_args, unsigned *args);
+
+OSMesaContext
+osmesa_bench_create_context(GLint depth_bits, OSMesaContext share,
+                            unsigned width, unsigned height, void **buffer);
+
+void
+osmesa_bench_destroy_context(OSMesaContext ctx, void *buffer);
+
+int
+osmesa_bench_main(const struct osmesa_bench *bench, int argc, char **argv);
+
+
+#endif /* OSMESA_BENCH_H */
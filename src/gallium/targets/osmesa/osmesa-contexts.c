@@ -0,0 +1,156 @@
+/*
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * OSMesa concurrent context benchmark.
+ *
+ * Runs 1, 2, 4, ... up to max_contexts threads, each rendering small
+ * thumbnails with its own OSMesa context, and reports the total number of
+ * thumbnails rendered per second.  All the contexts share the screen and,
+ * with llvmpipe, its rasterizer threads.
+ *
+ * Usage: osmesa-contexts [max_contexts [thumbnails_per_context [size]]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "os/os_thread.h"
+#include "os/os_time.h"
+
+#include "osmesa-bench.h"
+
+
+struct worker
+{
+   pipe_thread thread;
+   unsigned num_thumbnails;
+   unsigned size;
+   boolean failed;
+};
+
+
+static void
+draw_thumbnail(unsigned i)
+{
+   unsigned j;
+
+   glClearColor(0.2f, 0.3f, 0.4f, 1.0f);
+   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+   glEnable(GL_DEPTH_TEST);
+   glBegin(GL_TRIANGLES);
+   for (j = 0; j < 64; j++) {
+      float x = -1.0f + (float) ((i + j) % 16) / 8.0f;
+      float y = -1.0f + (float) (j / 8) / 4.0f;
+
+      glColor3f(1.0f, 0.0f, 0.0f);
+      glVertex3f(x, y, 0.0f);
+      glColor3f(0.0f, 1.0f, 0.0f);
+      glVertex3f(x + 0.5f, y, 0.5f);
+      glColor3f(0.0f, 0.0f, 1.0f);
+      glVertex3f(x, y + 0.5f, -0.5f);
+   }
+   glEnd();
+
+   glFinish();
+}
+
+
+static PIPE_THREAD_ROUTINE(worker_thread, param)
+{
+   struct worker *w = (struct worker *) param;
+   OSMesaContext ctx;
+   void *buffer;
+   unsigned i;
+
+   ctx = osmesa_bench_create_context(24, NULL, w->size, w->size, &buffer);
+   if (!ctx) {
+      w->failed = TRUE;
+      return 0;
+   }
+
+   OSMesaPixelStore(OSMESA_Y_UP, 0);
+
+   for (i = 0; i < w->num_thumbnails; i++)
+      draw_thumbnail(i);
+
+   osmesa_bench_destroy_context(ctx, buffer);
+   return 0;
+}
+
+
+static int
+run(unsigned num_contexts, unsigned num_thumbnails, unsigned size)
+{
+   struct worker *workers = calloc(num_contexts, sizeof *workers);
+   int64_t start, end;
+   double secs;
+   unsigned i;
+   int ret = 0;
+
+   if (!workers)
+      return 1;
+
+   start = os_time_get();
+
+   for (i = 0; i < num_contexts; i++) {
+      workers[i].num_thumbnails = num_thumbnails;
+      workers[i].size = size;
+      workers[i].thread = pipe_thread_create(worker_thread, &workers[i]);
+   }
+
+   for (i = 0; i < num_contexts; i++) {
+      pipe_thread_wait(workers[i].thread);
+      if (workers[i].failed)
+         ret = 1;
+   }
+
+   end = os_time_get();
+
+   secs = (double) (end - start) / 1000000.0;
+   printf("%2u contexts: %u %ux%u thumbnails in %.3f s: %.1f thumbnails/s%s\n",
+          num_contexts, num_contexts * num_thumbnails, size, size, secs,
+          (double) (num_contexts * num_thumbnails) / secs,
+          ret ? " (FAILED)" : "");
+
+   free(workers);
+   return ret;
+}
+
+
+int
+main(int argc, char **argv)
+{
+   /* max_contexts, num_thumbnails, size */
+   unsigned args[3] = { 64, 50, 256 };
+   unsigned n;
+   int ret = 0;
+
+   osmesa_bench_parse_args(argc, argv, 3, args);
+
+   for (n = 1; n <= args[0]; n *= 2)
+      ret |= run(n, args[1], args[2]);
+
+   return ret;
+}
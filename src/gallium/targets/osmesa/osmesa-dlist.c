@@ -0,0 +1,145 @@
+/*
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Display list playback benchmark.
+ *
+ * Draws a lit mesh the way old CAD applications do: every quad is its own
+ * glBegin(GL_TRIANGLES)/glEnd block of two triangles, preceded by a
+ * glColor call and every few quads by a glMaterial call.  The mesh is
+ * drawn in immediate mode and from a display list.  When the list is
+ * compiled, the blocks between two glMaterial calls are merged into one
+ * indexed draw; run with MESA_VERBOSE=list to print the number of draws
+ * before and after merging.
+ *
+ * Usage: osmesa-dlist [grid_size [num_frames]]
+ */
+
+#include <stdio.h>
+
+#include "os/os_time.h"
+
+#include "osmesa-bench.h"
+
+#define WIDTH 256
+#define HEIGHT 256
+
+
+static void
+draw_mesh(unsigned grid)
+{
+   const float step = 2.0f / grid;
+   unsigned x, y;
+
+   glNormal3f(0.0f, 0.0f, 1.0f);
+
+   for (y = 0; y < grid; y++) {
+      for (x = 0; x < grid; x++) {
+         const float x0 = -1.0f + x * step, x1 = x0 + step;
+         const float y0 = -1.0f + y * step, y1 = y0 + step;
+
+         if (x % 8 == 0) {
+            const GLfloat diffuse[4] = {
+               (float) x / grid, (float) y / grid, 0.5f, 1.0f
+            };
+            glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, diffuse);
+         }
+         glColor3f((float) (x & 1), (float) (y & 1), 1.0f);
+
+         glBegin(GL_TRIANGLES);
+         glVertex2f(x0, y0);
+         glVertex2f(x1, y0);
+         glVertex2f(x1, y1);
+         glVertex2f(x0, y0);
+         glVertex2f(x1, y1);
+         glVertex2f(x0, y1);
+         glEnd();
+      }
+   }
+}
+
+
+static void
+run(const char *name, unsigned grid, unsigned num_frames, GLuint list)
+{
+   int64_t start = 0, end;
+   double secs;
+   unsigned i;
+
+   for (i = 0; i <= num_frames; i++) {
+      /* the first frame is a warm up */
+      if (i == 1)
+         start = os_time_get();
+
+      glClear(GL_COLOR_BUFFER_BIT);
+      if (list)
+         glCallList(list);
+      else
+         draw_mesh(grid);
+      glFinish();
+   }
+   end = os_time_get();
+
+   secs = (double) (end - start) / 1000000.0;
+   printf("%-16s %u quads x %u frames in %.3f s: %.2f frames/s\n",
+          name, grid * grid, num_frames, secs, (double) num_frames / secs);
+}
+
+
+static int
+run_all(const unsigned *args)
+{
+   const unsigned grid = args[0], num_frames = args[1];
+   GLuint list;
+
+   glEnable(GL_LIGHTING);
+   glEnable(GL_LIGHT0);
+
+   list = glGenLists(1);
+   glNewList(list, GL_COMPILE);
+   draw_mesh(grid);
+   glEndList();
+
+   run("immediate mode", grid, num_frames, 0);
+   run("display list", grid, num_frames, list);
+
+   glDeleteLists(list, 1);
+
+   return 0;
+}
+
+
+static const struct osmesa_bench bench = {
+   .width = WIDTH,
+   .height = HEIGHT,
+   .num_args = 2,
+   .args = { 128, 50 },   /* grid_size, num_frames */
+   .run_all = run_all,
+};
+
+
+int
+main(int argc, char **argv)
+{
+   return osmesa_bench_main(&bench, argc, argv);
+}
@@ -0,0 +1,239 @@
+/*
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Draw call overhead benchmark.
+ *
+ * Issues many draws of a single tiny triangle with a GLSL program that has
+ * a 4 KB uniform array, so the time is dominated by per-draw state
+ * validation and constant buffer updates.  The cases measured are:
+ * no uniform changes between draws, one vec4 of the array changed before
+ * every draw, the same value stored again before every draw, state changes
+ * which don't affect the result (blend and depth functions with blending
+ * and depth testing disabled), and blending toggled on and off.
+ * ST_DEBUG=upload prints how many constant buffers were uploaded or reused.
+ *
+ * The time until the final glFinish is reported separately as the time
+ * spent on the application thread; compare it with and without
+ * GALLIUM_THREADED=1 to see how much of the per-draw work moves to the
+ * driver thread.
+ *
+ * Unless MESA_NO_ERROR is set in the environment already, all cases are
+ * run twice: in a regular context, and in a context created with
+ * MESA_NO_ERROR set, where the draws and most of the state changes skip
+ * parameter validation (GL_KHR_no_error).
+ *
+ * Usage: osmesa-drawoverhead [num_draws]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define GL_GLEXT_PROTOTYPES
+#include "GL/gl.h"
+#include "GL/glext.h"
+
+#include "os/os_time.h"
+
+#include "osmesa-bench.h"
+
+#define WIDTH 64
+#define HEIGHT 64
+#define NUM_VECTORS 256
+
+
+static const char *vs_source =
+   "void main()\n"
+   "{\n"
+   "   gl_Position = gl_Vertex;\n"
+   "}\n";
+
+static const char *fs_source =
+   "#version 120\n"
+   "uniform vec4 data[256];\n"
+   "uniform int index;\n"
+   "void main()\n"
+   "{\n"
+   "   gl_FragColor = data[index];\n"
+   "}\n";
+
+
+enum mode {
+   MODE_STATIC,
+   MODE_CHANGE_ONE,
+   MODE_SAME_VALUE,
+   MODE_IDLE_STATE_CHURN,
+   MODE_BLEND_TOGGLE,
+   MODE_PROGRAM_REBIND,
+};
+
+static const char *mode_names[] = {
+   "no uniform changes",
+   "one vec4 changed per draw",
+   "same value stored per draw",
+   "disabled state churn",
+   "blend toggled per draw",
+   "program bound per draw",
+};
+
+
+static GLuint
+compile_shader(GLenum type, const char *source)
+{
+   GLuint shader = glCreateShader(type);
+   GLint status;
+
+   glShaderSource(shader, 1, &source, NULL);
+   glCompileShader(shader);
+   glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+   if (!status) {
+      char log[1000];
+      glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+      fprintf(stderr, "shader compilation failed:\n%s\n", log);
+      exit(1);
+   }
+
+   return shader;
+}
+
+
+static GLuint
+make_program(void)
+{
+   GLuint program = glCreateProgram();
+   GLint status;
+
+   glAttachShader(program, compile_shader(GL_VERTEX_SHADER, vs_source));
+   glAttachShader(program, compile_shader(GL_FRAGMENT_SHADER, fs_source));
+   glLinkProgram(program);
+   glGetProgramiv(program, GL_LINK_STATUS, &status);
+   if (!status) {
+      fprintf(stderr, "program link failed\n");
+      exit(1);
+   }
+
+   return program;
+}
+
+
+static void
+run(enum mode mode, unsigned num_draws, GLuint program, GLint data_loc)
+{
+   int64_t start, submitted, end;
+   double secs, submit_secs;
+   unsigned i;
+
+   glClear(GL_COLOR_BUFFER_BIT);
+   glFinish();
+
+   start = os_time_get();
+   for (i = 0; i < num_draws; i++) {
+      switch (mode) {
+      case MODE_STATIC:
+         break;
+      case MODE_CHANGE_ONE:
+         glUniform4f(data_loc + i % NUM_VECTORS,
+                     (float) (i & 0xff) / 255.0f, 0.0f, 0.0f, 1.0f);
+         break;
+      case MODE_SAME_VALUE:
+         glUniform4f(data_loc, 1.0f, 1.0f, 1.0f, 1.0f);
+         break;
+      case MODE_IDLE_STATE_CHURN:
+         glBlendFunc(GL_ONE, (i & 1) ? GL_ONE : GL_ZERO);
+         glDepthFunc((i & 1) ? GL_LEQUAL : GL_LESS);
+         break;
+      case MODE_BLEND_TOGGLE:
+         if (i & 1)
+            glEnable(GL_BLEND);
+         else
+            glDisable(GL_BLEND);
+         break;
+      case MODE_PROGRAM_REBIND:
+         glUseProgram(program);
+         break;
+      }
+      glDrawArrays(GL_TRIANGLES, 0, 3);
+   }
+   submitted = os_time_get();
+   glFinish();
+   end = os_time_get();
+
+   secs = (double) (end - start) / 1000000.0;
+   submit_secs = (double) (submitted - start) / 1000000.0;
+   printf("%-28s %u draws in %.3f s (%.3f s submitting): %.0f draws/s\n",
+          mode_names[mode], num_draws, secs, submit_secs,
+          (double) num_draws / secs);
+}
+
+
+static int
+run_all(const unsigned *args)
+{
+   static const GLfloat verts[3][2] = {
+      { -0.01f, -0.01f }, { 0.01f, -0.01f }, { 0.0f, 0.01f }
+   };
+   const unsigned num_draws = args[0];
+   GLuint program;
+   GLint data_loc;
+   int mode;
+
+   program = make_program();
+   glUseProgram(program);
+   data_loc = glGetUniformLocation(program, "data");
+   glUniform1i(glGetUniformLocation(program, "index"), 0);
+
+   glEnableClientState(GL_VERTEX_ARRAY);
+   glVertexPointer(2, GL_FLOAT, 0, verts);
+
+   /* warm up (shader variants, buffer allocation) */
+   run(MODE_STATIC, 100, program, data_loc);
+
+   for (mode = MODE_STATIC; mode <= MODE_PROGRAM_REBIND; mode++)
+      run((enum mode) mode, num_draws, program, data_loc);
+
+   glDeleteProgram(program);
+
+   return 0;
+}
+
+
+static const struct osmesa_bench bench = {
+   .width = WIDTH,
+   .height = HEIGHT,
+   .num_args = 1,
+   .args = { 100000 },   /* num_draws */
+   .env_name = "MESA_NO_ERROR",   /* read when the context is created */
+   .num_settings = 2,
+   .settings = {
+      { "regular context", NULL },
+      { "no-error context", "1" },
+   },
+   .run_all = run_all,
+};
+
+
+int
+main(int argc, char **argv)
+{
+   return osmesa_bench_main(&bench, argc, argv);
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Fill rate benchmark.
+ *
+ * Every frame clears color and depth and draws a stack of screen-sized
+ * quads, either opaque, depth tested or blended, and reports the number
+ * of pixels shaded per second.
+ *
+ * llvmpipe reads the LP_TILE_BUFFERS option once, when the screen is
+ * created.  Unless it is set in the environment already, the benchmark
+ * runs itself twice, with the fragment shaders working on the linear
+ * framebuffer and on the swizzled per-thread tile buffers, to compare
+ * the two.
+ *
+ * Usage: osmesa-fillrate [num_layers [num_frames]]
+ */
+
+#include <stdio.h>
+
+#include "os/os_time.h"
+
+#include "osmesa-bench.h"
+
+#define WIDTH 1024
+#define HEIGHT 1024
+
+
+enum mode {
+   MODE_OPAQUE,
+   MODE_DEPTH,
+   MODE_BLEND,
+};
+
+static const char *mode_names[] = {
+   "opaque",
+   "depth tested",
+   "blended",
+};
+
+
+static void
+run(enum mode mode, unsigned num_layers, unsigned num_frames)
+{
+   int64_t start = 0, end;
+   double secs;
+   unsigned i, j;
+
+   glDisable(GL_DEPTH_TEST);
+   glDisable(GL_BLEND);
+
+   switch (mode) {
+   case MODE_OPAQUE:
+      break;
+   case MODE_DEPTH:
+      glEnable(GL_DEPTH_TEST);
+      glDepthFunc(GL_LESS);
+      break;
+   case MODE_BLEND:
+      glEnable(GL_BLEND);
+      glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+      break;
+   }
+
+   for (i = 0; i <= num_frames; i++) {
+      /* the first frame is a warm up */
+      if (i == 1)
+         start = os_time_get();
+
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+      for (j = 0; j < num_layers; j++) {
+         /* each layer is in front of the previous one */
+         const float z = 0.9f - 1.8f * j / num_layers;
+
+         glColor4f((float) (j & 1), (float) (j & 2), 0.5f, 0.5f);
+         glBegin(GL_QUADS);
+         glVertex3f(-1.0f, -1.0f, z);
+         glVertex3f( 1.0f, -1.0f, z);
+         glVertex3f( 1.0f,  1.0f, z);
+         glVertex3f(-1.0f,  1.0f, z);
+         glEnd();
+      }
+      glFinish();
+   }
+   end = os_time_get();
+
+   secs = (double) (end - start) / 1000000.0;
+   printf("%-14s %u layers x %u frames in %.3f s: %.1f Mpixels/s\n",
+          mode_names[mode], num_layers, num_frames, secs,
+          (double) WIDTH * HEIGHT * num_layers * num_frames / secs / 1e6);
+}
+
+
+static int
+run_all(const unsigned *args)
+{
+   int mode;
+
+   for (mode = MODE_OPAQUE; mode <= MODE_BLEND; mode++)
+      run((enum mode) mode, args[0], args[1]);
+
+   return 0;
+}
+
+
+static const struct osmesa_bench bench = {
+   .width = WIDTH,
+   .height = HEIGHT,
+   .depth_bits = 24,
+   .num_args = 2,
+   .args = { 8, 20 },   /* num_layers, num_frames */
+   .env_name = "LP_TILE_BUFFERS",
+   .num_settings = 2,
+   .settings = {
+      { "linear framebuffer", "0" },
+      { "swizzled tile buffers", "1" },
+   },
+   .run_all = run_all,
+};
+
+
+int
+main(int argc, char **argv)
+{
+   return osmesa_bench_main(&bench, argc, argv);
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+ * Guard band clipping benchmark.
+ *
+ * Draws triangles entirely inside the viewport, small triangles straddling
+ * the viewport edges and large triangles reaching far outside it, and
+ * reports the time per frame.  Only triangles which leave the guard band
+ * have to be clipped by draw; the others are scissored to the viewport by
+ * llvmpipe's triangle setup.
+ *
+ * The benchmark runs itself twice, with no_guard_band added to LP_PERF
+ * (draw clips every triangle crossing the viewport) and with the default
+ * guard band, to compare the two.  Any LP_PERF flags set in the
+ * environment apply to both runs.
+ *
+ * Usage: osmesa-guardband [num_tris [num_frames]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "os/os_time.h"
+
+#include "osmesa-bench.h"
+
+#define WIDTH 1024
+#define HEIGHT 1024
+
+
+enum scene {
+   SCENE_INSIDE,
+   SCENE_EDGES,
+   SCENE_LARGE,
+};
+
+static const char *scene_names[] = {
+   "inside viewport",
+   "crossing edges",
+   "far outside",
+};
+
+
+static float
+random_float(unsigned *seed, float min, float max)
+{
+   *seed = *seed * 1103515245 + 12345;
+   return min + (max - min) * (float) ((*seed >> 8) & 0xffff) / 65535.0f;
+}
+
+
+static void
+make_triangles(enum scene scene, unsigned num_tris, GLfloat *verts)
+{
+   unsigned seed = 1;
+   unsigned i, j;
+
+   for (i = 0; i < num_tris; i++) {
+      float cx, cy, size;
+
+      switch (scene) {
+      case SCENE_INSIDE:
+         cx = random_float(&seed, -0.9f, 0.9f);
+         cy = random_float(&seed, -0.9f, 0.9f);
+         size = 0.1f;
+         break;
+      case SCENE_EDGES:
+      default:
+         /* centered on one of the four viewport edges */
+         cx = random_float(&seed, -1.0f, 1.0f);
+         cy = (i & 1) ? 1.0f : -1.0f;
+         if (i & 2) {
+            const float t = cx;
+            cx = cy;
+            cy = t;
+         }
+         size = 0.2f;
+         break;
+      case SCENE_LARGE:
+         cx = random_float(&seed, -1.0f, 1.0f);
+         cy = random_float(&seed, -1.0f, 1.0f);
+         size = 8.0f;
+         break;
+      }
+
+      for (j = 0; j < 3; j++) {
+         *verts++ = cx + random_float(&seed, -size, size);
+         *verts++ = cy + random_float(&seed, -size, size);
+      }
+   }
+}
+
+
+static void
+run(enum scene scene, unsigned num_tris, unsigned num_frames)
+{
+   int64_t start = 0, end;
+   double secs;
+   GLfloat *verts;
+   unsigned i;
+
+   verts = malloc(num_tris * 3 * 2 * sizeof *verts);
+   if (!verts)
+      return;
+
+   make_triangles(scene, num_tris, verts);
+   glVertexPointer(2, GL_FLOAT, 0, verts);
+
+   for (i = 0; i <= num_frames; i++) {
+      /* the first frame is a warm up */
+      if (i == 1)
+         start = os_time_get();
+
+      glClear(GL_COLOR_BUFFER_BIT);
+      glDrawArrays(GL_TRIANGLES, 0, num_tris * 3);
+      glFinish();
+   }
+   end = os_time_get();
+
+   secs = (double) (end - start) / 1000000.0;
+   printf("%-16s %u tris x %u frames in %.3f s: %.2f ms/frame\n",
+          scene_names[scene], num_tris, num_frames, secs,
+          secs * 1000.0 / num_frames);
+
+   free(verts);
+}
+
+
+static int
+run_all(const unsigned *args)
+{
+   int scene;
+
+   glEnableClientState(GL_VERTEX_ARRAY);
+   glEnable(GL_BLEND);
+   glBlendFunc(GL_ONE, GL_ONE);
+   glColor4f(0.01f, 0.01f, 0.01f, 1.0f);
+
+   for (scene = SCENE_INSIDE; scene <= SCENE_LARGE; scene++)
+      run((enum scene) scene, args[0], args[1]);
+
+   return 0;
+}
+
+
+static const struct osmesa_bench bench = {
+   .width = WIDTH,
+   .height = HEIGHT,
+   .num_args = 2,
+   .args = { 20000, 20 },   /* num_tris, num_frames */
+   .env_name = "LP_PERF",
+   .append = GL_TRUE,
+   .num_settings = 2,
+   .settings = {
+      { "clipped to the viewport", "no_guard_band" },
+      { "clipped to the guard band", NULL },
+   },
+   .run_all = run_all,
+};
+
+
+int
+main(int argc, char **argv)
+{
+   return osmesa_bench_main(&bench, argc, argv);
+}
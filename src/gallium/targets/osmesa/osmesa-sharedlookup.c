@@ -0,0 +1,182 @@
+/*
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Shared object name lookup benchmark.
+ *
+ * Runs 1, 2, 4, ... up to max_contexts threads, each with its own OSMesa
+ * context in one share group, binding textures and buffer objects from the
+ * shared name space in a loop.  Every bind looks the name up in the shared
+ * hash tables, so this shows how well these lookups scale with the number of
+ * threads.  Reports the total number of binds per second.
+ *
+ * Usage: osmesa-sharedlookup [max_contexts [binds_per_context]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define GL_GLEXT_PROTOTYPES
+#include "GL/gl.h"
+#include "GL/glext.h"
+
+#include "os/os_thread.h"
+#include "os/os_time.h"
+
+#include "osmesa-bench.h"
+
+#define SIZE 16
+#define NUM_OBJECTS 256
+
+
+struct worker
+{
+   pipe_thread thread;
+   OSMesaContext ctx;
+   unsigned num_binds;
+   boolean failed;
+};
+
+
+static GLuint textures[NUM_OBJECTS];
+static GLuint buffers[NUM_OBJECTS];
+
+
+static PIPE_THREAD_ROUTINE(worker_thread, param)
+{
+   struct worker *w = (struct worker *) param;
+   void *buffer = malloc(SIZE * SIZE * 4);
+   unsigned i;
+
+   if (!buffer ||
+       !OSMesaMakeCurrent(w->ctx, buffer, GL_UNSIGNED_BYTE, SIZE, SIZE)) {
+      w->failed = TRUE;
+   }
+   else {
+      for (i = 0; i < w->num_binds; i++) {
+         glBindTexture(GL_TEXTURE_2D, textures[i % NUM_OBJECTS]);
+         glBindBuffer(GL_ARRAY_BUFFER, buffers[(i * 7) % NUM_OBJECTS]);
+      }
+      glBindTexture(GL_TEXTURE_2D, 0);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+      OSMesaMakeCurrent(NULL, NULL, 0, 0, 0);
+   }
+
+   free(buffer);
+   return 0;
+}
+
+
+static int
+run(OSMesaContext share, unsigned num_contexts, unsigned num_binds)
+{
+   struct worker *workers = calloc(num_contexts, sizeof *workers);
+   int64_t start, end;
+   double secs;
+   unsigned i;
+   int ret = 0;
+
+   if (!workers)
+      return 1;
+
+   /* create the contexts up front, so only the binds are timed */
+   for (i = 0; i < num_contexts; i++) {
+      workers[i].ctx = OSMesaCreateContextExt(OSMESA_RGBA, 0, 0, 0, share);
+      workers[i].num_binds = num_binds;
+      if (!workers[i].ctx)
+         ret = 1;
+   }
+
+   if (ret) {
+      fprintf(stderr, "OSMesaCreateContextExt failed\n");
+   }
+   else {
+      start = os_time_get();
+
+      for (i = 0; i < num_contexts; i++)
+         workers[i].thread = pipe_thread_create(worker_thread, &workers[i]);
+
+      for (i = 0; i < num_contexts; i++) {
+         pipe_thread_wait(workers[i].thread);
+         if (workers[i].failed)
+            ret = 1;
+      }
+
+      end = os_time_get();
+
+      secs = (double) (end - start) / 1000000.0;
+      printf("%2u contexts: %u binds in %.3f s: %.2f Mbinds/s%s\n",
+             num_contexts, num_contexts * num_binds * 2, secs,
+             (double) num_contexts * num_binds * 2 / secs / 1000000.0,
+             ret ? " (FAILED)" : "");
+   }
+
+   for (i = 0; i < num_contexts; i++) {
+      if (workers[i].ctx)
+         OSMesaDestroyContext(workers[i].ctx);
+   }
+
+   free(workers);
+   return ret;
+}
+
+
+int
+main(int argc, char **argv)
+{
+   /* max_contexts, num_binds */
+   unsigned args[2] = { 16, 1000000 };
+   OSMesaContext share;
+   void *buffer;
+   unsigned i, n;
+   int ret = 0;
+
+   osmesa_bench_parse_args(argc, argv, 2, args);
+
+   /* the context owning the shared objects */
+   share = osmesa_bench_create_context(0, NULL, SIZE, SIZE, &buffer);
+   if (!share)
+      return 1;
+
+   glGenTextures(NUM_OBJECTS, textures);
+   glGenBuffers(NUM_OBJECTS, buffers);
+   for (i = 0; i < NUM_OBJECTS; i++) {
+      glBindTexture(GL_TEXTURE_2D, textures[i]);
+      glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+   }
+   glBindTexture(GL_TEXTURE_2D, 0);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   glFinish();
+   OSMesaMakeCurrent(NULL, NULL, 0, 0, 0);
+
+   for (n = 1; n <= args[0]; n *= 2)
+      ret |= run(share, n, args[1]);
+
+   if (OSMesaMakeCurrent(share, buffer, GL_UNSIGNED_BYTE, SIZE, SIZE)) {
+      glDeleteTextures(NUM_OBJECTS, textures);
+      glDeleteBuffers(NUM_OBJECTS, buffers);
+   }
+   osmesa_bench_destroy_context(share, buffer);
+   return ret;
+}
@@ -0,0 +1,216 @@
+/*
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+ * Compressed texture fetch benchmark.
+ *
+ * Draws screen-sized quads textured with a 1024x1024 texture in each of
+ * the compressed formats supported, with bilinear filtering, and reports
+ * the number of pixels textured per second.  An uncompressed RGBA8 texture
+ * is drawn for reference.  The texture contents are random blocks, which
+ * decode to valid (if noisy) images in all the formats.
+ *
+ * Unless GALLIVM_TEXEL_CACHE is set in the environment already, the
+ * benchmark runs itself twice, with texels decoded one at a time and
+ * through llvmpipe's cache of decoded blocks, to compare the two.
+ *
+ * Usage: osmesa-texfetch [num_frames]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GL_GLEXT_PROTOTYPES
+#include "GL/gl.h"
+#include "GL/glext.h"
+
+#include "os/os_time.h"
+
+#include "osmesa-bench.h"
+
+#define WIDTH 512
+#define HEIGHT 512
+#define TEX_SIZE 1024
+
+
+struct tex_format {
+   const char *name;
+   const char *extension;   /**< required extension, if compressed */
+   GLenum internal_format;
+   unsigned block_bytes;    /**< per 4x4 block, or 0 if uncompressed */
+};
+
+static const struct tex_format formats[] = {
+   { "RGBA8", NULL, GL_RGBA8, 0 },
+   { "DXT1 RGB", "GL_EXT_texture_compression_s3tc",
+     GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 8 },
+   { "DXT1 RGBA", "GL_EXT_texture_compression_s3tc",
+     GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 8 },
+   { "DXT3", "GL_EXT_texture_compression_s3tc",
+     GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 16 },
+   { "DXT5", "GL_EXT_texture_compression_s3tc",
+     GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 16 },
+   { "RGTC1", "GL_ARB_texture_compression_rgtc",
+     GL_COMPRESSED_RED_RGTC1, 8 },
+   { "RGTC2", "GL_ARB_texture_compression_rgtc",
+     GL_COMPRESSED_RG_RGTC2, 16 },
+};
+
+
+static void
+fill_random(GLubyte *data, unsigned size)
+{
+   unsigned seed = 1;
+   unsigned i;
+
+   for (i = 0; i < size; i++) {
+      seed = seed * 1103515245 + 12345;
+      data[i] = (GLubyte) (seed >> 16);
+   }
+}
+
+
+static GLboolean
+make_texture(const struct tex_format *format)
+{
+   const unsigned size = format->block_bytes ?
+      (TEX_SIZE / 4) * (TEX_SIZE / 4) * format->block_bytes :
+      TEX_SIZE * TEX_SIZE * 4;
+   GLubyte *data = malloc(size);
+
+   if (!data)
+      return GL_FALSE;
+
+   fill_random(data, size);
+
+   if (format->block_bytes) {
+      glCompressedTexImage2D(GL_TEXTURE_2D, 0, format->internal_format,
+                             TEX_SIZE, TEX_SIZE, 0, size, data);
+   }
+   else {
+      glTexImage2D(GL_TEXTURE_2D, 0, format->internal_format,
+                   TEX_SIZE, TEX_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+   }
+
+   free(data);
+   return glGetError() == GL_NO_ERROR;
+}
+
+
+static void
+run(const struct tex_format *format, unsigned num_frames)
+{
+   int64_t start = 0, end;
+   double secs;
+   unsigned i;
+
+   if (format->extension &&
+       !strstr((const char *) glGetString(GL_EXTENSIONS), format->extension)) {
+      printf("%-10s not supported\n", format->name);
+      return;
+   }
+
+   if (!make_texture(format)) {
+      printf("%-10s texture creation failed\n", format->name);
+      return;
+   }
+
+   for (i = 0; i <= num_frames; i++) {
+      /* the first frame is a warm up */
+      if (i == 1)
+         start = os_time_get();
+
+      /* texture coordinates scaled up a bit, to mix magnification and
+       * minification across the frames
+       */
+      glMatrixMode(GL_TEXTURE);
+      glLoadIdentity();
+      glScalef(0.5f + (float) (i % 4) * 0.25f,
+               0.5f + (float) (i % 4) * 0.25f, 1.0f);
+
+      glBegin(GL_QUADS);
+      glTexCoord2f(0.0f, 0.0f);
+      glVertex2f(-1.0f, -1.0f);
+      glTexCoord2f(1.0f, 0.0f);
+      glVertex2f( 1.0f, -1.0f);
+      glTexCoord2f(1.0f, 1.0f);
+      glVertex2f( 1.0f,  1.0f);
+      glTexCoord2f(0.0f, 1.0f);
+      glVertex2f(-1.0f,  1.0f);
+      glEnd();
+      glFinish();
+   }
+   end = os_time_get();
+
+   secs = (double) (end - start) / 1000000.0;
+   printf("%-10s %u frames in %.3f s: %.1f Mpixels/s\n",
+          format->name, num_frames, secs,
+          (double) WIDTH * HEIGHT * num_frames / secs / 1e6);
+}
+
+
+static int
+run_all(const unsigned *args)
+{
+   GLuint tex;
+   unsigned i;
+
+   glGenTextures(1, &tex);
+   glBindTexture(GL_TEXTURE_2D, tex);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+   glEnable(GL_TEXTURE_2D);
+
+   for (i = 0; i < sizeof formats / sizeof formats[0]; i++)
+      run(&formats[i], args[0]);
+
+   glDeleteTextures(1, &tex);
+
+   return 0;
+}
+
+
+static const struct osmesa_bench bench = {
+   .width = WIDTH,
+   .height = HEIGHT,
+   .num_args = 1,
+   .args = { 50 },   /* num_frames */
+   .env_name = "GALLIVM_TEXEL_CACHE",
+   .num_settings = 2,
+   .settings = {
+      { "texels decoded one at a time", "0" },
+      { "decoded block cache", "1" },
+   },
+   .run_all = run_all,
+};
+
+
+int
+main(int argc, char **argv)
+{
+   return osmesa_bench_main(&bench, argc, argv);
+}
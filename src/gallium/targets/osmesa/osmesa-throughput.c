@@ -0,0 +1,135 @@
+/*
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * OSMesa frame rate benchmark.
+ *
+ * Renders a few triangles per frame and calls glFinish, at 1080p and 4K
+ * by default, so the time is dominated by clearing and getting the image
+ * into the user's buffer.  With OSMESA_Y_UP=FALSE (the default here) the
+ * image is rendered straight into the buffer; -y selects OSMESA_Y_UP=TRUE
+ * which needs the copy path, as does OSMESA_FORCE_COPY=1.
+ *
+ * Usage: osmesa-throughput [-y] [width height] [num_frames]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "os/os_time.h"
+
+#include "osmesa-bench.h"
+
+
+static void
+draw_frame(unsigned frame)
+{
+   float t = (float) (frame % 360);
+
+   glClearColor(0.2f, 0.3f, 0.4f, 1.0f);
+   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+   glPushMatrix();
+   glRotatef(t, 0.0f, 0.0f, 1.0f);
+   glBegin(GL_TRIANGLES);
+   glColor3f(1.0f, 0.0f, 0.0f);
+   glVertex2f(-0.8f, -0.8f);
+   glColor3f(0.0f, 1.0f, 0.0f);
+   glVertex2f(0.8f, -0.8f);
+   glColor3f(0.0f, 0.0f, 1.0f);
+   glVertex2f(0.0f, 0.8f);
+   glEnd();
+   glPopMatrix();
+
+   glFinish();
+}
+
+
+static int
+run(unsigned width, unsigned height, unsigned num_frames, GLboolean y_up)
+{
+   OSMesaContext ctx;
+   void *buffer;
+   unsigned i;
+   int64_t start, end;
+   double secs;
+
+   ctx = osmesa_bench_create_context(24, NULL, width, height, &buffer);
+   if (!ctx)
+      return 1;
+
+   OSMesaPixelStore(OSMESA_Y_UP, y_up);
+
+   /* warm up (shader compilation, buffer allocation) */
+   draw_frame(0);
+
+   start = os_time_get();
+   for (i = 0; i < num_frames; i++)
+      draw_frame(i);
+   end = os_time_get();
+
+   secs = (double) (end - start) / 1000000.0;
+   printf("%ux%u, y_up=%u: %u frames in %.3f s: %.1f frames/s\n",
+          width, height, (unsigned) y_up, num_frames, secs,
+          (double) num_frames / secs);
+
+   osmesa_bench_destroy_context(ctx, buffer);
+   return 0;
+}
+
+
+int
+main(int argc, char **argv)
+{
+   GLboolean y_up = GL_FALSE;
+   unsigned num_frames = 100;
+   int arg = 1;
+
+   if (arg < argc && strcmp(argv[arg], "-y") == 0) {
+      y_up = GL_TRUE;
+      arg++;
+   }
+
+   if (arg + 1 < argc) {
+      unsigned width = atoi(argv[arg]);
+      unsigned height = atoi(argv[arg + 1]);
+
+      if (arg + 2 < argc)
+         num_frames = atoi(argv[arg + 2]);
+
+      if (!width || !height || !num_frames) {
+         fprintf(stderr, "usage: %s [-y] [width height] [num_frames]\n",
+                 argv[0]);
+         return 1;
+      }
+
+      return run(width, height, num_frames, y_up);
+   }
+
+   if (arg < argc && atoi(argv[arg]) > 0)
+      num_frames = atoi(argv[arg]);
+
+   return run(1920, 1080, num_frames, y_up) ||
+          run(3840, 2160, num_frames, y_up);
+}
@@ -0,0 +1,335 @@
+/**************************************************************************
+ *
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ *  Stress test and benchmark for the buffer cache manager.
+ *
+ *  Replays randomized allocation patterns resembling the ones of the
+ *  radeon and svga winsys on top of malloc'ed buffers, and reports the
+ *  allocation rate and how many allocations were served from the cache.
+ *  The test fails if a buffer doesn't satisfy the request.
+ *
+ *  Usage: pb_cache_test [num_allocs]
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "os/os_thread.h"
+#include "os/os_time.h"
+#include "util/u_atomic.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+
+#include "pipebuffer/pb_buffer.h"
+#include "pipebuffer/pb_bufmgr.h"
+
+
+#define NUM_THREADS 4
+
+/* like VMW_BUFFER_USAGE_SHARED, buffers that must not be cached */
+#define USAGE_SHARED (1 << 20)
+
+
+struct pattern
+{
+   const char *name;
+
+   /* pb_cache_manager_create() parameters */
+   unsigned usecs;
+   float size_factor;
+   unsigned bypass_usage;
+   uint64_t max_cache_size;
+
+   pb_size min_size, max_size;
+   pb_size alignment;
+   unsigned usages[3];
+   unsigned shared_percent;
+
+   /** number of buffers alive at any time */
+   unsigned num_live;
+   /** number of buffers released into the cache before starting */
+   unsigned num_prefill;
+
+   unsigned num_threads;
+};
+
+
+static const struct pattern patterns[] = {
+   /* radeon: one manager for all the buffer objects, usage are domains */
+   { "radeon", 1000000, 2.0f, 0, 128 * 1024 * 1024,
+     4096, 1024 * 1024, 4096,
+     { PB_USAGE_CPU_WRITE, PB_USAGE_GPU_READ,
+       PB_USAGE_CPU_WRITE | PB_USAGE_GPU_READ }, 0,
+     64, 0, 1 },
+   /* radeon, with thousands of idle buffers in the cache */
+   { "radeon, full cache", 1000000, 2.0f, 0, 1024 * 1024 * 1024,
+     4096, 1024 * 1024, 4096,
+     { PB_USAGE_CPU_WRITE, PB_USAGE_GPU_READ,
+       PB_USAGE_CPU_WRITE | PB_USAGE_GPU_READ }, 0,
+     16, 4096, 1 },
+   /* svga: small upload and constant buffers, some of them shared */
+   { "svga", 100000, 2.0f, USAGE_SHARED, 64 * 1024 * 1024,
+     64, 64 * 1024, 64,
+     { PB_USAGE_GPU_READ_WRITE, PB_USAGE_GPU_READ_WRITE,
+       PB_USAGE_GPU_READ_WRITE }, 1,
+     256, 0, 1 },
+   /* svga, with several contexts allocating concurrently */
+   { "svga, threaded", 100000, 2.0f, USAGE_SHARED, 64 * 1024 * 1024,
+     64, 64 * 1024, 64,
+     { PB_USAGE_GPU_READ_WRITE, PB_USAGE_GPU_READ_WRITE,
+       PB_USAGE_GPU_READ_WRITE }, 1,
+     256, 0, NUM_THREADS },
+};
+
+
+/**
+ * Provider which counts the buffers created, i.e. the cache misses.
+ */
+struct counting_manager
+{
+   struct pb_manager base;
+   struct pb_manager *provider;
+   int32_t num_created;
+};
+
+
+static struct pb_buffer *
+counting_create_buffer(struct pb_manager *_mgr, pb_size size,
+                       const struct pb_desc *desc)
+{
+   struct counting_manager *mgr = (struct counting_manager *)_mgr;
+   p_atomic_inc(&mgr->num_created);
+   return mgr->provider->create_buffer(mgr->provider, size, desc);
+}
+
+
+static void
+counting_flush(struct pb_manager *_mgr)
+{
+   struct counting_manager *mgr = (struct counting_manager *)_mgr;
+   mgr->provider->flush(mgr->provider);
+}
+
+
+static boolean
+counting_is_buffer_busy(struct pb_manager *_mgr, struct pb_buffer *buf)
+{
+   struct counting_manager *mgr = (struct counting_manager *)_mgr;
+   return mgr->provider->is_buffer_busy(mgr->provider, buf);
+}
+
+
+struct thread_data
+{
+   const struct pattern *pattern;
+   struct pb_manager *cache;
+   unsigned num_allocs;
+   unsigned seed;
+   boolean failed;
+};
+
+
+static unsigned
+next_random(unsigned *seed)
+{
+   *seed = *seed * 1103515245 + 12345;
+   return *seed >> 8;
+}
+
+
+static struct pb_buffer *
+alloc_buffer(struct thread_data *data, unsigned *seed)
+{
+   const struct pattern *pattern = data->pattern;
+   unsigned min_bits = util_logbase2(pattern->min_size);
+   unsigned max_bits = util_logbase2(pattern->max_size);
+   unsigned bits = min_bits + next_random(seed) % (max_bits - min_bits + 1);
+   pb_size size = (1 << bits) + next_random(seed) % (1 << bits);
+   struct pb_desc desc;
+   struct pb_buffer *buf;
+   void *map;
+
+   size = MIN2(size, pattern->max_size);
+
+   desc.alignment = pattern->alignment;
+   desc.usage = pattern->usages[next_random(seed) % Elements(pattern->usages)];
+   if (next_random(seed) % 100 < pattern->shared_percent)
+      desc.usage |= USAGE_SHARED;
+
+   buf = data->cache->create_buffer(data->cache, size, &desc);
+   if (!buf) {
+      printf("failed to allocate %u bytes\n", size);
+      data->failed = TRUE;
+      return NULL;
+   }
+
+   if (buf->size < size ||
+       !pb_check_alignment(desc.alignment, buf->alignment) ||
+       !pb_check_usage(desc.usage & ~USAGE_SHARED, buf->usage)) {
+      printf("buffer of %u bytes, alignment %u, usage 0x%x returned for "
+             "%u bytes, alignment %u, usage 0x%x\n",
+             buf->size, buf->alignment, buf->usage,
+             size, desc.alignment, desc.usage);
+      data->failed = TRUE;
+   }
+
+   /* touch the buffer like an upload would */
+   map = pb_map(buf, PB_USAGE_CPU_WRITE, NULL);
+   if (map) {
+      *(unsigned char *)map = 0;
+      pb_unmap(buf);
+   }
+
+   return buf;
+}
+
+
+static PIPE_THREAD_ROUTINE(run_thread, thread_data)
+{
+   struct thread_data *data = (struct thread_data *)thread_data;
+   const struct pattern *pattern = data->pattern;
+   struct pb_buffer **live = CALLOC(pattern->num_live, sizeof *live);
+   unsigned seed = data->seed;
+   unsigned i;
+
+   for (i = 0; i < data->num_allocs && !data->failed; i++) {
+      /* release a random buffer and allocate its replacement */
+      unsigned slot = next_random(&seed) % pattern->num_live;
+      pb_reference(&live[slot], NULL);
+      live[slot] = alloc_buffer(data, &seed);
+   }
+
+   for (i = 0; i < pattern->num_live; i++)
+      pb_reference(&live[i], NULL);
+   FREE(live);
+
+   return 0;
+}
+
+
+static boolean
+run_pattern(const struct pattern *pattern, unsigned num_allocs)
+{
+   struct pb_manager *provider, *cache;
+   struct counting_manager counter;
+   struct thread_data data[NUM_THREADS];
+   pipe_thread threads[NUM_THREADS];
+   int64_t start, end;
+   double secs;
+   unsigned i, total = 0;
+   boolean failed = FALSE;
+
+   provider = pb_malloc_bufmgr_create();
+   if (!provider)
+      return FALSE;
+
+   memset(&counter, 0, sizeof counter);
+   counter.base.create_buffer = counting_create_buffer;
+   counter.base.flush = counting_flush;
+   counter.base.is_buffer_busy = counting_is_buffer_busy;
+   counter.provider = provider;
+
+   cache = pb_cache_manager_create(&counter.base,
+                                   pattern->usecs,
+                                   pattern->size_factor,
+                                   pattern->bypass_usage,
+                                   pattern->max_cache_size);
+   if (!cache) {
+      provider->destroy(provider);
+      return FALSE;
+   }
+
+   /* all the threads share the cache */
+   for (i = 0; i < pattern->num_threads; i++) {
+      data[i].pattern = pattern;
+      data[i].cache = cache;
+      data[i].num_allocs = num_allocs;
+      data[i].seed = i + 1;
+      data[i].failed = FALSE;
+   }
+
+   if (pattern->num_prefill) {
+      struct pb_buffer **bufs = CALLOC(pattern->num_prefill, sizeof *bufs);
+      unsigned seed = 1000;
+
+      for (i = 0; i < pattern->num_prefill; i++)
+         bufs[i] = alloc_buffer(&data[0], &seed);
+      for (i = 0; i < pattern->num_prefill; i++)
+         pb_reference(&bufs[i], NULL);
+      FREE(bufs);
+   }
+   counter.num_created = 0;
+
+   start = os_time_get();
+   if (pattern->num_threads > 1) {
+      for (i = 0; i < pattern->num_threads; i++)
+         threads[i] = pipe_thread_create(run_thread, &data[i]);
+      for (i = 0; i < pattern->num_threads; i++)
+         pipe_thread_wait(threads[i]);
+   }
+   else {
+      run_thread(&data[0]);
+   }
+   end = os_time_get();
+
+   for (i = 0; i < pattern->num_threads; i++) {
+      total += num_allocs;
+      failed |= data[i].failed;
+   }
+
+   secs = (double) (end - start) / 1000000.0;
+   printf("%-20s %u allocs in %.3f s: %.0f allocs/s, %.1f%% from the cache\n",
+          pattern->name, total, secs, (double) total / secs,
+          100.0 * (total - MIN2((unsigned) counter.num_created, total)) /
+          total);
+
+   cache->destroy(cache);
+   provider->destroy(provider);
+
+   return !failed;
+}
+
+
+int main(int argc, char **argv)
+{
+   unsigned num_allocs = 200000;
+   unsigned i;
+   boolean success = TRUE;
+
+   if (argc > 1 && atoi(argv[1]) > 0)
+      num_allocs = atoi(argv[1]);
+
+   for (i = 0; i < Elements(patterns); i++)
+      success &= run_pattern(&patterns[i], num_allocs);
+
+   printf("%s\n", success ? "Success!" : "Failure!");
+
+   return success ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+/**************************************************************************
+ *
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "util/u_memory.h"
+#include "util/u_vertex_cache.h"
+
+#define GRID 64
+#define NUM_TRIS ((GRID - 1) * (GRID - 1) * 2)
+
+static int
+compare_tris(const void *a, const void *b)
+{
+   return memcmp(a, b, 3 * sizeof(uint));
+}
+
+int
+main(int argc, char **argv)
+{
+   uint *indices = MALLOC(NUM_TRIS * 3 * sizeof(uint));
+   uint *sorted_before = MALLOC(NUM_TRIS * 3 * sizeof(uint));
+   uint *sorted_after = MALLOC(NUM_TRIS * 3 * sizeof(uint));
+   unsigned x, y, i, n = 0;
+   float acmr_before, acmr_after;
+   int ret = 0;
+
+   /* a regular grid mesh */
+   for (y = 0; y < GRID - 1; y++) {
+      for (x = 0; x < GRID - 1; x++) {
+         uint v = y * GRID + x;
+         indices[n++] = v;
+         indices[n++] = v + 1;
+         indices[n++] = v + GRID;
+         indices[n++] = v + 1;
+         indices[n++] = v + GRID + 1;
+         indices[n++] = v + GRID;
+      }
+   }
+
+   /* with the triangles in random order */
+   srand(1);
+   for (i = NUM_TRIS - 1; i > 0; i--) {
+      unsigned j = rand() % (i + 1);
+      uint tmp[3];
+      memcpy(tmp, &indices[i * 3], sizeof tmp);
+      memcpy(&indices[i * 3], &indices[j * 3], sizeof tmp);
+      memcpy(&indices[j * 3], tmp, sizeof tmp);
+   }
+
+   memcpy(sorted_before, indices, NUM_TRIS * 3 * sizeof(uint));
+   qsort(sorted_before, NUM_TRIS, 3 * sizeof(uint), compare_tris);
+
+   acmr_before = util_vertex_cache_acmr(4, indices, NUM_TRIS * 3, 16);
+
+   if (!util_optimize_vertex_cache(4, indices, NUM_TRIS * 3,
+                                   GRID * GRID, 32)) {
+      printf("util_optimize_vertex_cache failed\n");
+      ret = 1;
+      goto out;
+   }
+
+   acmr_after = util_vertex_cache_acmr(4, indices, NUM_TRIS * 3, 16);
+
+   memcpy(sorted_after, indices, NUM_TRIS * 3 * sizeof(uint));
+   qsort(sorted_after, NUM_TRIS, 3 * sizeof(uint), compare_tris);
+
+   if (memcmp(sorted_before, sorted_after, NUM_TRIS * 3 * sizeof(uint))) {
+      printf("Failure! Triangles changed by the reordering.\n");
+      ret = 1;
+   }
+   else if (!(acmr_after < 1.0f && acmr_after < acmr_before)) {
+      printf("Failure! ACMR %f -> %f\n", acmr_before, acmr_after);
+      ret = 1;
+   }
+   else {
+      printf("Success! ACMR %f -> %f\n", acmr_before, acmr_after);
+   }
+
+out:
+   FREE(indices);
+   FREE(sorted_before);
+   FREE(sorted_after);
+   return ret;
+}
@@ -30,7 +30,8 @@
  * Null software rasterizer winsys.
  * 
  * There is no present support. Framebuffer data needs to be obtained via
- * transfers.
+ * transfers, or rendered straight into user memory wrapped with
+ * displaytarget_create_mapped().
  *
  * @author Jose Fonseca
  */
@@ -43,6 +44,21 @@
 #include "null_sw_winsys.h"
 
 
+/** A display target wrapping caller owned memory */
+struct null_sw_displaytarget
+{
+   void *data;
+   unsigned stride;
+};
+
+
+static INLINE struct null_sw_displaytarget *
+null_sw_displaytarget(struct sw_displaytarget *dt)
+{
+   return (struct null_sw_displaytarget *) dt;
+}
+
+
 static boolean
 null_sw_is_displaytarget_format_supported(struct sw_winsys *ws,
                                           unsigned tex_usage,
@@ -57,8 +73,7 @@ null_sw_displaytarget_map(struct sw_winsys *ws,
                           struct sw_displaytarget *dt,
                           unsigned flags )
 {
-   assert(0);
-   return NULL;
+   return null_sw_displaytarget(dt)->data;
 }
 
 
@@ -66,7 +81,6 @@ static void
 null_sw_displaytarget_unmap(struct sw_winsys *ws,
                             struct sw_displaytarget *dt )
 {
-   assert(0);
 }
 
 
@@ -74,7 +88,8 @@ static void
 null_sw_displaytarget_destroy(struct sw_winsys *winsys,
                               struct sw_displaytarget *dt)
 {
-   assert(0);
+   /* the memory itself belongs to the caller */
+   FREE(null_sw_displaytarget(dt));
 }
 
 
@@ -91,6 +106,30 @@ null_sw_displaytarget_create(struct sw_winsys *winsys,
 }
 
 
+static struct sw_displaytarget *
+null_sw_displaytarget_create_mapped(struct sw_winsys *winsys,
+                                    unsigned tex_usage,
+                                    enum pipe_format format,
+                                    unsigned width, unsigned height,
+                                    unsigned stride,
+                                    void *data)
+{
+   struct null_sw_displaytarget *nsdt;
+
+   if (!data)
+      return NULL;
+
+   nsdt = CALLOC_STRUCT(null_sw_displaytarget);
+   if (!nsdt)
+      return NULL;
+
+   nsdt->data = data;
+   nsdt->stride = stride;
+
+   return (struct sw_displaytarget *) nsdt;
+}
+
+
 static struct sw_displaytarget *
 null_sw_displaytarget_from_handle(struct sw_winsys *winsys,
                                   const struct pipe_resource *templat,
@@ -140,6 +179,7 @@ null_sw_create(void)
    winsys->destroy = null_sw_destroy;
    winsys->is_displaytarget_format_supported = null_sw_is_displaytarget_format_supported;
    winsys->displaytarget_create = null_sw_displaytarget_create;
+   winsys->displaytarget_create_mapped = null_sw_displaytarget_create_mapped;
    winsys->displaytarget_from_handle = null_sw_displaytarget_from_handle;
    winsys->displaytarget_get_handle = null_sw_displaytarget_get_handle;
    winsys->displaytarget_map = null_sw_displaytarget_map;
@@ -467,6 +467,7 @@ dri2_convert_glx_attribs(unsigned num_attribs, const uint32_t *attribs,
    unsigned i;
    bool got_profile = false;
    uint32_t profile;
+   bool no_error = false;
 
    *major_ver = 1;
    *minor_ver = 0;
@@ -504,6 +505,9 @@ dri2_convert_glx_attribs(unsigned num_attribs, const uint32_t *attribs,
       case GLX_RENDER_TYPE:
          *render_type = attribs[i * 2 + 1];
 	 break;
+      case GLX_CONTEXT_OPENGL_NO_ERROR_ARB:
+         no_error = attribs[i * 2 + 1] != 0;
+         break;
       case GLX_CONTEXT_RESET_NOTIFICATION_STRATEGY_ARB:
          switch (attribs[i * 2 + 1]) {
          case GLX_NO_RESET_NOTIFICATION_ARB:
@@ -590,6 +594,12 @@ dri2_convert_glx_attribs(unsigned num_attribs, const uint32_t *attribs,
       return false;
    }
 
+   /* GLX_ARB_create_context_no_error is an attribute of its own, but the
+    * driver gets it as a context flag.
+    */
+   if (no_error)
+      *flags |= __DRI_CTX_FLAG_NO_ERROR;
+
    *error = __DRI_CTX_ERROR_SUCCESS;
    return true;
 }
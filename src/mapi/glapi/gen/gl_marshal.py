@@ -0,0 +1,501 @@
+#!/usr/bin/env python
+
+# Copyright 2015 VMware, Inc.
+# All Rights Reserved.
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice (including the next
+# paragraph) shall be included in all copies or substantial portions of the
+# Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+
+# This script generates the file marshal_generated.c, which contains the
+# marshalling dispatch table used by glthread (see main/glthread.h): one
+# function per GL entry point which either packs the call into a command
+# for the worker thread or, when the call can't be deferred, waits for the
+# worker and executes it directly.  It also generates the functions which
+# unpack and execute the commands on the worker thread.
+
+import license
+import gl_XML
+import sys, getopt
+
+
+header = """
+#include "api_exec.h"
+#include "context.h"
+#include "dispatch.h"
+#include "glthread.h"
+
+
+/* Offset of the variable-length data following a command struct. */
+#define MARSHAL_DATA_OFFSET(type) ((sizeof(type) + 7) & ~(size_t) 7)
+
+#define MARSHAL_ALIGN(size) (((size) + 7) & ~(size_t) 7)
+"""
+
+
+# Functions which always execute synchronously although their parameters
+# could be copied: glFinish has to wait for the worker anyway,
+# glPopClientAttrib restores bindings the application thread tracks (see
+# post_hooks), and the data of the others may come from a pixel unpack
+# buffer, in which case the pointer is an offset that can't be
+# dereferenced.
+sync_functions = set([
+    'Finish',
+    'PopClientAttrib',
+    'PolygonStipple',
+    'PixelMapfv',
+    'PixelMapuiv',
+    'PixelMapusv',
+    ])
+
+sync_prefixes = ('CompressedTex',)
+
+# Functions setting an array pointer: the pointer is only stored, so it is
+# passed by value.  Pointers set while no buffer is bound point to client
+# memory which is read at draw time.
+pointer_functions = set([
+    'ColorPointer',
+    'EdgeFlagPointer',
+    'FogCoordPointer',
+    'IndexPointer',
+    'InterleavedArrays',
+    'NormalPointer',
+    'PointSizePointerOES',
+    'SecondaryColorPointer',
+    'TexCoordPointer',
+    'VertexAttribIPointer',
+    'VertexAttribLPointer',
+    'VertexAttribPointer',
+    'VertexAttribPointerNV',
+    'VertexPointer',
+    'ColorPointerEXT',
+    'EdgeFlagPointerEXT',
+    'IndexPointerEXT',
+    'NormalPointerEXT',
+    'TexCoordPointerEXT',
+    'VertexPointerEXT',
+    ])
+
+# Draws which read the current vertex arrays: deferred unless some array
+# points to client memory.
+array_draw_functions = set([
+    'ArrayElement',
+    'DrawArrays',
+    'DrawArraysInstancedARB',
+    'DrawArraysInstancedBaseInstance',
+    'DrawTransformFeedback',
+    'DrawTransformFeedbackInstanced',
+    'DrawTransformFeedbackStream',
+    'DrawTransformFeedbackStreamInstanced',
+    ])
+
+# Draws which also read indices: deferred only if those come from an
+# element array buffer, so that 'indices' is an offset.
+element_draw_functions = set([
+    'DrawElements',
+    'DrawElementsBaseVertex',
+    'DrawElementsInstancedARB',
+    'DrawElementsInstancedBaseInstance',
+    'DrawElementsInstancedBaseVertex',
+    'DrawElementsInstancedBaseVertexBaseInstance',
+    'DrawRangeElements',
+    'DrawRangeElementsBaseVertex',
+    ])
+
+# State the application thread tracks itself, updated before the call is
+# queued.
+hooks = {
+    'BindBuffer': '_mesa_glthread_BindBuffer(ctx, target, buffer);',
+    'DeleteBuffers': '_mesa_glthread_DeleteBuffers(ctx, n, buffer);',
+    'BindVertexArray': '_mesa_glthread_BindVertexArray(ctx, array);',
+    'BindVertexArrayAPPLE': '_mesa_glthread_BindVertexArray(ctx, array);',
+    'DeleteVertexArrays':
+        '_mesa_glthread_DeleteVertexArrays(ctx, n, arrays);',
+    'BindVertexBuffer':
+        '_mesa_glthread_BindVertexBuffers(ctx, 1, &buffer);',
+    'BindVertexBuffers':
+        '_mesa_glthread_BindVertexBuffers(ctx, count, buffers);',
+    }
+
+# State the application thread reads back after a synchronous call.
+post_hooks = {
+    'GenBuffers': '_mesa_glthread_GenBuffers(ctx, n, buffer);',
+    'CreateBuffers': '_mesa_glthread_GenBuffers(ctx, n, buffers);',
+    'PopClientAttrib': '_mesa_glthread_PopClientAttrib(ctx);',
+    }
+
+
+class marshal_param(object):
+    """How one parameter is stored in a command."""
+
+    # kinds
+    VALUE = 0       # stored in the command struct
+    FIXED = 1       # array of known size stored in the command struct
+    VARIABLE = 2    # array whose size depends on another parameter,
+                    # stored after the command struct
+
+    def __init__(self, func, p, kind):
+        self.p = p
+        self.name = p.name
+        self.kind = kind
+
+    def base_type(self):
+        base = self.p.get_base_type_string()
+        if base in ('GLvoid', 'void'):
+            return 'GLubyte'
+        return base
+
+    def fixed_elements(self):
+        """Number of elements of a FIXED array."""
+        if self.base_type() == 'GLubyte':
+            return self.p.size()
+        return self.p.count * self.p.count_scale
+
+    def size_expr(self):
+        """Size in bytes of a VARIABLE array."""
+        return '(size_t) %s * %d' % (self.p.counter, self.p.size())
+
+
+class marshal_function(object):
+    def __init__(self, func):
+        self.func = func
+        self.name = func.name
+        self.params = []
+        self.is_async = self.classify()
+
+    def classify(self):
+        f = self.func
+
+        if f.return_type != 'void':
+            return False
+        if f.name in sync_functions or f.name.startswith(sync_prefixes):
+            return False
+
+        names = [p.name for p in f.parameterIterator()]
+        if 'ctx' in names or 'cmd' in names:
+            return False
+
+        for p in f.parameterIterator():
+            if p.is_padding:
+                continue
+
+            if not p.is_pointer():
+                self.params.append(marshal_param(f, p, marshal_param.VALUE))
+                continue
+
+            if f.name in pointer_functions and p.name == 'pointer':
+                self.params.append(marshal_param(f, p, marshal_param.VALUE))
+                continue
+            if f.name in element_draw_functions and p.name == 'indices':
+                self.params.append(marshal_param(f, p, marshal_param.VALUE))
+                continue
+
+            # Everything else must be input data of a known size.
+            type_string = p.type_string()
+            if (p.is_output or p.is_image() or p.count_parameter_list or
+                not type_string.startswith('const') or
+                type_string.count('*') > 1):
+                return False
+
+            if p.counter:
+                counters = [c for c in f.parameterIterator()
+                            if c.name == p.counter and not c.is_pointer()]
+                if not counters:
+                    return False
+                self.params.append(marshal_param(f, p,
+                                                 marshal_param.VARIABLE))
+            elif p.count:
+                self.params.append(marshal_param(f, p, marshal_param.FIXED))
+            else:
+                return False
+
+        return True
+
+    def variable_params(self):
+        return [p for p in self.params if p.kind == marshal_param.VARIABLE]
+
+    def fixed_params(self):
+        return [p for p in self.params if p.kind == marshal_param.FIXED]
+
+    def async_condition(self):
+        """C condition which must hold for the call to be deferred."""
+        conditions = []
+
+        if self.name in array_draw_functions:
+            conditions.append('!_mesa_glthread_has_user_pointers(ctx)')
+        if self.name in element_draw_functions:
+            conditions.append('!_mesa_glthread_has_user_pointers(ctx)')
+            conditions.append('_mesa_glthread_has_index_buffer(ctx)')
+        for p in self.fixed_params():
+            conditions.append('%s != NULL' % (p.name))
+        for p in self.variable_params():
+            # Also rejects negative counts, which are errors.
+            conditions.append('(size_t) %s <= MARSHAL_MAX_CMD_SIZE' %
+                              (p.p.counter))
+        if self.variable_params():
+            conditions.append('cmd_size <= MARSHAL_MAX_CMD_SIZE')
+
+        return ' && '.join(conditions)
+
+    def print_struct(self):
+        print 'struct marshal_cmd_%s' % (self.name)
+        print '{'
+        print '   struct marshal_cmd_base cmd_base;'
+        for p in self.params:
+            if p.kind == marshal_param.VALUE:
+                print '   %s %s;' % (p.p.type_string(), p.name)
+            elif p.kind == marshal_param.FIXED:
+                print '   %s %s[%d];' % (p.base_type(), p.name,
+                                         p.fixed_elements())
+            else:
+                print '   GLboolean %s_null;' % (p.name)
+        print '};'
+        print
+
+    def print_unmarshal(self):
+        print 'static void'
+        print '_mesa_unmarshal_%s(struct gl_context *ctx, const void *_cmd)' % \
+            (self.name)
+        print '{'
+        if self.params:
+            print '   const struct marshal_cmd_%s *cmd = _cmd;' % (self.name)
+        variable = self.variable_params()
+        if variable:
+            print '   const char *variable_data = (const char *) cmd +'
+            print '      MARSHAL_DATA_OFFSET(struct marshal_cmd_%s);' % \
+                (self.name)
+            for p in variable:
+                print '   const %s *%s = NULL;' % (p.base_type(), p.name)
+            print
+            for p in variable:
+                counter = 'cmd->%s' % (p.p.counter)
+                print '   if (!cmd->%s_null) {' % (p.name)
+                print '      %s = (const %s *) variable_data;' % \
+                    (p.name, p.base_type())
+                if p != variable[-1]:
+                    print '      variable_data += MARSHAL_ALIGN((size_t) %s * %d);' % \
+                        (counter, p.p.size())
+                print '   }'
+
+        args = []
+        for p in self.func.parameterIterator():
+            if p.is_padding:
+                continue
+            if [v for v in variable if v.name == p.name]:
+                args.append(p.name)
+            else:
+                args.append('cmd->%s' % (p.name))
+        if self.params:
+            print
+        print '   CALL_%s(ctx->CurrentDispatch, (%s));' % \
+            (self.name, ', '.join(args))
+        print '}'
+        print
+
+    def print_sync_call(self, indent):
+        f = self.func
+        print '%s_mesa_glthread_finish_before(ctx, "%s");' % (indent, f.name)
+        if f.return_type != 'void':
+            print '%sresult = CALL_%s(ctx->CurrentDispatch, (%s));' % \
+                (indent, f.name, f.get_called_parameter_string())
+        else:
+            print '%sCALL_%s(ctx->CurrentDispatch, (%s));' % \
+                (indent, f.name, f.get_called_parameter_string())
+        if f.name in post_hooks:
+            print '%s%s' % (indent, post_hooks[f.name])
+        print '%s_mesa_glthread_restore_dispatch(ctx);' % (indent)
+
+    def print_marshal(self):
+        f = self.func
+        print 'static %s GLAPIENTRY' % (f.return_type)
+        print '_mesa_marshal_%s(%s)' % (f.name, f.get_parameter_string())
+        print '{'
+        print '   GET_CURRENT_CONTEXT(ctx);'
+
+        if f.return_type != 'void':
+            print '   %s result;' % (f.return_type)
+        if not self.is_async:
+            print
+            if f.name in hooks:
+                print '   %s' % (hooks[f.name])
+            self.print_sync_call('   ')
+            if f.return_type != 'void':
+                print '   return result;'
+            print '}'
+            print
+            return
+
+        variable = self.variable_params()
+        for p in variable:
+            print '   size_t %s_size = %s ? %s : 0;' % \
+                (p.name, p.name, p.size_expr())
+        cmd_size = 'MARSHAL_DATA_OFFSET(struct marshal_cmd_%s)' % (self.name)
+        for p in variable:
+            cmd_size += ' +\n      MARSHAL_ALIGN(%s_size)' % (p.name)
+        print '   size_t cmd_size = %s;' % (cmd_size)
+        if self.params:
+            print '   struct marshal_cmd_%s *cmd;' % (self.name)
+        print
+
+        if f.name in hooks:
+            print '   %s' % (hooks[f.name])
+        if f.name in pointer_functions:
+            print '   _mesa_glthread_AttribPointer(ctx);'
+
+        condition = self.async_condition()
+        indent = '   '
+        if condition:
+            print '   if (%s) {' % (condition)
+            indent = '      '
+
+        if self.params:
+            print '%scmd = _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_%s,' \
+                % (indent, self.name)
+            print '%s                                      cmd_size);' % (indent)
+        else:
+            print '%s_mesa_glthread_allocate_command(ctx, DISPATCH_CMD_%s, cmd_size);' \
+                % (indent, self.name)
+        for p in self.params:
+            if p.kind == marshal_param.VALUE:
+                print '%scmd->%s = %s;' % (indent, p.name, p.name)
+            elif p.kind == marshal_param.FIXED:
+                print '%smemcpy(cmd->%s, %s, %d);' % \
+                    (indent, p.name, p.name, p.p.size())
+            else:
+                print '%scmd->%s_null = %s == NULL;' % \
+                    (indent, p.name, p.name)
+        if variable:
+            print '%s{' % (indent)
+            print '%s   char *variable_data = (char *) cmd +' % (indent)
+            print '%s      MARSHAL_DATA_OFFSET(struct marshal_cmd_%s);' % \
+                (indent, self.name)
+            for p in variable:
+                print '%s   memcpy(variable_data, %s, %s_size);' % \
+                    (indent, p.name, p.name)
+                if p != variable[-1]:
+                    print '%s   variable_data += MARSHAL_ALIGN(%s_size);' % \
+                        (indent, p.name)
+            print '%s}' % (indent)
+
+        if condition:
+            print '      return;'
+            print '   }'
+            print
+            self.print_sync_call('   ')
+        print '}'
+        print
+
+
+class PrintCode(gl_XML.gl_print_base):
+
+    def __init__(self):
+        gl_XML.gl_print_base.__init__(self)
+
+        self.name = 'gl_marshal.py'
+        self.license = license.bsd_license_template % (
+            'Copyright 2015 VMware, Inc.', 'VMWARE')
+
+    def printRealHeader(self):
+        print header
+
+    def printBody(self, api):
+        functions = [marshal_function(f)
+                     for f in api.functionIterateByOffset()]
+        deferred = [m for m in functions if m.is_async]
+
+        print 'enum marshal_dispatch_cmd_id'
+        print '{'
+        for m in deferred:
+            print '   DISPATCH_CMD_%s,' % (m.name)
+        print '   NUM_DISPATCH_CMD'
+        print '};'
+        print
+        print
+
+        for m in deferred:
+            m.print_struct()
+            m.print_unmarshal()
+        for m in functions:
+            m.print_marshal()
+
+        print
+        print 'typedef void (*unmarshal_func)(struct gl_context *ctx,'
+        print '                               const void *cmd);'
+        print
+        print 'static const unmarshal_func unmarshal_dispatch[NUM_DISPATCH_CMD] = {'
+        for m in deferred:
+            print '   [DISPATCH_CMD_%s] = _mesa_unmarshal_%s,' % \
+                (m.name, m.name)
+        print '};'
+        print
+        print
+        print '/**'
+        print ' * Execute one command on the worker thread.'
+        print ' * \\return the size of the command in bytes'
+        print ' */'
+        print 'size_t'
+        print '_mesa_unmarshal_dispatch_cmd(struct gl_context *ctx, const void *cmd)'
+        print '{'
+        print '   const struct marshal_cmd_base *cmd_base = cmd;'
+        print
+        print '   assert(cmd_base->cmd_id < NUM_DISPATCH_CMD);'
+        print '   unmarshal_dispatch[cmd_base->cmd_id](ctx, cmd);'
+        print '   return cmd_base->cmd_size;'
+        print '}'
+        print
+        print
+        print '/**'
+        print ' * Create the dispatch table installed on the application thread'
+        print ' * while glthread is active.'
+        print ' */'
+        print 'struct _glapi_table *'
+        print '_mesa_create_marshal_table(const struct gl_context *ctx)'
+        print '{'
+        print '   struct _glapi_table *table = _mesa_alloc_dispatch_table();'
+        print
+        print '   if (table == NULL)'
+        print '      return NULL;'
+        print
+        for m in functions:
+            print '   SET_%s(table, _mesa_marshal_%s);' % (m.name, m.name)
+        print
+        print '   return table;'
+        print '}'
+
+
+def show_usage():
+    print "Usage: %s [-f input_file_name]" % sys.argv[0]
+    sys.exit(1)
+
+
+if __name__ == '__main__':
+    file_name = "gl_and_es_API.xml"
+
+    try:
+        (args, trail) = getopt.getopt(sys.argv[1:], "f:")
+    except Exception,e:
+        show_usage()
+
+    for (arg,val) in args:
+        if arg == "-f":
+            file_name = val
+
+    printer = PrintCode()
+
+    api = gl_XML.parse_GL_API(file_name)
+    printer.Print(api)
@@ -828,6 +828,65 @@ OSMesaCreateContextExt( GLenum format, GLint depthBits, GLint stencilBits,
 }
 
 
+/**
+ * New in Mesa 10.6
+ *
+ * Create context with attribute list.  The classic OSMesa only does
+ * compatibility profile contexts.
+ */
+GLAPI OSMesaContext GLAPIENTRY
+OSMesaCreateContextAttribs(const int *attribList, OSMesaContext sharelist)
+{
+   OSMesaContext osmesa;
+   GLenum format = GL_RGBA;
+   int depthBits = 0, stencilBits = 0, accumBits = 0;
+   int profile = OSMESA_COMPAT_PROFILE, version_major = 1, version_minor = 0;
+   int i;
+
+   for (i = 0; attribList[i]; i += 2) {
+      switch (attribList[i]) {
+      case OSMESA_FORMAT:
+         format = attribList[i+1];
+         break;
+      case OSMESA_DEPTH_BITS:
+         depthBits = attribList[i+1];
+         break;
+      case OSMESA_STENCIL_BITS:
+         stencilBits = attribList[i+1];
+         break;
+      case OSMESA_ACCUM_BITS:
+         accumBits = attribList[i+1];
+         break;
+      case OSMESA_PROFILE:
+         profile = attribList[i+1];
+         break;
+      case OSMESA_CONTEXT_MAJOR_VERSION:
+         version_major = attribList[i+1];
+         break;
+      case OSMESA_CONTEXT_MINOR_VERSION:
+         version_minor = attribList[i+1];
+         break;
+      default:
+         _mesa_warning(NULL, "Bad attribute in OSMesaCreateContextAttribs()");
+         return NULL;
+      }
+   }
+
+   if (profile != OSMESA_COMPAT_PROFILE)
+      return NULL;
+
+   osmesa = OSMesaCreateContextExt(format, depthBits, stencilBits,
+                                   accumBits, sharelist);
+   if (osmesa &&
+       osmesa->mesa.Version < (GLuint) (version_major * 10 + version_minor)) {
+      OSMesaDestroyContext(osmesa);
+      return NULL;
+   }
+
+   return osmesa;
+}
+
+
 /**
  * Destroy an Off-Screen Mesa rendering context.
  *
@@ -1121,6 +1180,7 @@ struct name_function
 static struct name_function functions[] = {
    { "OSMesaCreateContext", (OSMESAproc) OSMesaCreateContext },
    { "OSMesaCreateContextExt", (OSMESAproc) OSMesaCreateContextExt },
+   { "OSMesaCreateContextAttribs", (OSMESAproc) OSMesaCreateContextAttribs },
    { "OSMesaDestroyContext", (OSMESAproc) OSMesaDestroyContext },
    { "OSMesaMakeCurrent", (OSMESAproc) OSMesaMakeCurrent },
    { "OSMesaGetCurrentContext", (OSMESAproc) OSMesaGetCurrentContext },
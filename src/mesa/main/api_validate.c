@@ -30,6 +30,7 @@
 #include "imports.h"
 #include "mtypes.h"
 #include "enums.h"
+#include "state.h"
 #include "vbo/vbo.h"
 #include "transformfeedback.h"
 #include <stdbool.h>
@@ -104,6 +105,47 @@ check_valid_to_render(struct gl_context *ctx, const char *function)
 }
 
 
+/**
+ * What's left of the draw validation in a KHR_no_error context: flush the
+ * current vertex attributes, bring the derived state up to date and skip
+ * the draws which draw nothing without generating an error.  None of the
+ * parameter, program or framebuffer checks are done.
+ *
+ * \return GL_TRUE if there is something to draw
+ */
+GLboolean
+_mesa_prepare_draw_no_error(struct gl_context *ctx, GLsizei count,
+                            GLsizei numInstances)
+{
+   FLUSH_CURRENT(ctx, 0);
+
+   if (ctx->NewState)
+      _mesa_update_state(ctx);
+
+   if (count == 0 || numInstances == 0)
+      return GL_FALSE;
+
+   switch (ctx->API) {
+   case API_OPENGLES2:
+   case API_OPENGL_CORE:
+      return ctx->VertexProgram._Current != NULL;
+
+   case API_OPENGLES:
+      return ctx->Array.VAO->VertexAttrib[VERT_ATTRIB_POS].Enabled;
+
+   case API_OPENGL_COMPAT:
+      return (ctx->VertexProgram._Current != NULL ||
+              ctx->Array.VAO->VertexAttrib[VERT_ATTRIB_POS].Enabled ||
+              ctx->Array.VAO->VertexAttrib[VERT_ATTRIB_GENERIC0].Enabled);
+
+   default:
+      unreachable("Invalid API value in _mesa_prepare_draw_no_error()");
+   }
+
+   return GL_TRUE;
+}
+
+
 /**
  * Is 'mode' a valid value for glBegin(), glDrawArrays(), glDrawElements(),
  * etc?  The set of legal values depends on whether geometry shaders/programs
@@ -42,6 +42,11 @@ extern GLboolean
 _mesa_valid_prim_mode(struct gl_context *ctx, GLenum mode, const char *name);
 
 
+extern GLboolean
+_mesa_prepare_draw_no_error(struct gl_context *ctx, GLsizei count,
+                            GLsizei numInstances);
+
+
 extern GLboolean
 _mesa_validate_DrawArrays(struct gl_context *ctx, GLenum mode, GLsizei count);
 
@@ -47,6 +47,7 @@
 #include "texstore.h"
 #include "transformfeedback.h"
 #include "dispatch.h"
+#include "util/hash_table.h"
 
 
 /* Debug flags */
@@ -425,6 +426,54 @@ _mesa_delete_buffer_object(struct gl_context *ctx,
 
 
 
+/**
+ * Mark the index ranges memoized for this buffer by vbo_get_minmax_index()
+ * as stale.  Called whenever the contents of the buffer may change.
+ */
+static void
+invalidate_minmax_cache(struct gl_buffer_object *bufObj)
+{
+   mtx_lock(&bufObj->MinMaxCacheMutex);
+   bufObj->MinMaxCacheDirty = true;
+   mtx_unlock(&bufObj->MinMaxCacheMutex);
+}
+
+
+static void
+delete_minmax_cache_entry(struct hash_entry *entry)
+{
+   free(entry->data);
+}
+
+
+/**
+ * Free the min/max index cache of a buffer object that's being deleted,
+ * and report how useful it was.
+ */
+static void
+delete_minmax_cache(struct gl_buffer_object *bufObj)
+{
+   const unsigned lookups = bufObj->MinMaxCacheHits +
+                            bufObj->MinMaxCacheMisses;
+
+   if (MESA_VERBOSE & VERBOSE_DRAW && lookups) {
+      _mesa_debug(NULL, "buffer %u min/max index cache: %u hits, "
+                  "%u misses (%.1f%%)%s\n", bufObj->Name,
+                  bufObj->MinMaxCacheHits, bufObj->MinMaxCacheMisses,
+                  100.0 * bufObj->MinMaxCacheHits / lookups,
+                  bufObj->MinMaxCacheDisabled ? ", disabled" : "");
+   }
+
+   if (bufObj->MinMaxCache) {
+      _mesa_hash_table_destroy(bufObj->MinMaxCache,
+                               delete_minmax_cache_entry);
+      bufObj->MinMaxCache = NULL;
+   }
+
+   mtx_destroy(&bufObj->MinMaxCacheMutex);
+}
+
+
 /**
  * Set ptr to bufObj w/ reference counting.
  * This is normally only called from the _mesa_reference_buffer_object() macro
@@ -460,6 +509,8 @@ _mesa_reference_buffer_object_(struct gl_context *ctx,
 	 assert(ctx->Array.VAO->Vertex.BufferObj != bufObj);
 #endif
 
+         delete_minmax_cache(oldObj);
+
 	 assert(ctx->Driver.DeleteBuffer);
          ctx->Driver.DeleteBuffer(ctx, oldObj);
       }
@@ -500,6 +551,7 @@ _mesa_initialize_buffer_object(struct gl_context *ctx,
 {
    memset(obj, 0, sizeof(struct gl_buffer_object));
    mtx_init(&obj->Mutex, mtx_plain);
+   mtx_init(&obj->MinMaxCacheMutex, mtx_plain);
    obj->RefCount = 1;
    obj->Name = name;
    obj->Usage = GL_STATIC_DRAW_ARB;
@@ -955,6 +1007,12 @@ bind_buffer_object(struct gl_context *ctx, GLenum target, GLuint buffer)
          return;
    }
    
+   /* GPU writes into pack buffers aren't tracked, remember that this one
+    * may get some so that nothing gets cached about its contents.
+    */
+   if (target == GL_PIXEL_PACK_BUFFER && _mesa_is_bufferobj(newBufObj))
+      newBufObj->UsageHistory |= USAGE_PIXEL_PACK_BUFFER;
+
    /* bind new buffer */
    _mesa_reference_buffer_object(ctx, bindTarget, newBufObj);
 }
@@ -1438,6 +1496,7 @@ _mesa_buffer_storage(struct gl_context *ctx, struct gl_buffer_object *bufObj,
 
    bufObj->Written = GL_TRUE;
    bufObj->Immutable = GL_TRUE;
+   invalidate_minmax_cache(bufObj);
 
    assert(ctx->Driver.BufferData);
    if (!ctx->Driver.BufferData(ctx, target, size, data, GL_DYNAMIC_DRAW,
@@ -1550,6 +1609,7 @@ _mesa_buffer_data(struct gl_context *ctx, struct gl_buffer_object *bufObj,
    FLUSH_VERTICES(ctx, _NEW_BUFFER_OBJECT);
 
    bufObj->Written = GL_TRUE;
+   invalidate_minmax_cache(bufObj);
 
 #ifdef VBO_DEBUG
    printf("glBufferDataARB(%u, sz %ld, from %p, usage 0x%x)\n",
@@ -1647,6 +1707,7 @@ _mesa_buffer_sub_data(struct gl_context *ctx, struct gl_buffer_object *bufObj,
       return;
 
    bufObj->Written = GL_TRUE;
+   invalidate_minmax_cache(bufObj);
 
    assert(ctx->Driver.BufferSubData);
    ctx->Driver.BufferSubData(ctx, offset, size, data, bufObj);
@@ -1762,6 +1823,8 @@ _mesa_clear_buffer_sub_data(struct gl_context *ctx,
       return;
    }
 
+   invalidate_minmax_cache(bufObj);
+
    if (data == NULL) {
       /* clear to zeros, per the spec */
       if (size > 0) {
@@ -2179,6 +2242,8 @@ _mesa_copy_buffer_sub_data(struct gl_context *ctx,
       }
    }
 
+   invalidate_minmax_cache(dst);
+
    ctx->Driver.CopyBufferSubData(ctx, src, dst, readOffset, writeOffset, size);
 }
 
@@ -2371,8 +2436,10 @@ _mesa_map_buffer_range(struct gl_context *ctx,
       assert(bufObj->Mappings[MAP_USER].AccessFlags == access);
    }
 
-   if (access & GL_MAP_WRITE_BIT)
+   if (access & GL_MAP_WRITE_BIT) {
       bufObj->Written = GL_TRUE;
+      invalidate_minmax_cache(bufObj);
+   }
 
 #ifdef VBO_DEBUG
    if (strstr(func, "Range") == NULL) { /* If not MapRange */
@@ -98,6 +98,7 @@
 #include "fog.h"
 #include "formats.h"
 #include "framebuffer.h"
+#include "glthread.h"
 #include "hint.h"
 #include "hash.h"
 #include "light.h"
@@ -117,6 +118,7 @@
 #include "remap.h"
 #include "scissor.h"
 #include "shared.h"
+#include "shaderapi.h"
 #include "shaderobj.h"
 #include "util/simple_list.h"
 #include "state.h"
@@ -931,8 +933,8 @@ nop_glFlush(void)
  * populated with pointers to "no-op" functions.  In turn, the no-op
  * functions will call nop_handler() above.
  */
-static struct _glapi_table *
-alloc_dispatch_table(void)
+struct _glapi_table *
+_mesa_alloc_dispatch_table(void)
 {
    /* Find the larger of Mesa's dispatch table and libGL's dispatch table.
     * In practice, this'll be the same for stand-alone Mesa.  But for DRI
@@ -1001,7 +1003,7 @@ create_beginend_table(const struct gl_context *ctx)
 {
    struct _glapi_table *table;
 
-   table = alloc_dispatch_table();
+   table = _mesa_alloc_dispatch_table();
    if (!table)
       return NULL;
 
@@ -1044,12 +1046,32 @@ create_beginend_table(const struct gl_context *ctx)
    return table;
 }
 
+/**
+ * Replace the frequently called state setters with versions which don't
+ * validate their parameters, for contexts where the application promised
+ * not to generate errors.  The draw calls are handled by
+ * vbo_initialize_exec_dispatch().
+ */
+static void
+install_no_error_functions(struct gl_context *ctx, struct _glapi_table *exec)
+{
+   SET_BlendFunc(exec, _mesa_BlendFunc_no_error);
+   SET_BlendFuncSeparate(exec, _mesa_BlendFuncSeparate_no_error);
+   SET_DepthFunc(exec, _mesa_DepthFunc_no_error);
+
+   if (ctx->API != API_OPENGLES)
+      SET_UseProgram(exec, _mesa_UseProgram_no_error);
+}
+
 void
 _mesa_initialize_dispatch_tables(struct gl_context *ctx)
 {
    /* Do the code-generated setup of the exec table in api_exec.c. */
    _mesa_initialize_exec_table(ctx);
 
+   if (_mesa_is_no_error_enabled(ctx))
+      install_no_error_functions(ctx, ctx->Exec);
+
    if (ctx->Save)
       _mesa_initialize_save_table(ctx);
 }
@@ -1139,8 +1161,14 @@ _mesa_initialize_context(struct gl_context *ctx,
    if (!init_attrib_groups( ctx ))
       goto fail;
 
+   /* Pretend the application asked for a KHR_no_error context.  This has to
+    * be known before the dispatch tables are set up.
+    */
+   if (getenv("MESA_NO_ERROR"))
+      ctx->Const.ContextFlags |= GL_CONTEXT_FLAG_NO_ERROR_BIT_KHR;
+
    /* setup the API dispatch tables with all nop functions */
-   ctx->OutsideBeginEnd = alloc_dispatch_table();
+   ctx->OutsideBeginEnd = _mesa_alloc_dispatch_table();
    if (!ctx->OutsideBeginEnd)
       goto fail;
    ctx->Exec = ctx->OutsideBeginEnd;
@@ -1167,7 +1195,7 @@ _mesa_initialize_context(struct gl_context *ctx,
    switch (ctx->API) {
    case API_OPENGL_COMPAT:
       ctx->BeginEnd = create_beginend_table(ctx);
-      ctx->Save = alloc_dispatch_table();
+      ctx->Save = _mesa_alloc_dispatch_table();
       if (!ctx->BeginEnd || !ctx->Save)
          goto fail;
 
@@ -1263,6 +1291,8 @@ _mesa_free_context_data( struct gl_context *ctx )
       _mesa_make_current(ctx, NULL, NULL);
    }
 
+   _mesa_glthread_destroy(ctx);
+
    /* unreference WinSysDraw/Read buffers */
    _mesa_reference_framebuffer(&ctx->WinSysDrawBuffer, NULL);
    _mesa_reference_framebuffer(&ctx->WinSysReadBuffer, NULL);
@@ -1614,6 +1644,12 @@ _mesa_make_current( struct gl_context *newCtx,
    if (MESA_VERBOSE & VERBOSE_API)
       _mesa_debug(newCtx, "_mesa_make_current()\n");
 
+   /* Both contexts are accessed directly below. */
+   if (curCtx)
+      _mesa_glthread_finish(curCtx);
+   if (newCtx && newCtx != curCtx)
+      _mesa_glthread_finish(newCtx);
+
    /* Check that the context's and framebuffer's visuals are compatible.
     */
    if (newCtx && drawBuffer && newCtx->WinSysDrawBuffer != drawBuffer) {
@@ -1647,7 +1683,10 @@ _mesa_make_current( struct gl_context *newCtx,
       _glapi_set_dispatch(NULL);  /* none current */
    }
    else {
-      _glapi_set_dispatch(newCtx->CurrentDispatch);
+      if (newCtx->GLThread)
+         _glapi_set_dispatch(newCtx->MarshalExec);
+      else
+         _glapi_set_dispatch(newCtx->CurrentDispatch);
 
       if (drawBuffer && readBuffer) {
          assert(_mesa_is_winsys_fbo(drawBuffer));
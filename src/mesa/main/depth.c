@@ -57,6 +57,20 @@ _mesa_ClearDepthf( GLclampf depth )
 }
 
 
+static void
+depth_func(struct gl_context *ctx, GLenum func)
+{
+   if (ctx->Depth.Func == func)
+      return;
+
+   FLUSH_VERTICES(ctx, _NEW_DEPTH);
+   ctx->Depth.Func = func;
+
+   if (ctx->Driver.DepthFunc)
+      ctx->Driver.DepthFunc( ctx, func );
+}
+
+
 void GLAPIENTRY
 _mesa_DepthFunc( GLenum func )
 {
@@ -80,14 +94,18 @@ _mesa_DepthFunc( GLenum func )
       return;
    }
 
-   if (ctx->Depth.Func == func)
-      return;
+   depth_func(ctx, func);
+}
 
-   FLUSH_VERTICES(ctx, _NEW_DEPTH);
-   ctx->Depth.Func = func;
 
-   if (ctx->Driver.DepthFunc)
-      ctx->Driver.DepthFunc( ctx, func );
+/**
+ * glDepthFunc() for KHR_no_error contexts: the function isn't validated.
+ */
+void GLAPIENTRY
+_mesa_DepthFunc_no_error(GLenum func)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   depth_func(ctx, func);
 }
 
 
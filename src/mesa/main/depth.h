@@ -46,6 +46,9 @@ _mesa_ClearDepthf( GLclampf depth );
 extern void GLAPIENTRY
 _mesa_DepthFunc( GLenum func );
 
+extern void GLAPIENTRY
+_mesa_DepthFunc_no_error(GLenum func);
+
 extern void GLAPIENTRY
 _mesa_DepthMask( GLboolean flag );
 
@@ -1211,6 +1211,125 @@ trim_list(struct gl_context *ctx)
 }
 
 
+/**
+ * Append an item to the array built by merge_vertex_lists().
+ */
+static struct vbo_save_list_item *
+add_list_item(struct vbo_save_list_item **items, GLuint *count, GLuint *max)
+{
+   if (*count == *max) {
+      GLuint new_max = MAX2(*max * 2, 64);
+      struct vbo_save_list_item *new_items =
+         realloc(*items, new_max * sizeof(**items));
+      if (!new_items)
+         return NULL;
+      *items = new_items;
+      *max = new_max;
+   }
+   memset(&(*items)[*count], 0, sizeof(**items));
+   return &(*items)[(*count)++];
+}
+
+
+/**
+ * Called by EndList to let the vbo module merge vertex lists which are
+ * only separated by current attribute changes (glColor, glNormal, etc.
+ * outside glBegin/End) into fewer draws.  Each sequence of extension
+ * opcodes and constant attribute values is passed to
+ * vbo_save_merge_vertex_lists(); any other instruction ends a sequence.
+ * That includes glMaterial, which is lighting state rather than a vertex
+ * attribute once a vertex program is bound.
+ */
+static void
+merge_vertex_lists(struct gl_context *ctx, struct gl_display_list *dlist)
+{
+   struct vbo_save_list_item *items = NULL, *item;
+   GLuint num_items = 0, max_items = 0;
+   GLuint draws_before = 0, draws_after = 0;
+   Node *n = dlist->Head;
+   GLboolean done = n == NULL;
+
+   while (!done) {
+      const OpCode opcode = n[0].opcode;
+      GLboolean barrier = GL_FALSE;
+
+      if (is_ext_opcode(opcode)) {
+         item = add_list_item(&items, &num_items, &max_items);
+         if (item) {
+            item->opcode = opcode;
+            item->data = &n[1];
+         }
+         else {
+            barrier = GL_TRUE;
+         }
+         n += ctx->ListExt->Opcode[opcode - OPCODE_EXT_0].Size;
+      }
+      else {
+         switch (opcode) {
+         case OPCODE_ATTR_1F_NV:
+         case OPCODE_ATTR_2F_NV:
+         case OPCODE_ATTR_3F_NV:
+         case OPCODE_ATTR_4F_NV:
+         case OPCODE_ATTR_1F_ARB:
+         case OPCODE_ATTR_2F_ARB:
+         case OPCODE_ATTR_3F_ARB:
+         case OPCODE_ATTR_4F_ARB:
+            {
+               const GLboolean arb = opcode >= OPCODE_ATTR_1F_ARB;
+               const GLuint size = 1 + (opcode - (arb ? OPCODE_ATTR_1F_ARB :
+                                                        OPCODE_ATTR_1F_NV));
+               GLuint attr = n[1].ui;
+
+               /* attribute 0 would emit a vertex */
+               if (attr == 0) {
+                  barrier = GL_TRUE;
+                  break;
+               }
+               if (arb)
+                  attr = VERT_ATTRIB_GENERIC(attr);
+
+               item = add_list_item(&items, &num_items, &max_items);
+               if (!item) {
+                  barrier = GL_TRUE;
+                  break;
+               }
+               item->attr = attr;
+               item->size = size;
+               ASSIGN_4V(item->value, 0, 0, 0, 1);
+               COPY_SZ_4V(item->value, size, &n[2].f);
+            }
+            break;
+         case OPCODE_NOP:
+            break;
+         case OPCODE_END_OF_LIST:
+            done = GL_TRUE;
+            /* fall-through */
+         default:
+            barrier = GL_TRUE;
+            break;
+         }
+
+         if (opcode == OPCODE_CONTINUE)
+            n = (Node *) get_pointer(&n[1]);
+         else
+            n += InstSize[opcode];
+      }
+
+      if (barrier && num_items) {
+         vbo_save_merge_vertex_lists(ctx, items, num_items,
+                                     &draws_before, &draws_after);
+         num_items = 0;
+      }
+   }
+
+   free(items);
+
+   if (MESA_VERBOSE & VERBOSE_DISPLAY_LIST)
+      _mesa_debug(ctx, "display list %u: %u draws, %u after merging "
+                  "vertex lists\n", dlist->Name, draws_before, draws_after);
+}
+
+
 
 /*
  * Display List compilation functions
@@ -9096,6 +9215,8 @@ _mesa_EndList(void)
 
    trim_list(ctx);
 
+   merge_vertex_lists(ctx, ctx->ListState.CurrentList);
+
    /* Destroy old list, if any */
    destroy_list(ctx, ctx->ListState.CurrentList->Name);
 
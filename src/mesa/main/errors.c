@@ -1454,6 +1454,13 @@ _mesa_error( struct gl_context *ctx, GLenum error, const char *fmtString, ... )
     */
    static GLuint error_msg_id = 0;
 
+   /* In a KHR_no_error context GetError may only ever return NO_ERROR or
+    * OUT_OF_MEMORY, and errors which are still detected needn't be reported
+    * through the debug output either.
+    */
+   if (_mesa_is_no_error_enabled(ctx) && error != GL_OUT_OF_MEMORY)
+      return;
+
    debug_get_id(&error_msg_id);
 
    do_output = should_output(ctx, error, fmtString);
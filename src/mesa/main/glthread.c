@@ -0,0 +1,594 @@
+/*
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file glthread.c
+ * Worker thread and command queue of the threaded GL dispatch.
+ *
+ * The application thread fills one batch at a time and appends full
+ * batches to a queue; the worker executes queued batches in order.  At
+ * most MARSHAL_MAX_BATCHES batches are queued so that a fast application
+ * can't buffer an unbounded amount of work.
+ */
+
+#include <stdio.h>
+
+#include "glheader.h"
+#include "context.h"
+#include "glthread.h"
+#include "bufferobj.h"
+#include "hash.h"
+#include "imports.h"
+#include "util/hash_table.h"
+#include "util/set.h"
+
+
+/**
+ * MESA_GLTHREAD=true enables the threaded dispatch for all contexts of
+ * drivers that support it; MESA_GLTHREAD=stats additionally prints the
+ * number of synchronous calls per entry point when a context is destroyed.
+ */
+bool
+_mesa_glthread_enabled(void)
+{
+   const char *env = getenv("MESA_GLTHREAD");
+
+   return env && (strcmp(env, "true") == 0 || strcmp(env, "1") == 0 ||
+                  strcmp(env, "stats") == 0);
+}
+
+
+static struct glthread_batch *
+get_free_batch(struct glthread_state *glthread)
+{
+   struct glthread_batch *batch;
+
+   mtx_lock(&glthread->mutex);
+   batch = glthread->free_batches;
+   if (batch)
+      glthread->free_batches = batch->next;
+   mtx_unlock(&glthread->mutex);
+
+   if (!batch) {
+      batch = malloc(sizeof(*batch));
+      if (!batch)
+         return NULL;
+   }
+
+   batch->next = NULL;
+   batch->used = 0;
+   return batch;
+}
+
+
+static void
+glthread_execute_batch(struct gl_context *ctx, struct glthread_batch *batch)
+{
+   size_t pos = 0;
+
+   while (pos < batch->used) {
+      pos += _mesa_unmarshal_dispatch_cmd(ctx,
+                                          (uint8_t *) batch->buffer + pos);
+   }
+   assert(pos == batch->used);
+}
+
+
+static int
+glthread_worker(void *data)
+{
+   struct gl_context *ctx = data;
+   struct glthread_state *glthread = ctx->GLThread;
+
+   _glapi_check_multithread();
+   _glapi_set_context(ctx);
+   _glapi_set_dispatch(ctx->CurrentDispatch);
+
+   mtx_lock(&glthread->mutex);
+   for (;;) {
+      struct glthread_batch *batch;
+
+      while (!glthread->batch_queue && !glthread->shutdown)
+         cnd_wait(&glthread->new_work, &glthread->mutex);
+
+      if (!glthread->batch_queue) {
+         assert(glthread->shutdown);
+         break;
+      }
+
+      batch = glthread->batch_queue;
+      glthread->batch_queue = batch->next;
+      if (!glthread->batch_queue)
+         glthread->batch_queue_tail = &glthread->batch_queue;
+      glthread->num_queued--;
+      glthread->busy = true;
+      mtx_unlock(&glthread->mutex);
+
+      glthread_execute_batch(ctx, batch);
+
+      mtx_lock(&glthread->mutex);
+      batch->next = glthread->free_batches;
+      glthread->free_batches = batch;
+      glthread->busy = false;
+      cnd_broadcast(&glthread->work_done);
+   }
+   mtx_unlock(&glthread->mutex);
+
+   return 0;
+}
+
+
+/**
+ * Start the worker thread for a context and install the marshalling
+ * dispatch table.  On failure the context simply stays single-threaded.
+ */
+void
+_mesa_glthread_init(struct gl_context *ctx)
+{
+   struct glthread_state *glthread;
+   const char *env = getenv("MESA_GLTHREAD");
+
+   if (ctx->GLThread)
+      return;
+
+   glthread = calloc(1, sizeof(*glthread));
+   if (!glthread)
+      return;
+
+   ctx->MarshalExec = _mesa_create_marshal_table(ctx);
+   glthread->VAOs = _mesa_NewHashTable();
+   glthread->BufferNames = _mesa_set_create(NULL, _mesa_hash_pointer,
+                                            _mesa_key_pointer_equal);
+   glthread->sync_counts = _mesa_hash_table_create(NULL, _mesa_hash_pointer,
+                                                   _mesa_key_pointer_equal);
+   if (!ctx->MarshalExec || !glthread->VAOs || !glthread->BufferNames ||
+       !glthread->sync_counts)
+      goto fail;
+
+   glthread->batch_queue_tail = &glthread->batch_queue;
+   glthread->CurrentVAO = &glthread->DefaultVAO;
+   glthread->print_stats = env && strcmp(env, "stats") == 0;
+
+   mtx_init(&glthread->mutex, mtx_plain);
+   cnd_init(&glthread->new_work);
+   cnd_init(&glthread->work_done);
+
+   glthread->batch = get_free_batch(glthread);
+   if (!glthread->batch)
+      goto fail_sync;
+
+   ctx->GLThread = glthread;
+
+   /* Both threads have this context current from now on. */
+   _glapi_check_multithread();
+   if (thrd_create(&glthread->queue_thread, glthread_worker, ctx) !=
+       thrd_success) {
+      ctx->GLThread = NULL;
+      free(glthread->batch);
+      goto fail_sync;
+   }
+
+   if (_mesa_get_current_context() == ctx)
+      _glapi_set_dispatch(ctx->MarshalExec);
+   return;
+
+fail_sync:
+   cnd_destroy(&glthread->work_done);
+   cnd_destroy(&glthread->new_work);
+   mtx_destroy(&glthread->mutex);
+fail:
+   if (glthread->sync_counts)
+      _mesa_hash_table_destroy(glthread->sync_counts, NULL);
+   if (glthread->BufferNames)
+      _mesa_set_destroy(glthread->BufferNames, NULL);
+   if (glthread->VAOs)
+      _mesa_DeleteHashTable(glthread->VAOs);
+   free(ctx->MarshalExec);
+   ctx->MarshalExec = NULL;
+   free(glthread);
+}
+
+
+static void
+free_vao(GLuint key, void *data, void *userData)
+{
+   free(data);
+}
+
+
+static void
+print_sync_stats(struct glthread_state *glthread)
+{
+   struct hash_entry *entry;
+
+   fprintf(stderr, "Mesa glthread: %u batches, %u synchronous calls\n",
+           glthread->num_batches, glthread->num_syncs);
+
+   hash_table_foreach(glthread->sync_counts, entry) {
+      fprintf(stderr, "   gl%-40s %u\n", (const char *) entry->key,
+              (unsigned) (uintptr_t) entry->data);
+   }
+}
+
+
+/**
+ * Execute all pending commands, stop the worker and switch the calling
+ * thread back to the context's own dispatch table.
+ */
+void
+_mesa_glthread_destroy(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_batch *batch;
+
+   if (!glthread)
+      return;
+
+   _mesa_glthread_flush_batch(ctx);
+
+   mtx_lock(&glthread->mutex);
+   glthread->shutdown = true;
+   cnd_signal(&glthread->new_work);
+   mtx_unlock(&glthread->mutex);
+
+   thrd_join(glthread->queue_thread, NULL);
+   assert(!glthread->batch_queue);
+
+   if (glthread->print_stats)
+      print_sync_stats(glthread);
+
+   free(glthread->batch);
+   while ((batch = glthread->free_batches)) {
+      glthread->free_batches = batch->next;
+      free(batch);
+   }
+
+   cnd_destroy(&glthread->work_done);
+   cnd_destroy(&glthread->new_work);
+   mtx_destroy(&glthread->mutex);
+
+   _mesa_hash_table_destroy(glthread->sync_counts, NULL);
+   _mesa_set_destroy(glthread->BufferNames, NULL);
+   _mesa_HashDeleteAll(glthread->VAOs, free_vao, NULL);
+   _mesa_DeleteHashTable(glthread->VAOs);
+   free(glthread);
+   ctx->GLThread = NULL;
+
+   if (_mesa_get_current_context() == ctx)
+      _glapi_set_dispatch(ctx->CurrentDispatch);
+
+   free(ctx->MarshalExec);
+   ctx->MarshalExec = NULL;
+}
+
+
+/**
+ * Hand the current batch over to the worker and start a new one.  Blocks
+ * while the worker is MARSHAL_MAX_BATCHES batches behind.
+ */
+void
+_mesa_glthread_flush_batch(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_batch *batch;
+
+   if (!glthread || !glthread->batch->used)
+      return;
+
+   /* Allocate the next batch first so that running out of memory only
+    * costs us the parallelism, not the queued commands.
+    */
+   batch = get_free_batch(glthread);
+
+   mtx_lock(&glthread->mutex);
+   while (glthread->num_queued >= MARSHAL_MAX_BATCHES)
+      cnd_wait(&glthread->work_done, &glthread->mutex);
+
+   *glthread->batch_queue_tail = glthread->batch;
+   glthread->batch_queue_tail = &glthread->batch->next;
+   glthread->num_queued++;
+   glthread->num_batches++;
+   cnd_signal(&glthread->new_work);
+
+   if (!batch) {
+      while (glthread->batch_queue || glthread->busy)
+         cnd_wait(&glthread->work_done, &glthread->mutex);
+      batch = glthread->free_batches;
+      glthread->free_batches = batch->next;
+      batch->next = NULL;
+      batch->used = 0;
+   }
+   mtx_unlock(&glthread->mutex);
+
+   glthread->batch = batch;
+}
+
+
+/**
+ * Wait until the worker has executed every command issued so far.  After
+ * this the calling thread may access the context directly.
+ */
+void
+_mesa_glthread_finish(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (!glthread)
+      return;
+
+   /* Called by the driver while executing a command (e.g. a flush from
+    * inside a draw): nothing to wait for, and waiting would deadlock.
+    */
+   if (thrd_equal(thrd_current(), glthread->queue_thread))
+      return;
+
+   _mesa_glthread_flush_batch(ctx);
+
+   mtx_lock(&glthread->mutex);
+   while (glthread->batch_queue || glthread->busy)
+      cnd_wait(&glthread->work_done, &glthread->mutex);
+   mtx_unlock(&glthread->mutex);
+}
+
+
+/**
+ * Prepare for executing entry point 'func' on the application thread:
+ * wait for the worker, count the synchronization and make the real
+ * dispatch table current, in case the function calls other GL functions
+ * through it.
+ */
+void
+_mesa_glthread_finish_before(struct gl_context *ctx, const char *func)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct hash_entry *entry;
+
+   _mesa_glthread_finish(ctx);
+
+   glthread->num_syncs++;
+   entry = _mesa_hash_table_search(glthread->sync_counts, func);
+   if (entry)
+      entry->data = (void *) ((uintptr_t) entry->data + 1);
+   else
+      _mesa_hash_table_insert(glthread->sync_counts, func, (void *) 1);
+
+   _glapi_set_dispatch(ctx->CurrentDispatch);
+}
+
+
+/**
+ * Undo the dispatch change of _mesa_glthread_finish_before().  The
+ * function may also have switched dispatch tables (glBegin, glNewList),
+ * which only concerns ctx->CurrentDispatch used by the worker.
+ */
+void
+_mesa_glthread_restore_dispatch(struct gl_context *ctx)
+{
+   if (ctx->GLThread)
+      _glapi_set_dispatch(ctx->MarshalExec);
+}
+
+
+/** Key of a buffer name in glthread_state::BufferNames */
+#define BUFFER_NAME_KEY(name) ((const void *) (uintptr_t) (name))
+
+
+void
+_mesa_glthread_BindBuffer(struct gl_context *ctx, GLenum target,
+                          GLuint buffer)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   /* Binding a name that glGen/CreateBuffers didn't return is an error in
+    * core profiles, which leaves the old binding in place.  Recording the
+    * new name anyway could make us defer draws that read client memory, so
+    * keep tracking the old one.  Other profiles create the buffer.
+    */
+   if (buffer != 0 && ctx->API == API_OPENGL_CORE &&
+       !_mesa_set_search(glthread->BufferNames, BUFFER_NAME_KEY(buffer)))
+      return;
+
+   switch (target) {
+   case GL_ARRAY_BUFFER:
+      glthread->CurrentArrayBufferName = buffer;
+      break;
+   case GL_ELEMENT_ARRAY_BUFFER:
+      glthread->CurrentVAO->IndexBufferName = buffer;
+      break;
+   }
+}
+
+
+/**
+ * Called after the synchronous glGenBuffers and glCreateBuffers.
+ */
+void
+_mesa_glthread_GenBuffers(struct gl_context *ctx, GLsizei n,
+                          const GLuint *buffers)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   GLsizei i;
+
+   if (n < 0 || !buffers)
+      return;
+
+   for (i = 0; i < n; i++) {
+      if (buffers[i] != 0)
+         _mesa_set_add(glthread->BufferNames, BUFFER_NAME_KEY(buffers[i]));
+   }
+}
+
+
+void
+_mesa_glthread_DeleteBuffers(struct gl_context *ctx, GLsizei n,
+                             const GLuint *buffers)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   GLsizei i;
+
+   if (n < 0 || !buffers)
+      return;
+
+   /* Deleting a bound buffer unbinds it from the current VAO only. */
+   for (i = 0; i < n; i++) {
+      struct set_entry *entry;
+
+      if (buffers[i] == 0)
+         continue;
+      if (buffers[i] == glthread->CurrentArrayBufferName)
+         glthread->CurrentArrayBufferName = 0;
+      if (buffers[i] == glthread->CurrentVAO->IndexBufferName)
+         glthread->CurrentVAO->IndexBufferName = 0;
+
+      entry = _mesa_set_search(glthread->BufferNames,
+                               BUFFER_NAME_KEY(buffers[i]));
+      if (entry)
+         _mesa_set_remove(glthread->BufferNames, entry);
+   }
+}
+
+
+void
+_mesa_glthread_BindVertexArray(struct gl_context *ctx, GLuint id)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_vao *vao;
+
+   if (id == 0) {
+      glthread->CurrentVAO = &glthread->DefaultVAO;
+      return;
+   }
+
+   vao = _mesa_HashLookup(glthread->VAOs, id);
+   if (!vao) {
+      vao = calloc(1, sizeof(*vao));
+      if (!vao) {
+         /* Unknown bindings make every draw synchronous. */
+         glthread->DefaultVAO.HasUserPointers = true;
+         glthread->CurrentVAO = &glthread->DefaultVAO;
+         return;
+      }
+      vao->Name = id;
+      _mesa_HashInsert(glthread->VAOs, id, vao);
+   }
+   glthread->CurrentVAO = vao;
+}
+
+
+void
+_mesa_glthread_DeleteVertexArrays(struct gl_context *ctx, GLsizei n,
+                                  const GLuint *ids)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   GLsizei i;
+
+   if (n < 0 || !ids)
+      return;
+
+   for (i = 0; i < n; i++) {
+      struct glthread_vao *vao;
+
+      if (ids[i] == 0)
+         continue;
+
+      vao = _mesa_HashLookup(glthread->VAOs, ids[i]);
+      if (!vao)
+         continue;
+
+      if (glthread->CurrentVAO == vao)
+         glthread->CurrentVAO = &glthread->DefaultVAO;
+      _mesa_HashRemove(glthread->VAOs, ids[i]);
+      free(vao);
+   }
+}
+
+
+/**
+ * A vertex buffer binding without a buffer makes the offset a pointer to
+ * client memory.  Unbinding everything (buffers == NULL) doesn't.
+ */
+void
+_mesa_glthread_BindVertexBuffers(struct gl_context *ctx, GLsizei count,
+                                 const GLuint *buffers)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   GLsizei i;
+
+   if (!buffers)
+      return;
+
+   for (i = 0; i < count; i++) {
+      if (buffers[i] == 0) {
+         glthread->CurrentVAO->HasUserPointers = true;
+         break;
+      }
+   }
+}
+
+
+/**
+ * Called for every gl*Pointer call: arrays set without a buffer bound
+ * point into client memory, which draws read at execution time.
+ */
+void
+_mesa_glthread_AttribPointer(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (glthread->CurrentArrayBufferName == 0)
+      glthread->CurrentVAO->HasUserPointers = true;
+}
+
+
+/**
+ * Called after the synchronous glPopClientAttrib, which may restore any of
+ * the tracked bindings and array pointers.  The worker is idle, so read
+ * them back from the context.
+ */
+void
+_mesa_glthread_PopClientAttrib(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct gl_vertex_array_object *vao = ctx->Array.VAO;
+   struct glthread_vao *tracked;
+   unsigned i;
+
+   glthread->CurrentArrayBufferName = ctx->Array.ArrayBufferObj->Name;
+
+   _mesa_glthread_BindVertexArray(ctx, vao->Name);
+   tracked = glthread->CurrentVAO;
+   tracked->IndexBufferName = vao->IndexBufferObj->Name;
+
+   tracked->HasUserPointers = false;
+   for (i = 0; i < ARRAY_SIZE(vao->VertexAttrib); i++) {
+      const struct gl_vertex_attrib_array *array = &vao->VertexAttrib[i];
+      const struct gl_vertex_buffer_binding *binding =
+         &vao->VertexBinding[array->VertexBinding];
+
+      if ((array->Enabled || array->Ptr) &&
+          !_mesa_is_bufferobj(binding->BufferObj)) {
+         tracked->HasUserPointers = true;
+         break;
+      }
+   }
+}
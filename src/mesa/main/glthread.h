@@ -0,0 +1,233 @@
+/*
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file glthread.h
+ * Threaded GL dispatch ("glthread").
+ *
+ * When enabled with MESA_GLTHREAD, the application thread's dispatch table
+ * is ctx->MarshalExec.  Its functions (generated by gl_marshal.py into
+ * marshal_generated.c) pack the call and its input data into a command
+ * batch which a worker thread unpacks and executes through
+ * ctx->CurrentDispatch.  Calls which return data, write to client memory
+ * or read client memory of unknown size wait for the worker to go idle and
+ * then execute directly on the application thread.
+ */
+
+#ifndef GLTHREAD_H
+#define GLTHREAD_H
+
+#include "c11/threads.h"
+#include "mtypes.h"
+
+
+struct hash_table;
+struct _mesa_HashTable;
+
+
+/** Size of one command batch in bytes; also the largest single command */
+#define MARSHAL_MAX_CMD_SIZE (8 * 1024)
+
+/** Number of full batches the application may run ahead of the worker */
+#define MARSHAL_MAX_BATCHES 4
+
+
+/**
+ * Header of every command in a batch.  Commands are 8-byte aligned and
+ * cmd_size includes the header and any trailing variable-length data.
+ */
+struct marshal_cmd_base
+{
+   uint16_t cmd_id;
+   uint16_t cmd_size;
+};
+
+
+struct glthread_batch
+{
+   struct glthread_batch *next;
+   size_t used;                 /**< bytes of buffer in use */
+   uint64_t buffer[MARSHAL_MAX_CMD_SIZE / 8];
+};
+
+
+/**
+ * Client-side view of a vertex array object, to tell whether draws may
+ * read client memory.
+ */
+struct glthread_vao
+{
+   GLuint Name;
+   GLuint IndexBufferName;
+   /** An array pointer was set while no buffer was bound (sticky) */
+   bool HasUserPointers;
+};
+
+
+struct glthread_state
+{
+   thrd_t queue_thread;
+   mtx_t mutex;
+   cnd_t new_work;              /**< batch queued or shutdown requested */
+   cnd_t work_done;             /**< worker consumed a batch or went idle */
+
+   /** Batches waiting to be executed, oldest first */
+   struct glthread_batch *batch_queue;
+   struct glthread_batch **batch_queue_tail;
+   unsigned num_queued;
+
+   /** Executed batches kept for reuse */
+   struct glthread_batch *free_batches;
+
+   bool busy;                   /**< worker is executing a batch */
+   bool shutdown;
+
+   /** Batch being filled by the application thread (no lock needed) */
+   struct glthread_batch *batch;
+
+   /**
+    * Number of synchronous calls per entry point, keyed by the function
+    * name string.  Only touched by the application thread.
+    */
+   struct hash_table *sync_counts;
+   unsigned num_syncs;
+   unsigned num_batches;
+   bool print_stats;
+
+   /** Buffer and VAO bindings as the application sees them */
+   GLuint CurrentArrayBufferName;
+
+   /**
+    * Names returned by glGenBuffers/glCreateBuffers and not deleted since.
+    * Binding any other name fails in core profiles.
+    */
+   struct set *BufferNames;
+
+   struct glthread_vao DefaultVAO;
+   struct glthread_vao *CurrentVAO;
+   struct _mesa_HashTable *VAOs;
+};
+
+
+extern bool
+_mesa_glthread_enabled(void);
+
+extern void
+_mesa_glthread_init(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_destroy(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_flush_batch(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_finish(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_finish_before(struct gl_context *ctx, const char *func);
+
+extern void
+_mesa_glthread_restore_dispatch(struct gl_context *ctx);
+
+
+/**
+ * Reserve space for a command of the given size in the current batch.
+ * The caller fills in everything after the header.
+ */
+static inline void *
+_mesa_glthread_allocate_command(struct gl_context *ctx,
+                                uint16_t cmd_id, size_t size)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct marshal_cmd_base *cmd_base;
+
+   size = (size + 7) & ~(size_t) 7;
+   assert(size <= MARSHAL_MAX_CMD_SIZE);
+
+   if (glthread->batch->used + size > MARSHAL_MAX_CMD_SIZE)
+      _mesa_glthread_flush_batch(ctx);
+
+   cmd_base = (struct marshal_cmd_base *)
+      ((uint8_t *) glthread->batch->buffer + glthread->batch->used);
+   glthread->batch->used += size;
+   cmd_base->cmd_id = cmd_id;
+   cmd_base->cmd_size = size;
+   return cmd_base;
+}
+
+
+/* Tracking of the state which decides whether a call can be deferred. */
+
+extern void
+_mesa_glthread_BindBuffer(struct gl_context *ctx, GLenum target,
+                          GLuint buffer);
+
+extern void
+_mesa_glthread_GenBuffers(struct gl_context *ctx, GLsizei n,
+                          const GLuint *buffers);
+
+extern void
+_mesa_glthread_DeleteBuffers(struct gl_context *ctx, GLsizei n,
+                             const GLuint *buffers);
+
+extern void
+_mesa_glthread_BindVertexArray(struct gl_context *ctx, GLuint id);
+
+extern void
+_mesa_glthread_DeleteVertexArrays(struct gl_context *ctx, GLsizei n,
+                                  const GLuint *ids);
+
+extern void
+_mesa_glthread_BindVertexBuffers(struct gl_context *ctx, GLsizei count,
+                                 const GLuint *buffers);
+
+extern void
+_mesa_glthread_AttribPointer(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_PopClientAttrib(struct gl_context *ctx);
+
+static inline bool
+_mesa_glthread_has_user_pointers(const struct gl_context *ctx)
+{
+   return ctx->GLThread->CurrentVAO->HasUserPointers;
+}
+
+static inline bool
+_mesa_glthread_has_index_buffer(const struct gl_context *ctx)
+{
+   return ctx->GLThread->CurrentVAO->IndexBufferName != 0;
+}
+
+
+/* marshal_generated.c */
+
+extern struct _glapi_table *
+_mesa_create_marshal_table(const struct gl_context *ctx);
+
+extern size_t
+_mesa_unmarshal_dispatch_cmd(struct gl_context *ctx, const void *cmd);
+
+
+#endif /* GLTHREAD_H */
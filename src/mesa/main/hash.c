@@ -3,7 +3,8 @@
  * Generic hash table. 
  *
  * Used for display lists, texture objects, vertex/fragment programs,
- * buffer objects, etc.  The hash functions are thread-safe.
+ * buffer objects, etc.  The hash functions are thread-safe, and lookups of
+ * small keys don't take a lock (see struct dense_array).
  * 
  * \note key=0 is illegal.
  *
@@ -38,6 +39,7 @@
 #include "imports.h"
 #include "hash.h"
 #include "util/hash_table.h"
+#include "util/u_atomic.h"
 
 /**
  * Magic GLuint object name that gets stored outside of the struct hash_table.
@@ -52,11 +54,40 @@
  */
 #define DELETED_KEY_VALUE 1
 
+/**
+ * Keys below this are also stored in a flat array, which is read without
+ * taking the table mutex.  glGen*() hands out small, dense names, so this
+ * covers nearly all lookups; larger (application chosen) names are only in
+ * the hash table.
+ */
+#define DENSE_MAX_KEYS (64 * 1024)
+
+/** Initial number of slots of the flat array */
+#define DENSE_MIN_KEYS 256
+
+/**
+ * Flat array indexed by key, mirroring the hash table entries with keys
+ * below _mesa_HashTable::DenseLimit.
+ *
+ * Readers load the array pointer and the slot without locking.  Writers hold
+ * the table mutex; when the array is too small they publish a bigger copy
+ * and keep the old one on the Retired list until the table is destroyed,
+ * since a reader may still be looking at it.  As the size doubles each time,
+ * the retired arrays take no more memory than the current one.
+ */
+struct dense_array {
+   GLuint Size;                  /**< number of slots */
+   struct dense_array *Retired;  /**< the array this one replaced */
+   void **Slots;                 /**< points just past this struct */
+};
+
 /**
  * The hash table data structure.  
  */
 struct _mesa_HashTable {
    struct hash_table *ht;
+   struct dense_array *Dense;            /**< read without locking */
+   GLuint DenseLimit;                    /**< keys below are in Dense */
    GLuint MaxKey;                        /**< highest key inserted so far */
    mtx_t Mutex;                /**< mutual exclusion lock */
    mtx_t WalkMutex;            /**< for _mesa_HashWalk() */
@@ -109,6 +140,78 @@ uint_key(GLuint id)
 }
 /** @} */
 
+
+/**
+ * Lookup a key below table->DenseLimit.  Takes no lock.
+ */
+static inline void *
+dense_lookup(const struct _mesa_HashTable *table, GLuint key)
+{
+   const struct dense_array *dense = p_atomic_read(&table->Dense);
+
+   if (!dense || key >= dense->Size)
+      return NULL;
+
+   return p_atomic_read(&dense->Slots[key]);
+}
+
+
+/**
+ * Store a pointer where lock-less readers can see it.  The compare and swap
+ * is only there for its memory barrier: everything written before (the
+ * object being inserted, or the contents of a new array) must be visible
+ * before the pointer is.  Called with the table mutex held, so it can't
+ * fail.
+ */
+static inline void
+dense_publish(void **ptr, void *value)
+{
+   (void) p_atomic_cmpxchg(ptr, *ptr, value);
+}
+
+
+/**
+ * Store data in the flat array, growing it if needed.  Called with the
+ * table mutex held for keys below table->DenseLimit.
+ */
+static void
+dense_set(struct _mesa_HashTable *table, GLuint key, void *data)
+{
+   struct dense_array *dense = table->Dense;
+
+   if (!dense || key >= dense->Size) {
+      struct dense_array *bigger;
+      GLuint size = dense ? dense->Size * 2 : DENSE_MIN_KEYS;
+
+      if (!data)
+         return;
+
+      while (size <= key)
+         size *= 2;
+      if (size > DENSE_MAX_KEYS)
+         size = DENSE_MAX_KEYS;
+
+      bigger = calloc(1, sizeof(*bigger) + size * sizeof(void *));
+      if (!bigger) {
+         /* Keep the keys from here on in the hash table only. */
+         table->DenseLimit = dense ? dense->Size : 0;
+         return;
+      }
+
+      bigger->Size = size;
+      bigger->Retired = dense;
+      bigger->Slots = (void **) (bigger + 1);
+      if (dense)
+         memcpy(bigger->Slots, dense->Slots, dense->Size * sizeof(void *));
+
+      /* See dense_publish() */
+      (void) p_atomic_cmpxchg(&table->Dense, dense, bigger);
+      dense = bigger;
+   }
+
+   dense_publish(&dense->Slots[key], data);
+}
+
 /**
  * Create a new hash table.
  * 
@@ -129,6 +232,7 @@ _mesa_NewHashTable(void)
       }
 
       _mesa_hash_table_set_deleted_key(table->ht, uint_key(DELETED_KEY_VALUE));
+      table->DenseLimit = DENSE_MAX_KEYS;
       mtx_init(&table->Mutex, mtx_plain);
       mtx_init(&table->WalkMutex, mtx_plain);
    }
@@ -152,6 +256,8 @@ _mesa_NewHashTable(void)
 void
 _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 {
+   struct dense_array *dense, *retired;
+
    assert(table);
 
    if (_mesa_hash_table_next_entry(table->ht, NULL) != NULL) {
@@ -160,6 +266,11 @@ _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 
    _mesa_hash_table_destroy(table->ht, NULL);
 
+   for (dense = table->Dense; dense; dense = retired) {
+      retired = dense->Retired;
+      free(dense);
+   }
+
    mtx_destroy(&table->Mutex);
    mtx_destroy(&table->WalkMutex);
    free(table);
@@ -179,6 +290,9 @@ _mesa_HashLookup_unlocked(struct _mesa_HashTable *table, GLuint key)
    assert(table);
    assert(key);
 
+   if (key < p_atomic_read(&table->DenseLimit))
+      return dense_lookup(table, key);
+
    if (key == DELETED_KEY_VALUE)
       return table->deleted_key_data;
 
@@ -203,6 +317,12 @@ _mesa_HashLookup(struct _mesa_HashTable *table, GLuint key)
 {
    void *res;
    assert(table);
+   assert(key);
+
+   /* The common case, no lock needed */
+   if (key < p_atomic_read(&table->DenseLimit))
+      return dense_lookup(table, key);
+
    mtx_lock(&table->Mutex);
    res = _mesa_HashLookup_unlocked(table, key);
    mtx_unlock(&table->Mutex);
@@ -270,6 +390,9 @@ _mesa_HashInsert_unlocked(struct _mesa_HashTable *table, GLuint key, void *data)
    if (key > table->MaxKey)
       table->MaxKey = key;
 
+   if (key < table->DenseLimit)
+      dense_set(table, key, data);
+
    if (key == DELETED_KEY_VALUE) {
       table->deleted_key_data = data;
    } else {
@@ -344,6 +467,9 @@ _mesa_HashRemove(struct _mesa_HashTable *table, GLuint key)
    }
 
    mtx_lock(&table->Mutex);
+   if (key < table->DenseLimit)
+      dense_set(table, key, NULL);
+
    if (key == DELETED_KEY_VALUE) {
       table->deleted_key_data = NULL;
    } else {
@@ -383,6 +509,11 @@ _mesa_HashDeleteAll(struct _mesa_HashTable *table,
       callback(DELETED_KEY_VALUE, table->deleted_key_data, userData);
       table->deleted_key_data = NULL;
    }
+   if (table->Dense) {
+      GLuint key;
+      for (key = 0; key < table->Dense->Size; key++)
+         p_atomic_set(&table->Dense->Slots[key], NULL);
+   }
    table->InDeleteAll = GL_FALSE;
    mtx_unlock(&table->Mutex);
 }
@@ -86,6 +86,8 @@ struct prog_instruction;
 struct gl_program_parameter_list;
 struct set;
 struct set_entry;
+struct hash_table;
+struct glthread_state;
 struct vbo_context;
 /*@}*/
 
@@ -1460,6 +1462,8 @@ typedef enum {
    USAGE_UNIFORM_BUFFER = 0x1,
    USAGE_TEXTURE_BUFFER = 0x2,
    USAGE_ATOMIC_COUNTER_BUFFER = 0x4,
+   USAGE_TRANSFORM_FEEDBACK_BUFFER = 0x8,
+   USAGE_PIXEL_PACK_BUFFER = 0x10,
 } gl_buffer_usage;
 
 
@@ -1483,6 +1487,20 @@ struct gl_buffer_object
    gl_buffer_usage UsageHistory; /**< How has this buffer been used so far? */
 
    struct gl_buffer_mapping Mappings[MAP_COUNT];
+
+   /**
+    * Memoized index ranges for vbo_get_minmax_index(), shared by all the
+    * contexts using this buffer.  MinMaxCacheDirty is set whenever the
+    * contents may have changed and makes the next lookup drop the cache.
+    * All of these are protected by MinMaxCacheMutex.  The entries are
+    * malloc'ed, and freed with the buffer object.
+    */
+   mtx_t MinMaxCacheMutex;
+   struct hash_table *MinMaxCache;
+   unsigned MinMaxCacheHits;
+   unsigned MinMaxCacheMisses;
+   bool MinMaxCacheDirty;
+   bool MinMaxCacheDisabled; /**< contents change too often to bother */
 };
 
 
@@ -4112,8 +4130,17 @@ struct gl_context
     * re-set on glXMakeCurrent().
     */
    struct _glapi_table *CurrentDispatch;
+   /**
+    * The dispatch table of the application thread while glthread is
+    * active.  It queues the calls for the glthread worker, which executes
+    * them through CurrentDispatch.
+    */
+   struct _glapi_table *MarshalExec;
    /*@}*/
 
+   /** Threaded dispatch state, or NULL if glthread isn't active */
+   struct glthread_state *GLThread;
+
    struct gl_config Visual;
    struct gl_framebuffer *DrawBuffer;	/**< buffer for writing */
    struct gl_framebuffer *ReadBuffer;	/**< buffer for reading */
@@ -1561,6 +1561,36 @@ _mesa_ShaderSource(GLhandleARB shaderObj, GLsizei count,
 }
 
 
+static void
+use_program(struct gl_context *ctx, struct gl_shader_program *shProg)
+{
+   /* The ARB_separate_shader_object spec says:
+    *
+    *     "The executable code for an individual shader stage is taken from
+    *     the current program for that stage.  If there is a current program
+    *     object established by UseProgram, that program is considered current
+    *     for all stages.  Otherwise, if there is a bound program pipeline
+    *     object (section 2.14.PPO), the program bound to the appropriate
+    *     stage of the pipeline object is considered current."
+    */
+   if (shProg) {
+      /* Attach shader state to the binding point */
+      _mesa_reference_pipeline_object(ctx, &ctx->_Shader, &ctx->Shader);
+      /* Update the program */
+      _mesa_use_program(ctx, shProg);
+   } else {
+      /* Must be done first: detach the progam */
+      _mesa_use_program(ctx, shProg);
+      /* Unattach shader_state binding point */
+      _mesa_reference_pipeline_object(ctx, &ctx->_Shader, ctx->Pipeline.Default);
+      /* If a pipeline was bound, rebind it */
+      if (ctx->Pipeline.Current) {
+         _mesa_BindProgramPipeline(ctx->Pipeline.Current->Name);
+      }
+   }
+}
+
+
 void GLAPIENTRY
 _mesa_UseProgram(GLhandleARB program)
 {
@@ -1593,30 +1623,22 @@ _mesa_UseProgram(GLhandleARB program)
       shProg = NULL;
    }
 
-   /* The ARB_separate_shader_object spec says:
-    *
-    *     "The executable code for an individual shader stage is taken from
-    *     the current program for that stage.  If there is a current program
-    *     object established by UseProgram, that program is considered current
-    *     for all stages.  Otherwise, if there is a bound program pipeline
-    *     object (section 2.14.PPO), the program bound to the appropriate
-    *     stage of the pipeline object is considered current."
-    */
-   if (program) {
-      /* Attach shader state to the binding point */
-      _mesa_reference_pipeline_object(ctx, &ctx->_Shader, &ctx->Shader);
-      /* Update the program */
-      _mesa_use_program(ctx, shProg);
-   } else {
-      /* Must be done first: detach the progam */
-      _mesa_use_program(ctx, shProg);
-      /* Unattach shader_state binding point */
-      _mesa_reference_pipeline_object(ctx, &ctx->_Shader, ctx->Pipeline.Default);
-      /* If a pipeline was bound, rebind it */
-      if (ctx->Pipeline.Current) {
-         _mesa_BindProgramPipeline(ctx->Pipeline.Current->Name);
-      }
-   }
+   use_program(ctx, shProg);
+}
+
+
+/**
+ * glUseProgram() for KHR_no_error contexts: the program is assumed to exist
+ * and to be linked, and transform feedback to be inactive.
+ */
+void GLAPIENTRY
+_mesa_UseProgram_no_error(GLhandleARB program)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct gl_shader_program *shProg =
+      program ? _mesa_lookup_shader_program(ctx, program) : NULL;
+
+   use_program(ctx, shProg);
 }
 
 
@@ -117,6 +117,9 @@ _mesa_ShaderSource(GLhandleARB, GLsizei, const GLcharARB* const *, const GLint *
 extern void GLAPIENTRY
 _mesa_UseProgram(GLhandleARB);
 
+extern void GLAPIENTRY
+_mesa_UseProgram_no_error(GLhandleARB);
+
 extern void GLAPIENTRY
 _mesa_ValidateProgram(GLhandleARB);
 
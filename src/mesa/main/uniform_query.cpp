@@ -31,6 +31,7 @@
 #include "ir.h"
 #include "ir_uniform.h"
 #include "program/hash_table.h"
+#include "program/prog_parameter.h"
 #include "../glsl/program.h"
 #include "../glsl/ir_uniform.h"
 #include "../glsl/glsl_parser_extras.h"
@@ -570,6 +571,22 @@ _mesa_propagate_uniforms_to_driver_storage(struct gl_uniform_storage *uni,
 }
 
 
+/**
+ * Let the consumers of the linked programs' parameter lists know that
+ * uniform values were propagated into them.
+ */
+static void
+flag_parameter_values_changed(struct gl_shader_program *shProg)
+{
+   for (int i = 0; i < MESA_SHADER_STAGES; i++) {
+      struct gl_shader *const sh = shProg->_LinkedShaders[i];
+
+      if (sh && sh->Program && sh->Program->Parameters)
+         _mesa_parameter_values_changed(sh->Program->Parameters);
+   }
+}
+
+
 /**
  * Return printable string for a given GLSL_TYPE_x
  */
@@ -628,49 +645,52 @@ _mesa_uniform(struct gl_context *ctx, struct gl_shader_program *shProg,
    if (uni == NULL)
       return;
 
-   if (uni->type->is_matrix()) {
-      /* Can't set matrix uniforms (like mat4) with glUniform */
-      _mesa_error(ctx, GL_INVALID_OPERATION,
-                  "glUniform%u(uniform \"%s\"@%d is matrix)",
-                  src_components, uni->name, location);
-      return;
-   }
-
-   /* Verify that the types are compatible.
-    */
    const unsigned components = uni->type->is_sampler()
       ? 1 : uni->type->vector_elements;
 
-   if (components != src_components) {
-      /* glUniformN() must match float/vecN type */
-      _mesa_error(ctx, GL_INVALID_OPERATION,
-                  "glUniform%u(\"%s\"@%u has %u components, not %u)",
-                  src_components, uni->name, location,
-                  components, src_components);
-      return;
-   }
+   /* Verify that the types are compatible, unless the application promised
+    * that they are (KHR_no_error).
+    */
+   if (!_mesa_is_no_error_enabled(ctx)) {
+      if (uni->type->is_matrix()) {
+         /* Can't set matrix uniforms (like mat4) with glUniform */
+         _mesa_error(ctx, GL_INVALID_OPERATION,
+                     "glUniform%u(uniform \"%s\"@%d is matrix)",
+                     src_components, uni->name, location);
+         return;
+      }
 
-   bool match;
-   switch (uni->type->base_type) {
-   case GLSL_TYPE_BOOL:
-      match = (basicType != GLSL_TYPE_DOUBLE);
-      break;
-   case GLSL_TYPE_SAMPLER:
-   case GLSL_TYPE_IMAGE:
-      match = (basicType == GLSL_TYPE_INT);
-      break;
-   default:
-      match = (basicType == uni->type->base_type);
-      break;
-   }
+      if (components != src_components) {
+         /* glUniformN() must match float/vecN type */
+         _mesa_error(ctx, GL_INVALID_OPERATION,
+                     "glUniform%u(\"%s\"@%u has %u components, not %u)",
+                     src_components, uni->name, location,
+                     components, src_components);
+         return;
+      }
 
-   if (!match) {
-      _mesa_error(ctx, GL_INVALID_OPERATION,
-                  "glUniform%u(\"%s\"@%d is %s, not %s)",
-                  src_components, uni->name, location,
-                  glsl_type_name(uni->type->base_type),
-                  glsl_type_name(basicType));
-      return;
+      bool match;
+      switch (uni->type->base_type) {
+      case GLSL_TYPE_BOOL:
+         match = (basicType != GLSL_TYPE_DOUBLE);
+         break;
+      case GLSL_TYPE_SAMPLER:
+      case GLSL_TYPE_IMAGE:
+         match = (basicType == GLSL_TYPE_INT);
+         break;
+      default:
+         match = (basicType == uni->type->base_type);
+         break;
+      }
+
+      if (!match) {
+         _mesa_error(ctx, GL_INVALID_OPERATION,
+                     "glUniform%u(\"%s\"@%d is %s, not %s)",
+                     src_components, uni->name, location,
+                     glsl_type_name(uni->type->base_type),
+                     glsl_type_name(basicType));
+         return;
+      }
    }
 
    if (unlikely(ctx->_Shader->Flags & GLSL_UNIFORMS)) {
@@ -695,7 +715,7 @@ _mesa_uniform(struct gl_context *ctx, struct gl_shader_program *shProg,
     * Based on that, when an invalid sampler is specified, we generate a
     * GL_INVALID_VALUE error and ignore the command.
     */
-   if (uni->type->is_sampler()) {
+   if (uni->type->is_sampler() && !_mesa_is_no_error_enabled(ctx)) {
       for (int i = 0; i < count; i++) {
 	 const unsigned texUnit = ((unsigned *) values)[i];
 
@@ -710,7 +730,7 @@ _mesa_uniform(struct gl_context *ctx, struct gl_shader_program *shProg,
       }
    }
 
-   if (uni->type->is_image()) {
+   if (uni->type->is_image() && !_mesa_is_no_error_enabled(ctx)) {
       for (int i = 0; i < count; i++) {
          const int unit = ((GLint *) values)[i];
 
@@ -739,6 +759,16 @@ _mesa_uniform(struct gl_context *ctx, struct gl_shader_program *shProg,
       count = MIN2(count, (int) (uni->array_elements - offset));
    }
 
+   /* Applications often set all their uniforms before every draw.  When
+    * the values don't change, don't flush and don't make the driver upload
+    * the program constants again.
+    */
+   if (uni->initialized && !uni->type->is_boolean() &&
+       !uni->type->is_sampler() && !uni->type->is_image() &&
+       memcmp(&uni->storage[size_mul * components * offset], values,
+              sizeof(uni->storage[0]) * components * count * size_mul) == 0)
+      return;
+
    FLUSH_VERTICES(ctx, _NEW_PROGRAM_CONSTANTS);
 
    /* Store the data in the "actual type" backing storage for the uniform.
@@ -764,6 +794,7 @@ _mesa_uniform(struct gl_context *ctx, struct gl_shader_program *shProg,
    uni->initialized = true;
 
    _mesa_propagate_uniforms_to_driver_storage(uni, offset, count);
+   flag_parameter_values_changed(shProg);
 
    /* If the uniform is a sampler, do the extra magic necessary to propagate
     * the changes through.
@@ -954,6 +985,7 @@ _mesa_uniform_matrix(struct gl_context *ctx, struct gl_shader_program *shProg,
    uni->initialized = true;
 
    _mesa_propagate_uniforms_to_driver_storage(uni, offset, count);
+   flag_parameter_values_changed(shProg);
 }
 
 
@@ -35,12 +35,19 @@
 #include "prog_instruction.h"
 #include "prog_parameter.h"
 #include "prog_statevars.h"
+#include "util/u_atomic.h"
 
 
 struct gl_program_parameter_list *
 _mesa_new_parameter_list(void)
 {
-   return CALLOC_STRUCT(gl_program_parameter_list);
+   struct gl_program_parameter_list *p =
+      CALLOC_STRUCT(gl_program_parameter_list);
+
+   if (p)
+      _mesa_parameter_values_changed(p);
+
+   return p;
 }
 
 
@@ -72,6 +79,19 @@ _mesa_new_parameter_list_sized(unsigned size)
 }
 
 
+/**
+ * Note that some of the list's ParameterValues[] were (or may have been)
+ * written, by giving the list a new ValuesSerial.
+ */
+void
+_mesa_parameter_values_changed(struct gl_program_parameter_list *paramList)
+{
+   static uint32_t next_serial = 0;
+
+   paramList->ValuesSerial = p_atomic_inc_return(&next_serial);
+}
+
+
 /**
  * Free a parameter list and all its parameters
  */
@@ -142,6 +162,7 @@ _mesa_add_parameter(struct gl_program_parameter_list *paramList,
       GLuint i, j;
 
       paramList->NumParameters = oldNum + sz4;
+      _mesa_parameter_values_changed(paramList);
 
       memset(&paramList->Parameters[oldNum], 0,
              sz4 * sizeof(struct gl_program_parameter));
@@ -229,6 +250,7 @@ _mesa_add_typed_unnamed_constant(struct gl_program_parameter_list *paramList,
             GLuint swz = p->Size; /* 1, 2 or 3 for Y, Z, W */
             pVal[p->Size] = values[0];
             p->Size++;
+            _mesa_parameter_values_changed(paramList);
             *swizzleOut = MAKE_SWIZZLE4(swz, swz, swz, swz);
             return pos;
          }
@@ -87,6 +87,12 @@ struct gl_program_parameter_list
    gl_constant_value (*ParameterValues)[4]; /**< Array [Size] of constant[4] */
    GLbitfield StateFlags; /**< _NEW_* flags indicating which state changes
                                might invalidate ParameterValues[] */
+   /**
+    * Changes whenever ParameterValues[] may have changed, so that drivers
+    * can skip uploading the same constants again.  Serials are unique
+    * across all lists.  See _mesa_parameter_values_changed().
+    */
+   GLuint ValuesSerial;
 };
 
 
@@ -99,6 +105,9 @@ _mesa_new_parameter_list_sized(unsigned size);
 extern void
 _mesa_free_parameter_list(struct gl_program_parameter_list *paramList);
 
+extern void
+_mesa_parameter_values_changed(struct gl_program_parameter_list *paramList);
+
 extern struct gl_program_parameter_list *
 _mesa_clone_parameter_list(const struct gl_program_parameter_list *list);
 
@@ -1061,6 +1061,7 @@ void
 _mesa_load_state_parameters(struct gl_context *ctx,
                             struct gl_program_parameter_list *paramList)
 {
+   GLboolean changed = GL_FALSE;
    GLuint i;
 
    if (!paramList)
@@ -1068,9 +1069,21 @@ _mesa_load_state_parameters(struct gl_context *ctx,
 
    for (i = 0; i < paramList->NumParameters; i++) {
       if (paramList->Parameters[i].Type == PROGRAM_STATE_VAR) {
+         gl_constant_value value[4];
+
+         /* Not every state fills all four components */
+         COPY_4V(value, paramList->ParameterValues[i]);
          _mesa_fetch_state(ctx,
 			   paramList->Parameters[i].StateIndexes,
-                           &paramList->ParameterValues[i][0].f);
+                           &value[0].f);
+
+         if (memcmp(value, paramList->ParameterValues[i], sizeof(value))) {
+            COPY_4V(paramList->ParameterValues[i], value);
+            changed = GL_TRUE;
+         }
       }
    }
+
+   if (changed)
+      _mesa_parameter_values_changed(paramList);
 }
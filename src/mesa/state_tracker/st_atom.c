@@ -31,6 +31,7 @@
 #include "main/context.h"
 
 #include "pipe/p_defines.h"
+#include "util/u_math.h"
 #include "st_context.h"
 #include "st_atom.h"
 #include "st_cb_bitmap.h"
@@ -76,9 +77,46 @@ static const struct st_tracked_state *atoms[] =
 };
 
 
+/**
+ * The atoms (bits of a mask indexed like atoms[]) to update for each bit
+ * of the Mesa and the state tracker dirty flags.
+ */
+static unsigned atoms_for_mesa_flag[32];
+static unsigned atoms_for_st_flag[64];
+static once_flag atom_tables_once = ONCE_FLAG_INIT;
+
+static void init_atom_tables( void )
+{
+   unsigned i, bit;
+
+   STATIC_ASSERT(ARRAY_SIZE(atoms) <= 32);
+
+   for (i = 0; i < ARRAY_SIZE(atoms); i++) {
+      unsigned mesa = atoms[i]->dirty.mesa;
+      uint64_t st = atoms[i]->dirty.st;
+
+      while (mesa) {
+         bit = u_bit_scan(&mesa);
+         atoms_for_mesa_flag[bit] |= 1u << i;
+      }
+      while (st) {
+         bit = u_bit_scan64(&st);
+         atoms_for_st_flag[bit] |= 1u << i;
+      }
+   }
+}
+
+
 void st_init_atoms( struct st_context *st )
 {
-   /* no-op */
+   call_once(&atom_tables_once, init_atom_tables);
+
+   /* Make sure the first update of the atoms which only pass on state
+    * that changed doesn't get skipped.
+    */
+   memset(&st->state.blend, 0xff, sizeof(st->state.blend));
+   memset(&st->state.depth_stencil, 0xff, sizeof(st->state.depth_stencil));
+   memset(&st->state.rasterizer, 0xff, sizeof(st->state.rasterizer));
 }
 
 
@@ -115,6 +153,24 @@ static void xor_states( struct st_state_flags *result,
 }
 
 
+/**
+ * Mask of the atoms which need to be updated for the given dirty flags.
+ */
+static unsigned atoms_for_state( const struct st_state_flags *state )
+{
+   unsigned mesa = state->mesa;
+   uint64_t st = state->st;
+   unsigned mask = 0;
+
+   while (mesa)
+      mask |= atoms_for_mesa_flag[u_bit_scan(&mesa)];
+   while (st)
+      mask |= atoms_for_st_flag[u_bit_scan64(&st)];
+
+   return mask;
+}
+
+
 /* Too complex to figure out, just check every time:
  */
 static void check_program_state( struct st_context *st )
@@ -229,9 +285,24 @@ void st_validate_state( struct st_context *st )
 
    }
    else {
-      for (i = 0; i < ARRAY_SIZE(atoms); i++) {	 
-	 if (check_state(state, &atoms[i]->dirty))
-	    atoms[i]->update( st );
+      /* Only visit the atoms whose dirty flags are set.  Atoms may flag
+       * state examined by later atoms only (which the debug path above
+       * checks), so pick up whatever an update generated for those.
+       */
+      unsigned pending = atoms_for_state(state);
+
+      while (pending) {
+         const struct st_state_flags prev = *state;
+
+         i = u_bit_scan(&pending);
+         atoms[i]->update( st );
+
+         if (state->mesa != prev.mesa || state->st != prev.st) {
+            struct st_state_flags generated;
+
+            xor_states(&generated, &prev, state);
+            pending |= atoms_for_state(&generated) & ~((2u << i) - 1);
+         }
       }
    }
 
@@ -189,7 +189,7 @@ blend_per_rt(const struct gl_context *ctx)
 static void 
 update_blend( struct st_context *st )
 {
-   struct pipe_blend_state *blend = &st->state.blend;
+   struct pipe_blend_state blend_state, *blend = &blend_state;
    const struct gl_context *ctx = st->ctx;
    unsigned num_state = 1;
    unsigned i, j;
@@ -272,7 +272,11 @@ update_blend( struct st_context *st )
       blend->alpha_to_one = ctx->Multisample.SampleAlphaToOne;
    }
 
-   cso_set_blend(st->cso_context, blend);
+   /* Don't make the cso context hash state that didn't change */
+   if (memcmp(blend, &st->state.blend, sizeof(*blend)) != 0) {
+      memcpy(&st->state.blend, blend, sizeof(*blend));
+      cso_set_blend(st->cso_context, blend);
+   }
 
    {
       struct pipe_blend_color bc;
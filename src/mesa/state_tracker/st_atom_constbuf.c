@@ -73,6 +73,16 @@ void st_upload_constants( struct st_context *st,
        */
       _mesa_load_state_parameters(st->ctx, params);
 
+      /* Nothing changed since these constants were bound: keep the buffer
+       * the pipe already has.
+       */
+      if (st->state.constants[shader_type].ptr == params->ParameterValues &&
+          st->state.constants[shader_type].size == paramBytes &&
+          st->state.constants[shader_type].serial == params->ValuesSerial) {
+         st->num_constants_reused++;
+         return;
+      }
+
       /* We always need to get a new buffer, to keep the drivers simple and
        * avoid gratuitous rendering synchronization.
        * Let's use a user buffer to avoid an unnecessary copy.
@@ -102,11 +112,14 @@ void st_upload_constants( struct st_context *st,
 
       st->state.constants[shader_type].ptr = params->ParameterValues;
       st->state.constants[shader_type].size = paramBytes;
+      st->state.constants[shader_type].serial = params->ValuesSerial;
+      st->num_constants_uploaded++;
    }
    else if (st->state.constants[shader_type].ptr) {
       /* Unbind. */
       st->state.constants[shader_type].ptr = NULL;
       st->state.constants[shader_type].size = 0;
+      st->state.constants[shader_type].serial = 0;
       cso_set_constant_buffer(st->cso_context, shader_type, 0, NULL);
    }
 }
@@ -98,7 +98,7 @@ gl_stencil_op_to_pipe(GLenum func)
 static void
 update_depth_stencil_alpha(struct st_context *st)
 {
-   struct pipe_depth_stencil_alpha_state *dsa = &st->state.depth_stencil;
+   struct pipe_depth_stencil_alpha_state dsa_state, *dsa = &dsa_state;
    struct pipe_stencil_ref sr;
    struct gl_context *ctx = st->ctx;
 
@@ -148,7 +148,11 @@ update_depth_stencil_alpha(struct st_context *st)
       dsa->alpha.ref_value = ctx->Color.AlphaRefUnclamped;
    }
 
-   cso_set_depth_stencil_alpha(st->cso_context, dsa);
+   /* Don't make the cso context hash state that didn't change */
+   if (memcmp(dsa, &st->state.depth_stencil, sizeof(*dsa)) != 0) {
+      memcpy(&st->state.depth_stencil, dsa, sizeof(*dsa));
+      cso_set_depth_stencil_alpha(st->cso_context, dsa);
+   }
    cso_set_stencil_ref(st->cso_context, &sr);
 }
 
@@ -60,7 +60,7 @@ static GLuint translate_fill( GLenum mode )
 static void update_raster_state( struct st_context *st )
 {
    struct gl_context *ctx = st->ctx;
-   struct pipe_rasterizer_state *raster = &st->state.rasterizer;
+   struct pipe_rasterizer_state raster_state, *raster = &raster_state;
    const struct gl_vertex_program *vertProg = ctx->VertexProgram._Current;
    const struct gl_fragment_program *fragProg = ctx->FragmentProgram._Current;
    uint i;
@@ -267,7 +267,11 @@ static void update_raster_state( struct st_context *st )
    raster->clip_plane_enable = ctx->Transform.ClipPlanesEnabled;
    raster->clip_halfz = (ctx->Transform.ClipDepthMode == GL_ZERO_TO_ONE);
 
-   cso_set_rasterizer(st->cso_context, raster);
+   /* Don't make the cso context hash state that didn't change */
+   if (memcmp(raster, &st->state.rasterizer, sizeof(*raster)) != 0) {
+      memcpy(&st->state.rasterizer, raster, sizeof(*raster));
+      cso_set_rasterizer(st->cso_context, raster);
+   }
 }
 
 const struct st_tracked_state st_update_rasterizer = {
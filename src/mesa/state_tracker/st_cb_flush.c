@@ -39,11 +39,13 @@
 #include "st_cb_flush.h"
 #include "st_cb_clear.h"
 #include "st_cb_fbo.h"
+#include "st_debug.h"
 #include "st_manager.h"
 #include "pipe/p_context.h"
 #include "pipe/p_defines.h"
 #include "pipe/p_screen.h"
 #include "util/u_gen_mipmap.h"
+#include "util/u_upload_mgr.h"
 
 
 /** Check if we have a front color buffer and if it's been drawn to. */
@@ -75,16 +77,91 @@ display_front_buffer(struct st_context *st)
 }
 
 
+static void
+print_upload_stats(const char *name, struct u_upload_mgr *upload)
+{
+   struct u_upload_stats stats;
+
+   if (!upload)
+      return;
+
+   u_upload_get_stats(upload, &stats, TRUE);
+   debug_printf("st: %s uploader: %llu bytes, %u buffers allocated, "
+                "%u recycled, %u released\n", name,
+                (unsigned long long) stats.bytes_uploaded,
+                stats.buffers_allocated, stats.buffers_recycled,
+                stats.buffers_released);
+}
+
+
+/**
+ * Whether any of the upload managers has persistent buffers waiting for
+ * a fence.
+ */
+static boolean
+st_uploaders_need_fence(struct st_context *st)
+{
+   return u_upload_needs_fence(st->uploader) ||
+          (st->indexbuf_uploader &&
+           u_upload_needs_fence(st->indexbuf_uploader)) ||
+          (st->constbuf_uploader &&
+           u_upload_needs_fence(st->constbuf_uploader));
+}
+
+
+/**
+ * Hand the flush fence to the upload managers so they can recycle their
+ * buffers, and print their per-frame statistics if asked to.
+ */
+static void
+st_fence_uploaders(struct st_context *st,
+                   struct pipe_fence_handle *fence,
+                   unsigned flags)
+{
+   if (fence) {
+      u_upload_fence(st->uploader, fence);
+      if (st->indexbuf_uploader)
+         u_upload_fence(st->indexbuf_uploader, fence);
+      if (st->constbuf_uploader)
+         u_upload_fence(st->constbuf_uploader, fence);
+   }
+
+   if ((ST_DEBUG & DEBUG_UPLOAD) && (flags & PIPE_FLUSH_END_OF_FRAME)) {
+      print_upload_stats("vertex", st->uploader);
+      print_upload_stats("index", st->indexbuf_uploader);
+      print_upload_stats("constant", st->constbuf_uploader);
+      debug_printf("st: constant buffers: %u uploaded, %u reused\n",
+                   st->num_constants_uploaded, st->num_constants_reused);
+      st->num_constants_uploaded = 0;
+      st->num_constants_reused = 0;
+   }
+}
+
+
 void st_flush(struct st_context *st,
               struct pipe_fence_handle **fence,
               unsigned flags)
 {
+   struct pipe_screen *screen = st->pipe->screen;
+   struct pipe_fence_handle *upload_fence = NULL;
+
    FLUSH_VERTICES(st->ctx, 0);
    FLUSH_CURRENT(st->ctx, 0);
 
    st_flush_bitmap_cache(st);
 
+   /* Ask for a fence when the upload managers need one to recycle their
+    * persistent buffers, even if the caller doesn't.
+    */
+   if (!fence && st_uploaders_need_fence(st))
+      fence = &upload_fence;
+
    st->pipe->flush(st->pipe, fence, flags);
+
+   st_fence_uploaders(st, fence ? *fence : NULL, flags);
+
+   if (upload_fence)
+      screen->fence_reference(screen, &upload_fence, NULL);
 }
 
 
@@ -83,6 +83,9 @@ struct st_context
 
    struct u_upload_mgr *uploader, *indexbuf_uploader, *constbuf_uploader;
 
+   /** Constant buffer updates this frame, for ST_DEBUG=upload */
+   unsigned num_constants_uploaded, num_constants_reused;
+
    struct draw_context *draw;  /**< For selection/feedback/rastpos only */
    struct draw_stage *feedback_stage;  /**< For GL_FEEDBACK rendermode */
    struct draw_stage *selection_stage;  /**< For GL_SELECT rendermode */
@@ -121,6 +124,7 @@ struct st_context
       struct {
          void *ptr;
          unsigned size;
+         GLuint serial;  /**< gl_program_parameter_list::ValuesSerial */
       } constants[PIPE_SHADER_TYPES];
       struct pipe_framebuffer_state framebuffer;
       struct pipe_scissor_state scissor[PIPE_MAX_VIEWPORTS];
@@ -279,7 +283,8 @@ extern struct st_context *
 st_create_context(gl_api api, struct pipe_context *pipe,
                   const struct gl_config *visual,
                   struct st_context *share,
-                  const struct st_config_options *options);
+                  const struct st_config_options *options,
+                  bool no_error);
 
 extern void
 st_destroy_context(struct st_context *st);
@@ -48,6 +48,7 @@ st_print_current(void);
 #define DEBUG_BUFFER    0x200
 #define DEBUG_WIREFRAME 0x400
 #define DEBUG_PRECOMPILE   0x800
+#define DEBUG_UPLOAD    0x1000
 
 #ifdef DEBUG
 extern int ST_DEBUG;
@@ -33,6 +33,7 @@
 #include "main/texstate.h"
 #include "main/errors.h"
 #include "main/framebuffer.h"
+#include "main/glthread.h"
 #include "main/fbobject.h"
 #include "main/renderbuffer.h"
 #include "main/version.h"
@@ -496,6 +497,8 @@ st_context_flush(struct st_context_iface *stctxi, unsigned flags,
    struct st_context *st = (struct st_context *) stctxi;
    unsigned pipe_flags = 0;
 
+   _mesa_glthread_finish(st->ctx);
+
    if (flags & ST_FLUSH_END_OF_FRAME) {
       pipe_flags |= PIPE_FLUSH_END_OF_FRAME;
    }
@@ -521,6 +524,8 @@ st_context_teximage(struct st_context_iface *stctxi,
    GLuint width, height, depth;
    GLenum target;
 
+   _mesa_glthread_finish(ctx);
+
    switch (tex_type) {
    case ST_TEXTURE_1D:
       target = GL_TEXTURE_1D;
@@ -663,7 +668,8 @@ st_api_create_context(struct st_api *stapi, struct st_manager *smapi,
    }
 
    st_visual_to_context_mode(&attribs->visual, &mode);
-   st = st_create_context(api, pipe, &mode, shared_ctx, &attribs->options);
+   st = st_create_context(api, pipe, &mode, shared_ctx, &attribs->options,
+                          attribs->flags & ST_CONTEXT_FLAG_NO_ERROR);
    if (!st) {
       *error = ST_CONTEXT_ERROR_NO_MEMORY;
       pipe->destroy(pipe);
@@ -750,6 +756,8 @@ st_api_make_current(struct st_api *stapi, struct st_context_iface *stctxi,
    _glapi_check_multithread();
 
    if (st) {
+      _mesa_glthread_finish(st->ctx);
+
       /* reuse or create the draw fb */
       stdraw = st_framebuffer_reuse_or_create(st,
             st->ctx->WinSysDrawBuffer, stdrawi);
@@ -783,6 +791,12 @@ st_api_make_current(struct st_api *stapi, struct st_context_iface *stctxi,
 
       st_framebuffer_reference(&stdraw, NULL);
       st_framebuffer_reference(&stread, NULL);
+
+      /* Window system calls from the other entry points in this file
+       * finish the queue, so the threaded dispatch is safe here.
+       */
+      if (ret && _mesa_glthread_enabled())
+         _mesa_glthread_init(st->ctx);
    }
    else {
       ret = _mesa_make_current(NULL, NULL, NULL);
@@ -186,6 +186,26 @@ vbo_can_merge_prims(const struct _mesa_prim *p0, const struct _mesa_prim *p1);
 void
 vbo_merge_prims(struct _mesa_prim *p0, const struct _mesa_prim *p1);
 
+
+/**
+ * One instruction of a display list being finished, as passed to
+ * vbo_save_merge_vertex_lists(): either an extension opcode (which may be
+ * a vbo vertex list) or a constant current attribute value.
+ */
+struct vbo_save_list_item {
+   GLuint opcode;       /**< extension opcode, if data != NULL */
+   void *data;          /**< payload of the extension opcode */
+   GLuint attr;         /**< VERT_ATTRIB_x */
+   GLuint size;
+   GLfloat value[4];
+};
+
+void
+vbo_save_merge_vertex_lists(struct gl_context *ctx,
+                            const struct vbo_save_list_item *items,
+                            GLuint count,
+                            GLuint *draws_before, GLuint *draws_after);
+
 void
 vbo_sw_primitive_restart(struct gl_context *ctx,
                          const struct _mesa_prim *prim,
@@ -38,6 +38,7 @@
 #include "main/macros.h"
 #include "main/transformfeedback.h"
 #include "main/sse_minmax.h"
+#include "util/hash_table.h"
 #include "x86/common_x86_asm.h"
 
 #include "vbo_context.h"
@@ -81,6 +82,175 @@ vbo_check_buffers_are_unmapped(struct gl_context *ctx)
 
 
 
+/**
+ * Don't bother caching the range of draws with fewer indices than this,
+ * scanning them is about as cheap as a lookup.
+ */
+#define MINMAX_CACHE_MIN_COUNT 64
+
+/** Drop the whole cache when it grows beyond this many entries */
+#define MINMAX_CACHE_MAX_ENTRIES 4096
+
+struct minmax_cache_key {
+   GLintptr offset;
+   GLuint count;
+   GLenum type;
+   GLboolean primitive_restart;
+   GLuint restart_index;   /**< only meaningful with primitive_restart */
+};
+
+struct minmax_cache_entry {
+   struct minmax_cache_key key;
+   GLuint min;
+   GLuint max;
+};
+
+
+static uint32_t
+vbo_minmax_cache_hash(const void *key)
+{
+   return _mesa_hash_data(key, sizeof(struct minmax_cache_key));
+}
+
+
+static bool
+vbo_minmax_cache_key_equal(const void *a, const void *b)
+{
+   return memcmp(a, b, sizeof(struct minmax_cache_key)) == 0;
+}
+
+
+static void
+vbo_minmax_cache_delete_entry(struct hash_entry *entry)
+{
+   free(entry->data);
+}
+
+
+/**
+ * Can the index ranges of this buffer be memoized?  Not if the buffer may
+ * be written behind our back: through a persistent mapping, by transform
+ * feedback, atomic counters, image stores to a buffer texture or pixel
+ * packing.
+ */
+static bool
+vbo_use_minmax_cache(const struct gl_buffer_object *bufferObj, GLuint count)
+{
+   const gl_buffer_usage gpu_writes = USAGE_ATOMIC_COUNTER_BUFFER |
+                                      USAGE_TEXTURE_BUFFER |
+                                      USAGE_TRANSFORM_FEEDBACK_BUFFER |
+                                      USAGE_PIXEL_PACK_BUFFER;
+
+   if (count < MINMAX_CACHE_MIN_COUNT || bufferObj->MinMaxCacheDisabled)
+      return false;
+
+   if (bufferObj->UsageHistory & gpu_writes)
+      return false;
+
+   if ((bufferObj->StorageFlags & GL_MAP_PERSISTENT_BIT) &&
+       (bufferObj->StorageFlags & GL_MAP_WRITE_BIT))
+      return false;
+
+   return true;
+}
+
+
+/**
+ * Throw away stale entries.  Called with the cache mutex held.
+ */
+static void
+vbo_minmax_cache_validate(struct gl_buffer_object *bufferObj)
+{
+   if (!bufferObj->MinMaxCacheDirty)
+      return;
+
+   bufferObj->MinMaxCacheDirty = false;
+
+   if (bufferObj->MinMaxCache) {
+      _mesa_hash_table_destroy(bufferObj->MinMaxCache,
+                               vbo_minmax_cache_delete_entry);
+      bufferObj->MinMaxCache = NULL;
+   }
+
+   /* A buffer that gets respecified more often than its ranges get reused
+    * is streamed: stop caching for it.
+    */
+   if (bufferObj->MinMaxCacheMisses > 100 &&
+       bufferObj->MinMaxCacheHits < bufferObj->MinMaxCacheMisses)
+      bufferObj->MinMaxCacheDisabled = true;
+}
+
+
+static bool
+vbo_minmax_cache_lookup(struct gl_buffer_object *bufferObj,
+                        const struct minmax_cache_key *key,
+                        GLuint *min_index, GLuint *max_index)
+{
+   struct hash_entry *result = NULL;
+
+   mtx_lock(&bufferObj->MinMaxCacheMutex);
+   vbo_minmax_cache_validate(bufferObj);
+
+   if (bufferObj->MinMaxCache)
+      result = _mesa_hash_table_search(bufferObj->MinMaxCache, key);
+
+   if (result) {
+      const struct minmax_cache_entry *entry = result->data;
+      *min_index = entry->min;
+      *max_index = entry->max;
+      bufferObj->MinMaxCacheHits++;
+   }
+   else {
+      bufferObj->MinMaxCacheMisses++;
+   }
+   mtx_unlock(&bufferObj->MinMaxCacheMutex);
+
+   return result != NULL;
+}
+
+
+static void
+vbo_minmax_cache_store(struct gl_buffer_object *bufferObj,
+                       const struct minmax_cache_key *key,
+                       GLuint min_index, GLuint max_index)
+{
+   struct minmax_cache_entry *entry;
+
+   mtx_lock(&bufferObj->MinMaxCacheMutex);
+
+   /* The contents may have changed while we were scanning them */
+   if (bufferObj->MinMaxCacheDirty || bufferObj->MinMaxCacheDisabled)
+      goto out;
+
+   if (bufferObj->MinMaxCache &&
+       bufferObj->MinMaxCache->entries >= MINMAX_CACHE_MAX_ENTRIES) {
+      _mesa_hash_table_destroy(bufferObj->MinMaxCache,
+                               vbo_minmax_cache_delete_entry);
+      bufferObj->MinMaxCache = NULL;
+   }
+
+   if (!bufferObj->MinMaxCache) {
+      bufferObj->MinMaxCache =
+         _mesa_hash_table_create(NULL, vbo_minmax_cache_hash,
+                                 vbo_minmax_cache_key_equal);
+      if (!bufferObj->MinMaxCache)
+         goto out;
+   }
+
+   entry = MALLOC_STRUCT(minmax_cache_entry);
+   if (!entry)
+      goto out;
+
+   entry->key = *key;
+   entry->min = min_index;
+   entry->max = max_index;
+   _mesa_hash_table_insert(bufferObj->MinMaxCache, &entry->key, entry);
+
+out:
+   mtx_unlock(&bufferObj->MinMaxCacheMutex);
+}
+
+
 /**
  * Compute min and max elements by scanning the index buffer for
  * glDraw[Range]Elements() calls.
@@ -97,12 +267,28 @@ vbo_get_minmax_index(struct gl_context *ctx,
    const GLboolean restart = ctx->Array._PrimitiveRestart;
    const GLuint restartIndex = _mesa_primitive_restart_index(ctx, ib->type);
    const int index_size = vbo_sizeof_ib_type(ib->type);
+   struct minmax_cache_key key;
+   bool use_cache = false;
    const char *indices;
    GLuint i;
 
    indices = (char *) ib->ptr + prim->start * index_size;
    if (_mesa_is_bufferobj(ib->obj)) {
       GLsizeiptr size = MIN2(count * index_size, ib->obj->Size);
+
+      use_cache = vbo_use_minmax_cache(ib->obj, count);
+      if (use_cache) {
+         memset(&key, 0, sizeof(key));
+         key.offset = (GLintptr) indices;
+         key.count = count;
+         key.type = ib->type;
+         key.primitive_restart = restart;
+         key.restart_index = restart ? restartIndex : 0;
+
+         if (vbo_minmax_cache_lookup(ib->obj, &key, min_index, max_index))
+            return;
+      }
+
       indices = ctx->Driver.MapBufferRange(ctx, (GLintptr) indices, size,
                                            GL_MAP_READ_BIT, ib->obj,
                                            MAP_INTERNAL);
@@ -187,6 +373,9 @@ vbo_get_minmax_index(struct gl_context *ctx,
 
    if (_mesa_is_bufferobj(ib->obj)) {
       ctx->Driver.UnmapBuffer(ctx, ib->obj, MAP_INTERNAL);
+
+      if (use_cache)
+         vbo_minmax_cache_store(ib->obj, &key, *min_index, *max_index);
    }
 }
 
@@ -1785,6 +1974,128 @@ vbo_exec_MultiDrawElementsIndirect(GLenum mode, GLenum type,
                                            primcount, stride);
 }
 
+/*
+ * Draw entry points for contexts created with GL_CONTEXT_FLAG_NO_ERROR_BIT_KHR.
+ * The application promises that the parameters are valid, so these skip
+ * straight to drawing after _mesa_prepare_draw_no_error().
+ */
+
+static void GLAPIENTRY
+vbo_exec_DrawArrays_no_error(GLenum mode, GLint start, GLsizei count)
+{
+   GET_CURRENT_CONTEXT(ctx);
+
+   if (!_mesa_prepare_draw_no_error(ctx, count, 1))
+      return;
+
+   vbo_draw_arrays(ctx, mode, start, count, 1, 0);
+}
+
+
+static void GLAPIENTRY
+vbo_exec_DrawArraysInstanced_no_error(GLenum mode, GLint start, GLsizei count,
+                                      GLsizei numInstances)
+{
+   GET_CURRENT_CONTEXT(ctx);
+
+   if (!_mesa_prepare_draw_no_error(ctx, count, numInstances))
+      return;
+
+   vbo_draw_arrays(ctx, mode, start, count, numInstances, 0);
+}
+
+
+static inline GLboolean
+prepare_draw_elements_no_error(struct gl_context *ctx, GLsizei count,
+                               const GLvoid *indices, GLsizei numInstances)
+{
+   if (!_mesa_prepare_draw_no_error(ctx, count, numInstances))
+      return GL_FALSE;
+
+   /* Not using a VBO for indices, so avoid NULL pointer derefs later.
+    */
+   return _mesa_is_bufferobj(ctx->Array.VAO->IndexBufferObj) || indices;
+}
+
+
+static void GLAPIENTRY
+vbo_exec_DrawElementsInstancedBaseVertex_no_error(GLenum mode, GLsizei count,
+                                                  GLenum type,
+                                                  const GLvoid *indices,
+                                                  GLsizei numInstances,
+                                                  GLint basevertex)
+{
+   GET_CURRENT_CONTEXT(ctx);
+
+   if (!prepare_draw_elements_no_error(ctx, count, indices, numInstances))
+      return;
+
+   vbo_validated_drawrangeelements(ctx, mode, GL_FALSE, ~0, ~0,
+                                   count, type, indices, basevertex,
+                                   numInstances, 0);
+}
+
+
+static void GLAPIENTRY
+vbo_exec_DrawElements_no_error(GLenum mode, GLsizei count, GLenum type,
+                               const GLvoid *indices)
+{
+   vbo_exec_DrawElementsInstancedBaseVertex_no_error(mode, count, type,
+                                                     indices, 1, 0);
+}
+
+
+static void GLAPIENTRY
+vbo_exec_DrawElementsBaseVertex_no_error(GLenum mode, GLsizei count,
+                                         GLenum type, const GLvoid *indices,
+                                         GLint basevertex)
+{
+   vbo_exec_DrawElementsInstancedBaseVertex_no_error(mode, count, type,
+                                                     indices, 1, basevertex);
+}
+
+
+static void GLAPIENTRY
+vbo_exec_DrawElementsInstanced_no_error(GLenum mode, GLsizei count,
+                                        GLenum type, const GLvoid *indices,
+                                        GLsizei numInstances)
+{
+   vbo_exec_DrawElementsInstancedBaseVertex_no_error(mode, count, type,
+                                                     indices, numInstances, 0);
+}
+
+
+/**
+ * The index range is trusted to cover all the indices, so unlike
+ * vbo_exec_DrawRangeElementsBaseVertex() it is always passed on as valid.
+ */
+static void GLAPIENTRY
+vbo_exec_DrawRangeElementsBaseVertex_no_error(GLenum mode,
+                                              GLuint start, GLuint end,
+                                              GLsizei count, GLenum type,
+                                              const GLvoid *indices,
+                                              GLint basevertex)
+{
+   GET_CURRENT_CONTEXT(ctx);
+
+   if (!prepare_draw_elements_no_error(ctx, count, indices, 1))
+      return;
+
+   vbo_validated_drawrangeelements(ctx, mode, GL_TRUE, start, end,
+                                   count, type, indices, basevertex, 1, 0);
+}
+
+
+static void GLAPIENTRY
+vbo_exec_DrawRangeElements_no_error(GLenum mode, GLuint start, GLuint end,
+                                    GLsizei count, GLenum type,
+                                    const GLvoid *indices)
+{
+   vbo_exec_DrawRangeElementsBaseVertex_no_error(mode, start, end, count,
+                                                 type, indices, 0);
+}
+
+
 /**
  * Initialize the dispatch table with the VBO functions for drawing.
  */
@@ -1835,6 +2146,23 @@ vbo_initialize_exec_dispatch(const struct gl_context *ctx,
       SET_DrawTransformFeedbackInstanced(exec, vbo_exec_DrawTransformFeedbackInstanced);
       SET_DrawTransformFeedbackStreamInstanced(exec, vbo_exec_DrawTransformFeedbackStreamInstanced);
    }
+
+   if (_mesa_is_no_error_enabled(ctx)) {
+      SET_DrawArrays(exec, vbo_exec_DrawArrays_no_error);
+      SET_DrawElements(exec, vbo_exec_DrawElements_no_error);
+
+      if (_mesa_is_desktop_gl(ctx) || _mesa_is_gles3(ctx)) {
+         SET_DrawRangeElements(exec, vbo_exec_DrawRangeElements_no_error);
+         SET_DrawArraysInstancedARB(exec, vbo_exec_DrawArraysInstanced_no_error);
+         SET_DrawElementsInstancedARB(exec, vbo_exec_DrawElementsInstanced_no_error);
+      }
+
+      if (_mesa_is_desktop_gl(ctx)) {
+         SET_DrawElementsBaseVertex(exec, vbo_exec_DrawElementsBaseVertex_no_error);
+         SET_DrawRangeElementsBaseVertex(exec, vbo_exec_DrawRangeElementsBaseVertex_no_error);
+         SET_DrawElementsInstancedBaseVertex(exec, vbo_exec_DrawElementsInstancedBaseVertex_no_error);
+      }
+   }
 }
 
 
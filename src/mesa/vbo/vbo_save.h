@@ -83,6 +83,12 @@ struct vbo_save_vertex_list {
 
    struct vbo_save_vertex_store *vertex_store;
    struct vbo_save_primitive_store *prim_store;
+
+   /* Indices of the prims if this list was built by merging several
+    * vertex lists at glEndList time (ib.obj != NULL), see
+    * vbo_save_merge.c.
+    */
+   struct _mesa_index_buffer ib;
 };
 
 /* These buffers should be a reasonable size to support upload to
@@ -103,6 +109,9 @@ struct vbo_save_vertex_list {
 
 #define VBO_SAVE_FALLBACK    0x10000000
 
+/* An interesting VBO number/name to help with debugging */
+#define VBO_BUF_ID  12345
+
 /* Storage to be shared among several vertex_lists.
  */
 struct vbo_save_vertex_store {
@@ -183,6 +192,7 @@ void vbo_save_SaveFlushVertices( struct gl_context *ctx );
 GLboolean vbo_save_NotifyBegin( struct gl_context *ctx, GLenum mode );
 
 void vbo_save_playback_vertex_list( struct gl_context *ctx, void *data );
+void vbo_destroy_vertex_list( struct gl_context *ctx, void *data );
 
 void vbo_save_api_init( struct vbo_save_context *save );
 
@@ -88,10 +88,6 @@ USE OR OTHER DEALINGS IN THE SOFTWARE.
 #endif
 
 
-/* An interesting VBO number/name to help with debugging */
-#define VBO_BUF_ID  12345
-
-
 /*
  * NOTE: Old 'parity' issue is gone, but copying can still be
  * wrong-footed on replay.
@@ -397,6 +393,7 @@ _save_compile_vertex_list(struct gl_context *ctx)
    node->prim_count = save->prim_count;
    node->vertex_store = save->vertex_store;
    node->prim_store = save->prim_store;
+   memset(&node->ib, 0, sizeof(node->ib));
 
    node->vertex_store->refcount++;
    node->prim_store->refcount++;
@@ -1508,11 +1505,10 @@ vbo_save_EndCallList(struct gl_context *ctx)
 }
 
 
-static void
+void
 vbo_destroy_vertex_list(struct gl_context *ctx, void *data)
 {
    struct vbo_save_vertex_list *node = (struct vbo_save_vertex_list *) data;
-   (void) ctx;
 
    if (--node->vertex_store->refcount == 0)
       free_vertex_store(ctx, node->vertex_store);
@@ -1520,6 +1516,8 @@ vbo_destroy_vertex_list(struct gl_context *ctx, void *data)
    if (--node->prim_store->refcount == 0)
       free(node->prim_store);
 
+   _mesa_reference_buffer_object(ctx, &node->ib.obj, NULL);
+
    free(node->current_data);
    node->current_data = NULL;
 }
@@ -1535,9 +1533,9 @@ vbo_print_vertex_list(struct gl_context *ctx, void *data, FILE *f)
    (void) ctx;
 
    fprintf(f, "VBO-VERTEX-LIST, %u vertices %d primitives, %d vertsize "
-           "buffer %p\n",
+           "buffer %p%s\n",
            node->count, node->prim_count, node->vertex_size,
-           buffer);
+           buffer, node->ib.obj ? " indexed" : "");
 
    for (i = 0; i < node->prim_count; i++) {
       struct _mesa_prim *prim = &node->prim[i];
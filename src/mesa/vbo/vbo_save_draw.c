@@ -216,6 +216,49 @@ static void vbo_bind_vertex_list(struct gl_context *ctx,
 }
 
 
+/**
+ * Expand the vertices of an indexed (merged) vertex list into index order,
+ * so that the prim starts refer to vertices again.  Returns NULL if out of
+ * memory.
+ */
+static GLfloat *
+expand_indexed_vertex_list(struct gl_context *ctx,
+                           const struct vbo_save_vertex_list *list,
+                           const GLfloat *vertices)
+{
+   const GLuint vertex_size = list->vertex_size;
+   const GLuint index_size = vbo_sizeof_ib_type(list->ib.type);
+   const GLubyte *indices;
+   GLfloat *expanded;
+   GLuint i, index;
+
+   expanded = malloc(list->ib.count * vertex_size * sizeof(GLfloat));
+   if (!expanded)
+      return NULL;
+
+   indices = ctx->Driver.MapBufferRange(ctx, 0, list->ib.obj->Size,
+                                        GL_MAP_READ_BIT, list->ib.obj,
+                                        MAP_INTERNAL);
+   if (!indices) {
+      free(expanded);
+      return NULL;
+   }
+
+   for (i = 0; i < list->ib.count; i++) {
+      if (index_size == sizeof(GLushort))
+         index = ((const GLushort *) indices)[i];
+      else
+         index = ((const GLuint *) indices)[i];
+
+      memcpy(expanded + i * vertex_size, vertices + index * vertex_size,
+             vertex_size * sizeof(GLfloat));
+   }
+
+   ctx->Driver.UnmapBuffer(ctx, list->ib.obj, MAP_INTERNAL);
+   return expanded;
+}
+
+
 static void
 vbo_save_loopback_vertex_list(struct gl_context *ctx,
                               const struct vbo_save_vertex_list *list)
@@ -226,15 +269,29 @@ vbo_save_loopback_vertex_list(struct gl_context *ctx,
 				 GL_MAP_READ_BIT, /* ? */
 				 list->vertex_store->bufferobj,
                                  MAP_INTERNAL);
+   const GLfloat *vertices = (const GLfloat *)(buffer + list->buffer_offset);
+   GLfloat *expanded = NULL;
+
+   if (list->ib.obj) {
+      expanded = expand_indexed_vertex_list(ctx, list, vertices);
+      if (!expanded) {
+         _mesa_error(ctx, GL_OUT_OF_MEMORY, "glCallList");
+         goto end;
+      }
+      vertices = expanded;
+   }
 
    vbo_loopback_vertex_list(ctx,
-                            (const GLfloat *)(buffer + list->buffer_offset),
+                            vertices,
                             list->attrsz,
                             list->prim,
                             list->prim_count,
                             list->wrap_count,
                             list->vertex_size);
 
+   free(expanded);
+
+end:
    ctx->Driver.UnmapBuffer(ctx, list->vertex_store->bufferobj,
                            MAP_INTERNAL);
 }
@@ -310,7 +367,7 @@ vbo_save_playback_vertex_list(struct gl_context *ctx, void *data)
          vbo_context(ctx)->draw_prims(ctx, 
                                       node->prim,
                                       node->prim_count,
-                                      NULL,
+                                      node->ib.obj ? &node->ib : NULL,
                                       GL_TRUE,
                                       0,    /* Node is a VBO, so this is ok */
                                       node->count - 1,
@@ -0,0 +1,594 @@
+/*
+ * Copyright 2015 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file vbo_save_merge.c
+ * Merging of display list vertex lists at glEndList time.
+ *
+ * Any glColor, glNormal, etc. call outside glBegin/End ends the vertex
+ * list being compiled, so a display list made of many small glBegin/End
+ * blocks with attribute changes between them is played back with one
+ * draw per block.
+ *
+ * Here a run of vertex lists separated only by such calls is rebuilt as
+ * a single vertex list in a new buffer, with the attributes that were set
+ * between the blocks stored per vertex.  Identical vertices are shared
+ * through an index buffer.  This is only possible if the value of every
+ * attribute of the merged list is known for every block, i.e. it was set
+ * earlier in the display list.
+ *
+ * The attribute opcodes stay in the display list.  The merged list takes
+ * the place of the last list of the run, so that it draws after all of
+ * them executed and its update of the current values leaves the same
+ * state as the original lists.  The other lists of the run become empty.
+ */
+
+
+#include "main/glheader.h"
+#include "main/bufferobj.h"
+#include "main/imports.h"
+#include "main/macros.h"
+#include "main/mtypes.h"
+#include "util/hash_table.h"
+
+#include "vbo_context.h"
+
+
+/** Merged lists are limited so that GL_UNSIGNED_SHORT indices suffice */
+#define MAX_MERGED_VERTICES (64 * 1024)
+
+#define GENERIC_ATTRIBS \
+   (BITFIELD64_MASK(VBO_ATTRIB_GENERIC15 + 1) & \
+    ~BITFIELD64_MASK(VBO_ATTRIB_GENERIC0))
+
+#define MATERIAL_ATTRIBS \
+   (BITFIELD64_MASK(VBO_ATTRIB_LAST_MATERIAL + 1) & \
+    ~BITFIELD64_MASK(VBO_ATTRIB_FIRST_MATERIAL))
+
+
+/** Current attribute values at some point of the display list */
+struct merge_current {
+   GLbitfield64 known;          /**< attributes with a known value */
+   GLubyte size[VBO_ATTRIB_MAX];
+   GLfloat value[VBO_ATTRIB_MAX][4];
+};
+
+
+/** A run of vertex lists being collected for merging */
+struct merge_run {
+   GLuint first, last;          /**< items of the first and last list */
+   GLuint num_lists;
+   GLuint num_vertices;
+   GLuint draws;                /**< prims of the lists before merging */
+   GLbitfield64 used;           /**< attributes of the merged list */
+   GLbitfield64 defined;        /**< attributes known for every list */
+   GLbitfield64 pending;        /**< attributes set since the last list */
+   struct merge_current start;  /**< current values before the first list */
+   struct _mesa_prim prim[VBO_SAVE_PRIM_SIZE];
+   GLuint prim_count;
+};
+
+
+struct merge_context {
+   struct merge_current current;
+   struct merge_run run;
+};
+
+
+static GLbitfield64
+list_attribs(const struct vbo_save_vertex_list *node)
+{
+   GLbitfield64 attribs = 0;
+   GLuint i;
+
+   for (i = 0; i < VBO_ATTRIB_MAX; i++) {
+      if (node->attrsz[i])
+         attribs |= BITFIELD64_BIT(i);
+   }
+   return attribs;
+}
+
+
+/**
+ * Can the list be merged with others?  It must be made of complete
+ * glBegin/End blocks, update the current values from its last vertex and
+ * only have float attributes.
+ */
+static bool
+is_mergeable(const struct vbo_save_vertex_list *node)
+{
+   GLuint i;
+
+   if (node->count == 0 ||
+       node->prim_count == 0 ||
+       node->ib.obj ||
+       node->dangling_attr_ref ||
+       node->wrap_count ||
+       !node->prim[0].begin ||
+       !node->prim[node->prim_count - 1].end ||
+       node->prim[0].no_current_update ||
+       !node->attrsz[VBO_ATTRIB_POS] ||
+       (node->current_size && !node->current_data))
+      return false;
+
+   for (i = 0; i < VBO_ATTRIB_MAX; i++) {
+      if (node->attrsz[i] && node->attrtype[i] != GL_FLOAT)
+         return false;
+   }
+
+   return true;
+}
+
+
+static void
+set_current(struct merge_current *current,
+            const struct vbo_save_list_item *item)
+{
+   current->known |= BITFIELD64_BIT(item->attr);
+   current->size[item->attr] = item->size;
+   COPY_4V(current->value[item->attr], item->value);
+}
+
+
+/**
+ * Update the current values as playing back the list does.
+ */
+static void
+update_current(struct merge_current *current,
+               const struct vbo_save_vertex_list *node)
+{
+   const fi_type *data = node->current_data;
+   GLuint i;
+
+   for (i = VBO_ATTRIB_POS + 1; i < VBO_ATTRIB_MAX; i++) {
+      if (node->attrsz[i]) {
+         ASSIGN_4V(current->value[i], 0, 0, 0, 1);
+         memcpy(current->value[i], data, node->attrsz[i] * sizeof(GLfloat));
+         current->size[i] = node->attrsz[i];
+         current->known |= BITFIELD64_BIT(i);
+         data += node->attrsz[i];
+      }
+   }
+}
+
+
+/**
+ * Try to append the list to the run.  The prims are merged with the
+ * previous ones where possible.
+ */
+static bool
+add_to_run(struct merge_run *run, const struct vbo_save_vertex_list *node,
+           GLbitfield64 node_defined)
+{
+   const GLbitfield64 used = run->used | run->pending | list_attribs(node);
+   const GLbitfield64 defined = run->defined & node_defined;
+   const GLuint prim_count = run->prim_count;
+   struct _mesa_prim last_prim;
+   GLuint i;
+
+   if (used & ~defined)
+      return false;
+
+   /* In fixed-function mode materials are bound in place of the generic
+    * attributes, so the vertex layout can't have both.
+    */
+   if ((used & GENERIC_ATTRIBS) && (used & MATERIAL_ATTRIBS))
+      return false;
+
+   if (run->num_vertices + node->count > MAX_MERGED_VERTICES)
+      return false;
+
+   if (prim_count)
+      last_prim = run->prim[prim_count - 1];
+
+   for (i = 0; i < node->prim_count; i++) {
+      struct _mesa_prim prim = node->prim[i];
+
+      prim.start += run->num_vertices;
+
+      if (run->prim_count &&
+          vbo_can_merge_prims(&run->prim[run->prim_count - 1], &prim)) {
+         vbo_merge_prims(&run->prim[run->prim_count - 1], &prim);
+      }
+      else if (run->prim_count < VBO_SAVE_PRIM_SIZE) {
+         run->prim[run->prim_count++] = prim;
+      }
+      else {
+         /* undo */
+         run->prim_count = prim_count;
+         if (prim_count)
+            run->prim[prim_count - 1] = last_prim;
+         return false;
+      }
+   }
+
+   run->used = used;
+   run->defined = defined;
+   run->pending = 0;
+   run->num_vertices += node->count;
+   run->draws += node->prim_count;
+   run->num_lists++;
+   return true;
+}
+
+
+/**
+ * Replace identical vertices by references to the first one.  The unique
+ * vertices are moved to the start of the array.
+ * \return number of unique vertices, or 0 if out of memory
+ */
+static GLuint
+dedup_vertices(fi_type *vertices, GLuint count, GLuint vertex_size,
+               GLushort *indices)
+{
+   const GLuint bytes = vertex_size * sizeof(fi_type);
+   GLuint table_size = 64, num_unique = 0, i;
+   GLuint *table;
+
+   while (table_size < 2 * count)
+      table_size *= 2;
+
+   /* unique vertex number + 1, 0 for empty slots */
+   table = calloc(table_size, sizeof(GLuint));
+   if (!table)
+      return 0;
+
+   for (i = 0; i < count; i++) {
+      const fi_type *v = vertices + i * vertex_size;
+      GLuint slot = _mesa_hash_data(v, bytes) & (table_size - 1);
+
+      while (table[slot] &&
+             memcmp(vertices + (table[slot] - 1) * vertex_size, v, bytes))
+         slot = (slot + 1) & (table_size - 1);
+
+      if (!table[slot]) {
+         if (num_unique != i)
+            memcpy(vertices + num_unique * vertex_size, v, bytes);
+         table[slot] = ++num_unique;
+      }
+      indices[i] = table[slot] - 1;
+   }
+
+   free(table);
+   return num_unique;
+}
+
+
+/**
+ * Build the merged vertex list of the run and put it in place of the last
+ * list of the run.
+ */
+static bool
+merge_run(struct gl_context *ctx, struct merge_run *run,
+          const struct vbo_save_list_item *items)
+{
+   const GLuint opcode = vbo_context(ctx)->save.opcode_vertex_list;
+   struct vbo_save_vertex_list *node;
+   struct vbo_save_vertex_store *vertex_store = NULL;
+   struct vbo_save_primitive_store *prim_store = NULL;
+   struct gl_buffer_object *index_buffer = NULL;
+   struct merge_current current;
+   GLubyte attrsz[VBO_ATTRIB_MAX];
+   GLuint vertex_size = 0, num_unique, last_vertex, current_size, i, j, k;
+   fi_type *vertices = NULL, *dst, *current_data = NULL;
+   GLushort *indices = NULL;
+   GLfloat *src = NULL;
+
+   /* Size of each attribute in the merged list */
+   memset(attrsz, 0, sizeof(attrsz));
+   current = run->start;
+   for (i = run->first; i <= run->last; i++) {
+      if (!items[i].data) {
+         set_current(&current, &items[i]);
+         continue;
+      }
+
+      node = (struct vbo_save_vertex_list *) items[i].data;
+      for (j = 0; j < VBO_ATTRIB_MAX; j++) {
+         if (run->used & BITFIELD64_BIT(j)) {
+            GLuint size = node->attrsz[j] ? node->attrsz[j] : current.size[j];
+            attrsz[j] = MAX2(attrsz[j], size);
+         }
+      }
+      update_current(&current, node);
+   }
+
+   for (j = 0; j < VBO_ATTRIB_MAX; j++)
+      vertex_size += attrsz[j];
+
+   vertices = malloc(run->num_vertices * vertex_size * sizeof(fi_type));
+   indices = malloc(run->num_vertices * sizeof(GLushort));
+   if (!vertices || !indices)
+      goto fail;
+
+   /* Copy the vertices, filling in the attributes a list doesn't have
+    * with the current values at that point.
+    */
+   dst = vertices;
+   current = run->start;
+   for (i = run->first; i <= run->last; i++) {
+      if (!items[i].data) {
+         set_current(&current, &items[i]);
+         continue;
+      }
+
+      node = (struct vbo_save_vertex_list *) items[i].data;
+      src = malloc(node->count * node->vertex_size * sizeof(GLfloat));
+      if (!src)
+         goto fail;
+
+      ctx->Driver.GetBufferSubData(ctx, node->buffer_offset,
+                                   node->count * node->vertex_size *
+                                   sizeof(GLfloat),
+                                   src, node->vertex_store->bufferobj);
+
+      for (k = 0; k < node->count; k++) {
+         const GLfloat *in = src + k * node->vertex_size;
+
+         for (j = 0; j < VBO_ATTRIB_MAX; j++) {
+            GLfloat value[4];
+
+            if (!attrsz[j])
+               continue;
+
+            if (node->attrsz[j]) {
+               ASSIGN_4V(value, 0, 0, 0, 1);
+               memcpy(value, in, node->attrsz[j] * sizeof(GLfloat));
+               in += node->attrsz[j];
+               memcpy(dst, value, attrsz[j] * sizeof(GLfloat));
+            }
+            else {
+               memcpy(dst, current.value[j], attrsz[j] * sizeof(GLfloat));
+            }
+            dst += attrsz[j];
+         }
+      }
+
+      free(src);
+      src = NULL;
+      update_current(&current, node);
+   }
+
+   num_unique = dedup_vertices(vertices, run->num_vertices, vertex_size,
+                               indices);
+   if (!num_unique)
+      goto fail;
+
+   last_vertex = indices[run->num_vertices - 1];
+
+   /* copy of the last vertex for _playback_copy_to_current() */
+   current_size = vertex_size - attrsz[VBO_ATTRIB_POS];
+   if (current_size) {
+      current_data = malloc(current_size * sizeof(fi_type));
+      if (!current_data)
+         goto fail;
+      memcpy(current_data,
+             vertices + last_vertex * vertex_size + attrsz[VBO_ATTRIB_POS],
+             current_size * sizeof(fi_type));
+   }
+
+   vertex_store = CALLOC_STRUCT(vbo_save_vertex_store);
+   prim_store = CALLOC_STRUCT(vbo_save_primitive_store);
+   if (!vertex_store || !prim_store)
+      goto fail;
+
+   vertex_store->bufferobj = ctx->Driver.NewBufferObject(ctx, VBO_BUF_ID);
+   if (!vertex_store->bufferobj ||
+       !ctx->Driver.BufferData(ctx, GL_ARRAY_BUFFER_ARB,
+                               num_unique * vertex_size * sizeof(fi_type),
+                               vertices, GL_STATIC_DRAW_ARB,
+                               GL_MAP_WRITE_BIT | GL_DYNAMIC_STORAGE_BIT,
+                               vertex_store->bufferobj))
+      goto fail;
+   vertex_store->used = num_unique * vertex_size;
+
+   /* Only index the list if some vertices are shared. */
+   if (num_unique < run->num_vertices) {
+      index_buffer = ctx->Driver.NewBufferObject(ctx, VBO_BUF_ID);
+      if (!index_buffer ||
+          !ctx->Driver.BufferData(ctx, GL_ELEMENT_ARRAY_BUFFER_ARB,
+                                  run->num_vertices * sizeof(GLushort),
+                                  indices, GL_STATIC_DRAW_ARB,
+                                  GL_MAP_WRITE_BIT | GL_DYNAMIC_STORAGE_BIT,
+                                  index_buffer))
+         goto fail;
+   }
+
+   memcpy(prim_store->buffer, run->prim,
+          run->prim_count * sizeof(struct _mesa_prim));
+   prim_store->used = run->prim_count;
+   for (i = 0; i < run->prim_count; i++)
+      prim_store->buffer[i].indexed = index_buffer != NULL;
+
+   /* Nothing can fail anymore, rewrite the lists. */
+   for (i = run->first; i <= run->last; i++) {
+      if (!items[i].data)
+         continue;
+
+      assert(items[i].opcode == opcode);
+      node = (struct vbo_save_vertex_list *) items[i].data;
+      vbo_destroy_vertex_list(ctx, node);
+
+      node->vertex_store = vertex_store;
+      node->prim_store = prim_store;
+      vertex_store->refcount++;
+      prim_store->refcount++;
+
+      node->prim = prim_store->buffer;
+      node->buffer_offset = 0;
+      node->wrap_count = 0;
+      node->dangling_attr_ref = GL_FALSE;
+      memset(&node->ib, 0, sizeof(node->ib));
+
+      if (i == run->last) {
+         memcpy(node->attrsz, attrsz, sizeof(attrsz));
+         for (j = 0; j < VBO_ATTRIB_MAX; j++)
+            node->attrtype[j] = GL_FLOAT;
+         node->vertex_size = vertex_size;
+         node->count = num_unique;
+         node->prim_count = run->prim_count;
+         node->current_size = current_size;
+         node->current_data = current_data;
+
+         if (index_buffer) {
+            node->ib.count = run->num_vertices;
+            node->ib.type = GL_UNSIGNED_SHORT;
+            node->ib.obj = index_buffer;
+            node->ib.ptr = NULL;
+         }
+      }
+      else {
+         node->count = 0;
+         node->prim_count = 0;
+         node->current_size = 0;
+         node->current_data = NULL;
+      }
+   }
+
+   free(vertices);
+   free(indices);
+   return true;
+
+fail:
+   if (vertex_store) {
+      _mesa_reference_buffer_object(ctx, &vertex_store->bufferobj, NULL);
+      free(vertex_store);
+   }
+   _mesa_reference_buffer_object(ctx, &index_buffer, NULL);
+   free(prim_store);
+   free(current_data);
+   free(src);
+   free(vertices);
+   free(indices);
+   return false;
+}
+
+
+static void
+finish_run(struct gl_context *ctx, struct merge_run *run,
+           const struct vbo_save_list_item *items, GLuint *draws_after)
+{
+   if (run->num_lists == 0)
+      return;
+
+   if (run->num_lists > 1 && merge_run(ctx, run, items))
+      *draws_after += run->prim_count;
+   else
+      *draws_after += run->draws;
+
+   run->num_lists = 0;
+}
+
+
+static void
+start_run(struct merge_run *run, const struct merge_current *current,
+          GLuint first)
+{
+   run->first = run->last = first;
+   run->num_lists = 0;
+   run->num_vertices = 0;
+   run->draws = 0;
+   run->used = 0;
+   run->defined = ~(GLbitfield64) 0;
+   run->pending = 0;
+   run->start = *current;
+   run->prim_count = 0;
+}
+
+
+/**
+ * Called by glEndList with a sequence of display list instructions which
+ * only consists of extension opcodes and current attribute changes.
+ * Adds the number of prims drawn by the vbo vertex lists before and after
+ * merging to draws_before and draws_after.
+ */
+void
+vbo_save_merge_vertex_lists(struct gl_context *ctx,
+                            const struct vbo_save_list_item *items,
+                            GLuint count,
+                            GLuint *draws_before, GLuint *draws_after)
+{
+   const GLuint opcode = vbo_context(ctx)->save.opcode_vertex_list;
+   struct merge_context *merge = CALLOC_STRUCT(merge_context);
+   GLuint i;
+
+   for (i = 0; i < count; i++) {
+      const struct vbo_save_list_item *item = &items[i];
+      struct vbo_save_vertex_list *node;
+      GLbitfield64 node_defined;
+
+      if (!item->data) {
+         if (merge) {
+            set_current(&merge->current, item);
+            merge->run.pending |= BITFIELD64_BIT(item->attr);
+         }
+         continue;
+      }
+
+      if (item->opcode != opcode) {
+         /* some other extension opcode, may change anything */
+         if (merge) {
+            finish_run(ctx, &merge->run, items, draws_after);
+            merge->current.known = 0;
+         }
+         continue;
+      }
+
+      node = (struct vbo_save_vertex_list *) item->data;
+      *draws_before += node->prim_count;
+
+      if (!merge) {
+         *draws_after += node->prim_count;
+         continue;
+      }
+
+      if (!is_mergeable(node)) {
+         finish_run(ctx, &merge->run, items, draws_after);
+         *draws_after += node->prim_count;
+         merge->current.known &= ~list_attribs(node);
+         continue;
+      }
+
+      node_defined = list_attribs(node) | merge->current.known;
+
+      if (!merge->run.num_lists ||
+          !add_to_run(&merge->run, node, node_defined)) {
+         finish_run(ctx, &merge->run, items, draws_after);
+         start_run(&merge->run, &merge->current, i);
+         if (!add_to_run(&merge->run, node, node_defined)) {
+            /* the list itself has both generics and materials */
+            *draws_after += node->prim_count;
+            merge->current.known &= ~list_attribs(node);
+            continue;
+         }
+      }
+
+      merge->run.last = i;
+      update_current(&merge->current, node);
+   }
+
+   if (merge) {
+      finish_run(ctx, &merge->run, items, draws_after);
+      free(merge);
+   }
+}